@@ -217,6 +217,11 @@ template <typename... Middlewares> class Crow
         return utility::getElementByType<T, Middlewares...>(middlewares);
     }
 
+    std::shared_ptr<asio::io_context> getIoContext()
+    {
+        return io;
+    }
+
     template <typename Duration, typename Func> self_t& tick(Duration d, Func f)
     {
         tickInterval = std::chrono::duration_cast<std::chrono::milliseconds>(d);
@@ -10,6 +10,7 @@
 #include <boost/beast/http.hpp>
 #include <boost/beast/websocket.hpp>
 #include <chrono>
+#include <deque>
 #include <vector>
 
 #include "crow/http_response.h"
@@ -348,6 +349,24 @@ class Connection
             res.isAliveHelper = [this]() -> bool {
                 return adaptor.lowest_layer().is_open();
             };
+            // Chunked transfer encoding only exists in HTTP/1.1; older
+            // clients get the streamed output buffered into one body.
+            if (req->version() == 11)
+            {
+                res.streamStartHandler = [this] { startStreaming(); };
+                res.streamChunkHandler = [this](std::string&& chunk) {
+                    queueStreamChunk(std::move(chunk));
+                };
+                res.streamBacklogHelper = [this]() -> size_t {
+                    return streamBacklogBytes;
+                };
+            }
+            else
+            {
+                res.streamStartHandler = nullptr;
+                res.streamChunkHandler = nullptr;
+                res.streamBacklogHelper = nullptr;
+            }
 
             ctx = detail::Context<Middlewares...>();
             req->middlewareContext = (void*)&ctx;
@@ -402,6 +421,20 @@ class Connection
         // auto self = this->shared_from_this();
         res.completeRequestHandler = res.completeRequestHandler = [] {};
 
+        if (streamActive)
+        {
+            // Headers and body are already on their way; all that's left is
+            // the terminating chunk.
+            if (!adaptor.lowest_layer().is_open() && !streamWriteInProgress)
+            {
+                isWriting = false;
+                checkDestroy();
+                return;
+            }
+            doStreamWrite();
+            return;
+        }
+
         if (!adaptor.lowest_layer().is_open())
         {
             // BMCWEB_LOG_DEBUG << this << " delete (socket is closed) " <<
@@ -538,37 +571,169 @@ class Connection
             adaptor, *serializer,
             [&](const boost::system::error_code& ec,
                 std::size_t bytes_transferred) {
-                isWriting = false;
                 BMCWEB_LOG_DEBUG << this << " Wrote " << bytes_transferred
                                  << " bytes";
+                completeWrite(ec);
+            });
+    }
+
+    void completeWrite(const boost::system::error_code& ec)
+    {
+        isWriting = false;
+        streamActive = false;
+
+        if (ec)
+        {
+            BMCWEB_LOG_DEBUG << this << " from write(2)";
+            checkDestroy();
+            return;
+        }
+        if (!res.keepAlive())
+        {
+            adaptor.lowest_layer().close();
+            BMCWEB_LOG_DEBUG << this << " from write(1)";
+            checkDestroy();
+            return;
+        }
+
+        serializer.reset();
+        BMCWEB_LOG_DEBUG << this << " Clearing response";
+        res.clear();
+        parser.emplace(std::piecewise_construct, std::make_tuple());
+        parser->body_limit(httpReqBodyLimit); // reset body limit for
+                                              // newly created parser
+        buffer.consume(buffer.size());
+
+        req.emplace(parser->get());
+        doReadHeaders();
+    }
+
+    void startStreaming()
+    {
+        BMCWEB_LOG_DEBUG << this << " Starting chunked response";
+        // Headers can't change once they're on the wire, so the middlewares
+        // get their afterHandle call now instead of at the end of the body.
+        if (needToCallAfterHandlers)
+        {
+            needToCallAfterHandlers = false;
+            detail::afterHandlersCallHelper<((int)sizeof...(Middlewares) - 1),
+                                            decltype(ctx),
+                                            decltype(*middlewares)>(
+                *middlewares, ctx, *req, res);
+        }
+        res.addHeader(boost::beast::http::field::server, serverName);
+        res.addHeader(boost::beast::http::field::date, getCachedDateStr());
+        res.keepAlive(req->keepAlive());
+        res.stringResponse->chunked(true);
+
+        // Anything written before the stream started goes out first
+        if (!res.body().empty())
+        {
+            queueStreamChunk(std::move(res.body()));
+            res.body().clear();
+        }
 
+        streamActive = true;
+        isWriting = true;
+        streamWriteInProgress = true;
+        serializer.emplace(*res.stringResponse);
+        boost::beast::http::async_write_header(
+            adaptor, *serializer,
+            [this](const boost::system::error_code& ec, std::size_t) {
+                streamWriteInProgress = false;
                 if (ec)
                 {
-                    BMCWEB_LOG_DEBUG << this << " from write(2)";
-                    checkDestroy();
-                    return;
-                }
-                if (!res.keepAlive())
-                {
-                    adaptor.lowest_layer().close();
-                    BMCWEB_LOG_DEBUG << this << " from write(1)";
-                    checkDestroy();
+                    failStream();
                     return;
                 }
+                doStreamWrite();
+            });
+    }
 
-                serializer.reset();
-                BMCWEB_LOG_DEBUG << this << " Clearing response";
-                res.clear();
-                parser.emplace(std::piecewise_construct, std::make_tuple());
-                parser->body_limit(httpReqBodyLimit); // reset body limit for
-                                                      // newly created parser
-                buffer.consume(buffer.size());
+    void queueStreamChunk(std::string&& chunk)
+    {
+        if (!adaptor.lowest_layer().is_open())
+        {
+            return;
+        }
+        streamBacklogBytes += chunk.size();
+        streamChunks.emplace_back(std::move(chunk));
+        if (streamActive)
+        {
+            doStreamWrite();
+        }
+    }
 
-                req.emplace(parser->get());
-                doReadHeaders();
+    void doStreamWrite()
+    {
+        if (streamWriteInProgress)
+        {
+            return;
+        }
+        if (!streamChunks.empty())
+        {
+            streamWriteInProgress = true;
+            boost::asio::async_write(
+                adaptor,
+                boost::beast::http::make_chunk(
+                    boost::asio::buffer(streamChunks.front())),
+                [this](const boost::system::error_code& ec, std::size_t) {
+                    streamWriteInProgress = false;
+                    streamBacklogBytes -= streamChunks.front().size();
+                    streamChunks.pop_front();
+                    if (ec)
+                    {
+                        failStream();
+                        return;
+                    }
+                    if (streamChunks.empty() && res.streamDrainedHandler)
+                    {
+                        std::function<void()> drained =
+                            std::move(res.streamDrainedHandler);
+                        res.streamDrainedHandler = nullptr;
+                        drained();
+                    }
+                    doStreamWrite();
+                });
+            return;
+        }
+        if (!res.completed)
+        {
+            // Wait for the handler to produce more
+            return;
+        }
+        streamWriteInProgress = true;
+        boost::asio::async_write(
+            adaptor, boost::beast::http::make_chunk_last(),
+            [this](const boost::system::error_code& ec, std::size_t) {
+                streamWriteInProgress = false;
+                completeWrite(ec);
             });
     }
 
+    void failStream()
+    {
+        BMCWEB_LOG_DEBUG << this << " Chunked write failed";
+        adaptor.lowest_layer().close();
+        streamChunks.clear();
+        streamBacklogBytes = 0;
+        if (res.completed)
+        {
+            isWriting = false;
+            checkDestroy();
+            return;
+        }
+        // The handler still owns the response; let anything waiting on the
+        // backlog run so it notices the dead socket and calls end().
+        if (res.streamDrainedHandler)
+        {
+            std::function<void()> drained =
+                std::move(res.streamDrainedHandler);
+            res.streamDrainedHandler = nullptr;
+            drained();
+        }
+    }
+
     void checkDestroy()
     {
         BMCWEB_LOG_DEBUG << this << " isReading " << isReading << " isWriting "
@@ -630,6 +795,12 @@ class Connection
     bool needToCallAfterHandlers{};
     bool needToStartReadAfterComplete{};
 
+    // State for chunked (streamed) responses
+    bool streamActive{};
+    bool streamWriteInProgress{};
+    std::deque<std::string> streamChunks;
+    size_t streamBacklogBytes{};
+
     std::tuple<Middlewares...>* middlewares;
     detail::Context<Middlewares...> ctx;
 
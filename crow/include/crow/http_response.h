@@ -76,6 +76,7 @@ struct Response
         r.stringResponse.emplace(response_type{});
         jsonValue = std::move(r.jsonValue);
         completed = r.completed;
+        streaming = r.streaming;
         return *this;
     }
 
@@ -130,6 +131,8 @@ struct Response
         stringResponse.emplace(response_type{});
         jsonValue.clear();
         completed = false;
+        streaming = false;
+        streamDrainedHandler = nullptr;
     }
 
     void write(boost::string_view body_part)
@@ -164,10 +167,89 @@ struct Response
         return isAliveHelper && isAliveHelper();
     }
 
+    // A Response that isn't owned by a connection, such as one operation of
+    // a batch request, gets its completion and liveness from whoever owns it.
+    void setCompleteRequestHandler(std::function<void()>&& handler)
+    {
+        completeRequestHandler = std::move(handler);
+    }
+
+    void setIsAliveHelper(std::function<bool()>&& helper)
+    {
+        isAliveHelper = std::move(helper);
+    }
+
+    // True when startStreaming() will put a chunked body on the wire rather
+    // than buffering it.
+    bool canStream() const noexcept
+    {
+        return static_cast<bool>(streamStartHandler) &&
+               static_cast<bool>(streamChunkHandler);
+    }
+
+    // Sends the status line and headers now, and every later writeChunk()
+    // as its own HTTP/1.1 chunk.  end() terminates the body.  Connections
+    // that can't carry a chunked body (HTTP/1.0, or a response that isn't
+    // attached to a connection) fall back to buffering the chunks into
+    // body(), so callers don't need to care which one they got.
+    void startStreaming()
+    {
+        if (streaming || completed)
+        {
+            return;
+        }
+        streaming = true;
+        if (streamStartHandler)
+        {
+            streamStartHandler();
+        }
+    }
+
+    void writeChunk(std::string&& chunk)
+    {
+        if (!streaming || !streamChunkHandler)
+        {
+            write(chunk);
+            return;
+        }
+        if (!chunk.empty())
+        {
+            streamChunkHandler(std::move(chunk));
+        }
+    }
+
+    bool isStreaming() const noexcept
+    {
+        return streaming;
+    }
+
+    // Bytes handed to writeChunk() that haven't reached the socket yet.
+    // Producers use this to stop generating output for a slow client.
+    size_t streamBacklog()
+    {
+        return streamBacklogHelper ? streamBacklogHelper() : 0;
+    }
+
+    // Called once when the streamed backlog has been fully written.
+    void onStreamDrained(std::function<void()>&& handler)
+    {
+        if (streamBacklog() == 0)
+        {
+            handler();
+            return;
+        }
+        streamDrainedHandler = std::move(handler);
+    }
+
   private:
     bool completed{};
+    bool streaming{};
     std::function<void()> completeRequestHandler;
     std::function<bool()> isAliveHelper;
+    std::function<void()> streamStartHandler;
+    std::function<void(std::string&&)> streamChunkHandler;
+    std::function<size_t()> streamBacklogHelper;
+    std::function<void()> streamDrainedHandler;
 
     // In case of a JSON object, set the Content-Type header
     void jsonMode()
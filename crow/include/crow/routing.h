@@ -307,7 +307,7 @@ class WebSocketRule : public BaseRule
     {
         new crow::websocket::ConnectionImpl<boost::asio::ip::tcp::socket>(
             req, std::move(adaptor), openHandler, messageHandler, closeHandler,
-            errorHandler);
+            errorHandler, deflateOptions);
     }
 #ifdef BMCWEB_ENABLE_SSL
     void handleUpgrade(const Request& req, Response&,
@@ -319,7 +319,7 @@ class WebSocketRule : public BaseRule
             myConnection = std::make_shared<crow::websocket::ConnectionImpl<
                 boost::beast::ssl_stream<boost::asio::ip::tcp::socket>>>(
                 req, std::move(adaptor), openHandler, messageHandler,
-                closeHandler, errorHandler);
+                closeHandler, errorHandler, deflateOptions);
         myConnection->start();
     }
 #endif
@@ -348,6 +348,14 @@ class WebSocketRule : public BaseRule
         return *this;
     }
 
+    // Offers permessage-deflate to clients of this route
+    self_t& deflate(crow::websocket::DeflateOptions options = {})
+    {
+        options.enable = true;
+        deflateOptions = options;
+        return *this;
+    }
+
   protected:
     std::function<void(crow::websocket::Connection&)> openHandler;
     std::function<void(crow::websocket::Connection&, const std::string&, bool)>
@@ -355,6 +363,7 @@ class WebSocketRule : public BaseRule
     std::function<void(crow::websocket::Connection&, const std::string&)>
         closeHandler;
     std::function<void(crow::websocket::Connection&)> errorHandler;
+    crow::websocket::DeflateOptions deflateOptions;
 };
 
 template <typename T> struct RuleParameterTraits
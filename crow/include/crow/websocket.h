@@ -1,9 +1,14 @@
 #pragma once
+#include <algorithm>
 #include <array>
 #include <boost/algorithm/string/predicate.hpp>
 #include <boost/asio/buffer.hpp>
 #include <boost/beast/websocket.hpp>
+#include <cstdint>
+#include <deque>
 #include <functional>
+#include <memory>
+#include <vector>
 
 #include "crow/http_request.h"
 
@@ -15,6 +20,132 @@ namespace crow
 {
 namespace websocket
 {
+// What happens to messages sent while more than the send queue limit is
+// waiting to be written
+enum class OverflowPolicy
+{
+    // Queue them anyway.  congested() tells producers to hold off, and the
+    // drain handler is called once the queue is down to half the limit.
+    pause,
+    // Discard them
+    drop,
+    // Close the connection
+    close
+};
+
+struct SendQueueStats
+{
+    size_t queuedBytes = 0;
+    size_t queuedMessages = 0;
+    size_t peakBytes = 0;
+    size_t droppedMessages = 0;
+    size_t droppedBytes = 0;
+    // Messages and the writes they went out in, which can be fewer when
+    // messages are coalesced
+    size_t messagesWritten = 0;
+    size_t writes = 0;
+};
+
+// Connections close rather than queue more than this, unless they set a limit
+// of their own
+constexpr size_t defaultSendQueueLimit = 16 * 1024 * 1024;
+
+// permessage-deflate settings for a route.  A compressed connection keeps a
+// deflate stream of about (1 << (windowBits + 2)) + (1 << (memLevel + 9))
+// bytes and an inflate stream of about 1 << windowBits, so the defaults are
+// well below zlib's to suit the BMC's memory.  Each message is compressed
+// on its own, so small ones gain little unless the route also coalesces.
+struct DeflateOptions
+{
+    bool enable = false;
+    // 9 to 15.  Clients are asked for the same limit, which bounds the
+    // window needed to inflate what they send.
+    int windowBits = 12;
+    // 1 to 9
+    int memLevel = 4;
+    // 0 to 9
+    int level = 6;
+};
+
+struct CompressionStats
+{
+    // Whether the client took up permessage-deflate
+    bool negotiated = false;
+    // Message payloads, and the frames that carried them
+    uint64_t payloadBytesSent = 0;
+    uint64_t wireBytesSent = 0;
+    uint64_t payloadBytesReceived = 0;
+    uint64_t wireBytesReceived = 0;
+};
+
+// Passes a stream through, counting the bytes that cross it
+template <typename NextLayer> class CountingStream
+{
+  public:
+    using next_layer_type = NextLayer;
+    using executor_type = typename NextLayer::executor_type;
+
+    explicit CountingStream(NextLayer&& nextIn) : next(std::move(nextIn))
+    {
+    }
+
+    executor_type get_executor() noexcept
+    {
+        return next.get_executor();
+    }
+
+    NextLayer& next_layer()
+    {
+        return next;
+    }
+
+    template <typename Buffers, typename Handler>
+    void async_read_some(const Buffers& buffers, Handler&& handler)
+    {
+        next.async_read_some(
+            buffers, [count{&bytesRead},
+                      handler{std::forward<Handler>(handler)}](
+                         boost::system::error_code ec, size_t n) mutable {
+                *count += n;
+                handler(ec, n);
+            });
+    }
+
+    template <typename Buffers, typename Handler>
+    void async_write_some(const Buffers& buffers, Handler&& handler)
+    {
+        next.async_write_some(
+            buffers, [count{&bytesWritten},
+                      handler{std::forward<Handler>(handler)}](
+                         boost::system::error_code ec, size_t n) mutable {
+                *count += n;
+                handler(ec, n);
+            });
+    }
+
+    uint64_t bytesRead = 0;
+    uint64_t bytesWritten = 0;
+
+  private:
+    NextLayer next;
+};
+
+template <typename NextLayer>
+void teardown(boost::beast::role_type role, CountingStream<NextLayer>& stream,
+              boost::system::error_code& ec)
+{
+    using boost::beast::websocket::teardown;
+    teardown(role, stream.next_layer(), ec);
+}
+
+template <typename NextLayer, typename Handler>
+void async_teardown(boost::beast::role_type role,
+                    CountingStream<NextLayer>& stream, Handler&& handler)
+{
+    using boost::beast::websocket::async_teardown;
+    async_teardown(role, stream.next_layer(), std::forward<Handler>(handler));
+}
+
 struct Connection : std::enable_shared_from_this<Connection>
 {
   public:
@@ -23,10 +154,24 @@ struct Connection : std::enable_shared_from_this<Connection>
 
     virtual void sendBinary(const boost::beast::string_view msg) = 0;
     virtual void sendBinary(std::string&& msg) = 0;
+    // Sends a buffer that may also be queued on other connections
+    virtual void sendBinary(std::shared_ptr<const std::string> msg) = 0;
     virtual void sendText(const boost::beast::string_view msg) = 0;
     virtual void sendText(std::string&& msg) = 0;
     virtual void close(const boost::beast::string_view msg = "quit") = 0;
     virtual boost::asio::io_context& get_io_context() = 0;
+    // Bytes queued for sending, including a write in progress
+    virtual size_t sendQueueSize() const = 0;
+    virtual void setSendQueueLimit(size_t limit, OverflowPolicy policy) = 0;
+    // Whether a pause policy limit has been passed, and not drained since
+    virtual bool congested() const = 0;
+    virtual void onDrain(std::function<void(Connection&)> handler) = 0;
+    // For byte stream protocols, where message boundaries don't matter.
+    // Consecutive binary messages may then go out as one message, written
+    // straight from their buffers.
+    virtual void setCoalescing(bool coalesce) = 0;
+    virtual SendQueueStats sendQueueStats() const = 0;
+    virtual CompressionStats compressionStats() const = 0;
     virtual ~Connection() = default;
 
     void userdata(void* u)
@@ -53,7 +198,8 @@ template <typename Adaptor> class ConnectionImpl : public Connection
         std::function<void(Connection&, const std::string&, bool)>
             message_handler,
         std::function<void(Connection&, const std::string&)> close_handler,
-        std::function<void(Connection&)> error_handler) :
+        std::function<void(Connection&)> error_handler,
+        const DeflateOptions& deflate = DeflateOptions()) :
         inString(),
         inBuffer(inString, 4096), ws(std::move(adaptorIn)), Connection(req),
         openHandler(std::move(open_handler)),
@@ -62,6 +208,21 @@ template <typename Adaptor> class ConnectionImpl : public Connection
         errorHandler(std::move(error_handler))
     {
         BMCWEB_LOG_DEBUG << "Creating new connection " << this;
+        if (deflate.enable)
+        {
+            boost::beast::websocket::permessage_deflate option;
+            option.server_enable = true;
+            option.server_max_window_bits = deflate.windowBits;
+            option.client_max_window_bits = deflate.windowBits;
+            option.memLevel = deflate.memLevel;
+            option.compLevel = deflate.level;
+            ws.set_option(option);
+            // Beast takes up any valid offer once the server side is enabled
+            compression.negotiated = boost::algorithm::icontains(
+                req.getHeaderValue(
+                    boost::beast::http::field::sec_websocket_extensions),
+                "permessage-deflate");
+        }
     }
 
     boost::asio::io_context& get_io_context() override
@@ -69,6 +230,63 @@ template <typename Adaptor> class ConnectionImpl : public Connection
         return ws.get_executor().context();
     }
 
+    ~ConnectionImpl()
+    {
+        BMCWEB_LOG_DEBUG << "Websocket " << this << " wrote "
+                         << stats.messagesWritten << " messages in "
+                         << stats.writes << " writes, peak queue "
+                         << stats.peakBytes << " bytes, dropped "
+                         << stats.droppedMessages;
+        CompressionStats current = compressionStats();
+        if (current.negotiated && current.wireBytesSent != 0)
+        {
+            BMCWEB_LOG_DEBUG << "Websocket " << this << " compressed "
+                             << current.payloadBytesSent << " bytes to "
+                             << current.wireBytesSent;
+        }
+    }
+
+    size_t sendQueueSize() const override
+    {
+        return stats.queuedBytes;
+    }
+
+    void setSendQueueLimit(size_t limit, OverflowPolicy policy) override
+    {
+        queueLimit = limit;
+        overflowPolicy = policy;
+    }
+
+    bool congested() const override
+    {
+        return isCongested;
+    }
+
+    void onDrain(std::function<void(Connection&)> handler) override
+    {
+        drainHandler = std::move(handler);
+    }
+
+    void setCoalescing(bool coalesce) override
+    {
+        coalescing = coalesce;
+    }
+
+    SendQueueStats sendQueueStats() const override
+    {
+        SendQueueStats current = stats;
+        current.queuedMessages = outBuffer.size();
+        return current;
+    }
+
+    CompressionStats compressionStats() const override
+    {
+        CompressionStats current = compression;
+        current.wireBytesSent = ws.next_layer().bytesWritten;
+        current.wireBytesReceived = ws.next_layer().bytesRead;
+        return current;
+    }
+
     void start()
     {
         BMCWEB_LOG_DEBUG << "starting connection " << this;
@@ -99,34 +317,36 @@ template <typename Adaptor> class ConnectionImpl : public Connection
 
     void sendBinary(const boost::beast::string_view msg) override
     {
-        ws.binary(true);
-        outBuffer.emplace_back(msg);
-        doWrite();
+        queue(std::make_shared<const std::string>(msg), true);
     }
 
     void sendBinary(std::string&& msg) override
     {
-        ws.binary(true);
-        outBuffer.emplace_back(std::move(msg));
-        doWrite();
+        queue(std::make_shared<const std::string>(std::move(msg)), true);
+    }
+
+    void sendBinary(std::shared_ptr<const std::string> msg) override
+    {
+        queue(std::move(msg), true);
     }
 
     void sendText(const boost::beast::string_view msg) override
     {
-        ws.text(true);
-        outBuffer.emplace_back(msg);
-        doWrite();
+        queue(std::make_shared<const std::string>(msg), false);
     }
 
     void sendText(std::string&& msg) override
     {
-        ws.text(true);
-        outBuffer.emplace_back(std::move(msg));
-        doWrite();
+        queue(std::make_shared<const std::string>(std::move(msg)), false);
     }
 
     void close(const boost::beast::string_view msg) override
     {
+        if (closing)
+        {
+            return;
+        }
+        closing = true;
         ws.async_close(
             boost::beast::websocket::close_code::normal,
             [this, self(shared_from_this())](boost::system::error_code ec) {
@@ -145,6 +365,9 @@ template <typename Adaptor> class ConnectionImpl : public Connection
     void acceptDone()
     {
         BMCWEB_LOG_DEBUG << "Websocket accepted connection";
+        // Count only websocket frames, not the upgrade response
+        ws.next_layer().bytesWritten = 0;
+        ws.next_layer().bytesRead = 0;
 
         if (openHandler)
         {
@@ -171,6 +394,7 @@ template <typename Adaptor> class ConnectionImpl : public Connection
                     }
                     return;
                 }
+                compression.payloadBytesReceived += bytes_read;
                 if (messageHandler)
                 {
                     messageHandler(*this, inString, ws.got_text());
@@ -181,6 +405,47 @@ template <typename Adaptor> class ConnectionImpl : public Connection
             });
     }
 
+    void queue(std::shared_ptr<const std::string>&& msg, bool binary)
+    {
+        if (closing)
+        {
+            return;
+        }
+        // A message is always let into an empty queue, however large
+        if (!outBuffer.empty() &&
+            stats.queuedBytes + msg->size() > queueLimit)
+        {
+            if (overflowPolicy == OverflowPolicy::drop)
+            {
+                stats.droppedMessages++;
+                stats.droppedBytes += msg->size();
+                return;
+            }
+            if (overflowPolicy == OverflowPolicy::close)
+            {
+                BMCWEB_LOG_ERROR << "Websocket " << this
+                                 << " send queue full, closing";
+                // Keep only what's being written
+                for (auto it = outBuffer.begin() + writingMessages;
+                     it != outBuffer.end(); it++)
+                {
+                    stats.droppedMessages++;
+                    stats.droppedBytes += it->data->size();
+                    stats.queuedBytes -= it->data->size();
+                }
+                outBuffer.erase(outBuffer.begin() + writingMessages,
+                                outBuffer.end());
+                close("Send queue full");
+                return;
+            }
+            isCongested = true;
+        }
+        stats.queuedBytes += msg->size();
+        stats.peakBytes = std::max(stats.peakBytes, stats.queuedBytes);
+        outBuffer.push_back({std::move(msg), binary});
+        doWrite();
+    }
+
     void doWrite()
     {
         // If we're already doing a write, ignore the request, it will be picked
@@ -195,13 +460,39 @@ template <typename Adaptor> class ConnectionImpl : public Connection
             // Done for now
             return;
         }
+
+        const bool binary = outBuffer.front().binary;
+        writeBuffers.clear();
+        for (const OutMessage& message : outBuffer)
+        {
+            if (message.binary != binary ||
+                writeBuffers.size() == maxCoalescedMessages)
+            {
+                break;
+            }
+            writeBuffers.emplace_back(boost::asio::buffer(*message.data));
+            if (!coalescing || !binary)
+            {
+                break;
+            }
+        }
+        writingMessages = writeBuffers.size();
         doingWrite = true;
+        ws.binary(binary);
         ws.async_write(
-            boost::asio::buffer(outBuffer.front()),
+            writeBuffers,
             [this, self(shared_from_this())](boost::beast::error_code ec,
                                              std::size_t bytes_written) {
                 doingWrite = false;
-                outBuffer.erase(outBuffer.begin());
+                stats.writes++;
+                for (size_t i = 0; i < writingMessages; i++)
+                {
+                    stats.queuedBytes -= outBuffer.front().data->size();
+                    outBuffer.pop_front();
+                }
+                stats.messagesWritten += writingMessages;
+                compression.payloadBytesSent += bytes_written;
+                writingMessages = 0;
                 if (ec == boost::beast::websocket::error::closed)
                 {
                     // Do nothing here.  doRead handler will call the
@@ -214,20 +505,49 @@ template <typename Adaptor> class ConnectionImpl : public Connection
                     BMCWEB_LOG_ERROR << "Error in ws.async_write " << ec;
                     return;
                 }
+                if (isCongested && stats.queuedBytes <= queueLimit / 2)
+                {
+                    isCongested = false;
+                    if (drainHandler)
+                    {
+                        drainHandler(*this);
+                    }
+                }
                 doWrite();
             });
     }
 
   private:
-    boost::beast::websocket::stream<Adaptor> ws;
+    boost::beast::websocket::stream<CountingStream<Adaptor>> ws;
 
     std::string inString;
     boost::asio::dynamic_string_buffer<std::string::value_type,
                                        std::string::traits_type,
                                        std::string::allocator_type>
         inBuffer;
-    std::vector<std::string> outBuffer;
+    struct OutMessage
+    {
+        // Shared so one message can be queued on many connections
+        std::shared_ptr<const std::string> data;
+        bool binary;
+    };
+
+    // Enough to catch up a backlog in a few writes, well within IOV_MAX
+    static constexpr size_t maxCoalescedMessages = 64;
+
+    std::deque<OutMessage> outBuffer;
+    // The messages at the front of outBuffer that are being written
+    size_t writingMessages = 0;
+    std::vector<boost::asio::const_buffer> writeBuffers;
     bool doingWrite = false;
+    bool coalescing = false;
+    bool closing = false;
+    size_t queueLimit = defaultSendQueueLimit;
+    OverflowPolicy overflowPolicy = OverflowPolicy::close;
+    bool isCongested = false;
+    SendQueueStats stats;
+    std::function<void(Connection&)> drainHandler;
+    CompressionStats compression;
 
     std::function<void(Connection&)> openHandler;
     std::function<void(Connection&, const std::string&, bool)> messageHandler;
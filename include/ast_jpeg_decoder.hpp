@@ -2,12 +2,17 @@
 
 #include <aspeed/JTABLES.H>
 
+#include <algorithm>
 #include <array>
+#include <ast_jpeg_huffman.hpp>
+#include <ast_jpeg_kernels.hpp>
 #include <ast_video_types.hpp>
+#include <ast_worker_pool.hpp>
 #include <cassert>
 #include <cstdint>
 #include <cstring>
 #include <iostream>
+#include <memory>
 #include <vector>
 
 namespace ast_video
@@ -60,7 +65,10 @@ enum class JpgBlock
 class AstJpegDecoder
 {
   public:
-    AstJpegDecoder()
+    // useVectorKernels selects the vector IDCT and color conversion where the
+    // compiler supports them; the scalar path is kept as the reference
+    AstJpegDecoder(bool useVectorKernels = true) :
+        vectorKernels(useVectorKernels)
     {
         // TODO(ed) figure out how to init this in the constructor
         yuvBuffer.resize(1920 * 1200);
@@ -383,8 +391,15 @@ class AstJpegDecoder
         bytePos += 64;
     }
 
-    void idctTransform(short *coef, uint8_t *data, uint8_t nBlock)
+    void idctTransform(const short *coef, uint8_t *data, uint8_t nBlock)
     {
+#ifdef AST_JPEG_VECTOR_KERNELS
+        if (vectorKernels)
+        {
+            kernels::idctTransform(coef, splitQt[nBlock].data(), data);
+            return;
+        }
+#endif
 #define FIX_1_082392200 ((int)277) /* FIX(1.082392200) */
 #define FIX_1_414213562 ((int)362) /* FIX(1.414213562) */
 #define FIX_1_847759065 ((int)473) /* FIX(1.847759065) */
@@ -397,7 +412,7 @@ class AstJpegDecoder
         int z5, z10, z11, z12, z13;
         int workspace[64]; /* buffers data between passes */
 
-        short *inptr = coef;
+        const short *inptr = coef;
         long *quantptr;
         int *wsptr = workspace;
         unsigned char *outptr;
@@ -589,6 +604,23 @@ class AstJpegDecoder
         int nBlocksInMcu = 6;
         unsigned int pixelX, pixelY;
 
+#ifdef AST_JPEG_VECTOR_KERNELS
+        if (vectorKernels)
+        {
+            if (yuvmode == YuvMode::YUV444)
+            {
+                kernels::yuv444ToRgb(pYCbCr,
+                                     reinterpret_cast<unsigned char *>(pYUV),
+                                     pBgr, (tyb * 8 * width) + txb * 8, width);
+            }
+            else
+            {
+                kernels::yuv420ToRgb(pYCbCr, pBgr,
+                                     (tyb * 16 * width) + txb * 16, width);
+            }
+            return;
+        }
+#endif
         pByte = reinterpret_cast<struct RGB *>(pBgr);
         if (yuvmode == YuvMode::YUV444)
         {
@@ -668,6 +700,23 @@ class AstJpegDecoder
         int nBlocksInMcu = 6;
         unsigned int pixelX, pixelY;
 
+#ifdef AST_JPEG_VECTOR_KERNELS
+        if (vectorKernels)
+        {
+            if (yuvmode == YuvMode::YUV444)
+            {
+                kernels::yuv444AddToRgb(
+                    pYCbCr, reinterpret_cast<unsigned char *>(pYUV), pBgr,
+                    (tyb * 8 * width) + txb * 8, width);
+            }
+            else
+            {
+                kernels::yuv420ToRgb(pYCbCr, pBgr,
+                                     (tyb * 16 * width) + txb * 16, width);
+            }
+            return;
+        }
+#endif
         pByte = reinterpret_cast<struct RGB *>(pBgr);
         if (yuvmode == YuvMode::YUV444)
         {
@@ -685,7 +734,8 @@ class AstJpegDecoder
                 {
                     m = ((j << 3) + i);
                     n = pos + i;
-                    y = pYUV[n].g + (py[m] - 128);
+                    // Wraps like cb and cr; an int sum could index past mY
+                    y = static_cast<unsigned char>(pYUV[n].g + (py[m] - 128));
                     cb = pYUV[n].b + (pcb[m] - 128);
                     cr = pYUV[n].r + (pcr[m] - 128);
                     pYUV[n].b = cb;
@@ -729,111 +779,177 @@ class AstJpegDecoder
             }
         }
     }
-    void decompress(int txb, int tyb, char *outBuf, uint8_t QT_TableSelection)
+    // A block entropy decoded by the first stage of a threaded decode, with
+    // the offset of its coefficients, or for VQ its pixels
+    struct BlockJob
     {
-        unsigned char *ptr;
-        unsigned char byTileYuv[768] = {};
-
-        memset(dctCoeff, 0, 384 * 2);
-        ptr = byTileYuv;
-        processHuffmanDataUnit(ydcNr, yacNr, &dcy, 0);
-        idctTransform(dctCoeff, ptr, QT_TableSelection);
-        ptr += 64;
-
-        if (yuvmode == YuvMode::YUV420)
+        enum class Kind
         {
-            processHuffmanDataUnit(ydcNr, yacNr, &dcy, 64);
-            idctTransform(dctCoeff + 64, ptr, QT_TableSelection);
-            ptr += 64;
-
-            processHuffmanDataUnit(ydcNr, yacNr, &dcy, 128);
-            idctTransform(dctCoeff + 128, ptr, QT_TableSelection);
-            ptr += 64;
+            jpeg,
+            jpegPass2,
+            vq
+        };
+        Kind kind;
+        int txb;
+        int tyb;
+        uint8_t table;
+        size_t offset;
+    };
+
+    // Blocks in a JPEG coded MCU: Y, Cb and Cr, with four Y blocks for
+    // YUV420.  A second pass block is always Y, Cb and Cr.
+    size_t blocksInMcu(bool pass2) const
+    {
+        return pass2 || yuvmode == YuvMode::YUV444 ? 3 : 6;
+    }
 
-            processHuffmanDataUnit(ydcNr, yacNr, &dcy, 192);
-            idctTransform(dctCoeff + 192, ptr, QT_TableSelection);
-            ptr += 64;
+    // Entropy decodes the coefficients of the next MCU into coef
+    void readCoefficients(short *coef, size_t blocks)
+    {
+        std::fill(coef, coef + blocks * 64, 0);
+        // A local copy stays in registers for the whole MCU
+        huffman::BitReader bits = reader;
+        for (size_t block = 0; block < blocks - 2; block++)
+        {
+            processHuffmanDataUnit(bits, ydcNr, yacNr, &dcy,
+                                   coef + block * 64);
+        }
+        processHuffmanDataUnit(bits, cbDcNr, cbAcNr, &dcCb,
+                               coef + (blocks - 2) * 64);
+        processHuffmanDataUnit(bits, crDcNr, crAcNr, &dcCr,
+                               coef + (blocks - 1) * 64);
+        reader = bits;
+    }
 
-            processHuffmanDataUnit(cbDcNr, cbAcNr, &dcCb, 256);
-            idctTransform(dctCoeff + 256, ptr, QT_TableSelection + 1);
-            ptr += 64;
+    // Transforms and color converts an MCU from its coefficients.  This only
+    // touches the pixels of the MCU, so MCUs can be reconstructed in any
+    // order, or at the same time on different threads.
+    void reconstruct(int txb, int tyb, const short *coef, size_t blocks,
+                     bool pass2, uint8_t QT_TableSelection)
+    {
+        unsigned char byTileYuv[768] = {};
+        for (size_t block = 0; block < blocks; block++)
+        {
+            // Luma uses the selected table, chroma the one after it
+            uint8_t table = block < blocks - 2 ? QT_TableSelection
+                                               : QT_TableSelection + 1;
+            idctTransform(coef + block * 64, byTileYuv + block * 64, table);
+        }
 
-            processHuffmanDataUnit(crDcNr, crAcNr, &dcCr, 320);
-            idctTransform(dctCoeff + 320, ptr, QT_TableSelection + 1);
+        //  yuvBuffer for YUV record
+        if (pass2)
+        {
+            yuvToBuffer(txb, tyb, byTileYuv, yuvBuffer.data(),
+                        reinterpret_cast<unsigned char *>(outBuffer.data()));
         }
         else
         {
-            processHuffmanDataUnit(cbDcNr, cbAcNr, &dcCb, 64);
-            idctTransform(dctCoeff + 64, ptr, QT_TableSelection + 1);
-            ptr += 64;
-
-            processHuffmanDataUnit(crDcNr, crAcNr, &dcCr, 128);
-            idctTransform(dctCoeff + 128, ptr, QT_TableSelection + 1);
+            yuvToRgb(txb, tyb, byTileYuv, yuvBuffer.data(),
+                     reinterpret_cast<unsigned char *>(outBuffer.data()));
         }
-
-        //    yuvToRgb (txb, tyb, byTileYuv, (unsigned char *)outBuf);
-        //  yuvBuffer for YUV record
-        yuvToRgb(txb, tyb, byTileYuv, yuvBuffer.data(),
-                 reinterpret_cast<unsigned char *>(outBuf));
     }
 
-    void decompress2Pass(int txb, int tyb, char *outBuf,
-                         uint8_t QT_TableSelection)
+    // Reads the color of each pixel of a VQ block into yuv, laid out as Y, Cb
+    // and Cr planes
+    void readVqBlock(const ColorCache &VQ, unsigned char *yuv)
     {
-        unsigned char *ptr;
-        unsigned char byTileYuv[768];
-        memset(dctCoeff, 0, 384 * 2);
-
-        ptr = byTileYuv;
-        processHuffmanDataUnit(ydcNr, yacNr, &dcy, 0);
-        idctTransform(dctCoeff, ptr, QT_TableSelection);
-        ptr += 64;
-
-        processHuffmanDataUnit(cbDcNr, cbAcNr, &dcCb, 64);
-        idctTransform(dctCoeff + 64, ptr, QT_TableSelection + 1);
-        ptr += 64;
+        unsigned char *ptr = yuv;
+        for (int i = 0; i < 64; i++)
+        {
+            int data = 0;
+            if (VQ.bitMapBits != 0)
+            {
+                data = static_cast<int>(lookKbits(VQ.bitMapBits));
+                skipKbits(VQ.bitMapBits);
+            }
+            ptr[0] = (VQ.color[VQ.index[data]] & 0xFF0000) >> 16;
+            ptr[64] = (VQ.color[VQ.index[data]] & 0x00FF00) >> 8;
+            ptr[128] = VQ.color[VQ.index[data]] & 0x0000FF;
+            ptr += 1;
+        }
+    }
 
-        processHuffmanDataUnit(crDcNr, crAcNr, &dcCr, 128);
-        idctTransform(dctCoeff + 128, ptr, QT_TableSelection + 1);
+    void decodeJpegBlock(uint8_t QT_TableSelection, bool pass2)
+    {
+        size_t blocks = blocksInMcu(pass2);
+        if (workers != nullptr)
+        {
+            size_t offset = jobCoefficients.size();
+            jobCoefficients.resize(offset + blocks * 64);
+            readCoefficients(&jobCoefficients[offset], blocks);
+            jobs.push_back({pass2 ? BlockJob::Kind::jpegPass2
+                                  : BlockJob::Kind::jpeg,
+                            txb, tyb, QT_TableSelection, offset});
+            return;
+        }
+        decodeBlock(txb, tyb, [&] {
+            readCoefficients(dctCoeff, blocks);
+            reconstruct(txb, tyb, dctCoeff, blocks, pass2, QT_TableSelection);
+        });
+    }
 
-        yuvToBuffer(txb, tyb, byTileYuv, yuvBuffer.data(),
-                    reinterpret_cast<unsigned char *>(outBuf));
-        //    yuvToRgb (txb, tyb, byTileYuv, (unsigned char *)outBuf);
+    void decodeVqBlock(const ColorCache &VQ)
+    {
+        if (workers != nullptr)
+        {
+            size_t offset = jobPixels.size();
+            jobPixels.resize(offset + 192);
+            readVqBlock(VQ, &jobPixels[offset]);
+            jobs.push_back({BlockJob::Kind::vq, txb, tyb, 0, offset});
+            return;
+        }
+        decodeBlock(txb, tyb, [&] {
+            unsigned char byTileYuv[192];
+            readVqBlock(VQ, byTileYuv);
+            yuvToRgb(txb, tyb, byTileYuv, yuvBuffer.data(),
+                     reinterpret_cast<unsigned char *>(outBuffer.data()));
+        });
     }
 
-    void vqDecompress(int txb, int tyb, char *outBuf, uint8_t QT_TableSelection,
-                      struct ColorCache *VQ)
+    void runJob(const BlockJob &job)
     {
-        unsigned char *ptr, i;
-        unsigned char byTileYuv[192];
-        int data;
+        decodeBlock(job.txb, job.tyb, [&] {
+            if (job.kind == BlockJob::Kind::vq)
+            {
+                yuvToRgb(job.txb, job.tyb, &jobPixels[job.offset],
+                         yuvBuffer.data(),
+                         reinterpret_cast<unsigned char *>(outBuffer.data()));
+                return;
+            }
+            bool pass2 = job.kind == BlockJob::Kind::jpegPass2;
+            reconstruct(job.txb, job.tyb, &jobCoefficients[job.offset],
+                        blocksInMcu(pass2), pass2, job.table);
+        });
+    }
 
-        ptr = byTileYuv;
-        if (VQ->bitMapBits == 0)
-        {
-            for (i = 0; i < 64; i++)
+    // Second stage of a threaded decode.  Each thread takes whole rows of
+    // tiles and runs their blocks in stream order, so a tile that appears
+    // twice in a frame still ends up as the serial decode would leave it.
+    void runJobs()
+    {
+        size_t threads = workers->size();
+        workers->run([this, threads](size_t index) {
+            for (const BlockJob &job : jobs)
             {
-                ptr[0] = (VQ->color[VQ->index[0]] & 0xFF0000) >> 16;
-                ptr[64] = (VQ->color[VQ->index[0]] & 0x00FF00) >> 8;
-                ptr[128] = VQ->color[VQ->index[0]] & 0x0000FF;
-                ptr += 1;
+                if (isTileInFrame(job.txb, job.tyb) &&
+                    static_cast<size_t>(job.tyb) % threads == index)
+                {
+                    runJob(job);
+                }
             }
-        }
-        else
+        });
+        // Blocks placed outside the frame by a bad stream write into other
+        // rows, so they're left until the threads are done
+        for (const BlockJob &job : jobs)
         {
-            for (i = 0; i < 64; i++)
+            if (!isTileInFrame(job.txb, job.tyb))
             {
-                data = static_cast<int>(lookKbits(VQ->bitMapBits));
-                ptr[0] = (VQ->color[VQ->index[data]] & 0xFF0000) >> 16;
-                ptr[64] = (VQ->color[VQ->index[data]] & 0x00FF00) >> 8;
-                ptr[128] = VQ->color[VQ->index[data]] & 0x0000FF;
-                ptr += 1;
-                skipKbits(VQ->bitMapBits);
+                runJob(job);
             }
         }
-        //    yuvToRgb (txb, tyb, byTileYuv, (unsigned char *)outBuf);
-        yuvToRgb(txb, tyb, byTileYuv, yuvBuffer.data(),
-                 reinterpret_cast<unsigned char *>(outBuf));
+        jobs.clear();
+        jobCoefficients.clear();
+        jobPixels.clear();
     }
 
     void moveBlockIndex()
@@ -912,83 +1028,21 @@ class AstJpegDecoder
                 }
         */
     }
-    void loadHuffmanTable(HuffmanTable *HT, const unsigned char *nrcode,
-                          const unsigned char *value,
-                          const unsigned short int *Huff_code)
-    {
-        unsigned char k, j, i;
-        unsigned int code, codeIndex;
-
-        for (j = 1; j <= 16; j++)
-        {
-            HT->length[j] = nrcode[j];
-        }
-        for (i = 0, k = 1; k <= 16; k++)
-        {
-            for (j = 0; j < HT->length[k]; j++)
-            {
-                HT->v[wordHiLo(k, j)] = value[i];
-                i++;
-            }
-        }
-
-        code = 0;
-        for (k = 1; k <= 16; k++)
-        {
-            HT->minorCode[k] = static_cast<unsigned short int>(code);
-            for (j = 1; j <= HT->length[k]; j++)
-            {
-                code++;
-            }
-            HT->majorCode[k] = static_cast<unsigned short int>(code - 1);
-            code *= 2;
-            if (HT->length[k] == 0)
-            {
-                HT->minorCode[k] = 0xFFFF;
-                HT->majorCode[k] = 0;
-            }
-        }
-
-        HT->len[0] = 2;
-        i = 2;
-
-        for (codeIndex = 1; codeIndex < 65535; codeIndex++)
-        {
-            if (codeIndex < Huff_code[i])
-            {
-                HT->len[codeIndex] =
-                    static_cast<unsigned char>(Huff_code[i + 1]);
-            }
-            else
-            {
-                i = i + 2;
-                HT->len[codeIndex] =
-                    static_cast<unsigned char>(Huff_code[i + 1]);
-            }
-        }
-    }
     void initJpgTable()
     {
         initColorTable();
         prepareRangeLimitTable();
-        loadHuffmanTable(&htdc[0], stdDcLuminanceNrcodes, stdDcLuminanceValues,
-                         dcLuminanceHuffmancode);
-        loadHuffmanTable(&htac[0], stdAcLuminanceNrcodes, stdAcLuminanceValues,
-                         acLuminanceHuffmancode);
-        loadHuffmanTable(&htdc[1], stdDcChrominanceNrcodes,
-                         stdDcChrominanceValues, dcChrominanceHuffmancode);
-        loadHuffmanTable(&htac[1], stdAcChrominanceNrcodes,
-                         stdAcChrominanceValues, acChrominanceHuffmancode);
     }
 
     void prepareRangeLimitTable()
     /* Allocate and fill in the sample_range_limit table */
     {
         int j;
-        rlimitTable = reinterpret_cast<unsigned char *>(malloc(5 * 256L + 128));
-        /* First segment of "simple" table: limit[x] = 0 for x < 0 */
-        memset((void *)rlimitTable, 0, 256);
-        rlimitTable += 256; /* allow negative subscripts of simple table */
+        rlimitTable = reinterpret_cast<unsigned char *>(malloc(6 * 256L + 128));
+        /* First segment of "simple" table: limit[x] = 0 for x < 0.  The
+         * strongest blue shift of a dark pixel reaches down to -277 */
+        memset((void *)rlimitTable, 0, 512);
+        rlimitTable += 512; /* allow negative subscripts of simple table */
         /* Main part of "simple" table: limit[x] = x */
         for (j = 0; j < 256; j++)
         {
@@ -1008,130 +1062,49 @@ class AstJpegDecoder
         }
     }
 
-    inline unsigned short int wordHiLo(uint8_t byte_high, uint8_t byte_low)
+    // Inlined into each call in readCoefficients, where bits can be kept in
+    // registers, which the compiler won't do on its own for three calls
+    __attribute__((always_inline)) void
+        processHuffmanDataUnit(huffman::BitReader &bits, uint8_t DC_nr,
+                               uint8_t AC_nr, signed short int *previous_DC,
+                               short *coef)
     {
-        return (byte_high << 8) + byte_low;
-    }
-
-    // river
-    void processHuffmanDataUnit(uint8_t DC_nr, uint8_t AC_nr,
-                                signed short int *previous_DC,
-                                unsigned short int position)
-    {
-        uint8_t nr = 0;
-        uint8_t k;
-        unsigned short int tmpHcode;
-        uint8_t sizeVal, count0;
-        unsigned short int *minCode;
-        uint8_t *huffValues;
-        uint8_t byteTemp;
-
-        minCode = htdc[DC_nr].minorCode;
-        //   maj_code=htdc[DC_nr].majorCode;
-        huffValues = htdc[DC_nr].v;
-
-        // DC
-        k = htdc[DC_nr].len[static_cast<unsigned short int>(codebuf >> 16)];
-        // river
-        //	 tmp_Hcode=lookKbits(k);
-        tmpHcode = static_cast<unsigned short int>(codebuf >> (32 - k));
-        skipKbits(k);
-        sizeVal = huffValues[wordHiLo(
-            k, static_cast<uint8_t>(tmpHcode - minCode[k]))];
-        if (sizeVal == 0)
-        {
-            dctCoeff[position + 0] = *previous_DC;
-        }
-        else
-        {
-            dctCoeff[position + 0] = *previous_DC + getKbits(sizeVal);
-            *previous_DC = dctCoeff[position + 0];
-        }
+        const huffman::Table &dcTable =
+            DC_nr == 0 ? huffman::dcLuminance : huffman::dcChrominance;
+        const huffman::Table &acTable =
+            AC_nr == 0 ? huffman::acLuminance : huffman::acChrominance;
 
-        // Second, AC coefficient decoding
-        minCode = htac[AC_nr].minorCode;
-        //   maj_code=htac[AC_nr].majorCode;
-        huffValues = htac[AC_nr].v;
+        int value;
+        huffman::decode(bits, dcTable, value);
+        *previous_DC = static_cast<short>(*previous_DC + value);
+        coef[0] = *previous_DC;
 
-        nr = 1; // AC coefficient
+        unsigned int nr = 1; // AC coefficient
         do
         {
-            k = htac[AC_nr].len[static_cast<unsigned short int>(codebuf >> 16)];
-            tmpHcode = static_cast<unsigned short int>(codebuf >> (32 - k));
-            skipKbits(k);
-
-            byteTemp = huffValues[wordHiLo(
-                k, static_cast<uint8_t>(tmpHcode - minCode[k]))];
-            sizeVal = byteTemp & 0xF;
-            count0 = byteTemp >> 4;
-            if (sizeVal == 0)
-            {
-                if (count0 != 0xF)
-                {
-                    break;
-                }
-                nr += 16;
-            }
-            else
+            int symbol = huffman::decode(bits, acTable, value);
+            // Skip count_0 zeroes.  An end of block or a run of 16 zeroes
+            // stores a 0, where nothing has been stored yet.  The standard
+            // tables have no other symbol with no magnitude than those two.
+            nr += symbol >> 4;
+            coef[dezigzag[nr++]] = static_cast<short>(value);
+            if (symbol == 0)
             {
-                nr += count0; // skip count_0 zeroes
-                dctCoeff[position + dezigzag[nr++]] = getKbits(sizeVal);
+                break;
             }
         } while (nr < 64);
     }
 
     unsigned short int lookKbits(uint8_t k)
     {
-        unsigned short int revcode;
-
-        revcode = static_cast<unsigned short int>(codebuf >> (32 - k));
-
-        return (revcode);
+        return static_cast<unsigned short int>(reader.peek(k));
     }
 
     void skipKbits(uint8_t k)
     {
-        unsigned long readbuf;
-
-        if ((newbits - k) <= 0)
-        {
-            readbuf = buffer[bufferIndex];
-            bufferIndex++;
-            codebuf = (codebuf << k) |
-                      ((newbuf | (readbuf >> (newbits))) >> (32 - k));
-            newbuf = readbuf << (k - newbits);
-            newbits = 32 + newbits - k;
-        }
-        else
-        {
-            codebuf = (codebuf << k) | (newbuf >> (32 - k));
-            newbuf = newbuf << k;
-            newbits -= k;
-        }
+        reader.skip(k);
     }
 
-    signed short int getKbits(uint8_t k)
-    {
-        signed short int signedWordvalue;
-
-        // river
-        // signed_wordvalue=lookKbits(k);
-        signedWordvalue = static_cast<unsigned short int>(codebuf >> (32 - k));
-        if (((1L << (k - 1)) & signedWordvalue) == 0)
-        {
-            // neg_pow2 was previously defined as the below.  It seemed silly to
-            // keep a table of values around for something THat's relatively
-            // easy to compute, so it was replaced with the appropriate math
-            // signed_wordvalue = signed_wordvalue - (0xFFFF >> (16 - k));
-            std::array<signed short int, 17> negPow2 = {
-                0,    -1,   -3,    -7,    -15,   -31,   -63,    -127,
-                -255, -511, -1023, -2047, -4095, -8191, -16383, -32767};
-
-            signedWordvalue = signedWordvalue + negPow2[k];
-        }
-        skipKbits(k);
-        return signedWordvalue;
-    }
     int initJpgDecoding()
     {
         bytePos = 0;
@@ -1140,6 +1113,12 @@ class AstJpegDecoder
         //  Note: Added for Dual-JPEG
         loadAdvanceQuantTable(qt[2]);
         loadAdvanceQuantTableCb(qt[3]);
+#ifdef AST_JPEG_VECTOR_KERNELS
+        for (size_t i = 0; i < qt.size(); i++)
+        {
+            kernels::splitQuantTable(qt[i].data(), splitQt[i].data());
+        }
+#endif
         return 1;
     }
 
@@ -1165,44 +1144,37 @@ class AstJpegDecoder
         }
     }
 
-    void updatereadbuf(uint32_t *codebuf, uint32_t *newbuf, int walks,
-                       int *newbits, std::vector<uint32_t> &buffer)
+    // Decodes with up to this many threads.  The entropy decode is serial,
+    // but the IDCT and color conversion of each block is independent, and are
+    // spread across the threads once the whole frame has been entropy
+    // decoded.  0 or 1 decodes each block in turn on the calling thread.
+    void setDecodeThreads(size_t threads)
     {
-        unsigned long readbuf;
-
-        if ((*newbits - walks) <= 0)
+        if (threads <= 1)
         {
-            readbuf = buffer[bufferIndex];
-            bufferIndex++;
-            *codebuf = (*codebuf << walks) |
-                       ((*newbuf | (readbuf >> (*newbits))) >> (32 - walks));
-            *newbuf = readbuf << (walks - *newbits);
-            *newbits = 32 + *newbits - walks;
+            workers.reset();
         }
-        else
+        else if (workers == nullptr || workers->size() != threads)
         {
-            *codebuf = (*codebuf << walks) | (*newbuf >> (32 - walks));
-            *newbuf = *newbuf << walks;
-            *newbits -= walks;
+            workers = std::make_unique<WorkerPool>(threads);
         }
     }
 
-    uint32_t decode(std::vector<uint32_t> &bufferVector, unsigned long width,
-                    unsigned long height, YuvMode yuvmode_in, int ySelector,
-                    int uvSelector)
+    uint32_t decode(std::vector<uint32_t> &bufferVector,
+                    unsigned long width_in, unsigned long height_in,
+                    YuvMode yuvmode_in, int ySelector_in, int uvSelector_in)
     {
-        ColorCache decodeColor;
-        if (width != userWidth || height != userHeight ||
-            yuvmode_in != yuvmode || ySelector != ySelector ||
-            uvSelector != uvSelector)
+        if (width_in != userWidth || height_in != userHeight ||
+            yuvmode_in != yuvmode || ySelector_in != ySelector ||
+            uvSelector_in != uvSelector)
         {
             yuvmode = yuvmode_in;
-            ySelector = ySelector;   // 0-7
-            uvSelector = uvSelector; // 0-7
-            userHeight = height;
-            userWidth = width;
-            width = width;
-            height = height;
+            ySelector = ySelector_in;   // 0-7
+            uvSelector = uvSelector_in; // 0-7
+            userHeight = height_in;
+            userWidth = width_in;
+            width = width_in;
+            height = height_in;
 
             // TODO(ed) Magic number section.  Document appropriately
             advanceSelector = 0; // 0-7
@@ -1232,16 +1204,30 @@ class AstJpegDecoder
             }
 
             initJpgDecoding();
+
+            // Whatever was in the buffer belongs to the old mode
+            tileColumns = width / tileSize();
+            tileRows = height / tileSize();
+            dirtyTiles.assign(tileColumns * tileRows, 1);
+        }
+        else
+        {
+            std::fill(dirtyTiles.begin(), dirtyTiles.end(), 0);
+        }
+        uint32_t result = decodeStream(bufferVector);
+        if (workers != nullptr)
+        {
+            runJobs();
         }
-        // TODO(ed) cleanup cruft
-        buffer = bufferVector.data();
+        return result;
+    }
 
-        codebuf = bufferVector[0];
-        newbuf = bufferVector[1];
-        bufferIndex = 2;
+    uint32_t decodeStream(std::vector<uint32_t> &bufferVector)
+    {
+        ColorCache decodeColor;
+        reader.reset(bufferVector.data());
 
         txb = tyb = 0;
-        newbits = 32;
         dcy = dcCb = dcCr = 0;
 
         static const uint32_t vqHeaderMask = 0x01;
@@ -1257,207 +1243,175 @@ class AstJpegDecoder
 
         do
         {
-            auto blockHeader = static_cast<JpgBlock>((codebuf >> 28) & 0xFF);
+            auto blockHeader =
+                static_cast<JpgBlock>((reader.word() >> 28) & 0xFF);
             switch (blockHeader)
             {
                 case JpgBlock::JPEG_NO_SKIP_CODE:
-                    updatereadbuf(&codebuf, &newbuf, blockAsT2100StartLength,
-                                  &newbits, bufferVector);
-                    decompress(txb, tyb,
-                               reinterpret_cast<char *>(outBuffer.data()), 0);
+                    skipKbits(blockAsT2100StartLength);
+                    decodeJpegBlock(0, false);
                     break;
                 case JpgBlock::FRAME_END_CODE:
                     return 0;
                     break;
                 case JpgBlock::JPEG_SKIP_CODE:
 
-                    txb = (codebuf & 0x0FF00000) >> 20;
-                    tyb = (codebuf & 0x0FF000) >> 12;
+                    txb = (reader.word() & 0x0FF00000) >> 20;
+                    tyb = (reader.word() & 0x0FF000) >> 12;
 
-                    updatereadbuf(&codebuf, &newbuf, blockAsT2100SkipLength,
-                                  &newbits, bufferVector);
-                    decompress(txb, tyb,
-                               reinterpret_cast<char *>(outBuffer.data()), 0);
+                    skipKbits(blockAsT2100SkipLength);
+                    decodeJpegBlock(0, false);
                     break;
                 case JpgBlock::VQ_NO_SKIP_1_COLOR_CODE:
-                    updatereadbuf(&codebuf, &newbuf, blockAsT2100StartLength,
-                                  &newbits, bufferVector);
+                    skipKbits(blockAsT2100StartLength);
                     decodeColor.bitMapBits = 0;
 
                     for (int i = 0; i < 1; i++)
                     {
-                        decodeColor.index[i] = ((codebuf >> 29) & vqIndexMask);
-                        if (((codebuf >> 31) & vqHeaderMask) ==
+                        decodeColor.index[i] =
+                            ((reader.word() >> 29) & vqIndexMask);
+                        if (((reader.word() >> 31) & vqHeaderMask) ==
                             vqNoUpdateHeader)
                         {
-                            updatereadbuf(&codebuf, &newbuf, vqNoUpdateLength,
-                                          &newbits, bufferVector);
+                            skipKbits(vqNoUpdateLength);
                         }
                         else
                         {
                             decodeColor.color[decodeColor.index[i]] =
-                                ((codebuf >> 5) & vqColorMask);
-                            updatereadbuf(&codebuf, &newbuf, vqUpdateLength,
-                                          &newbits, bufferVector);
+                                ((reader.word() >> 5) & vqColorMask);
+                            skipKbits(vqUpdateLength);
                         }
                     }
-                    vqDecompress(txb, tyb,
-                                 reinterpret_cast<char *>(outBuffer.data()), 0,
-                                 &decodeColor);
+                    decodeVqBlock(decodeColor);
                     break;
                 case JpgBlock::VQ_SKIP_1_COLOR_CODE:
-                    txb = (codebuf & 0x0FF00000) >> 20;
-                    tyb = (codebuf & 0x0FF000) >> 12;
+                    txb = (reader.word() & 0x0FF00000) >> 20;
+                    tyb = (reader.word() & 0x0FF000) >> 12;
 
-                    updatereadbuf(&codebuf, &newbuf, blockAsT2100SkipLength,
-                                  &newbits, bufferVector);
+                    skipKbits(blockAsT2100SkipLength);
                     decodeColor.bitMapBits = 0;
 
                     for (int i = 0; i < 1; i++)
                     {
-                        decodeColor.index[i] = ((codebuf >> 29) & vqIndexMask);
-                        if (((codebuf >> 31) & vqHeaderMask) ==
+                        decodeColor.index[i] =
+                            ((reader.word() >> 29) & vqIndexMask);
+                        if (((reader.word() >> 31) & vqHeaderMask) ==
                             vqNoUpdateHeader)
                         {
-                            updatereadbuf(&codebuf, &newbuf, vqNoUpdateLength,
-                                          &newbits, bufferVector);
+                            skipKbits(vqNoUpdateLength);
                         }
                         else
                         {
                             decodeColor.color[decodeColor.index[i]] =
-                                ((codebuf >> 5) & vqColorMask);
-                            updatereadbuf(&codebuf, &newbuf, vqUpdateLength,
-                                          &newbits, bufferVector);
+                                ((reader.word() >> 5) & vqColorMask);
+                            skipKbits(vqUpdateLength);
                         }
                     }
-                    vqDecompress(txb, tyb,
-                                 reinterpret_cast<char *>(outBuffer.data()), 0,
-                                 &decodeColor);
+                    decodeVqBlock(decodeColor);
                     break;
 
                 case JpgBlock::VQ_NO_SKIP_2_COLOR_CODE:
-                    updatereadbuf(&codebuf, &newbuf, blockAsT2100StartLength,
-                                  &newbits, bufferVector);
+                    skipKbits(blockAsT2100StartLength);
                     decodeColor.bitMapBits = 1;
 
                     for (int i = 0; i < 2; i++)
                     {
-                        decodeColor.index[i] = ((codebuf >> 29) & vqIndexMask);
-                        if (((codebuf >> 31) & vqHeaderMask) ==
+                        decodeColor.index[i] =
+                            ((reader.word() >> 29) & vqIndexMask);
+                        if (((reader.word() >> 31) & vqHeaderMask) ==
                             vqNoUpdateHeader)
                         {
-                            updatereadbuf(&codebuf, &newbuf, vqNoUpdateLength,
-                                          &newbits, bufferVector);
+                            skipKbits(vqNoUpdateLength);
                         }
                         else
                         {
                             decodeColor.color[decodeColor.index[i]] =
-                                ((codebuf >> 5) & vqColorMask);
-                            updatereadbuf(&codebuf, &newbuf, vqUpdateLength,
-                                          &newbits, bufferVector);
+                                ((reader.word() >> 5) & vqColorMask);
+                            skipKbits(vqUpdateLength);
                         }
                     }
-                    vqDecompress(txb, tyb,
-                                 reinterpret_cast<char *>(outBuffer.data()), 0,
-                                 &decodeColor);
+                    decodeVqBlock(decodeColor);
                     break;
                 case JpgBlock::VQ_SKIP_2_COLOR_CODE:
-                    txb = (codebuf & 0x0FF00000) >> 20;
-                    tyb = (codebuf & 0x0FF000) >> 12;
+                    txb = (reader.word() & 0x0FF00000) >> 20;
+                    tyb = (reader.word() & 0x0FF000) >> 12;
 
-                    updatereadbuf(&codebuf, &newbuf, blockAsT2100SkipLength,
-                                  &newbits, bufferVector);
+                    skipKbits(blockAsT2100SkipLength);
                     decodeColor.bitMapBits = 1;
 
                     for (int i = 0; i < 2; i++)
                     {
-                        decodeColor.index[i] = ((codebuf >> 29) & vqIndexMask);
-                        if (((codebuf >> 31) & vqHeaderMask) ==
+                        decodeColor.index[i] =
+                            ((reader.word() >> 29) & vqIndexMask);
+                        if (((reader.word() >> 31) & vqHeaderMask) ==
                             vqNoUpdateHeader)
                         {
-                            updatereadbuf(&codebuf, &newbuf, vqNoUpdateLength,
-                                          &newbits, bufferVector);
+                            skipKbits(vqNoUpdateLength);
                         }
                         else
                         {
                             decodeColor.color[decodeColor.index[i]] =
-                                ((codebuf >> 5) & vqColorMask);
-                            updatereadbuf(&codebuf, &newbuf, vqUpdateLength,
-                                          &newbits, bufferVector);
+                                ((reader.word() >> 5) & vqColorMask);
+                            skipKbits(vqUpdateLength);
                         }
                     }
-                    vqDecompress(txb, tyb,
-                                 reinterpret_cast<char *>(outBuffer.data()), 0,
-                                 &decodeColor);
+                    decodeVqBlock(decodeColor);
 
                     break;
                 case JpgBlock::VQ_NO_SKIP_4_COLOR_CODE:
-                    updatereadbuf(&codebuf, &newbuf, blockAsT2100StartLength,
-                                  &newbits, bufferVector);
+                    skipKbits(blockAsT2100StartLength);
                     decodeColor.bitMapBits = 2;
 
                     for (unsigned char &i : decodeColor.index)
                     {
-                        i = ((codebuf >> 29) & vqIndexMask);
-                        if (((codebuf >> 31) & vqHeaderMask) ==
+                        i = ((reader.word() >> 29) & vqIndexMask);
+                        if (((reader.word() >> 31) & vqHeaderMask) ==
                             vqNoUpdateHeader)
                         {
-                            updatereadbuf(&codebuf, &newbuf, vqNoUpdateLength,
-                                          &newbits, bufferVector);
+                            skipKbits(vqNoUpdateLength);
                         }
                         else
                         {
                             decodeColor.color[i] =
-                                ((codebuf >> 5) & vqColorMask);
-                            updatereadbuf(&codebuf, &newbuf, vqUpdateLength,
-                                          &newbits, bufferVector);
+                                ((reader.word() >> 5) & vqColorMask);
+                            skipKbits(vqUpdateLength);
                         }
                     }
-                    vqDecompress(txb, tyb,
-                                 reinterpret_cast<char *>(outBuffer.data()), 0,
-                                 &decodeColor);
+                    decodeVqBlock(decodeColor);
 
                     break;
 
                 case JpgBlock::VQ_SKIP_4_COLOR_CODE:
-                    txb = (codebuf & 0x0FF00000) >> 20;
-                    tyb = (codebuf & 0x0FF000) >> 12;
+                    txb = (reader.word() & 0x0FF00000) >> 20;
+                    tyb = (reader.word() & 0x0FF000) >> 12;
 
-                    updatereadbuf(&codebuf, &newbuf, blockAsT2100SkipLength,
-                                  &newbits, bufferVector);
+                    skipKbits(blockAsT2100SkipLength);
                     decodeColor.bitMapBits = 2;
 
                     for (unsigned char &i : decodeColor.index)
                     {
-                        i = ((codebuf >> 29) & vqIndexMask);
-                        if (((codebuf >> 31) & vqHeaderMask) ==
+                        i = ((reader.word() >> 29) & vqIndexMask);
+                        if (((reader.word() >> 31) & vqHeaderMask) ==
                             vqNoUpdateHeader)
                         {
-                            updatereadbuf(&codebuf, &newbuf, vqNoUpdateLength,
-                                          &newbits, bufferVector);
+                            skipKbits(vqNoUpdateLength);
                         }
                         else
                         {
                             decodeColor.color[i] =
-                                ((codebuf >> 5) & vqColorMask);
-                            updatereadbuf(&codebuf, &newbuf, vqUpdateLength,
-                                          &newbits, bufferVector);
+                                ((reader.word() >> 5) & vqColorMask);
+                            skipKbits(vqUpdateLength);
                         }
                     }
-                    vqDecompress(txb, tyb,
-                                 reinterpret_cast<char *>(outBuffer.data()), 0,
-                                 &decodeColor);
+                    decodeVqBlock(decodeColor);
 
                     break;
                 case JpgBlock::JPEG_SKIP_PASS2_CODE:
-                    txb = (codebuf & 0x0FF00000) >> 20;
-                    tyb = (codebuf & 0x0FF000) >> 12;
+                    txb = (reader.word() & 0x0FF00000) >> 20;
+                    tyb = (reader.word() & 0x0FF000) >> 12;
 
-                    updatereadbuf(&codebuf, &newbuf, blockAsT2100SkipLength,
-                                  &newbits, bufferVector);
-                    decompress2Pass(txb, tyb,
-                                    reinterpret_cast<char *>(outBuffer.data()),
-                                    2);
+                    skipKbits(blockAsT2100SkipLength);
+                    decodeJpegBlock(2, true);
 
                     break;
                 default:
@@ -1467,11 +1421,34 @@ class AstJpegDecoder
             }
             moveBlockIndex();
 
-        } while (bufferIndex <= bufferVector.size());
+        } while (reader.index <= bufferVector.size());
 
         return -1;
     }
 
+    // Tiles are the 8x8 (YUV444) or 16x16 (YUV420) blocks of the stream
+    size_t tileSize() const
+    {
+        return yuvmode == YuvMode::YUV444 ? 8 : 16;
+    }
+
+    size_t getTileColumns() const
+    {
+        return tileColumns;
+    }
+
+    size_t getTileRows() const
+    {
+        return tileRows;
+    }
+
+    // Whether the tile at column x, row y changed during the last decode.
+    // Every tile is dirty after the mode or resolution changes.
+    bool isTileDirty(size_t x, size_t y) const
+    {
+        return dirtyTiles[y * tileColumns + x] != 0;
+    }
+
 #ifdef cimg_version
     void dump_to_bitmap_file()
     {
@@ -1491,6 +1468,51 @@ class AstJpegDecoder
 #endif
 
   private:
+    // Decodes the block at txb, tyb and marks its tile dirty if any pixel
+    // changed.  The stream skips unchanged blocks in motion mode, but a full
+    // refresh sends every block again, so the pixels are compared too.
+    bool isTileInFrame(int txb, int tyb) const
+    {
+        return txb >= 0 && tyb >= 0 &&
+               static_cast<size_t>(txb) < tileColumns &&
+               static_cast<size_t>(tyb) < tileRows;
+    }
+
+    template <typename Decompress>
+    void decodeBlock(int txb, int tyb, Decompress &&decompressBlock)
+    {
+        size_t size = tileSize();
+        if (!isTileInFrame(txb, tyb))
+        {
+            decompressBlock();
+            return;
+        }
+        size_t tile = tyb * tileColumns + txb;
+        if (dirtyTiles[tile] != 0)
+        {
+            decompressBlock();
+            return;
+        }
+
+        RGB *origin = outBuffer.data() + (tyb * size * width) + (txb * size);
+        std::array<RGB, 16 * 16> before;
+        for (size_t row = 0; row < size; row++)
+        {
+            std::memcpy(&before[row * size], origin + row * width,
+                        size * sizeof(RGB));
+        }
+        decompressBlock();
+        for (size_t row = 0; row < size; row++)
+        {
+            if (std::memcmp(&before[row * size], origin + row * width,
+                            size * sizeof(RGB)) != 0)
+            {
+                dirtyTiles[tile] = 1;
+                return;
+            }
+        }
+    }
+
     YuvMode yuvmode{};
     // width and height are the modes your display used
     unsigned long width{};
@@ -1509,18 +1531,17 @@ class AstJpegDecoder
 
     // quantization tables, no more than 4 quantization tables
     std::array<std::array<long, 64>, 4> qt{};
+#ifdef AST_JPEG_VECTOR_KERNELS
+    // qt as consumed by the vector IDCT
+    std::array<std::array<int32_t, 128>, 4> splitQt{};
+#endif
 
-    // DC huffman tables , no more than 4 (0..3)
-    std::array<HuffmanTable, 4> htdc{};
-    // AC huffman tables (0..3)
-    std::array<HuffmanTable, 4> htac{};
     std::array<int, 256> mCrToR{};
     std::array<int, 256> mCbToB{};
     std::array<int, 256> mCrToG{};
     std::array<int, 256> mCbToG{};
     std::array<int, 256> mY{};
-    unsigned long bufferIndex{};
-    uint32_t codebuf{}, newbuf{}, readbuf{};
+    huffman::BitReader reader;
     const unsigned char *stdLuminanceQt{};
     const uint8_t *stdChrominanceQt{};
 
@@ -1535,11 +1556,16 @@ class AstJpegDecoder
     uint8_t yacNr = 0, cbAcNr = 1, crAcNr = 1;
     int txb = 0;
     int tyb = 0;
-    int newbits{};
     uint8_t *rlimitTable{};
+    bool vectorKernels;
     std::vector<RGB> yuvBuffer;
-    // TODO(ed) this shouldn't exist.  It is cruft that needs cleaning up
-    uint32_t *buffer{};
+    size_t tileColumns{};
+    size_t tileRows{};
+    std::vector<uint8_t> dirtyTiles;
+    std::unique_ptr<WorkerPool> workers;
+    std::vector<BlockJob> jobs;
+    std::vector<short> jobCoefficients;
+    std::vector<unsigned char> jobPixels;
 
   public:
     std::vector<RGB> outBuffer;
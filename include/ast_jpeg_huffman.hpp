@@ -0,0 +1,212 @@
+#pragma once
+
+#include <aspeed/JTABLES.H>
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+
+namespace ast_video
+{
+namespace huffman
+{
+
+// Codes up to this long are decoded with a single lookup
+constexpr int lookaheadBits = 11;
+
+// Reads the stream MSB first from 32 bit words.  At least 33 bits are always
+// buffered, so any code plus its magnitude bits (at most 16 + 15) can be
+// peeked at once and consumed with a single refill check.
+struct BitReader
+{
+    uint64_t bits = 0;
+    int valid = 0;
+    const uint32_t *words = nullptr;
+    size_t index = 0;
+
+    void reset(const uint32_t *data)
+    {
+        words = data;
+        bits = (static_cast<uint64_t>(data[0]) << 32) | data[1];
+        valid = 64;
+        index = 2;
+    }
+
+    // The next 32 bits of the stream
+    uint32_t word() const
+    {
+        return static_cast<uint32_t>(bits >> 32);
+    }
+
+    uint32_t peek(int k) const
+    {
+        return static_cast<uint32_t>(bits >> (64 - k));
+    }
+
+    void skip(int k)
+    {
+        bits <<= k;
+        valid -= k;
+        if (valid <= 32)
+        {
+            bits |= static_cast<uint64_t>(words[index++]) << (32 - valid);
+            valid += 32;
+        }
+    }
+};
+
+// Sign extends a k bit magnitude as JPEG codes it.  A 0 bit magnitude is 0.
+constexpr int extend(uint32_t value, int k)
+{
+    int threshold = (1 << k) >> 1;
+    int magnitude = static_cast<int>(value);
+    return magnitude < threshold ? magnitude - (1 << k) + 1 : magnitude;
+}
+
+// Codes are at most this long
+constexpr int maxCodeBits = 16;
+constexpr int secondLevelBits = maxCodeBits - lookaheadBits;
+
+// The standard tables leave six lookahead prefixes to longer codes
+constexpr size_t maxSecondLevelTables = 8;
+
+// A lookup entry, indexed by the next lookaheadBits bits of the stream:
+//   bits 0-4   bits to consume, the code and its magnitude, or 0 when the
+//              code is longer than lookahead
+//   bit 5      set when the magnitude was within lookahead
+//   bits 8-15  the symbol, run << 4 | size
+//   bits 16-31 the signed coefficient, when the magnitude was within
+//              lookahead
+// Entries for prefixes of longer codes hold, in bits 8-31, one more than the
+// number of the second level table to look up the bits that follow in.
+constexpr int32_t entryLengthMask = 0x1F;
+constexpr int32_t entryComplete = 0x20;
+
+struct Table
+{
+    std::array<int32_t, 1 << lookaheadBits> fast{};
+    std::array<int32_t, maxSecondLevelTables << secondLevelBits> secondLevel{};
+};
+
+constexpr int32_t makeEntry(int length, uint8_t symbol, uint32_t following,
+                            int followingBits)
+{
+    int size = symbol & 0xF;
+    int32_t entry = (length + size) | (symbol << 8);
+    if (size == 0)
+    {
+        entry |= entryComplete;
+    }
+    else if (size <= followingBits)
+    {
+        // The magnitude is within the bits this entry is indexed by
+        uint32_t magnitude = following >> (followingBits - size);
+        int value = extend(magnitude, size);
+        entry |= entryComplete |
+                 static_cast<int32_t>(static_cast<uint32_t>(value) << 16);
+    }
+    return entry;
+}
+
+// Builds the lookups for the canonical code given by the number of codes of
+// each length and the symbols in code order
+template <size_t N>
+constexpr Table makeTable(const unsigned char (&counts)[17],
+                          const unsigned char (&symbols)[N])
+{
+    Table table;
+    size_t secondLevelTables = 0;
+    int32_t code = 0;
+    size_t index = 0;
+    for (int length = 1; length <= maxCodeBits; length++)
+    {
+        for (int i = 0; i < counts[length]; i++, code++, index++)
+        {
+            uint8_t symbol = symbols[index];
+            if (length <= lookaheadBits)
+            {
+                int shift = lookaheadBits - length;
+                for (int32_t fill = 0; fill < (1 << shift); fill++)
+                {
+                    table.fast[(code << shift) | fill] =
+                        makeEntry(length, symbol, fill, shift);
+                }
+                continue;
+            }
+
+            int32_t prefix = code >> (length - lookaheadBits);
+            if (table.fast[prefix] == 0)
+            {
+                // Fails to compile if a table needs more
+                if (secondLevelTables == maxSecondLevelTables)
+                {
+                    throw "Too many long Huffman code prefixes";
+                }
+                table.fast[prefix] =
+                    static_cast<int32_t>(++secondLevelTables << 8);
+            }
+            size_t base = ((static_cast<size_t>(table.fast[prefix]) >> 8) - 1)
+                          << secondLevelBits;
+            int shift = maxCodeBits - length;
+            int32_t suffix = code & ((1 << (length - lookaheadBits)) - 1);
+            for (int32_t fill = 0; fill < (1 << shift); fill++)
+            {
+                table.secondLevel[base + ((suffix << shift) | fill)] =
+                    makeEntry(length, symbol, fill, shift);
+            }
+        }
+        code <<= 1;
+    }
+    return table;
+}
+
+inline constexpr Table dcLuminance =
+    makeTable(stdDcLuminanceNrcodes, stdDcLuminanceValues);
+inline constexpr Table acLuminance =
+    makeTable(stdAcLuminanceNrcodes, stdAcLuminanceValues);
+inline constexpr Table dcChrominance =
+    makeTable(stdDcChrominanceNrcodes, stdDcChrominanceValues);
+inline constexpr Table acChrominance =
+    makeTable(stdAcChrominanceNrcodes, stdAcChrominanceValues);
+
+// Looks up the code at the front of window, the next 32 bits of the stream.
+// Bit patterns that aren't a code come back as a 16 bit end of block.
+inline int32_t lookup(const Table &table, uint32_t window)
+{
+    int32_t entry = table.fast[window >> (32 - lookaheadBits)];
+    if ((entry & entryLengthMask) != 0)
+    {
+        return entry;
+    }
+    uint32_t secondLevel = static_cast<uint32_t>(entry) >> 8;
+    if (secondLevel != 0)
+    {
+        entry = table.secondLevel[((secondLevel - 1) << secondLevelBits) |
+                                  ((window >> (32 - maxCodeBits)) &
+                                   ((1 << secondLevelBits) - 1))];
+    }
+    return entry != 0 ? entry : maxCodeBits | entryComplete;
+}
+
+// Decodes the next code with table, and its magnitude if it has one.
+// Returns the symbol, storing the coefficient (0 for none) in value.
+inline int decode(BitReader &reader, const Table &table, int &value)
+{
+    uint32_t window = reader.word();
+    int32_t entry = lookup(table, window);
+    int length = entry & entryLengthMask;
+    int symbol = (entry >> 8) & 0xFF;
+    int size = symbol & 0xF;
+
+    // Both outcomes are computed so the choice compiles to a select rather
+    // than a branch on the data.  How far to skip doesn't depend on it.
+    uint32_t magnitude = static_cast<uint32_t>(
+        static_cast<uint64_t>(window << (length - size)) >> (32 - size));
+    bool complete = (entry & entryComplete) != 0;
+    value = complete ? entry >> 16 : extend(magnitude, size);
+    reader.skip(length);
+    return symbol;
+}
+
+} // namespace huffman
+} // namespace ast_video
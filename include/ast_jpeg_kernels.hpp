@@ -0,0 +1,297 @@
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+
+// Vector versions of the per block AstJpegDecoder kernels.  They're written
+// with the GCC/clang vector extensions rather than intrinsics, so the same
+// code is lowered to NEON on the BMC and to SSE2 or AVX2 (depending on -m
+// flags) for the x86 build and tests.  Every kernel produces exactly the same
+// bytes as the scalar code in ast_jpeg_decoder.hpp.
+#if defined(__GNUC__) && defined(__BYTE_ORDER__) &&                           \
+    __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+#define AST_JPEG_VECTOR_KERNELS
+#endif
+
+#ifdef AST_JPEG_VECTOR_KERNELS
+namespace ast_video
+{
+namespace kernels
+{
+
+// 128 bit vectors, the native width of both NEON and SSE2
+typedef int32_t v4i __attribute__((vector_size(16)));
+typedef uint32_t v4u __attribute__((vector_size(16)));
+typedef int16_t v8s __attribute__((vector_size(16)));
+
+// Fixed point constants, computed the same way as the scalar color tables
+constexpr int fixY = static_cast<int>(1.164 * 65536 + 0.5);
+constexpr int fixCrToR = static_cast<int>(1.597656 * 65536 + 0.5);
+constexpr int fixCbToB = static_cast<int>(2.015625 * 65536 + 0.5);
+constexpr int fixCrToG = static_cast<int>(0.8125 * 65536 + 0.5);
+constexpr int fixCbToG = static_cast<int>(0.390625 * 65536 + 0.5);
+
+template <int i0, int i1, int i2, int i3> inline v4i shuffle(v4i a, v4i b)
+{
+#if defined(__clang__)
+    return __builtin_shufflevector(a, b, i0, i1, i2, i3);
+#else
+    return __builtin_shuffle(a, b, v4i{i0, i1, i2, i3});
+#endif
+}
+
+template <typename T> inline v4i load4(const T *in)
+{
+    return v4i{in[0], in[1], in[2], in[3]};
+}
+
+// Loads one byte channel of four consecutive 4 byte pixels
+inline v4i loadChannel(const uint8_t *pixels, int channel)
+{
+    v4u words;
+    std::memcpy(&words, pixels, sizeof(words));
+    words = (words >> (channel * 8)) & 0xFF;
+    return reinterpret_cast<v4i &>(words);
+}
+
+inline v4i clampByte(v4i v)
+{
+    v &= ~(v >> 31);
+    v4i over = v > 255;
+    return (v & ~over) | (255 & over);
+}
+
+inline void transpose4(v4i &a, v4i &b, v4i &c, v4i &d)
+{
+    v4i t0 = shuffle<0, 4, 1, 5>(a, b);
+    v4i t1 = shuffle<2, 6, 3, 7>(a, b);
+    v4i t2 = shuffle<0, 4, 1, 5>(c, d);
+    v4i t3 = shuffle<2, 6, 3, 7>(c, d);
+    a = shuffle<0, 1, 4, 5>(t0, t2);
+    b = shuffle<2, 3, 6, 7>(t0, t2);
+    c = shuffle<0, 1, 4, 5>(t1, t3);
+    d = shuffle<2, 3, 6, 7>(t1, t3);
+}
+
+// An 8x8 block as eight rows of two four lane halves
+struct Block
+{
+    v4i lo[8];
+    v4i hi[8];
+
+    void transpose()
+    {
+        transpose4(lo[0], lo[1], lo[2], lo[3]);
+        transpose4(hi[4], hi[5], hi[6], hi[7]);
+        transpose4(hi[0], hi[1], hi[2], hi[3]);
+        transpose4(lo[4], lo[5], lo[6], lo[7]);
+        for (int i = 0; i < 4; i++)
+        {
+            v4i upperRight = hi[i];
+            hi[i] = lo[i + 4];
+            lo[i + 4] = upperRight;
+        }
+    }
+};
+
+// The AAN butterfly from AstJpegDecoder::idctTransform, run on four columns
+// (first pass) or four rows (second pass) at once
+inline void idctButterfly(v4i (&v)[8])
+{
+    v4i tmp10 = v[0] + v[4];
+    v4i tmp11 = v[0] - v[4];
+    v4i tmp13 = v[2] + v[6];
+    v4i tmp12 = (((v[2] - v[6]) * 362) >> 8) - tmp13;
+
+    v4i tmp0 = tmp10 + tmp13;
+    v4i tmp3 = tmp10 - tmp13;
+    v4i tmp1 = tmp11 + tmp12;
+    v4i tmp2 = tmp11 - tmp12;
+
+    v4i z13 = v[5] + v[3];
+    v4i z10 = v[5] - v[3];
+    v4i z11 = v[1] + v[7];
+    v4i z12 = v[1] - v[7];
+
+    v4i tmp7 = z11 + z13;
+    tmp11 = ((z11 - z13) * 362) >> 8;
+    v4i z5 = ((z10 + z12) * 473) >> 8;
+    tmp10 = ((z12 * 277) >> 8) - z5;
+    tmp12 = ((z10 * -669) >> 8) + z5;
+
+    v4i tmp6 = tmp12 - tmp7;
+    v4i tmp5 = tmp11 - tmp6;
+    v4i tmp4 = tmp10 + tmp5;
+
+    v[0] = tmp0 + tmp7;
+    v[7] = tmp0 - tmp7;
+    v[1] = tmp1 + tmp6;
+    v[6] = tmp1 - tmp6;
+    v[2] = tmp2 + tmp5;
+    v[5] = tmp2 - tmp5;
+    v[4] = tmp3 + tmp4;
+    v[3] = tmp3 - tmp4;
+}
+
+// The scalar code multiplies by a 16.16 table held in longs.  Splitting each
+// entry into its integer and fraction halves keeps every product of the
+// dequantization within 32 bits, without changing the result.
+inline void splitQuantTable(const long *quant, int32_t *split)
+{
+    for (int i = 0; i < 64; i++)
+    {
+        split[i] = static_cast<int32_t>(quant[i] >> 16);
+        split[i + 64] = static_cast<int32_t>(quant[i] & 0xFFFF);
+    }
+}
+
+// Dequantizes and inverse transforms one 8x8 block, using a table prepared
+// with splitQuantTable
+inline void idctTransform(const short *coef, const int32_t *quant,
+                          uint8_t *data)
+{
+    v8s ac = v8s{0, -1, -1, -1, -1, -1, -1, -1};
+    for (int i = 0; i < 64; i += 8)
+    {
+        v8s c;
+        std::memcpy(&c, coef + i, sizeof(c));
+        ac = (i == 0 ? ac & c : ac | c);
+    }
+    bool dcOnly = true;
+    for (int i = 0; i < 8; i++)
+    {
+        dcOnly = dcOnly && ac[i] == 0;
+    }
+    if (dcOnly)
+    {
+        // Most blocks of a desktop are flat, and every output of the
+        // transform is then the dequantized DC term
+        v4i dc = v4i{} + (coef[0] * quant[0] + ((coef[0] * quant[64]) >> 16));
+        v4i out = clampByte((((dc >> 3) << 22) >> 22) + 128);
+        std::memset(data, out[0], 64);
+        return;
+    }
+
+    Block block;
+    for (int row = 0; row < 8; row++)
+    {
+        for (int half = 0; half < 2; half++)
+        {
+            int i = row * 8 + half * 4;
+            v4i c = load4(coef + i);
+            v4i v = c * load4(quant + i) + ((c * load4(quant + 64 + i)) >> 16);
+            (half == 0 ? block.lo : block.hi)[row] = v;
+        }
+    }
+    idctButterfly(block.lo);
+    idctButterfly(block.hi);
+    block.transpose();
+    idctButterfly(block.lo);
+    idctButterfly(block.hi);
+    block.transpose();
+
+    for (int row = 0; row < 8; row++)
+    {
+        // The scalar range limit table wraps the descaled value to 10 bits,
+        // then saturates it around the 128 level shift
+        v4i lo = clampByte((((block.lo[row] >> 3) << 22) >> 22) + 128);
+        v4i hi = clampByte((((block.hi[row] >> 3) << 22) >> 22) + 128);
+        uint8_t *out = data + row * 8;
+        for (int col = 0; col < 4; col++)
+        {
+            out[col] = static_cast<uint8_t>(lo[col]);
+            out[col + 4] = static_cast<uint8_t>(hi[col]);
+        }
+    }
+}
+
+// Converts four pixels and stores them as BGR, leaving the reserved byte of
+// each output pixel untouched
+inline void storeBgr(v4i y, v4i cb, v4i cr, uint8_t *out)
+{
+    v4i luma = (fixY * (y - 16) + 32768) >> 16;
+    cb -= 128;
+    cr -= 128;
+    v4i b = clampByte(luma + ((fixCbToB * cb + 32768) >> 16));
+    v4i g = clampByte(luma + ((-fixCbToG * cb + 32768) >> 16) +
+                      ((-fixCrToG * cr + 32768) >> 16));
+    v4i r = clampByte(luma + ((fixCrToR * cr + 32768) >> 16));
+
+    v4i pixels;
+    std::memcpy(&pixels, out, sizeof(pixels));
+    pixels = (pixels & static_cast<int32_t>(0xFF000000)) | b | (g << 8) |
+             (r << 16);
+    std::memcpy(out, &pixels, sizeof(pixels));
+}
+
+// Stores four Y/Cb/Cr samples in the 2 pass buffer, where they're kept in
+// the g/b/r slots of the pixel
+inline void storeYuv(v4i y, v4i cb, v4i cr, uint8_t *out)
+{
+    v4i pixels;
+    std::memcpy(&pixels, out, sizeof(pixels));
+    pixels = (pixels & static_cast<int32_t>(0xFF000000)) | (cb & 0xFF) |
+             ((y & 0xFF) << 8) | ((cr & 0xFF) << 16);
+    std::memcpy(out, &pixels, sizeof(pixels));
+}
+
+// Color converts an 8x8 YUV444 block at pixel offset pos of a frame width
+// pixels wide, recording its YUV values in yuv for the second pass
+inline void yuv444ToRgb(const uint8_t *yCbCr, uint8_t *yuv, uint8_t *bgr,
+                        size_t pos, size_t width)
+{
+    for (int i = 0; i < 64; i += 4)
+    {
+        size_t n = (pos + (i >> 3) * width + (i & 7)) * 4;
+        v4i y = load4(yCbCr + i);
+        v4i cb = load4(yCbCr + 64 + i);
+        v4i cr = load4(yCbCr + 128 + i);
+        storeYuv(y, cb, cr, yuv + n);
+        storeBgr(y, cb, cr, bgr + n);
+    }
+}
+
+// Applies a second pass YUV444 block on top of the values recorded for the
+// first pass, then color converts the result
+inline void yuv444AddToRgb(const uint8_t *yCbCr, uint8_t *yuv, uint8_t *bgr,
+                           size_t pos, size_t width)
+{
+    for (int i = 0; i < 64; i += 4)
+    {
+        size_t n = (pos + (i >> 3) * width + (i & 7)) * 4;
+        v4i y = (loadChannel(yuv + n, 1) + load4(yCbCr + i) - 128) & 0xFF;
+        v4i cb = (loadChannel(yuv + n, 0) + load4(yCbCr + 64 + i) - 128) & 0xFF;
+        v4i cr =
+            (loadChannel(yuv + n, 2) + load4(yCbCr + 128 + i) - 128) & 0xFF;
+        storeYuv(y, cb, cr, yuv + n);
+        storeBgr(y, cb, cr, bgr + n);
+    }
+}
+
+// Color converts a 16x16 YUV420 macroblock made of four Y blocks followed by
+// one Cb and one Cr block
+inline void yuv420ToRgb(const uint8_t *yCbCr, uint8_t *bgr, size_t pos,
+                        size_t width)
+{
+    const uint8_t *pcb = yCbCr + 256;
+    const uint8_t *pcr = pcb + 64;
+    for (int j = 0; j < 16; j++, pos += width)
+    {
+        const uint8_t *py = yCbCr + ((j >> 3) * 2) * 64 + (j & 7) * 8;
+        const uint8_t *cb = pcb + (j >> 1) * 8;
+        const uint8_t *cr = pcr + (j >> 1) * 8;
+        for (int i = 0; i < 16; i += 4)
+        {
+            // Each chroma sample covers two pixels of the row
+            int c = i >> 1;
+            storeBgr(load4(py + (i >> 3) * 64 + (i & 7)),
+                     v4i{cb[c], cb[c], cb[c + 1], cb[c + 1]},
+                     v4i{cr[c], cr[c], cr[c + 1], cr[c + 1]},
+                     bgr + (pos + i) * 4);
+        }
+    }
+}
+
+} // namespace kernels
+} // namespace ast_video
+#endif // AST_JPEG_VECTOR_KERNELS
@@ -1,10 +1,13 @@
 #pragma once
 
+#include <array>
 #include <ast_video_types.hpp>
 #include <boost/asio.hpp>
 #include <cassert>
+#include <chrono>
+#include <crow/logging.h>
+#include <functional>
 #include <iostream>
-#include <mutex>
 #include <vector>
 
 namespace ast_video
@@ -136,77 +139,163 @@ class SimpleVideoPuller
 };
 
 #if defined(BOOST_ASIO_HAS_POSIX_STREAM_DESCRIPTOR)
+// Reads frames from /dev/video without blocking the io_context.  Captures are
+// double buffered: when a frame is handed out, the next one is already being
+// captured into the other buffer, so capture and decode overlap.  At most one
+// frame is captured ahead of requestFrame(), and it's only handed out while
+// it's no older than maxHeldCaptureAge.
 class AsyncVideoPuller
 {
   public:
-    using video_callback = std::function<void(RawVideoBuffer &)>;
+    using video_callback = std::function<void(
+        const boost::system::error_code &, RawVideoBuffer &)>;
+
+    // About a frame at 30 frames per second
+    static constexpr std::chrono::milliseconds maxHeldCaptureAge{33};
 
     explicit AsyncVideoPuller(boost::asio::io_context &ioService) :
-        imageInfo(), devVideo(ioService, open("/dev/video", O_RDWR))
+        devVideo(ioService)
     {
-        videobuf = std::make_shared<RawVideoBuffer>();
+        for (Capture &capture : captures)
+        {
+            capture.imageInfo.doImageRefresh = 1; // full frame refresh
+            capture.imageInfo.qcValid = 0;        // quick cursor disabled
+            capture.imageInfo.crypttype = -1;
+            capture.imageInfo.parameter.features.buf =
+                reinterpret_cast<unsigned char *>(capture.raw.buffer.data());
+        }
 
-        imageInfo.doImageRefresh = 1; // full frame refresh
-        imageInfo.qcValid = 0;        // quick cursor disabled
-        imageInfo.parameter.features.buf =
-            reinterpret_cast<unsigned char *>(videobuf->buffer.data());
-        imageInfo.crypttype = -1;
+        int videoFd = open("/dev/video", O_RDWR);
+        if (videoFd < 0)
+        {
+            BMCWEB_LOG_ERROR << "Failed to open /dev/video";
+            return;
+        }
+        devVideo.assign(videoFd);
     };
 
-    void registerCallback(video_callback &callback)
+    bool isOpen() const
     {
-        std::lock_guard<std::mutex> lock(callbackMutex);
-        callbacks.push_back(callback);
-        startRead();
+        return devVideo.is_open();
     }
 
-    void startRead()
+    void registerCallback(video_callback &&callback)
     {
-        auto mutableBuffer = boost::asio::buffer(&imageInfo, sizeof(imageInfo));
-        boost::asio::async_read(devVideo, mutableBuffer,
-                                [this](const boost::system::error_code &ec,
-                                       std::size_t bytes_transferred) {
-                                    if (ec)
-                                    {
-                                        std::cerr << "Read failed with status "
-                                                  << ec << "\n";
-                                    }
-                                    else
-                                    {
-                                        this->readDone();
-                                    }
-                                });
+        callbacks.emplace_back(std::move(callback));
     }
 
-    void readDone()
+    // Asks for the next frame.  If one was captured ahead recently it's
+    // delivered right away, otherwise as soon as a capture completes.
+    void requestFrame()
     {
-        std::cout << "Done reading\n";
-        videobuf->buffer.resize(imageInfo.len);
+        if (readyCapture >= 0)
+        {
+            int index = readyCapture;
+            readyCapture = -1;
+            if (std::chrono::steady_clock::now() - captures[index].captured >
+                maxHeldCaptureAge)
+            {
+                // The screen may have changed since; capture it again
+                frameRequested = true;
+                startRead(index);
+                return;
+            }
+            if (!readInProgress)
+            {
+                startRead(1 - index);
+            }
+            deliver(index, boost::system::error_code());
+            return;
+        }
+        frameRequested = true;
+        if (!readInProgress)
+        {
+            startRead(nextCapture);
+        }
+    }
 
-        videobuf->height = imageInfo.parameter.features.h;
-        videobuf->width = imageInfo.parameter.features.w;
-        if (imageInfo.parameter.features.jpgFmt == 422)
+  private:
+    struct Capture
+    {
+        ImageInfo imageInfo{};
+        RawVideoBuffer raw;
+        std::chrono::steady_clock::time_point captured;
+    };
+
+    void startRead(int index)
+    {
+        if (!isOpen())
+        {
+            deliver(index, boost::asio::error::bad_descriptor);
+            return;
+        }
+        readInProgress = true;
+        nextCapture = 1 - index;
+        Capture &capture = captures[index];
+        devVideo.async_read_some(
+            boost::asio::buffer(&capture.imageInfo, sizeof(capture.imageInfo)),
+            [this, index](const boost::system::error_code &ec,
+                          std::size_t bytes_transferred) {
+                readInProgress = false;
+                // The driver completes a capture with a zero length read,
+                // which asio reports as end of file
+                if (ec && ec != boost::asio::error::eof)
+                {
+                    BMCWEB_LOG_ERROR << "Video read failed with status " << ec;
+                    frameRequested = false;
+                    deliver(index, ec);
+                    return;
+                }
+                readDone(index);
+            });
+    }
+
+    void readDone(int index)
+    {
+        Capture &capture = captures[index];
+        capture.captured = std::chrono::steady_clock::now();
+        // The buffer is left at full size; the decoder stops at the frame end
+        // code, and shrinking it would mean refilling it before the next read
+        capture.raw.height = capture.imageInfo.parameter.features.h;
+        capture.raw.width = capture.imageInfo.parameter.features.w;
+        if (capture.imageInfo.parameter.features.jpgFmt == 422)
         {
-            videobuf->mode = YuvMode::YUV420;
+            capture.raw.mode = YuvMode::YUV420;
         }
         else
         {
-            videobuf->mode = YuvMode::YUV444;
+            capture.raw.mode = YuvMode::YUV444;
         }
-        std::lock_guard<std::mutex> lock(callbackMutex);
-        for (auto &callback : callbacks)
+
+        if (!frameRequested)
         {
-            // TODO(ed) call callbacks async and double buffer frames
-            callback(*videobuf);
+            // Captured ahead; hold it for the next request
+            readyCapture = index;
+            return;
         }
+        frameRequested = false;
+        // Start capturing the next frame into the other buffer while this
+        // one is decoded
+        startRead(1 - index);
+        deliver(index, boost::system::error_code());
     }
 
-  private:
-    std::shared_ptr<RawVideoBuffer> videobuf;
+    void deliver(int index, const boost::system::error_code &ec)
+    {
+        for (video_callback &callback : callbacks)
+        {
+            callback(ec, captures[index].raw);
+        }
+    }
+
+    std::array<Capture, 2> captures;
     boost::asio::posix::stream_descriptor devVideo;
-    ImageInfo imageInfo;
-    std::mutex callbackMutex;
     std::vector<video_callback> callbacks;
+    bool readInProgress = false;
+    bool frameRequested = false;
+    int nextCapture = 0;
+    // Index of a capture completed ahead of a request, or -1
+    int readyCapture = -1;
 };
 #endif // defined(BOOST_ASIO_HAS_POSIX_STREAM_DESCRIPTOR)
 } // namespace ast_video
@@ -0,0 +1,104 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstddef>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace ast_video
+{
+
+// A fixed set of threads for splitting one piece of work, such as the
+// reconstruction of a frame, across cores.  run() calls the work function once
+// on every thread, the caller included, with that thread's index, and returns
+// when all of them are done.
+class WorkerPool
+{
+  public:
+    // threads counts the calling thread, so a pool of 1 starts no threads
+    explicit WorkerPool(size_t threads)
+    {
+        for (size_t index = 1; index < threads; index++)
+        {
+            workers.emplace_back([this, index] { workerLoop(index); });
+        }
+    }
+
+    ~WorkerPool()
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopping = true;
+        }
+        wake.notify_all();
+        for (std::thread& worker : workers)
+        {
+            worker.join();
+        }
+    }
+
+    WorkerPool(const WorkerPool&) = delete;
+    WorkerPool& operator=(const WorkerPool&) = delete;
+
+    size_t size() const
+    {
+        return workers.size() + 1;
+    }
+
+    void run(const std::function<void(size_t)>& work)
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            currentWork = &work;
+            running = workers.size();
+            generation++;
+        }
+        wake.notify_all();
+        work(0);
+
+        std::unique_lock<std::mutex> lock(mutex);
+        done.wait(lock, [this] { return running == 0; });
+        currentWork = nullptr;
+    }
+
+  private:
+    void workerLoop(size_t index)
+    {
+        size_t seen = 0;
+        while (true)
+        {
+            const std::function<void(size_t)>* work;
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                wake.wait(lock, [this, seen] {
+                    return stopping || generation != seen;
+                });
+                if (stopping)
+                {
+                    return;
+                }
+                seen = generation;
+                work = currentWork;
+            }
+            (*work)(index);
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                running--;
+            }
+            done.notify_one();
+        }
+    }
+
+    std::vector<std::thread> workers;
+    std::mutex mutex;
+    std::condition_variable wake;
+    std::condition_variable done;
+    const std::function<void(size_t)>* currentWork = nullptr;
+    size_t running = 0;
+    size_t generation = 0;
+    bool stopping = false;
+};
+
+} // namespace ast_video
@@ -0,0 +1,136 @@
+#pragma once
+
+#include <async_resp.hpp>
+#include <boost/asio/coroutine.hpp>
+#include <boost/asio/io_context.hpp>
+#include <boost/asio/post.hpp>
+#include <memory>
+
+namespace bmcweb
+{
+
+/**
+ * AsyncTask
+ * Base for handlers written as stackless coroutines instead of nested
+ * callbacks.  The derived class keeps its per-request state in members and
+ * implements step() with BOOST_ASIO_CORO_REENTER(this) and
+ * BOOST_ASIO_CORO_YIELD; each handler from resume() or whenAll() re-enters
+ * step() where it left off:
+ *
+ *     BOOST_ASIO_CORO_YIELD crow::connections::systemBus->async_method_call(
+ *         resume(ec, objects), service, path, interface, method);
+ *
+ * Outstanding handlers are what keep the task alive.  Once the client has
+ * gone away the task is no longer re-entered, so its state is released as
+ * soon as the calls already in flight come back.  Groups from whenAll()
+ * resume the task through io, the io_context its calls complete on.
+ */
+template <typename Derived>
+class AsyncTask : public std::enable_shared_from_this<Derived>,
+                  public boost::asio::coroutine
+{
+  public:
+    AsyncTask(boost::asio::io_context& io, crow::Response& res) :
+        io(io), asyncResp(std::make_shared<AsyncResp>(res))
+    {
+    }
+
+    AsyncTask(boost::asio::io_context& io,
+              const std::shared_ptr<AsyncResp>& asyncResp) :
+        io(io),
+        asyncResp(asyncResp)
+    {
+    }
+
+    void run()
+    {
+        reenter();
+    }
+
+    // Runs a group of calls concurrently and re-enters the task once, after
+    // the last of them has completed.  The task resumes when the Join and
+    // every handler made from it are gone, so a group that never issued a
+    // call resumes straight away.
+    class Join
+    {
+      public:
+        Join(boost::asio::io_context& io, std::shared_ptr<Derived> task) :
+            state(std::make_shared<State>(io, std::move(task)))
+        {
+        }
+
+        template <typename... Results>
+        auto add(boost::system::error_code& ec, Results&... results)
+        {
+            // Stays an error unless the call actually completes
+            ec = boost::asio::error::operation_aborted;
+            return [state{state}, &ec,
+                    &results...](const boost::system::error_code e,
+                                 Results... values) {
+                ec = e;
+                ((results = std::move(values)), ...);
+            };
+        }
+
+      private:
+        struct State
+        {
+            State(boost::asio::io_context& io, std::shared_ptr<Derived> task) :
+                io(io), task(std::move(task))
+            {
+            }
+
+            ~State()
+            {
+                // Always resume from the event loop, never from inside the
+                // step() that set up the group.
+                boost::asio::post(io,
+                                  [task{std::move(task)}] { task->reenter(); });
+            }
+
+            boost::asio::io_context& io;
+            std::shared_ptr<Derived> task;
+        };
+
+        std::shared_ptr<State> state;
+    };
+
+    // Handler for a single call: stores the error code and the call's
+    // results into the given members, then re-enters the task.
+    template <typename... Results>
+    auto resume(boost::system::error_code& ec, Results&... results)
+    {
+        return [self{this->shared_from_this()}, &ec,
+                &results...](const boost::system::error_code e,
+                             Results... values) {
+            ec = e;
+            ((results = std::move(values)), ...);
+            self->reenter();
+        };
+    }
+
+    Join whenAll()
+    {
+        return Join(io, this->shared_from_this());
+    }
+
+    bool isCancelled()
+    {
+        return !asyncResp->res.isAlive();
+    }
+
+    void reenter()
+    {
+        if (isCancelled())
+        {
+            BMCWEB_LOG_DEBUG << "Client went away, dropping task " << this;
+            return;
+        }
+        static_cast<Derived*>(this)->step();
+    }
+
+    boost::asio::io_context& io;
+    std::shared_ptr<AsyncResp> asyncResp;
+};
+
+} // namespace bmcweb
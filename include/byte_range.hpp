@@ -0,0 +1,114 @@
+#pragma once
+
+#include <algorithm>
+#include <boost/utility/string_view.hpp>
+#include <cctype>
+#include <cstddef>
+#include <string>
+
+namespace crow
+{
+
+// The bytes of a resource asked for by a Range header, last included
+struct ByteRange
+{
+    size_t first = 0;
+    size_t last = 0;
+};
+
+enum class RangeResult
+{
+    // No usable range, so the whole resource is sent
+    none,
+    satisfiable,
+    // The range starts past the end of the resource (416)
+    unsatisfiable
+};
+
+namespace detail
+{
+inline bool parseRangeNumber(boost::string_view text, size_t& value)
+{
+    if (text.empty() || text.size() > 18)
+    {
+        return false;
+    }
+    value = 0;
+    for (char c : text)
+    {
+        if (!std::isdigit(static_cast<unsigned char>(c)))
+        {
+            return false;
+        }
+        value = value * 10 + static_cast<size_t>(c - '0');
+    }
+    return true;
+}
+} // namespace detail
+
+// Parses a Range header of a single range, "bytes=first-last",
+// "bytes=first-" or "bytes=-suffixLength", against a resource of size bytes.
+// Anything else, including several ranges, is ignored and the whole resource
+// sent, as RFC 7233 allows.
+inline RangeResult parseByteRange(boost::string_view header, size_t size,
+                                  ByteRange& range)
+{
+    constexpr boost::string_view unit = "bytes=";
+    if (!header.starts_with(unit))
+    {
+        return RangeResult::none;
+    }
+    header.remove_prefix(unit.size());
+    size_t dash = header.find('-');
+    if (dash == boost::string_view::npos ||
+        header.find(',') != boost::string_view::npos)
+    {
+        return RangeResult::none;
+    }
+    boost::string_view firstText = header.substr(0, dash);
+    boost::string_view lastText = header.substr(dash + 1);
+
+    if (firstText.empty())
+    {
+        size_t suffix = 0;
+        if (!detail::parseRangeNumber(lastText, suffix))
+        {
+            return RangeResult::none;
+        }
+        if (suffix == 0 || size == 0)
+        {
+            return RangeResult::unsatisfiable;
+        }
+        range.first = size - std::min(suffix, size);
+        range.last = size - 1;
+        return RangeResult::satisfiable;
+    }
+
+    size_t first = 0;
+    size_t last = size - 1;
+    if (!detail::parseRangeNumber(firstText, first) ||
+        (!lastText.empty() && !detail::parseRangeNumber(lastText, last)))
+    {
+        return RangeResult::none;
+    }
+    if (!lastText.empty() && last < first)
+    {
+        return RangeResult::none;
+    }
+    if (first >= size)
+    {
+        return RangeResult::unsatisfiable;
+    }
+    range.first = first;
+    range.last = std::min(last, size - 1);
+    return RangeResult::satisfiable;
+}
+
+// The Content-Range value of a satisfiable range
+inline std::string contentRange(const ByteRange& range, size_t size)
+{
+    return "bytes " + std::to_string(range.first) + "-" +
+           std::to_string(range.last) + "/" + std::to_string(size);
+}
+
+} // namespace crow
@@ -0,0 +1,556 @@
+#pragma once
+
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <zlib.h>
+
+#include "filesystem.hpp"
+
+#include <algorithm>
+#include <array>
+#include <boost/asio/io_context.hpp>
+#include <boost/asio/steady_timer.hpp>
+#include <cerrno>
+#include <chrono>
+#include <crow/logging.h>
+#include <cstring>
+#include <deque>
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <vector>
+
+namespace crow
+{
+namespace obmc_console
+{
+
+// Where captured console output is kept
+constexpr const char* captureDir = "/var/lib/bmcweb/console";
+
+struct CaptureOptions
+{
+    // A segment is closed, and the next one started, once it's this large
+    size_t segmentSize = 1024 * 1024;
+    // Closed segments beyond this many are deleted, oldest first
+    size_t maxSegments = 8;
+    // Whether closed segments are gzipped
+    bool compress = true;
+    // Output is written out once this much is waiting, or flushInterval
+    // after it started waiting.  Nothing is synced, so a BMC reset can lose
+    // what the kernel hasn't written back yet.
+    size_t batchSize = 16 * 1024;
+    std::chrono::milliseconds flushInterval{1000};
+};
+
+// One capture file, named <console>.<sequence>.log, and .log.gz once
+// compressed.  Sequences only increase, and the compressed form has an id of
+// its own, so an id always refers to the same output: the plain form only
+// ever grows, and goes away once the compressed one is in place.
+struct CaptureSegment
+{
+    std::string console;
+    uint64_t sequence = 0;
+    bool compressed = false;
+    std::filesystem::path path;
+
+    std::string id() const
+    {
+        return console + "." + std::to_string(sequence) +
+               (compressed ? ".gz" : "");
+    }
+};
+
+// Lists the segments in dir, ordered by console then sequence.  A segment
+// left in both forms, by a stop between putting the compressed one in place
+// and removing the other, is listed compressed.
+inline std::vector<CaptureSegment>
+    listSegments(const std::filesystem::path& dir)
+{
+    std::vector<CaptureSegment> segments;
+    std::error_code ec;
+    for (const auto& entry : std::filesystem::directory_iterator(dir, ec))
+    {
+        std::string name = entry.path().filename().string();
+        CaptureSegment segment;
+        segment.path = entry.path();
+        constexpr const char* gz = ".gz";
+        if (name.size() > 3 && name.compare(name.size() - 3, 3, gz) == 0)
+        {
+            segment.compressed = true;
+            name.resize(name.size() - 3);
+        }
+        constexpr const char* log = ".log";
+        if (name.size() <= 4 || name.compare(name.size() - 4, 4, log) != 0)
+        {
+            continue;
+        }
+        name.resize(name.size() - 4);
+        size_t dot = name.rfind('.');
+        if (dot == std::string::npos || dot == 0 || dot + 1 == name.size() ||
+            name.find_first_not_of("0123456789", dot + 1) != std::string::npos)
+        {
+            continue;
+        }
+        segment.console = name.substr(0, dot);
+        segment.sequence = std::stoull(name.substr(dot + 1));
+        segments.emplace_back(std::move(segment));
+    }
+    std::sort(segments.begin(), segments.end(),
+              [](const CaptureSegment& a, const CaptureSegment& b) {
+                  if (a.console != b.console)
+                  {
+                      return a.console < b.console;
+                  }
+                  if (a.sequence != b.sequence)
+                  {
+                      return a.sequence < b.sequence;
+                  }
+                  return a.compressed && !b.compressed;
+              });
+    segments.erase(std::unique(segments.begin(), segments.end(),
+                               [](const CaptureSegment& a,
+                                  const CaptureSegment& b) {
+                                   return a.console == b.console &&
+                                          a.sequence == b.sequence;
+                               }),
+                   segments.end());
+    return segments;
+}
+
+// Finds the segment in dir with the given id
+inline bool findSegment(const std::filesystem::path& dir,
+                        const std::string& id, CaptureSegment& segmentOut)
+{
+    for (CaptureSegment& segment : listSegments(dir))
+    {
+        if (segment.id() == id)
+        {
+            segmentOut = std::move(segment);
+            return true;
+        }
+    }
+    return false;
+}
+
+inline bool writeAll(int fd, const char* data, size_t size)
+{
+    while (size > 0)
+    {
+        ssize_t ret = ::write(fd, data, size);
+        if (ret < 0)
+        {
+            if (errno == EINTR)
+            {
+                continue;
+            }
+            return false;
+        }
+        data += ret;
+        size -= static_cast<size_t>(ret);
+    }
+    return true;
+}
+
+// Gzips what's written to it into a file, so compressing a segment costs a
+// little of every write rather than a pass over the whole segment when it's
+// closed.  The output goes to path.tmp until finish() renames it to path.
+class GzipWriter
+{
+  public:
+    GzipWriter() = default;
+
+    ~GzipWriter()
+    {
+        abandon();
+    }
+
+    GzipWriter(const GzipWriter&) = delete;
+    GzipWriter& operator=(const GzipWriter&) = delete;
+
+    bool open(const std::filesystem::path& path)
+    {
+        abandon();
+        target = path;
+        temporary = path;
+        temporary += ".tmp";
+        // 16 added to the window bits asks for a gzip wrapper
+        if (deflateInit2(&stream, Z_DEFAULT_COMPRESSION, Z_DEFLATED, 15 + 16,
+                         8, Z_DEFAULT_STRATEGY) != Z_OK)
+        {
+            return false;
+        }
+        fd = ::open(temporary.c_str(),
+                    O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0640);
+        if (fd < 0)
+        {
+            deflateEnd(&stream);
+            return false;
+        }
+        return true;
+    }
+
+    bool isOpen() const
+    {
+        return fd >= 0;
+    }
+
+    bool write(const char* data, size_t size)
+    {
+        return deflateAll(data, size, Z_NO_FLUSH);
+    }
+
+    // Ends the gzip stream and puts the file in place
+    bool finish()
+    {
+        if (!deflateAll(nullptr, 0, Z_FINISH))
+        {
+            abandon();
+            return false;
+        }
+        deflateEnd(&stream);
+        ::close(fd);
+        fd = -1;
+        std::error_code ec;
+        std::filesystem::rename(temporary, target, ec);
+        if (ec)
+        {
+            std::filesystem::remove(temporary, ec);
+            return false;
+        }
+        return true;
+    }
+
+    // Stops, removing what was written so far
+    void abandon()
+    {
+        if (fd < 0)
+        {
+            return;
+        }
+        deflateEnd(&stream);
+        ::close(fd);
+        fd = -1;
+        std::error_code ec;
+        std::filesystem::remove(temporary, ec);
+    }
+
+  private:
+    bool deflateAll(const char* data, size_t size, int flush)
+    {
+        if (fd < 0)
+        {
+            return false;
+        }
+        stream.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(data));
+        stream.avail_in = static_cast<uInt>(size);
+        std::array<char, 16 * 1024> out;
+        int ret = Z_OK;
+        do
+        {
+            stream.next_out = reinterpret_cast<Bytef*>(out.data());
+            stream.avail_out = static_cast<uInt>(out.size());
+            ret = deflate(&stream, flush);
+            if (ret == Z_STREAM_ERROR ||
+                !writeAll(fd, out.data(), out.size() - stream.avail_out))
+            {
+                return false;
+            }
+        } while (stream.avail_out == 0);
+        return flush != Z_FINISH || ret == Z_STREAM_END;
+    }
+
+    z_stream stream{};
+    int fd = -1;
+    std::filesystem::path target;
+    std::filesystem::path temporary;
+};
+
+// Appends a console's output to size capped segment files, writing it in
+// batches from the io_context
+class ConsoleCapture
+{
+  public:
+    ConsoleCapture(boost::asio::io_context& io, std::filesystem::path dir,
+                   std::string console,
+                   const CaptureOptions& options = CaptureOptions()) :
+        dir(std::move(dir)),
+        console(std::move(console)), options(options), flushTimer(io),
+        leftoverTimer(io)
+    {
+        std::error_code ec;
+        std::filesystem::create_directories(this->dir, ec);
+        if (ec)
+        {
+            BMCWEB_LOG_ERROR << "Couldn't create " << this->dir << ": "
+                             << ec.message();
+        }
+
+        // Segments left open by a previous run are closed, and a new one is
+        // started.  They're compressed a piece at a time from the io_context,
+        // so a large backlog of them doesn't hold up startup.
+        for (const CaptureSegment& segment : listSegments(this->dir))
+        {
+            if (segment.console != this->console)
+            {
+                continue;
+            }
+            nextSequence = segment.sequence + 1;
+            closedSequences.push_back(segment.sequence);
+        }
+        prune();
+        for (uint64_t sequence : closedSequences)
+        {
+            std::filesystem::path path = segmentPath(sequence);
+            std::filesystem::path compressed = path;
+            compressed += ".gz";
+            // Output half compressed when the last run stopped
+            std::filesystem::path partial = compressed;
+            partial += ".tmp";
+            std::filesystem::remove(partial, ec);
+            if (!std::filesystem::exists(path, ec))
+            {
+                continue;
+            }
+            // The compressed form is only put in place once it's complete,
+            // so if the last run stopped before removing the other, that's
+            // all that's left to do
+            if (std::filesystem::exists(compressed, ec))
+            {
+                std::filesystem::remove(path, ec);
+            }
+            else if (options.compress)
+            {
+                leftovers.push_back(path);
+            }
+        }
+        scheduleLeftovers();
+    }
+
+    ~ConsoleCapture()
+    {
+        flush();
+        if (fd >= 0)
+        {
+            ::close(fd);
+        }
+    }
+
+    ConsoleCapture(const ConsoleCapture&) = delete;
+    ConsoleCapture& operator=(const ConsoleCapture&) = delete;
+
+    void append(const char* data, size_t size)
+    {
+        pending.append(data, size);
+        if (pending.size() >= options.batchSize)
+        {
+            flush();
+            return;
+        }
+        if (!flushPending)
+        {
+            flushPending = true;
+            flushTimer.expires_after(options.flushInterval);
+            flushTimer.async_wait([this](const boost::system::error_code& ec) {
+                if (ec)
+                {
+                    return;
+                }
+                flushPending = false;
+                flush();
+            });
+        }
+    }
+
+    void flush()
+    {
+        while (!pending.empty())
+        {
+            if (fd < 0 && !openSegment())
+            {
+                pending.clear();
+                return;
+            }
+            size_t size =
+                std::min(pending.size(), options.segmentSize - written);
+            if (!writeAll(fd, pending.data(), size))
+            {
+                BMCWEB_LOG_ERROR << "Couldn't write console capture: "
+                                 << std::strerror(errno);
+                pending.clear();
+                closeSegment();
+                return;
+            }
+            if (gzip.isOpen() && !gzip.write(pending.data(), size))
+            {
+                BMCWEB_LOG_ERROR << "Couldn't compress console capture";
+                gzip.abandon();
+            }
+            written += size;
+            pending.erase(0, size);
+            if (written >= options.segmentSize)
+            {
+                closeSegment();
+            }
+        }
+    }
+
+  private:
+    std::filesystem::path segmentPath(uint64_t sequence) const
+    {
+        return dir / (console + "." + std::to_string(sequence) + ".log");
+    }
+
+    bool openSegment()
+    {
+        std::filesystem::path path = segmentPath(nextSequence);
+        fd = ::open(path.c_str(), O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC,
+                    0640);
+        if (fd < 0)
+        {
+            BMCWEB_LOG_ERROR << "Couldn't open " << path << ": "
+                             << std::strerror(errno);
+            return false;
+        }
+        written = 0;
+        if (options.compress)
+        {
+            path += ".gz";
+            if (!gzip.open(path))
+            {
+                BMCWEB_LOG_ERROR << "Couldn't open " << path << ".tmp: "
+                                 << std::strerror(errno);
+            }
+        }
+        return true;
+    }
+
+    void closeSegment()
+    {
+        if (fd < 0)
+        {
+            return;
+        }
+        ::close(fd);
+        fd = -1;
+        std::filesystem::path path = segmentPath(nextSequence);
+        closedSequences.push_back(nextSequence++);
+        if (gzip.isOpen())
+        {
+            std::error_code ec;
+            if (gzip.finish())
+            {
+                std::filesystem::remove(path, ec);
+            }
+            else
+            {
+                BMCWEB_LOG_ERROR << "Couldn't compress " << path;
+            }
+        }
+        prune();
+    }
+
+    // Deletes the oldest closed segments beyond maxSegments
+    void prune()
+    {
+        while (closedSequences.size() > options.maxSegments)
+        {
+            std::filesystem::path path = segmentPath(closedSequences.front());
+            closedSequences.pop_front();
+            std::error_code ec;
+            std::filesystem::remove(path, ec);
+            path += ".gz";
+            std::filesystem::remove(path, ec);
+        }
+    }
+
+    // Compresses a piece of the segments left by a previous run, and waits
+    // for the io_context to come back for the next
+    void compressLeftovers()
+    {
+        if (leftovers.empty())
+        {
+            return;
+        }
+        const std::filesystem::path& path = leftovers.front();
+        if (!leftoverGzip.isOpen())
+        {
+            std::filesystem::path target = path;
+            target += ".gz";
+            leftoverIn.clear();
+            leftoverIn.open(path, std::ios::binary);
+            if (!leftoverIn.is_open() || !leftoverGzip.open(target))
+            {
+                BMCWEB_LOG_ERROR << "Couldn't compress " << path;
+                leftoverIn.close();
+                leftovers.pop_front();
+                scheduleLeftovers();
+                return;
+            }
+        }
+
+        std::array<char, leftoverChunkSize> chunk;
+        leftoverIn.read(chunk.data(), chunk.size());
+        bool ok = !leftoverIn.bad() &&
+                  leftoverGzip.write(chunk.data(),
+                                     static_cast<size_t>(leftoverIn.gcount()));
+        if (ok && !leftoverIn.eof())
+        {
+            scheduleLeftovers();
+            return;
+        }
+        std::error_code ec;
+        // The segment may have been pruned in the meantime
+        if (ok && std::filesystem::exists(path, ec) && leftoverGzip.finish())
+        {
+            std::filesystem::remove(path, ec);
+        }
+        else
+        {
+            leftoverGzip.abandon();
+        }
+        leftoverIn.close();
+        leftovers.pop_front();
+        scheduleLeftovers();
+    }
+
+    // A timer rather than a post, so it's cancelled with the capture
+    void scheduleLeftovers()
+    {
+        if (leftovers.empty())
+        {
+            return;
+        }
+        leftoverTimer.expires_after(std::chrono::milliseconds(0));
+        leftoverTimer.async_wait([this](const boost::system::error_code& ec) {
+            if (!ec)
+            {
+                compressLeftovers();
+            }
+        });
+    }
+
+    std::filesystem::path dir;
+    std::string console;
+    CaptureOptions options;
+
+    boost::asio::steady_timer flushTimer;
+    bool flushPending = false;
+    std::string pending;
+
+    int fd = -1;
+    uint64_t nextSequence = 0;
+    size_t written = 0;
+    GzipWriter gzip;
+    std::deque<uint64_t> closedSequences;
+
+    static constexpr size_t leftoverChunkSize = 16 * 1024;
+    boost::asio::steady_timer leftoverTimer;
+    std::deque<std::filesystem::path> leftovers;
+    std::ifstream leftoverIn;
+    GzipWriter leftoverGzip;
+};
+
+} // namespace obmc_console
+} // namespace crow
@@ -0,0 +1,83 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <string>
+
+namespace crow
+{
+namespace obmc_console
+{
+
+// The most recent output of a console, kept in a fixed size ring so a viewer
+// that connects later can be shown what came before, such as a kernel panic.
+// Storage grows with the output up to the capacity and is then reused.
+class Scrollback
+{
+  public:
+    explicit Scrollback(size_t capacity) : capacity(capacity)
+    {
+    }
+
+    void append(const char* data, size_t size)
+    {
+        if (size > capacity)
+        {
+            dropped = true;
+            data += size - capacity;
+            size = capacity;
+        }
+        if (buffer.size() < capacity)
+        {
+            size_t fill = std::min(size, capacity - buffer.size());
+            buffer.append(data, fill);
+            data += fill;
+            size -= fill;
+        }
+        // Once full, next is where the oldest byte is overwritten
+        while (size > 0)
+        {
+            dropped = true;
+            size_t chunk = std::min(size, capacity - next);
+            std::copy(data, data + chunk, buffer.begin() + next);
+            next = (next + chunk) % capacity;
+            data += chunk;
+            size -= chunk;
+        }
+    }
+
+    // The output held, oldest first.  Once older output has been lost, it
+    // starts after the first newline, rather than part way into a line or
+    // escape sequence.
+    std::string contents() const
+    {
+        std::string out;
+        out.reserve(buffer.size());
+        out.append(buffer, next, std::string::npos);
+        out.append(buffer, 0, next);
+        if (dropped)
+        {
+            size_t newline = out.find('\n');
+            if (newline != std::string::npos)
+            {
+                out.erase(0, newline + 1);
+            }
+        }
+        return out;
+    }
+
+    size_t size() const
+    {
+        return buffer.size();
+    }
+
+  private:
+    size_t capacity;
+    std::string buffer;
+    size_t next = 0;
+    // Whether any output has been lost to the capacity
+    bool dropped = false;
+};
+
+} // namespace obmc_console
+} // namespace crow
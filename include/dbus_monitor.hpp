@@ -28,7 +28,8 @@ namespace dbus_monitor
 
 struct DbusWebsocketSession
 {
-    std::vector<std::unique_ptr<sdbusplus::bus::match::match>> matches;
+    // Rules in matchRegistry this session is subscribed to
+    boost::container::flat_set<std::string> rules;
     boost::container::flat_set<std::string> interfaces;
 };
 
@@ -36,6 +37,18 @@ static boost::container::flat_map<crow::websocket::Connection*,
                                   DbusWebsocketSession>
     sessions;
 
+// One bus match per unique rule, shared by every session that asked for it.
+// Each signal is decoded and serialized once and the same text is sent to
+// all of the subscribers.
+struct SharedMatch
+{
+    std::unique_ptr<sdbusplus::bus::match::match> match;
+    boost::container::flat_set<crow::websocket::Connection*> subscribers;
+};
+
+static boost::container::flat_map<std::string, std::unique_ptr<SharedMatch>>
+    matchRegistry;
+
 inline int onPropertyUpdate(sd_bus_message* m, void* userdata,
                             sd_bus_error* ret_error)
 {
@@ -44,12 +57,9 @@ inline int onPropertyUpdate(sd_bus_message* m, void* userdata,
         BMCWEB_LOG_ERROR << "Got sdbus error on match";
         return 0;
     }
-    crow::websocket::Connection* connection =
-        static_cast<crow::websocket::Connection*>(userdata);
-    auto thisSession = sessions.find(connection);
-    if (thisSession == sessions.end())
+    SharedMatch* sharedMatch = static_cast<SharedMatch*>(userdata);
+    if (sharedMatch->subscribers.empty())
     {
-        BMCWEB_LOG_ERROR << "Couldn't find dbus connection " << connection;
         return 0;
     }
     sdbusplus::message::message message(m);
@@ -73,6 +83,13 @@ inline int onPropertyUpdate(sd_bus_message* m, void* userdata,
         // data is type sa{sv}as and is an array[3] of string, object, array
         j["interface"] = data[0];
         j["properties"] = data[1];
+
+        const std::string text = j.dump();
+        for (crow::websocket::Connection* connection :
+             sharedMatch->subscribers)
+        {
+            connection->sendText(text);
+        }
     }
     else if (strcmp(message.get_member(), "InterfacesAdded") == 0)
     {
@@ -90,14 +107,43 @@ inline int onPropertyUpdate(sd_bus_message* m, void* userdata,
             return 0;
         }
 
-        // data is type oa{sa{sv}} which is an array[2] of string, object
-        for (auto& entry : data[1].items())
+        // data is type oa{sa{sv}} which is an array[2] of string, object.
+        // Each session only sees the interfaces it asked for, so the text is
+        // built once per distinct interface filter rather than per session.
+        std::vector<std::pair<const boost::container::flat_set<std::string>*,
+                              std::string>>
+            filtered;
+        for (crow::websocket::Connection* connection :
+             sharedMatch->subscribers)
         {
-            auto it = thisSession->second.interfaces.find(entry.key());
-            if (it != thisSession->second.interfaces.end())
+            auto thisSession = sessions.find(connection);
+            if (thisSession == sessions.end())
             {
-                j["interfaces"][entry.key()] = entry.value();
+                BMCWEB_LOG_ERROR << "Couldn't find dbus connection "
+                                 << connection;
+                continue;
             }
+            const boost::container::flat_set<std::string>& interfaces =
+                thisSession->second.interfaces;
+            auto text = std::find_if(
+                filtered.begin(), filtered.end(),
+                [&interfaces](const auto& entry) {
+                    return *entry.first == interfaces;
+                });
+            if (text == filtered.end())
+            {
+                nlohmann::json sessionJson = j;
+                for (auto& entry : data[1].items())
+                {
+                    if (interfaces.find(entry.key()) != interfaces.end())
+                    {
+                        sessionJson["interfaces"][entry.key()] = entry.value();
+                    }
+                }
+                filtered.emplace_back(&interfaces, sessionJson.dump());
+                text = filtered.end() - 1;
+            }
+            connection->sendText(text->second);
         }
     }
     else
@@ -107,20 +153,64 @@ inline int onPropertyUpdate(sd_bus_message* m, void* userdata,
         return 0;
     }
 
-    connection->sendText(j.dump());
     return 0;
 };
 
+inline void subscribe(crow::websocket::Connection& conn,
+                      DbusWebsocketSession& session, const std::string& rule)
+{
+    if (!session.rules.insert(rule).second)
+    {
+        // Already subscribed
+        return;
+    }
+    std::unique_ptr<SharedMatch>& sharedMatch = matchRegistry[rule];
+    if (sharedMatch == nullptr)
+    {
+        BMCWEB_LOG_DEBUG << "Creating match " << rule;
+        sharedMatch = std::make_unique<SharedMatch>();
+        sharedMatch->match = std::make_unique<sdbusplus::bus::match::match>(
+            *crow::connections::systemBus, rule, onPropertyUpdate,
+            sharedMatch.get());
+    }
+    sharedMatch->subscribers.insert(&conn);
+}
+
+inline void unsubscribeAll(crow::websocket::Connection& conn)
+{
+    auto thisSession = sessions.find(&conn);
+    if (thisSession == sessions.end())
+    {
+        return;
+    }
+    for (const std::string& rule : thisSession->second.rules)
+    {
+        auto sharedMatch = matchRegistry.find(rule);
+        if (sharedMatch == matchRegistry.end())
+        {
+            continue;
+        }
+        sharedMatch->second->subscribers.erase(&conn);
+        if (sharedMatch->second->subscribers.empty())
+        {
+            BMCWEB_LOG_DEBUG << "Removing match " << rule;
+            matchRegistry.erase(sharedMatch);
+        }
+    }
+    sessions.erase(thisSession);
+}
+
 template <typename... Middlewares> void requestRoutes(Crow<Middlewares...>& app)
 {
     BMCWEB_ROUTE(app, "/subscribe")
         .websocket()
+        .deflate()
         .onopen([&](crow::websocket::Connection& conn) {
             BMCWEB_LOG_DEBUG << "Connection " << &conn << " opened";
             sessions[&conn] = DbusWebsocketSession();
         })
         .onclose([&](crow::websocket::Connection& conn,
-                     const std::string& reason) { sessions.erase(&conn); })
+                     const std::string& reason) { unsubscribeAll(conn); })
         .onmessage([&](crow::websocket::Connection& conn,
                        const std::string& data, bool is_binary) {
             DbusWebsocketSession& thisSession = sessions[&conn];
@@ -148,20 +238,6 @@ template <typename... Middlewares> void requestRoutes(Crow<Middlewares...>& app)
             }
 
             nlohmann::json::iterator paths = j.find("paths");
-            if (paths != j.end())
-            {
-                int interfaceCount = thisSession.interfaces.size();
-                if (interfaceCount == 0)
-                {
-                    interfaceCount = 1;
-                }
-                // Reserve our matches upfront.  For each path there is 1 for
-                // interfacesAdded, and InterfaceCount number for
-                // PropertiesChanged
-                thisSession.matches.reserve(thisSession.matches.size() +
-                                            paths->size() *
-                                                (1 + interfaceCount));
-            }
             std::string object_manager_match_string;
             std::string properties_match_string;
             std::string object_manager_interfaces_match_string;
@@ -198,13 +274,7 @@ template <typename... Middlewares> void requestRoutes(Crow<Middlewares...>& app)
                 // interfaces
                 if (thisSession.interfaces.size() == 0)
                 {
-                    BMCWEB_LOG_DEBUG << "Creating match "
-                                     << properties_match_string;
-
-                    thisSession.matches.emplace_back(
-                        std::make_unique<sdbusplus::bus::match::match>(
-                            *crow::connections::systemBus,
-                            properties_match_string, onPropertyUpdate, &conn));
+                    subscribe(conn, thisSession, properties_match_string);
                 }
                 else
                 {
@@ -222,12 +292,7 @@ template <typename... Middlewares> void requestRoutes(Crow<Middlewares...>& app)
                         std::string ifaceMatchString = properties_match_string +
                                                        ",arg0='" + interface +
                                                        "'";
-                        BMCWEB_LOG_DEBUG << "Creating match "
-                                         << ifaceMatchString;
-                        thisSession.matches.emplace_back(
-                            std::make_unique<sdbusplus::bus::match::match>(
-                                *crow::connections::systemBus, ifaceMatchString,
-                                onPropertyUpdate, &conn));
+                        subscribe(conn, thisSession, ifaceMatchString);
                     }
                 }
                 object_manager_match_string =
@@ -237,12 +302,7 @@ template <typename... Middlewares> void requestRoutes(Crow<Middlewares...>& app)
                      *thisPathString +
                      "',"
                      "member='InterfacesAdded'");
-                BMCWEB_LOG_DEBUG << "Creating match "
-                                 << object_manager_match_string;
-                thisSession.matches.emplace_back(
-                    std::make_unique<sdbusplus::bus::match::match>(
-                        *crow::connections::systemBus,
-                        object_manager_match_string, onPropertyUpdate, &conn));
+                subscribe(conn, thisSession, object_manager_match_string);
             }
         });
 }
@@ -0,0 +1,601 @@
+#pragma once
+
+#include <zlib.h>
+
+#include <algorithm>
+#include <array>
+#include <ast_jpeg_decoder.hpp>
+#include <boost/endian/arithmetic.hpp>
+#include <boost/endian/conversion.hpp>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <vector>
+
+namespace crow
+{
+namespace kvm
+{
+
+// A true color pixel format requested by an RFB client, with the per channel
+// lookups needed to translate decoder output into it
+class ClientPixelFormat
+{
+  public:
+    // The format announced in the server initialization message
+    ClientPixelFormat()
+    {
+        set(32, 24, false, 255, 255, 255, 16, 8, 0);
+    }
+
+    // Returns false, leaving the format as it was, for formats this server
+    // can't produce
+    bool set(uint8_t bitsPerPixel, uint8_t depthIn, bool bigEndianIn,
+             uint16_t redMax, uint16_t greenMax, uint16_t blueMax,
+             uint8_t redShift, uint8_t greenShift, uint8_t blueShift)
+    {
+        if ((bitsPerPixel != 8 && bitsPerPixel != 16 && bitsPerPixel != 32) ||
+            redMax == 0 || greenMax == 0 || blueMax == 0 ||
+            redShift >= bitsPerPixel || greenShift >= bitsPerPixel ||
+            blueShift >= bitsPerPixel)
+        {
+            return false;
+        }
+        bytesPerPixel = bitsPerPixel / 8;
+        depth = depthIn;
+        bigEndian = bigEndianIn;
+        for (uint32_t c = 0; c < 256; c++)
+        {
+            red[c] = ((c * redMax + 127) / 255) << redShift;
+            green[c] = ((c * greenMax + 127) / 255) << greenShift;
+            blue[c] = ((c * blueMax + 127) / 255) << blueShift;
+        }
+
+        // ZRLE sends 32 bit pixels as 3 bytes when every channel fits in
+        // either the low or the high three bytes
+        uint32_t used = red[255] | green[255] | blue[255];
+        compactSize = bytesPerPixel;
+        if (bytesPerPixel == 4 && depth <= 24)
+        {
+            if ((used & 0xFF000000) == 0)
+            {
+                compactSize = 3;
+                compactOffset = bigEndian ? 1 : 0;
+            }
+            else if ((used & 0x000000FF) == 0)
+            {
+                compactSize = 3;
+                compactOffset = bigEndian ? 0 : 1;
+            }
+        }
+        return true;
+    }
+
+    // mask drops the low bits of each channel for reduced quality updates
+    uint32_t pack(const ast_video::RGB& pixel, uint8_t mask = 0xFF) const
+    {
+        return red[pixel.r & mask] | green[pixel.g & mask] |
+               blue[pixel.b & mask];
+    }
+
+    size_t pixelSize() const
+    {
+        return bytesPerPixel;
+    }
+
+    // Size of a ZRLE CPIXEL
+    size_t compactPixelSize() const
+    {
+        return compactSize;
+    }
+
+    // Writes a packed pixel in the client's byte order
+    char* write(uint32_t value, char* out) const
+    {
+        writeBytes(value, out);
+        return out + bytesPerPixel;
+    }
+
+    char* writeCompact(uint32_t value, char* out) const
+    {
+        if (compactSize == bytesPerPixel)
+        {
+            return write(value, out);
+        }
+        char bytes[4];
+        writeBytes(value, bytes);
+        std::memcpy(out, bytes + compactOffset, 3);
+        return out + 3;
+    }
+
+    bool operator==(const ClientPixelFormat& other) const
+    {
+        return bytesPerPixel == other.bytesPerPixel &&
+               bigEndian == other.bigEndian &&
+               compactSize == other.compactSize &&
+               compactOffset == other.compactOffset && red == other.red &&
+               green == other.green && blue == other.blue;
+    }
+
+  private:
+    void writeBytes(uint32_t value, char* out) const
+    {
+        switch (bytesPerPixel)
+        {
+            case 1:
+                out[0] = static_cast<char>(value);
+                break;
+            case 2:
+            {
+                uint16_t v = static_cast<uint16_t>(value);
+                v = bigEndian ? boost::endian::native_to_big(v)
+                              : boost::endian::native_to_little(v);
+                std::memcpy(out, &v, 2);
+            }
+            break;
+            default:
+                value = bigEndian ? boost::endian::native_to_big(value)
+                                  : boost::endian::native_to_little(value);
+                std::memcpy(out, &value, 4);
+                break;
+        }
+    }
+
+    size_t bytesPerPixel = 4;
+    uint8_t depth = 24;
+    bool bigEndian = false;
+    size_t compactSize = 3;
+    size_t compactOffset = 0;
+    std::array<uint32_t, 256> red{};
+    std::array<uint32_t, 256> green{};
+    std::array<uint32_t, 256> blue{};
+};
+
+// A rectangle of decoder tiles
+struct TileRect
+{
+    size_t x;
+    size_t y;
+    size_t width;
+    size_t height;
+
+    bool operator==(const TileRect& other) const
+    {
+        return x == other.x && y == other.y && width == other.width &&
+               height == other.height;
+    }
+};
+
+// Turns the changed tiles into rectangles.  Runs of tiles on a row become one
+// rectangle, which grows down while the rows below have the same run.
+inline std::vector<TileRect> mergeTiles(const std::vector<uint8_t>& tiles,
+                                        size_t columns, size_t rows)
+{
+    std::vector<TileRect> rects;
+    // Rectangles that reach down to the previous row
+    std::vector<size_t> open;
+    std::vector<size_t> stillOpen;
+    for (size_t y = 0; y < rows; y++)
+    {
+        stillOpen.clear();
+        size_t x = 0;
+        while (x < columns)
+        {
+            if (tiles[y * columns + x] == 0)
+            {
+                x++;
+                continue;
+            }
+            size_t start = x;
+            while (x < columns && tiles[y * columns + x] != 0)
+            {
+                x++;
+            }
+            auto above =
+                std::find_if(open.begin(), open.end(), [&](size_t index) {
+                    return rects[index].x == start &&
+                           rects[index].width == x - start;
+                });
+            if (above != open.end())
+            {
+                rects[*above].height++;
+                stillOpen.push_back(*above);
+            }
+            else
+            {
+                rects.push_back({start, y, x - start, 1});
+                stillOpen.push_back(rects.size() - 1);
+            }
+        }
+        open.swap(stillOpen);
+    }
+    return rects;
+}
+
+// Appends the Raw encoding (RFC 6143 7.7.1) of the width x height rectangle
+// at pixels, whose rows are stride pixels apart, to out
+inline void encodeRaw(const ast_video::RGB* pixels, size_t stride,
+                      size_t width, size_t height,
+                      const ClientPixelFormat& format, uint8_t mask,
+                      std::string& out)
+{
+    size_t offset = out.size();
+    out.resize(offset + width * height * format.pixelSize());
+    char* data = &out[offset];
+    for (size_t row = 0; row < height; row++)
+    {
+        const ast_video::RGB* pixel = pixels + row * stride;
+        for (size_t col = 0; col < width; col++, pixel++)
+        {
+            data = format.write(format.pack(*pixel, mask), data);
+        }
+    }
+}
+
+// Appends a PNG chunk of the given type
+inline void appendPngChunk(const char* type, const std::string& data,
+                           std::string& out)
+{
+    boost::endian::big_uint32_t length = static_cast<uint32_t>(data.size());
+    out.append(reinterpret_cast<const char*>(&length), 4);
+    size_t crcStart = out.size();
+    out.append(type, 4);
+    out += data;
+    boost::endian::big_uint32_t crc = static_cast<uint32_t>(
+        crc32(0, reinterpret_cast<const Bytef*>(&out[crcStart]),
+              static_cast<uInt>(out.size() - crcStart)));
+    out.append(reinterpret_cast<const char*>(&crc), 4);
+}
+
+// Encodes the width x height image at pixels, whose rows are stride pixels
+// apart, as an 8 bit RGB PNG.  A scale above 1 shrinks the image by that
+// factor, averaging each scale x scale square into one pixel.  An image with
+// no pixels, as captured with no video signal, gives an empty string.
+inline std::string encodePng(const ast_video::RGB* pixels, size_t stride,
+                             size_t width, size_t height, size_t scale = 1)
+{
+    if (width == 0 || height == 0)
+    {
+        return std::string();
+    }
+    scale = std::max<size_t>(scale, 1);
+    const size_t outWidth = std::max<size_t>(width / scale, 1);
+    const size_t outHeight = std::max<size_t>(height / scale, 1);
+    scale = std::min({scale, width, height});
+
+    // Each row is the Sub filter type followed by the differences from the
+    // pixel to the left, which makes flat areas of a desktop all zeroes
+    const size_t rowSize = 1 + outWidth * 3;
+    std::string filtered(rowSize * outHeight, 0);
+    std::vector<uint32_t> sums(outWidth * 3);
+    const uint32_t area = static_cast<uint32_t>(scale * scale);
+    for (size_t y = 0; y < outHeight; y++)
+    {
+        std::fill(sums.begin(), sums.end(), 0);
+        for (size_t row = 0; row < scale; row++)
+        {
+            const ast_video::RGB* in = pixels + (y * scale + row) * stride;
+            for (size_t x = 0; x < outWidth * scale; x++, in++)
+            {
+                uint32_t* sum = &sums[(x / scale) * 3];
+                sum[0] += in->r;
+                sum[1] += in->g;
+                sum[2] += in->b;
+            }
+        }
+        char* out = &filtered[y * rowSize];
+        *out++ = 1;
+        uint8_t left[3] = {0, 0, 0};
+        for (size_t i = 0; i < outWidth * 3; i++)
+        {
+            uint8_t value = static_cast<uint8_t>((sums[i] + area / 2) / area);
+            *out++ = static_cast<char>(value - left[i % 3]);
+            left[i % 3] = value;
+        }
+    }
+
+    std::string compressed(compressBound(filtered.size()), 0);
+    uLongf compressedSize = compressed.size();
+    // A fast level; the filtering already makes flat areas compress well
+    compress2(reinterpret_cast<Bytef*>(&compressed[0]), &compressedSize,
+              reinterpret_cast<const Bytef*>(filtered.data()),
+              filtered.size(), 1);
+    compressed.resize(compressedSize);
+
+    struct
+    {
+        boost::endian::big_uint32_t width;
+        boost::endian::big_uint32_t height;
+        uint8_t bitDepth = 8;
+        uint8_t colorType = 2; // RGB
+        uint8_t compression = 0;
+        uint8_t filter = 0;
+        uint8_t interlace = 0;
+    } header;
+    static_assert(sizeof(header) == 13, "PNG header must be packed");
+    header.width = static_cast<uint32_t>(outWidth);
+    header.height = static_cast<uint32_t>(outHeight);
+
+    std::string png("\x89PNG\r\n\x1a\n", 8);
+    appendPngChunk(
+        "IHDR",
+        std::string(reinterpret_cast<const char*>(&header), sizeof(header)),
+        png);
+    appendPngChunk("IDAT", compressed, png);
+    appendPngChunk("IEND", std::string(), png);
+    return png;
+}
+
+// Tile encoder for ZRLE (RFC 6143 7.7.6).  It produces the uncompressed
+// tile data of a rectangle, which doesn't depend on anything sent before, so
+// it can be shared by every client that needs the same rectangle in the same
+// format.  ZrleStream then compresses it for each client.
+class ZrleTileEncoder
+{
+  public:
+    // Appends the tile data of the width x height rectangle at pixels (whose
+    // rows are stride pixels apart) to out
+    void encode(const ast_video::RGB* pixels, size_t stride, size_t width,
+                size_t height, const ClientPixelFormat& format, uint8_t mask,
+                std::string& out)
+    {
+        for (size_t y = 0; y < height; y += tileSize)
+        {
+            for (size_t x = 0; x < width; x += tileSize)
+            {
+                encodeTile(pixels + y * stride + x, stride,
+                           std::min(tileSize, width - x),
+                           std::min(tileSize, height - y), format, mask, out);
+            }
+        }
+    }
+
+  private:
+    static constexpr size_t tileSize = 64;
+    static constexpr size_t maxPaletteSize = 127;
+
+    // Bytes taken by a run length, as a series of 255s and a remainder
+    static size_t runLengthSize(size_t run)
+    {
+        return (run - 1) / 255 + 1;
+    }
+
+    static void writeRunLength(size_t run, std::string& out)
+    {
+        run -= 1;
+        while (run >= 255)
+        {
+            out.push_back(static_cast<char>(255));
+            run -= 255;
+        }
+        out.push_back(static_cast<char>(run));
+    }
+
+    static void writeCompact(uint32_t value, const ClientPixelFormat& format,
+                             std::string& out)
+    {
+        char bytes[4];
+        size_t size = format.writeCompact(value, bytes) - bytes;
+        out.append(bytes, size);
+    }
+
+    // Returns the palette index of value, adding it if there's room, or -1
+    int paletteIndex(uint32_t value)
+    {
+        for (size_t i = 0; i < paletteSize; i++)
+        {
+            if (palette[i] == value)
+            {
+                return static_cast<int>(i);
+            }
+        }
+        if (paletteSize == maxPaletteSize)
+        {
+            return -1;
+        }
+        palette[paletteSize] = value;
+        return static_cast<int>(paletteSize++);
+    }
+
+    void encodeTile(const ast_video::RGB* pixels, size_t stride, size_t width,
+                    size_t height, const ClientPixelFormat& format,
+                    uint8_t mask, std::string& out)
+    {
+        const size_t count = width * height;
+        for (size_t y = 0; y < height; y++)
+        {
+            for (size_t x = 0; x < width; x++)
+            {
+                values[y * width + x] =
+                    format.pack(pixels[y * stride + x], mask);
+            }
+        }
+
+        // Size every encoding, then write the smallest
+        paletteSize = 0;
+        bool paletteFull = false;
+        size_t runs = 0;
+        size_t plainRle = 0;
+        size_t paletteRle = 0;
+        for (size_t i = 0; i < count;)
+        {
+            size_t run = 1;
+            while (i + run < count && values[i + run] == values[i])
+            {
+                run++;
+            }
+            int index = paletteFull ? -1 : paletteIndex(values[i]);
+            if (index < 0)
+            {
+                paletteFull = true;
+            }
+            indexes[runs] = static_cast<uint8_t>(index);
+            runLengths[runs++] = run;
+            plainRle += runLengthSize(run);
+            paletteRle += run == 1 ? 1 : 1 + runLengthSize(run);
+            i += run;
+        }
+
+        const size_t cpixel = format.compactPixelSize();
+        if (!paletteFull && paletteSize == 1)
+        {
+            out.push_back(1);
+            writeCompact(values[0], format, out);
+            return;
+        }
+
+        size_t rawSize = count * cpixel;
+        plainRle += runs * cpixel;
+        size_t best = std::min(rawSize, plainRle);
+        size_t packedSize = SIZE_MAX;
+        size_t bits = paletteSize <= 2 ? 1 : paletteSize <= 4 ? 2 : 4;
+        if (!paletteFull)
+        {
+            paletteRle += paletteSize * cpixel;
+            if (paletteSize <= 16)
+            {
+                packedSize =
+                    paletteSize * cpixel + height * ((width * bits + 7) / 8);
+            }
+            best = std::min({best, paletteRle, packedSize});
+        }
+
+        if (best == packedSize)
+        {
+            out.push_back(static_cast<char>(paletteSize));
+            for (size_t i = 0; i < paletteSize; i++)
+            {
+                writeCompact(palette[i], format, out);
+            }
+            size_t i = 0;
+            for (size_t r = 0; r < runs; r++)
+            {
+                for (size_t n = 0; n < runLengths[r]; n++, i++)
+                {
+                    values[i] = indexes[r];
+                }
+            }
+            for (size_t y = 0; y < height; y++)
+            {
+                uint8_t byte = 0;
+                size_t used = 0;
+                for (size_t x = 0; x < width; x++)
+                {
+                    byte = static_cast<uint8_t>(
+                        byte | (values[y * width + x] << (8 - bits - used)));
+                    used += bits;
+                    if (used == 8)
+                    {
+                        out.push_back(static_cast<char>(byte));
+                        byte = 0;
+                        used = 0;
+                    }
+                }
+                if (used != 0)
+                {
+                    out.push_back(static_cast<char>(byte));
+                }
+            }
+        }
+        else if (best == paletteRle && !paletteFull)
+        {
+            out.push_back(static_cast<char>(128 + paletteSize));
+            for (size_t i = 0; i < paletteSize; i++)
+            {
+                writeCompact(palette[i], format, out);
+            }
+            for (size_t r = 0; r < runs; r++)
+            {
+                if (runLengths[r] == 1)
+                {
+                    out.push_back(static_cast<char>(indexes[r]));
+                }
+                else
+                {
+                    out.push_back(static_cast<char>(indexes[r] | 128));
+                    writeRunLength(runLengths[r], out);
+                }
+            }
+        }
+        else if (best == plainRle)
+        {
+            out.push_back(static_cast<char>(128));
+            size_t i = 0;
+            for (size_t r = 0; r < runs; r++)
+            {
+                writeCompact(values[i], format, out);
+                writeRunLength(runLengths[r], out);
+                i += runLengths[r];
+            }
+        }
+        else
+        {
+            out.push_back(0);
+            for (size_t i = 0; i < count; i++)
+            {
+                writeCompact(values[i], format, out);
+            }
+        }
+    }
+
+    std::array<uint32_t, tileSize * tileSize> values{};
+    std::array<size_t, tileSize * tileSize> runLengths{};
+    std::array<uint8_t, tileSize * tileSize> indexes{};
+    std::array<uint32_t, maxPaletteSize> palette{};
+    size_t paletteSize = 0;
+};
+
+// The zlib stream of one ZRLE client.  It's shared by every rectangle sent to
+// that client for the life of the connection, so it must not be used for more
+// than one.
+class ZrleStream
+{
+  public:
+    ZrleStream()
+    {
+        stream.zalloc = Z_NULL;
+        stream.zfree = Z_NULL;
+        stream.opaque = Z_NULL;
+        // A fast level; the tile encodings already remove most redundancy
+        deflateInit(&stream, 1);
+    }
+
+    ~ZrleStream()
+    {
+        deflateEnd(&stream);
+    }
+
+    ZrleStream(const ZrleStream&) = delete;
+    ZrleStream& operator=(const ZrleStream&) = delete;
+
+    // Appends the ZRLE data of a rectangle, its compressed tile data preceded
+    // by the length, to out
+    void compress(const std::string& tiles, std::string& out)
+    {
+        size_t lengthOffset = out.size();
+        out.resize(lengthOffset + 4);
+        stream.next_in =
+            reinterpret_cast<Bytef*>(const_cast<char*>(tiles.data()));
+        stream.avail_in = static_cast<uInt>(tiles.size());
+        do
+        {
+            size_t used = out.size();
+            size_t space = deflateBound(&stream, stream.avail_in) + 16;
+            out.resize(used + space);
+            stream.next_out = reinterpret_cast<Bytef*>(&out[used]);
+            stream.avail_out = static_cast<uInt>(space);
+            deflate(&stream, Z_SYNC_FLUSH);
+            out.resize(out.size() - stream.avail_out);
+        } while (stream.avail_in != 0 || stream.avail_out == 0);
+
+        boost::endian::big_uint32_t length =
+            static_cast<uint32_t>(out.size() - lengthOffset - 4);
+        std::memcpy(&out[lengthOffset], &length, 4);
+    }
+
+  private:
+    z_stream stream{};
+};
+
+} // namespace kvm
+} // namespace crow
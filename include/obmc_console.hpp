@@ -3,138 +3,327 @@
 #include <crow/websocket.h>
 #include <sys/socket.h>
 
+#include <boost/algorithm/string/split.hpp>
+#include <boost/algorithm/string/trim.hpp>
+#include <boost/asio/steady_timer.hpp>
 #include <boost/container/flat_map.hpp>
 #include <boost/container/flat_set.hpp>
+#include <chrono>
+#include <console_capture.hpp>
+#include <console_scrollback.hpp>
 #include <webserver_common.hpp>
 
+// Comma separated ids of the host consoles served besides the default one.
+// Each is the obmc-console socket "obmc-console.<id>", served at
+// /console/<id>.
+#ifndef BMCWEB_HOST_CONSOLES
+#define BMCWEB_HOST_CONSOLES ""
+#endif
+
 namespace crow
 {
 namespace obmc_console
 {
 
-static std::unique_ptr<boost::asio::local::stream_protocol::socket> host_socket;
+// The host's output is kept from startup, whether or not anyone is viewing it,
+// and the last this much is replayed to each new viewer
+constexpr size_t scrollbackSize = 1024 * 1024;
 
-static std::array<char, 4096> outputBuffer;
-static std::string inputBuffer;
+// A console viewer this far behind the host's output is disconnected, rather
+// than buffering it without limit.  It leaves room for a full replay.
+constexpr size_t maxSendQueue = 2 * scrollbackSize;
 
-static boost::container::flat_set<crow::websocket::Connection*> sessions;
+// Input beyond this, waiting for a console that isn't keeping up, is dropped
+constexpr size_t maxInputBuffer = 64 * 1024;
 
-static bool doingWrite = false;
+// How long to wait before trying the console socket again after losing it
+constexpr std::chrono::seconds reconnectDelay(5);
 
-void doWrite()
+// The abstract socket obmc-console serves a console id on
+inline std::string socketName(const std::string& id)
 {
-    if (doingWrite)
+    std::string name("\0obmc-console", 13);
+    if (!id.empty())
     {
-        BMCWEB_LOG_DEBUG << "Already writing.  Bailing out";
-        return;
+        name += "." + id;
     }
+    return name;
+}
 
-    if (inputBuffer.empty())
+// One host console socket and the websocket sessions viewing it.  Every
+// console is read asynchronously on the server's io_context.
+class Console
+{
+  public:
+    Console(boost::asio::io_context& io, const std::string& id) :
+        endpoint(socketName(id)), name(socketName(id).substr(1)),
+        hostSocket(io), reconnectTimer(io), scrollback(scrollbackSize)
     {
-        BMCWEB_LOG_DEBUG << "Outbuffer empty.  Bailing out";
-        return;
+#ifdef BMCWEB_ENABLE_HOST_CONSOLE_CAPTURE
+        capture = std::make_unique<ConsoleCapture>(io, captureDir, name);
+#endif
     }
 
-    doingWrite = true;
-    host_socket->async_write_some(
-        boost::asio::buffer(inputBuffer.data(), inputBuffer.size()),
-        [](boost::beast::error_code ec, std::size_t bytes_written) {
-            doingWrite = false;
-            inputBuffer.erase(0, bytes_written);
+    Console(const Console&) = delete;
+    Console& operator=(const Console&) = delete;
 
-            if (ec == boost::asio::error::eof)
-            {
-                for (auto session : sessions)
+    void connect()
+    {
+        hostSocket.async_connect(
+            endpoint, [this](const boost::system::error_code& ec) {
+                connectHandler(ec);
+            });
+    }
+
+    void addSession(crow::websocket::Connection& conn)
+    {
+        // The console is a byte stream, so output that piles up behind a
+        // slow viewer can go out in fewer, larger messages
+        conn.setCoalescing(true);
+        conn.setSendQueueLimit(maxSendQueue,
+                               crow::websocket::OverflowPolicy::close);
+        sessions.insert(&conn);
+
+        // Everything held goes out in one write, ahead of new output
+        if (scrollback.size() != 0)
+        {
+            conn.sendBinary(scrollback.contents());
+        }
+    }
+
+    void removeSession(crow::websocket::Connection& conn)
+    {
+        sessions.erase(&conn);
+        if (sessions.empty())
+        {
+            // The console stays connected to keep the scrollback filled, but
+            // input nobody is around for is dropped
+            inputBuffer.clear();
+            inputBuffer.shrink_to_fit();
+        }
+    }
+
+    void input(const std::string& data)
+    {
+        if (inputBuffer.size() + data.size() > maxInputBuffer)
+        {
+            BMCWEB_LOG_ERROR << "Console " << name
+                             << " input queue full, dropping " << data.size()
+                             << " bytes";
+            return;
+        }
+        inputBuffer += data;
+        doWrite();
+    }
+
+  private:
+    void doWrite()
+    {
+        if (doingWrite)
+        {
+            BMCWEB_LOG_DEBUG << "Already writing.  Bailing out";
+            return;
+        }
+
+        if (inputBuffer.empty())
+        {
+            BMCWEB_LOG_DEBUG << "Outbuffer empty.  Bailing out";
+            return;
+        }
+
+        if (!connected)
+        {
+            BMCWEB_LOG_DEBUG << "Not connected.  Bailing out";
+            return;
+        }
+
+        doingWrite = true;
+        hostSocket.async_write_some(
+            boost::asio::buffer(inputBuffer.data(), inputBuffer.size()),
+            [this](boost::beast::error_code ec, std::size_t bytes_written) {
+                doingWrite = false;
+                inputBuffer.erase(0, bytes_written);
+
+                if (ec == boost::asio::error::eof)
                 {
-                    session->close("Error in reading to host port");
+                    closeSessions("Error in reading to host port");
+                    return;
                 }
-                return;
-            }
+                if (ec)
+                {
+                    BMCWEB_LOG_ERROR << "Error in host serial write " << ec;
+                    return;
+                }
+                doWrite();
+            });
+    }
+
+    // Drops the console socket and tries it again after reconnectDelay
+    void reconnect()
+    {
+        connected = false;
+        doingWrite = false;
+        hostSocket.close();
+        reconnectTimer.expires_after(reconnectDelay);
+        reconnectTimer.async_wait([this](const boost::system::error_code& ec) {
             if (ec)
             {
-                BMCWEB_LOG_ERROR << "Error in host serial write " << ec;
                 return;
             }
-            doWrite();
+            connect();
         });
-}
+    }
 
-void doRead()
-{
-    BMCWEB_LOG_DEBUG << "Reading from socket";
-    host_socket->async_read_some(
-        boost::asio::buffer(outputBuffer.data(), outputBuffer.size()),
-        [](const boost::system::error_code& ec, std::size_t bytesRead) {
-            BMCWEB_LOG_DEBUG << "read done.  Read " << bytesRead << " bytes";
-            if (ec)
-            {
-                BMCWEB_LOG_ERROR << "Couldn't read from host serial port: "
-                                 << ec;
+    void doRead()
+    {
+        BMCWEB_LOG_DEBUG << "Reading from socket";
+        hostSocket.async_read_some(
+            boost::asio::buffer(outputBuffer.data(), outputBuffer.size()),
+            [this](const boost::system::error_code& ec, std::size_t bytesRead) {
+                BMCWEB_LOG_DEBUG << "read done.  Read " << bytesRead
+                                 << " bytes";
+                if (ec)
+                {
+                    BMCWEB_LOG_ERROR
+                        << "Couldn't read from host serial port: " << ec;
+                    closeSessions("Error in connecting to host port");
+                    reconnect();
+                    return;
+                }
+                scrollback.append(outputBuffer.data(), bytesRead);
+                if (capture != nullptr)
+                {
+                    capture->append(outputBuffer.data(), bytesRead);
+                }
+                auto payload = std::make_shared<const std::string>(
+                    outputBuffer.data(), bytesRead);
                 for (auto session : sessions)
                 {
-                    session->close("Error in connecting to host port");
+                    session->sendBinary(payload);
                 }
-                return;
-            }
-            boost::beast::string_view payload(outputBuffer.data(), bytesRead);
-            for (auto session : sessions)
-            {
-                session->sendBinary(payload);
-            }
-            doRead();
-        });
-}
+                doRead();
+            });
+    }
 
-void connectHandler(const boost::system::error_code& ec)
-{
-    if (ec)
+    void connectHandler(const boost::system::error_code& ec)
+    {
+        if (ec)
+        {
+            BMCWEB_LOG_ERROR << "Couldn't connect to host serial port "
+                             << name << ": " << ec;
+            closeSessions("Error in connecting to host port");
+            reconnect();
+            return;
+        }
+
+        connected = true;
+        doWrite();
+        doRead();
+    }
+
+    void closeSessions(const char* reason)
     {
-        BMCWEB_LOG_ERROR << "Couldn't connect to host serial port: " << ec;
         for (auto session : sessions)
         {
-            session->close("Error in connecting to host port");
+            session->close(reason);
         }
-        return;
     }
 
-    doWrite();
-    doRead();
-}
+    boost::asio::local::stream_protocol::endpoint endpoint;
+    // The socket name, for logs
+    std::string name;
+    boost::asio::local::stream_protocol::socket hostSocket;
+    boost::asio::steady_timer reconnectTimer;
+    bool connected = false;
 
-void requestRoutes(CrowApp& app)
+    std::array<char, 4096> outputBuffer;
+    std::string inputBuffer;
+    bool doingWrite = false;
+    Scrollback scrollback;
+    // Records the output to disk, when that's enabled
+    std::unique_ptr<ConsoleCapture> capture;
+
+    boost::container::flat_set<crow::websocket::Connection*> sessions;
+};
+
+// The consoles by id, the default console's id being empty
+static boost::container::flat_map<std::string, std::unique_ptr<Console>>
+    consoles;
+
+template <typename Func> void setupRoute(crow::WebSocketRule& rule, Func find)
 {
-    BMCWEB_ROUTE(app, "/console0")
-        .websocket()
-        .onopen([](crow::websocket::Connection& conn) {
+    rule.deflate()
+        .onopen([find](crow::websocket::Connection& conn) {
             BMCWEB_LOG_DEBUG << "Connection " << &conn << " opened";
-
-            sessions.insert(&conn);
-            if (host_socket == nullptr)
+            Console* console = find(conn);
+            if (console == nullptr)
             {
-                const std::string consoleName("\0obmc-console", 13);
-                boost::asio::local::stream_protocol::endpoint ep(consoleName);
-
-                host_socket = std::make_unique<
-                    boost::asio::local::stream_protocol::socket>(
-                    conn.get_io_context());
-                host_socket->async_connect(ep, connectHandler);
+                conn.close("No such console");
+                return;
             }
+            conn.userdata(console);
+            console->addSession(conn);
         })
         .onclose(
             [](crow::websocket::Connection& conn, const std::string& reason) {
-                sessions.erase(&conn);
-                if (sessions.empty())
+                Console* console = static_cast<Console*>(conn.userdata());
+                if (console != nullptr)
                 {
-                    host_socket = nullptr;
-                    inputBuffer.clear();
-                    inputBuffer.shrink_to_fit();
+                    console->removeSession(conn);
                 }
             })
         .onmessage([](crow::websocket::Connection& conn,
                       const std::string& data, bool is_binary) {
-            inputBuffer += data;
-            doWrite();
+            Console* console = static_cast<Console*>(conn.userdata());
+            if (console != nullptr)
+            {
+                console->input(data);
+            }
         });
 }
+
+void requestRoutes(CrowApp& app)
+{
+    std::string configured(BMCWEB_HOST_CONSOLES);
+    std::vector<std::string> ids;
+    boost::algorithm::split(ids, configured, [](char c) { return c == ','; });
+
+    std::shared_ptr<boost::asio::io_context> io = app.getIoContext();
+    consoles[""] = std::make_unique<Console>(*io, "");
+    consoles[""]->connect();
+    for (std::string& id : ids)
+    {
+        boost::algorithm::trim(id);
+        if (id.empty())
+        {
+            continue;
+        }
+        std::unique_ptr<Console>& console = consoles[id];
+        if (console == nullptr)
+        {
+            console = std::make_unique<Console>(*io, id);
+            console->connect();
+        }
+    }
+
+    setupRoute(BMCWEB_ROUTE(app, "/console0").websocket(),
+               [](crow::websocket::Connection&) { return consoles[""].get(); });
+
+    setupRoute(BMCWEB_ROUTE(app, "/console/<str>").websocket(),
+               [](crow::websocket::Connection& conn) -> Console* {
+                   std::string url(conn.req.url);
+                   std::string id = url.substr(url.rfind('/') + 1);
+                   if (id.empty())
+                   {
+                       return nullptr;
+                   }
+                   auto it = consoles.find(id);
+                   if (it == consoles.end())
+                   {
+                       return nullptr;
+                   }
+                   return it->second.get();
+               });
+}
 } // namespace obmc_console
 } // namespace crow
@@ -19,12 +19,18 @@
 #include <tinyxml2.h>
 
 #include <async_resp.hpp>
+#include <async_task.hpp>
 #include <boost/algorithm/string.hpp>
 #include <boost/container/flat_set.hpp>
 #include <dbus_singleton.hpp>
 #include <dbus_utility.hpp>
+#include <deque>
 #include <fstream>
+#include <map>
 #include <sdbusplus/message/types.hpp>
+#include <string_view>
+#include <unordered_map>
+#include <unordered_set>
 
 namespace crow
 {
@@ -51,6 +57,10 @@ const std::string methodNotAllowedDesc = "Method not allowed";
 const std::string forbiddenPropDesc =
     "The specified property cannot be created";
 const std::string forbiddenResDesc = "The specified resource cannot be created";
+const std::string badBatchDesc = "Expected a JSON array of operations";
+const std::string batchTooLargeDesc = "Too many operations in one batch";
+const std::string badBatchOperationDesc =
+    "Each operation needs a method and an object path";
 
 void setErrorResponse(crow::Response &res, boost::beast::http::status result,
                       const std::string &desc, const std::string &msg)
@@ -123,97 +133,267 @@ void introspectObjects(const std::string &processName,
         "Introspect");
 }
 
-void getPropertiesForEnumerate(const std::string &objectPath,
-                               const std::string &service,
-                               const std::string &interface,
-                               std::shared_ptr<bmcweb::AsyncResp> asyncResp)
+// Upper bound on the GetManagedObjects/GetAll calls a single enumerate keeps
+// in flight.  Without it a large subtree puts thousands of calls on the bus
+// at once and holds every reply in memory until the last one comes back.
+constexpr size_t maxEnumerateFetches = 8;
+
+// While more than this much output is waiting on a slow client, stop issuing
+// fetches and let the socket drain first.
+constexpr size_t maxEnumerateBacklog = 64 * 1024;
+
+struct InProgressEnumerateData
+{
+    InProgressEnumerateData(const std::string &objectPath,
+                            std::shared_ptr<bmcweb::AsyncResp> asyncResp,
+                            bool streamOutput) :
+        objectPath(objectPath),
+        asyncResp(asyncResp), streamOutput(streamOutput)
+    {
+    }
+
+    // An object is written out once every service hosting it has reported
+    // its properties.  services lists the ones not heard from yet, along with
+    // the interfaces each of them implements on the path.
+    struct PendingObject
+    {
+        std::vector<std::pair<std::string, std::vector<std::string>>> services;
+        nlohmann::json properties = nlohmann::json::object();
+        size_t outstandingGetAll = 0;
+        bool found = false;
+    };
+
+    const std::string objectPath;
+    std::shared_ptr<bmcweb::AsyncResp> asyncResp;
+    // When set, objects are sent to the client as chunks as soon as they're
+    // complete instead of being collected into res.jsonValue
+    const bool streamOutput;
+
+    std::shared_ptr<GetSubTreeType> subtree;
+    std::unordered_map<std::string, PendingObject> pending;
+    // Paths already written, so an object reported by more than one
+    // ObjectManager is only written once
+    std::unordered_set<std::string> written;
+    // (connection, path) of every ObjectManager queried so far
+    boost::container::flat_set<std::pair<std::string, std::string>>
+        objectManagers;
+
+    std::deque<std::function<void()>> fetches;
+    size_t fetchesInFlight = 0;
+    bool fallbackStarted = false;
+    bool waitingForDrain = false;
+    bool finished = false;
+
+    // Serialized objects not yet handed to the response
+    std::string output;
+    bool wroteObject = false;
+};
+
+template <typename PropertyList>
+void addEnumerateProperties(nlohmann::json &objectJson,
+                            const PropertyList &properties)
+{
+    for (const auto &[name, value] : properties)
+    {
+        nlohmann::json &propertyJson = objectJson[name];
+        std::visit([&propertyJson](auto &&val) { propertyJson = val; }, value);
+    }
+}
+
+void emitEnumeratedObject(InProgressEnumerateData &transaction,
+                          const std::string &path,
+                          InProgressEnumerateData::PendingObject &object)
+{
+    if (!object.found)
+    {
+        // Nothing could be read from any service hosting this path
+        return;
+    }
+    transaction.written.insert(path);
+    if (!transaction.streamOutput)
+    {
+        transaction.asyncResp->res.jsonValue["data"][path] =
+            std::move(object.properties);
+        return;
+    }
+    if (transaction.wroteObject)
+    {
+        transaction.output += ',';
+    }
+    transaction.wroteObject = true;
+    transaction.output += nlohmann::json(path).dump(-1, ' ', true);
+    transaction.output += ':';
+    transaction.output += object.properties.dump(-1, ' ', true);
+}
+
+// Hands everything serialized so far to the client in a single chunk, so a
+// GetManagedObjects reply turns into one write rather than one per object.
+void flushEnumerateOutput(InProgressEnumerateData &transaction)
+{
+    if (!transaction.output.empty())
+    {
+        transaction.asyncResp->res.writeChunk(std::move(transaction.output));
+        transaction.output.clear();
+    }
+}
+
+void startEnumerateFallback(
+    const std::shared_ptr<InProgressEnumerateData> &transaction);
+
+void finishEnumerate(InProgressEnumerateData &transaction)
+{
+    if (transaction.finished)
+    {
+        return;
+    }
+    transaction.finished = true;
+    BMCWEB_LOG_DEBUG << "Enumerate of " << transaction.objectPath
+                     << " complete";
+    if (transaction.streamOutput)
+    {
+        transaction.output += "},\"message\":\"200 OK\",\"status\":\"ok\"}";
+        flushEnumerateOutput(transaction);
+    }
+    // The response is ended when the last reference to asyncResp goes away
+}
+
+// Issues queued fetches until maxEnumerateFetches are outstanding.  Once the
+// ObjectManager pass has drained, falls back to GetAll for whatever it didn't
+// cover, and once that has drained too, finishes the response.
+void runEnumerateFetches(
+    const std::shared_ptr<InProgressEnumerateData> &transaction)
+{
+    crow::Response &res = transaction->asyncResp->res;
+    if (!res.isAlive())
+    {
+        // Nobody left to send the results to
+        transaction->fetches.clear();
+        transaction->pending.clear();
+    }
+
+    while (!transaction->fetches.empty() &&
+           transaction->fetchesInFlight < maxEnumerateFetches)
+    {
+        if (res.streamBacklog() > maxEnumerateBacklog)
+        {
+            if (!transaction->waitingForDrain)
+            {
+                transaction->waitingForDrain = true;
+                res.onStreamDrained([transaction] {
+                    transaction->waitingForDrain = false;
+                    runEnumerateFetches(transaction);
+                });
+            }
+            return;
+        }
+        std::function<void()> fetch = std::move(transaction->fetches.front());
+        transaction->fetches.pop_front();
+        transaction->fetchesInFlight++;
+        fetch();
+    }
+
+    if (transaction->fetchesInFlight != 0 || !transaction->fetches.empty())
+    {
+        return;
+    }
+    if (!transaction->fallbackStarted)
+    {
+        transaction->fallbackStarted = true;
+        startEnumerateFallback(transaction);
+        return;
+    }
+    finishEnumerate(*transaction);
+}
+
+void enumerateFetchDone(
+    const std::shared_ptr<InProgressEnumerateData> &transaction)
+{
+    flushEnumerateOutput(*transaction);
+    transaction->fetchesInFlight--;
+    runEnumerateFetches(transaction);
+}
+
+void getPropertiesForEnumerate(
+    const std::string &objectPath, const std::string &service,
+    const std::string &interface,
+    std::shared_ptr<InProgressEnumerateData> transaction)
 {
     BMCWEB_LOG_DEBUG << "getPropertiesForEnumerate " << objectPath << " "
                      << service << " " << interface;
 
     crow::connections::systemBus->async_method_call(
-        [asyncResp, objectPath, service,
+        [transaction, objectPath, service,
          interface](const boost::system::error_code ec,
                     const std::vector<
                         std::pair<std::string, dbus::utility::DbusVariantType>>
                         &propertiesList) {
-            if (ec)
+            auto it = transaction->pending.find(objectPath);
+            if (it != transaction->pending.end())
             {
-                BMCWEB_LOG_ERROR << "GetAll on path " << objectPath << " iface "
-                                 << interface << " service " << service
-                                 << " failed with code " << ec;
-                return;
-            }
-
-            nlohmann::json &dataJson = asyncResp->res.jsonValue["data"];
-            nlohmann::json &objectJson = dataJson[objectPath];
-            if (objectJson.is_null())
-            {
-                objectJson = nlohmann::json::object();
-            }
-
-            for (const auto &[name, value] : propertiesList)
-            {
-                nlohmann::json &propertyJson = objectJson[name];
-                std::visit([&propertyJson](auto &&val) { propertyJson = val; },
-                           value);
+                InProgressEnumerateData::PendingObject &object = it->second;
+                if (ec)
+                {
+                    BMCWEB_LOG_ERROR << "GetAll on path " << objectPath
+                                     << " iface " << interface << " service "
+                                     << service << " failed with code " << ec;
+                }
+                else
+                {
+                    object.found = true;
+                    addEnumerateProperties(object.properties, propertiesList);
+                }
+                if (--object.outstandingGetAll == 0)
+                {
+                    emitEnumeratedObject(*transaction, objectPath, object);
+                    transaction->pending.erase(it);
+                }
             }
+            enumerateFetchDone(transaction);
         },
         service, objectPath, "org.freedesktop.DBus.Properties", "GetAll",
         interface);
 }
 
 // Find any results that weren't picked up by ObjectManagers, to be
-// called after all ObjectManagers are searched for and called.
-void findRemainingObjectsForEnumerate(
-    const std::string &objectPath, std::shared_ptr<GetSubTreeType> subtree,
-    std::shared_ptr<bmcweb::AsyncResp> asyncResp)
+// called after all ObjectManagers have been queried.
+void startEnumerateFallback(
+    const std::shared_ptr<InProgressEnumerateData> &transaction)
 {
-    BMCWEB_LOG_DEBUG << "findRemainingObjectsForEnumerate";
-    const nlohmann::json &dataJson = asyncResp->res.jsonValue["data"];
+    BMCWEB_LOG_DEBUG << "startEnumerateFallback "
+                     << transaction->pending.size() << " objects remaining";
 
-    for (const auto &[path, interface_map] : *subtree)
+    // An enumerate does not return the target path's properties, unless an
+    // ObjectManager reported them
+    auto target = transaction->pending.find(transaction->objectPath);
+    if (target != transaction->pending.end())
     {
-        if (path == objectPath)
-        {
-            // An enumerate does not return the target path's properties
-            continue;
-        }
-        if (dataJson.find(path) == dataJson.end())
+        emitEnumeratedObject(*transaction, target->first, target->second);
+        transaction->pending.erase(target);
+    }
+
+    for (auto &[path, object] : transaction->pending)
+    {
+        for (const auto &[service, interfaces] : object.services)
         {
-            for (const auto &[service, interfaces] : interface_map)
+            for (const std::string &interface : interfaces)
             {
-                for (const auto &interface : interfaces)
-                {
-                    if (!boost::starts_with(interface, "org.freedesktop.DBus"))
-                    {
+                object.outstandingGetAll++;
+                transaction->fetches.emplace_back(
+                    [transaction, path{path}, service{service}, interface] {
                         getPropertiesForEnumerate(path, service, interface,
-                                                  asyncResp);
-                    }
-                }
+                                                  transaction);
+                    });
             }
         }
+        object.services.clear();
     }
+    runEnumerateFetches(transaction);
 }
 
-struct InProgressEnumerateData
-{
-    InProgressEnumerateData(const std::string &objectPath,
-                            std::shared_ptr<bmcweb::AsyncResp> asyncResp) :
-        objectPath(objectPath),
-        asyncResp(asyncResp)
-    {
-    }
-
-    ~InProgressEnumerateData()
-    {
-        findRemainingObjectsForEnumerate(objectPath, subtree, asyncResp);
-    }
-
-    const std::string objectPath;
-    std::shared_ptr<GetSubTreeType> subtree;
-    std::shared_ptr<bmcweb::AsyncResp> asyncResp;
-};
+void queueManagedObjectsForEnumerate(
+    const std::string &object_name, const std::string &object_manager_path,
+    const std::string &connection_name,
+    const std::shared_ptr<InProgressEnumerateData> &transaction);
 
 void getManagedObjectsForEnumerate(
     const std::string &object_name, const std::string &object_manager_path,
@@ -224,66 +404,111 @@ void getManagedObjectsForEnumerate(
                      << " object_manager_path " << object_manager_path
                      << " connection_name " << connection_name;
     crow::connections::systemBus->async_method_call(
-        [transaction, object_name,
+        [transaction, object_name, object_manager_path,
          connection_name](const boost::system::error_code ec,
                           const dbus::utility::ManagedObjectType &objects) {
             if (ec)
             {
-                BMCWEB_LOG_ERROR << "GetManagedObjects on path " << object_name
-                                 << " on connection " << connection_name
-                                 << " failed with code " << ec;
+                BMCWEB_LOG_ERROR << "GetManagedObjects on path "
+                                 << object_manager_path << " on connection "
+                                 << connection_name << " failed with code "
+                                 << ec;
+                enumerateFetchDone(transaction);
                 return;
             }
 
-            nlohmann::json &dataJson =
-                transaction->asyncResp->res.jsonValue["data"];
-
-            for (const auto &objectPath : objects)
+            for (const auto &[path, interfaces] : objects)
             {
-                if (boost::starts_with(objectPath.first.str, object_name))
+                for (const auto &interface : interfaces)
                 {
-                    BMCWEB_LOG_DEBUG << "Reading object "
-                                     << objectPath.first.str;
-                    nlohmann::json &objectJson = dataJson[objectPath.first.str];
-                    if (objectJson.is_null())
+                    if (interface.first == "org.freedesktop.DBus.ObjectManager")
                     {
-                        objectJson = nlohmann::json::object();
+                        queueManagedObjectsForEnumerate(path.str, path.str,
+                                                        connection_name,
+                                                        transaction);
                     }
-                    for (const auto &interface : objectPath.second)
+                }
+
+                auto it = transaction->pending.find(path.str);
+                if (it == transaction->pending.end())
+                {
+                    // Objects the mapper doesn't know about are still
+                    // returned, as long as they're below object_name
+                    if (boost::starts_with(path.str, object_name) &&
+                        transaction->written.count(path.str) == 0)
                     {
-                        for (const auto &property : interface.second)
+                        BMCWEB_LOG_DEBUG << "Reading object " << path.str;
+                        InProgressEnumerateData::PendingObject object;
+                        object.found = true;
+                        for (const auto &interface : interfaces)
                         {
-                            nlohmann::json &propertyJson =
-                                objectJson[property.first];
-                            std::visit([&propertyJson](
-                                           auto &&val) { propertyJson = val; },
-                                       property.second);
+                            addEnumerateProperties(object.properties,
+                                                   interface.second);
                         }
+                        emitEnumeratedObject(*transaction, path.str, object);
                     }
+                    continue;
                 }
-                for (const auto &interface : objectPath.second)
+                InProgressEnumerateData::PendingObject &object = it->second;
+                auto service = std::find_if(
+                    object.services.begin(), object.services.end(),
+                    [&connection_name](const auto &service) {
+                        return service.first == connection_name;
+                    });
+                if (service == object.services.end())
                 {
-                    if (interface.first == "org.freedesktop.DBus.ObjectManager")
-                    {
-                        getManagedObjectsForEnumerate(
-                            objectPath.first.str, objectPath.first.str,
-                            connection_name, transaction);
-                    }
+                    // Reported already through another ObjectManager
+                    continue;
+                }
+                BMCWEB_LOG_DEBUG << "Reading object " << path.str;
+                object.services.erase(service);
+                object.found = true;
+                for (const auto &interface : interfaces)
+                {
+                    addEnumerateProperties(object.properties,
+                                           interface.second);
+                }
+                if (object.services.empty())
+                {
+                    emitEnumeratedObject(*transaction, path.str, object);
+                    transaction->pending.erase(it);
                 }
             }
+            enumerateFetchDone(transaction);
         },
         connection_name, object_manager_path,
         "org.freedesktop.DBus.ObjectManager", "GetManagedObjects");
 }
 
+// Queues a GetManagedObjects on an ObjectManager, unless it's been queried
+// already.  Objects it reports are returned if they're below object_name.
+void queueManagedObjectsForEnumerate(
+    const std::string &object_name, const std::string &object_manager_path,
+    const std::string &connection_name,
+    const std::shared_ptr<InProgressEnumerateData> &transaction)
+{
+    if (!transaction->objectManagers
+             .emplace(connection_name, object_manager_path)
+             .second)
+    {
+        return;
+    }
+    transaction->fetches.emplace_back(
+        [transaction, object_name, object_manager_path, connection_name] {
+            getManagedObjectsForEnumerate(object_name, object_manager_path,
+                                          connection_name, transaction);
+        });
+}
+
 void findObjectManagerPathForEnumerate(
-    const std::string &object_name, const std::string &connection_name,
+    const std::string &connection_name,
     std::shared_ptr<InProgressEnumerateData> transaction)
 {
-    BMCWEB_LOG_DEBUG << "Finding objectmanager for path " << object_name
+    BMCWEB_LOG_DEBUG << "Finding objectmanager for path "
+                     << transaction->objectPath
                      << " on connection:" << connection_name;
     crow::connections::systemBus->async_method_call(
-        [transaction, object_name, connection_name](
+        [transaction, connection_name](
             const boost::system::error_code ec,
             const boost::container::flat_map<
                 std::string, boost::container::flat_map<
@@ -291,8 +516,10 @@ void findObjectManagerPathForEnumerate(
                 &objects) {
             if (ec)
             {
-                BMCWEB_LOG_ERROR << "GetAncestors on path " << object_name
+                BMCWEB_LOG_ERROR << "GetAncestors on path "
+                                 << transaction->objectPath
                                  << " failed with code " << ec;
+                enumerateFetchDone(transaction);
                 return;
             }
 
@@ -303,17 +530,22 @@ void findObjectManagerPathForEnumerate(
                     if (connectionGroup.first == connection_name)
                     {
                         // Found the object manager path for this resource.
-                        getManagedObjectsForEnumerate(
-                            object_name, pathGroup.first, connection_name,
-                            transaction);
+                        // Queue the fetch before releasing this one, so the
+                        // ObjectManager pass can't be considered finished.
+                        queueManagedObjectsForEnumerate(
+                            transaction->objectPath, pathGroup.first,
+                            connection_name, transaction);
+                        enumerateFetchDone(transaction);
                         return;
                     }
                 }
             }
+            enumerateFetchDone(transaction);
         },
         "xyz.openbmc_project.ObjectMapper",
         "/xyz/openbmc_project/object_mapper",
-        "xyz.openbmc_project.ObjectMapper", "GetAncestors", object_name,
+        "xyz.openbmc_project.ObjectMapper", "GetAncestors",
+        transaction->objectPath,
         std::array<const char *, 1>{"org.freedesktop.DBus.ObjectManager"});
 }
 
@@ -330,64 +562,94 @@ void getObjectAndEnumerate(std::shared_ptr<InProgressEnumerateData> transaction)
                       const GetObjectType &objects) {
             if (ec)
             {
-                BMCWEB_LOG_ERROR << "GetObject for path "
+                // Not an error; the target is often just a namespace with
+                // objects below it
+                BMCWEB_LOG_DEBUG << "GetObject for path "
                                  << transaction->objectPath
                                  << " failed with code " << ec;
-                return;
             }
-
-            BMCWEB_LOG_DEBUG << "GetObject for " << transaction->objectPath
-                             << " has " << objects.size() << " entries";
-            if (!objects.empty())
+            else if (!objects.empty())
             {
+                BMCWEB_LOG_DEBUG << "GetObject for " << transaction->objectPath
+                                 << " has " << objects.size() << " entries";
                 transaction->subtree->emplace_back(transaction->objectPath,
                                                    objects);
             }
 
-            // Map indicating connection name, and the path where the object
-            // manager exists
-            boost::container::flat_map<std::string, std::string> connections;
+            // Connections that host data in the subtree, and the
+            // ObjectManagers each of them has inside it
+            boost::container::flat_map<std::string, std::vector<std::string>>
+                connections;
+            boost::container::flat_map<std::string, std::vector<std::string>>
+                objectManagers;
 
-            for (const auto &object : *(transaction->subtree))
+            transaction->pending.reserve(transaction->subtree->size());
+            for (auto &[path, services] : *transaction->subtree)
             {
-                for (const auto &connection : object.second)
+                for (auto &[service, interfaces] : services)
                 {
-                    std::string &objectManagerPath =
-                        connections[connection.first];
-                    for (const auto &interface : connection.second)
+                    std::vector<std::string> dataInterfaces;
+                    for (std::string &interface : interfaces)
                     {
-                        BMCWEB_LOG_DEBUG << connection.first
-                                         << " has interface " << interface;
                         if (interface == "org.freedesktop.DBus.ObjectManager")
                         {
                             BMCWEB_LOG_DEBUG << "found object manager path "
-                                             << object.first;
-                            objectManagerPath = object.first;
+                                             << path;
+                            objectManagers[service].push_back(path);
+                        }
+                        else if (!boost::starts_with(interface,
+                                                     "org.freedesktop.DBus"))
+                        {
+                            dataInterfaces.emplace_back(std::move(interface));
                         }
                     }
+                    if (!dataInterfaces.empty())
+                    {
+                        connections[service];
+                        transaction->pending[path].services.emplace_back(
+                            service, std::move(dataInterfaces));
+                    }
                 }
             }
+            transaction->subtree.reset();
             BMCWEB_LOG_DEBUG << "Got " << connections.size() << " connections";
 
             for (const auto &connection : connections)
             {
-                // If we already know where the object manager is, we don't need
-                // to search for it, we can call directly in to
+                auto managers = objectManagers.find(connection.first);
+                // If we already know where the object managers are, we don't
+                // need to search for them, we can call directly in to
                 // getManagedObjects
-                if (!connection.second.empty())
+                if (managers != objectManagers.end())
                 {
-                    getManagedObjectsForEnumerate(
-                        transaction->objectPath, connection.second,
-                        connection.first, transaction);
+                    for (const std::string &managerPath : managers->second)
+                    {
+                        queueManagedObjectsForEnumerate(
+                            transaction->objectPath, managerPath,
+                            connection.first, transaction);
+                    }
                 }
                 else
                 {
                     // otherwise we need to find the object manager path before
                     // we can continue
-                    findObjectManagerPathForEnumerate(
-                        transaction->objectPath, connection.first, transaction);
+                    transaction->fetches.emplace_back(
+                        [transaction, connectionName{connection.first}] {
+                            findObjectManagerPathForEnumerate(connectionName,
+                                                              transaction);
+                        });
                 }
             }
+
+            if (transaction->streamOutput)
+            {
+                crow::Response &res = transaction->asyncResp->res;
+                res.addHeader("Content-Type", "application/json");
+                res.startStreaming();
+                transaction->output = "{\"data\":{";
+                flushEnumerateOutput(*transaction);
+            }
+            runEnumerateFetches(transaction);
         },
         "xyz.openbmc_project.ObjectMapper",
         "/xyz/openbmc_project/object_mapper",
@@ -465,132 +727,254 @@ struct InProgressActionData
     nlohmann::json arguments;
 };
 
-std::vector<std::string> dbusArgSplit(const std::string &string)
+// A D-Bus type signature compiled into a flat, pre-order list of type nodes.
+// Containers are immediately followed by the nodes of their contained types,
+// and every node records the index one past its last descendant, so the
+// converters below can walk siblings and children without ever reparsing or
+// splitting the signature string.
+struct DbusTypeNode
 {
-    std::vector<std::string> ret;
-    if (string.empty())
-    {
-        return ret;
-    }
-    ret.push_back("");
-    int containerDepth = 0;
+    char type;
+    // Index of the first node that is not a descendant of this one
+    uint32_t end;
+    // Signature of the container contents, in the form expected by
+    // sd_bus_message_open_container/sd_bus_message_enter_container.  Empty
+    // for basic types.
+    std::string contents;
+};
 
-    for (std::string::const_iterator character = string.begin();
-         character != string.end(); character++)
+using DbusSignature = std::vector<DbusTypeNode>;
+
+// D-Bus limits container nesting to 32 levels of arrays plus 32 of structs
+constexpr int maxDbusTypeDepth = 64;
+
+// Bound on the number of distinct signatures held by the cache.  Real
+// services expose a small, fixed set, so this only guards against a client
+// feeding us an endless stream of unique variant types.
+constexpr size_t maxCachedDbusSignatures = 512;
+
+bool isBasicDbusType(char type)
+{
+    switch (type)
     {
-        ret.back() += *character;
-        switch (*character)
-        {
-            case ('a'):
-                break;
-            case ('('):
-            case ('{'):
-                containerDepth++;
-                break;
-            case ('}'):
-            case (')'):
-                containerDepth--;
-                if (containerDepth == 0)
-                {
-                    if (character + 1 != string.end())
-                    {
-                        ret.push_back("");
-                    }
-                }
-                break;
-            default:
-                if (containerDepth == 0)
-                {
-                    if (character + 1 != string.end())
-                    {
-                        ret.push_back("");
-                    }
-                }
-                break;
-        }
+        case 'y':
+        case 'b':
+        case 'n':
+        case 'q':
+        case 'i':
+        case 'u':
+        case 'x':
+        case 't':
+        case 'd':
+        case 'h':
+        case 's':
+        case 'o':
+        case 'g':
+            return true;
+        default:
+            return false;
     }
-
-    return ret;
 }
 
-int convertJsonToDbus(sd_bus_message *m, const std::string &arg_type,
-                      const nlohmann::json &input_json)
+// Compiles the single complete type starting at signature[pos], appending its
+// nodes to the list.  Returns the position following the type, or npos if the
+// signature is malformed.
+size_t compileDbusType(std::string_view signature, size_t pos,
+                       DbusSignature &nodes, int depth)
 {
-    int r = 0;
-    BMCWEB_LOG_DEBUG << "Converting " << input_json.dump()
-                     << " to type: " << arg_type;
-    const std::vector<std::string> argTypes = dbusArgSplit(arg_type);
-
-    // Assume a single object for now.
-    const nlohmann::json *j = &input_json;
-    nlohmann::json::const_iterator jIt = input_json.begin();
+    if (pos >= signature.size() || depth > maxDbusTypeDepth)
+    {
+        return std::string_view::npos;
+    }
+    const char type = signature[pos];
+    const size_t self = nodes.size();
+    nodes.push_back({type, 0, std::string()});
 
-    for (const std::string &argCode : argTypes)
+    size_t next = pos + 1;
+    if (type == 'a')
     {
-        // If we are decoding multiple objects, grab the pointer to the
-        // iterator, and increment it for the next loop
-        if (argTypes.size() > 1)
+        next = compileDbusType(signature, next, nodes, depth + 1);
+        if (next == std::string_view::npos)
         {
-            if (jIt == input_json.end())
+            return next;
+        }
+        nodes[self].contents =
+            std::string(signature.substr(pos + 1, next - pos - 1));
+    }
+    else if (type == '(')
+    {
+        while (next < signature.size() && signature[next] != ')')
+        {
+            next = compileDbusType(signature, next, nodes, depth + 1);
+            if (next == std::string_view::npos)
             {
-                return -2;
+                return next;
             }
-            j = &*jIt;
-            jIt++;
         }
-        const int64_t *intValue = j->get_ptr<const int64_t *>();
-        const uint64_t *uintValue = j->get_ptr<const uint64_t *>();
-        const std::string *stringValue = j->get_ptr<const std::string *>();
-        const double *doubleValue = j->get_ptr<const double *>();
-        const bool *b = j->get_ptr<const bool *>();
-        int64_t v = 0;
-        double d = 0.0;
-
-        // Do some basic type conversions that make sense.  uint can be
-        // converted to int.  int and uint can be converted to double
-        if (uintValue != nullptr && intValue == nullptr)
+        // Structs must be terminated and can't be empty
+        if (next >= signature.size() || next == pos + 1)
         {
-            v = static_cast<int64_t>(*uintValue);
-            intValue = &v;
+            return std::string_view::npos;
         }
-        if (uintValue != nullptr && doubleValue == nullptr)
+        next++;
+        nodes[self].contents =
+            std::string(signature.substr(pos + 1, next - pos - 2));
+    }
+    else if (type == '{')
+    {
+        // Dict entries are only valid as array elements, and are exactly a
+        // basic key type followed by a value type.  An array node is always
+        // directly followed by its element node.
+        if (self == 0 || nodes[self - 1].type != 'a' ||
+            next >= signature.size() || !isBasicDbusType(signature[next]))
         {
-            d = static_cast<double>(*uintValue);
-            doubleValue = &d;
+            return std::string_view::npos;
         }
-        if (intValue != nullptr && doubleValue == nullptr)
+        next = compileDbusType(signature, next, nodes, depth + 1);
+        next = compileDbusType(signature, next, nodes, depth + 1);
+        if (next == std::string_view::npos || next >= signature.size() ||
+            signature[next] != '}')
         {
-            d = static_cast<double>(*intValue);
-            doubleValue = &d;
+            return std::string_view::npos;
         }
+        next++;
+        nodes[self].contents =
+            std::string(signature.substr(pos + 1, next - pos - 2));
+    }
+    else if (type != 'v' && !isBasicDbusType(type))
+    {
+        return std::string_view::npos;
+    }
+
+    nodes[self].end = static_cast<uint32_t>(nodes.size());
+    return next;
+}
+
+// Returns the compiled form of a signature, compiling and caching it on first
+// use.  Returns nullptr if the signature is malformed.  The returned pointer
+// keeps the compiled signature alive even if the cache is later flushed.
+std::shared_ptr<const DbusSignature>
+    getCompiledSignature(std::string_view signature)
+{
+    static std::map<std::string, std::shared_ptr<const DbusSignature>,
+                    std::less<>>
+        cache;
+
+    auto it = cache.find(signature);
+    if (it != cache.end())
+    {
+        return it->second;
+    }
 
-        if (argCode == "s")
+    auto compiled = std::make_shared<DbusSignature>();
+    size_t pos = 0;
+    while (pos < signature.size())
+    {
+        pos = compileDbusType(signature, pos, *compiled, 0);
+        if (pos == std::string_view::npos)
+        {
+            BMCWEB_LOG_ERROR << "Invalid D-Bus signature " << signature;
+            return nullptr;
+        }
+    }
+
+    if (cache.size() >= maxCachedDbusSignatures)
+    {
+        cache.clear();
+    }
+    cache.emplace(std::string(signature), compiled);
+    return compiled;
+}
+
+// Picks a D-Bus signature for a JSON value that is to be sent as a variant
+const char *getVariantSignature(const nlohmann::json &j)
+{
+    switch (j.type())
+    {
+        case nlohmann::json::value_t::boolean:
+            return "b";
+        case nlohmann::json::value_t::number_integer:
+            return "x";
+        case nlohmann::json::value_t::number_unsigned:
+            if (j.get<uint64_t>() >
+                static_cast<uint64_t>(std::numeric_limits<int64_t>::max()))
+            {
+                return "t";
+            }
+            return "x";
+        case nlohmann::json::value_t::number_float:
+            return "d";
+        case nlohmann::json::value_t::string:
+            return "s";
+        case nlohmann::json::value_t::array:
+            if (!j.empty() && j.front().is_string())
+            {
+                return "as";
+            }
+            return nullptr;
+        default:
+            return nullptr;
+    }
+}
+
+int writeDbusTypes(const DbusSignature &sig, uint32_t begin, uint32_t end,
+                   sd_bus_message *m, const nlohmann::json &j);
+
+int writeDbusType(const DbusSignature &sig, uint32_t index, sd_bus_message *m,
+                  const nlohmann::json &j)
+{
+    const DbusTypeNode &node = sig[index];
+    int r = 0;
+
+    const int64_t *intValue = j.get_ptr<const int64_t *>();
+    const uint64_t *uintValue = j.get_ptr<const uint64_t *>();
+    const std::string *stringValue = j.get_ptr<const std::string *>();
+    const double *doubleValue = j.get_ptr<const double *>();
+    const bool *b = j.get_ptr<const bool *>();
+    int64_t v = 0;
+    double d = 0.0;
+
+    // Do some basic type conversions that make sense.  uint can be
+    // converted to int.  int and uint can be converted to double
+    if (uintValue != nullptr && intValue == nullptr)
+    {
+        v = static_cast<int64_t>(*uintValue);
+        intValue = &v;
+    }
+    if (uintValue != nullptr && doubleValue == nullptr)
+    {
+        d = static_cast<double>(*uintValue);
+        doubleValue = &d;
+    }
+    if (intValue != nullptr && doubleValue == nullptr)
+    {
+        d = static_cast<double>(*intValue);
+        doubleValue = &d;
+    }
+
+    switch (node.type)
+    {
+        case 's':
+        case 'o':
+        case 'g':
         {
             if (stringValue == nullptr)
             {
                 return -1;
             }
-            r = sd_bus_message_append_basic(m, argCode[0],
-                                            (void *)stringValue->c_str());
-            if (r < 0)
-            {
-                return r;
-            }
+            return sd_bus_message_append_basic(m, node.type,
+                                               stringValue->c_str());
         }
-        else if (argCode == "i")
+        case 'i':
         {
             if (intValue == nullptr)
             {
                 return -1;
             }
             int32_t i = static_cast<int32_t>(*intValue);
-            r = sd_bus_message_append_basic(m, argCode[0], &i);
-            if (r < 0)
-            {
-                return r;
-            }
+            return sd_bus_message_append_basic(m, node.type, &i);
         }
-        else if (argCode == "b")
+        case 'b':
         {
             // lots of ways bool could be represented here.  Try them all
             int boolInt = false;
@@ -610,197 +994,234 @@ int convertJsonToDbus(sd_bus_message *m, const std::string &arg_type,
             {
                 return -1;
             }
-            r = sd_bus_message_append_basic(m, argCode[0], &boolInt);
-            if (r < 0)
-            {
-                return r;
-            }
+            return sd_bus_message_append_basic(m, node.type, &boolInt);
         }
-        else if (argCode == "n")
+        case 'n':
         {
             if (intValue == nullptr)
             {
                 return -1;
             }
             int16_t n = static_cast<int16_t>(*intValue);
-            r = sd_bus_message_append_basic(m, argCode[0], &n);
-            if (r < 0)
-            {
-                return r;
-            }
+            return sd_bus_message_append_basic(m, node.type, &n);
         }
-        else if (argCode == "x")
+        case 'x':
         {
             if (intValue == nullptr)
             {
                 return -1;
             }
-            r = sd_bus_message_append_basic(m, argCode[0], intValue);
-            if (r < 0)
-            {
-                return r;
-            }
+            return sd_bus_message_append_basic(m, node.type, intValue);
         }
-        else if (argCode == "y")
+        case 'y':
         {
             if (uintValue == nullptr)
             {
                 return -1;
             }
             uint8_t y = static_cast<uint8_t>(*uintValue);
-            r = sd_bus_message_append_basic(m, argCode[0], &y);
+            return sd_bus_message_append_basic(m, node.type, &y);
         }
-        else if (argCode == "q")
+        case 'q':
         {
             if (uintValue == nullptr)
             {
                 return -1;
             }
             uint16_t q = static_cast<uint16_t>(*uintValue);
-            r = sd_bus_message_append_basic(m, argCode[0], &q);
+            return sd_bus_message_append_basic(m, node.type, &q);
         }
-        else if (argCode == "u")
+        case 'u':
         {
             if (uintValue == nullptr)
             {
                 return -1;
             }
             uint32_t u = static_cast<uint32_t>(*uintValue);
-            r = sd_bus_message_append_basic(m, argCode[0], &u);
+            return sd_bus_message_append_basic(m, node.type, &u);
         }
-        else if (argCode == "t")
+        case 't':
         {
             if (uintValue == nullptr)
             {
                 return -1;
             }
-            r = sd_bus_message_append_basic(m, argCode[0], uintValue);
+            return sd_bus_message_append_basic(m, node.type, uintValue);
         }
-        else if (argCode == "d")
+        case 'd':
         {
-            sd_bus_message_append_basic(m, argCode[0], doubleValue);
+            if (doubleValue == nullptr)
+            {
+                return -1;
+            }
+            return sd_bus_message_append_basic(m, node.type, doubleValue);
         }
-        else if (boost::starts_with(argCode, "a"))
+        case 'a':
         {
-            std::string containedType = argCode.substr(1);
+            const uint32_t element = index + 1;
+            const bool dict = sig[element].type == '{';
+            if (dict ? !j.is_object() : !j.is_array())
+            {
+                return -1;
+            }
             r = sd_bus_message_open_container(m, SD_BUS_TYPE_ARRAY,
-                                              containedType.c_str());
+                                              node.contents.c_str());
             if (r < 0)
             {
                 return r;
             }
-
-            for (nlohmann::json::const_iterator it = j->begin(); it != j->end();
-                 ++it)
+            if (dict)
+            {
+                const uint32_t key = element + 1;
+                const uint32_t value = sig[key].end;
+                const bool stringKey = sig[key].type == 's' ||
+                                       sig[key].type == 'o' ||
+                                       sig[key].type == 'g';
+                for (const auto &item : j.items())
+                {
+                    r = sd_bus_message_open_container(
+                        m, SD_BUS_TYPE_DICT_ENTRY,
+                        sig[element].contents.c_str());
+                    if (r < 0)
+                    {
+                        return r;
+                    }
+                    // json only has string keys.  For any other key type,
+                    // parse the key text back into the value it represents
+                    nlohmann::json keyJson =
+                        stringKey
+                            ? nlohmann::json(item.key())
+                            : nlohmann::json::parse(item.key(), nullptr, false);
+                    r = writeDbusType(sig, key, m, keyJson);
+                    if (r < 0)
+                    {
+                        return r;
+                    }
+                    r = writeDbusType(sig, value, m, item.value());
+                    if (r < 0)
+                    {
+                        return r;
+                    }
+                    r = sd_bus_message_close_container(m);
+                    if (r < 0)
+                    {
+                        return r;
+                    }
+                }
+            }
+            else
             {
-                r = convertJsonToDbus(m, containedType, *it);
-                if (r < 0)
+                for (const nlohmann::json &item : j)
                 {
-                    return r;
+                    r = writeDbusType(sig, element, m, item);
+                    if (r < 0)
+                    {
+                        return r;
+                    }
                 }
             }
-            sd_bus_message_close_container(m);
+            return sd_bus_message_close_container(m);
         }
-        else if (boost::starts_with(argCode, "v"))
+        case '(':
         {
-            std::string containedType = argCode.substr(1);
-            BMCWEB_LOG_DEBUG << "variant type: " << argCode
-                             << " appending variant of type: " << containedType;
-            r = sd_bus_message_open_container(m, SD_BUS_TYPE_VARIANT,
-                                              containedType.c_str());
-            if (r < 0)
+            if (!j.is_array())
             {
-                return r;
+                return -1;
             }
-
-            r = convertJsonToDbus(m, containedType, input_json);
+            r = sd_bus_message_open_container(m, SD_BUS_TYPE_STRUCT,
+                                              node.contents.c_str());
             if (r < 0)
             {
                 return r;
             }
-
-            r = sd_bus_message_close_container(m);
+            r = writeDbusTypes(sig, index + 1, node.end, m, j);
             if (r < 0)
             {
                 return r;
             }
+            return sd_bus_message_close_container(m);
         }
-        else if (boost::starts_with(argCode, "(") &&
-                 boost::ends_with(argCode, ")"))
+        case 'v':
         {
-            std::string containedType = argCode.substr(1, argCode.size() - 1);
-            r = sd_bus_message_open_container(m, SD_BUS_TYPE_STRUCT,
-                                              containedType.c_str());
-            nlohmann::json::const_iterator it = j->begin();
-            for (const std::string &argCode : dbusArgSplit(arg_type))
+            const char *containedType = getVariantSignature(j);
+            if (containedType == nullptr)
             {
-                if (it == j->end())
-                {
-                    return -1;
-                }
-                r = convertJsonToDbus(m, argCode, *it);
-                if (r < 0)
-                {
-                    return r;
-                }
-                it++;
+                return -1;
             }
-            r = sd_bus_message_close_container(m);
-        }
-        else if (boost::starts_with(argCode, "{") &&
-                 boost::ends_with(argCode, "}"))
-        {
-            std::string containedType = argCode.substr(1, argCode.size() - 1);
-            r = sd_bus_message_open_container(m, SD_BUS_TYPE_DICT_ENTRY,
-                                              containedType.c_str());
-            std::vector<std::string> codes = dbusArgSplit(containedType);
-            if (codes.size() != 2)
+            BMCWEB_LOG_DEBUG << "appending variant of type: " << containedType;
+            std::shared_ptr<const DbusSignature> variantSig =
+                getCompiledSignature(containedType);
+            if (variantSig == nullptr)
             {
-                return -1;
+                return -2;
             }
-            const std::string &key_type = codes[0];
-            const std::string &value_type = codes[1];
-            for (auto it : j->items())
+            r = sd_bus_message_open_container(m, SD_BUS_TYPE_VARIANT,
+                                              containedType);
+            if (r < 0)
             {
-                r = convertJsonToDbus(m, key_type, it.key());
-                if (r < 0)
-                {
-                    return r;
-                }
-
-                r = convertJsonToDbus(m, value_type, it.value());
-                if (r < 0)
-                {
-                    return r;
-                }
+                return r;
             }
-            r = sd_bus_message_close_container(m);
+            r = writeDbusType(*variantSig, 0, m, j);
+            if (r < 0)
+            {
+                return r;
+            }
+            return sd_bus_message_close_container(m);
         }
-        else
+        default:
+            return -2;
+    }
+}
+
+// Writes the sibling types in [begin, end), each taking the next element of
+// the json array
+int writeDbusTypes(const DbusSignature &sig, uint32_t begin, uint32_t end,
+                   sd_bus_message *m, const nlohmann::json &j)
+{
+    nlohmann::json::const_iterator jIt = j.begin();
+    for (uint32_t index = begin; index < end; index = sig[index].end)
+    {
+        if (jIt == j.end())
         {
             return -2;
         }
+        int r = writeDbusType(sig, index, m, *jIt);
         if (r < 0)
         {
             return r;
         }
+        jIt++;
+    }
+    return 0;
+}
 
-        if (argTypes.size() > 1)
-        {
-            jIt++;
-        }
+int convertJsonToDbus(sd_bus_message *m, const std::string &arg_type,
+                      const nlohmann::json &input_json)
+{
+    BMCWEB_LOG_DEBUG << "Converting " << input_json.dump()
+                     << " to type: " << arg_type;
+    std::shared_ptr<const DbusSignature> sig = getCompiledSignature(arg_type);
+    if (sig == nullptr || sig->empty())
+    {
+        return -2;
     }
 
-    return r;
+    // A single complete type takes the whole json value.  Multiple types
+    // take one element of the json array each.
+    if (sig->front().end == sig->size())
+    {
+        return writeDbusType(*sig, 0, m, input_json);
+    }
+    return writeDbusTypes(*sig, 0, static_cast<uint32_t>(sig->size()), m,
+                          input_json);
 }
 
 template <typename T>
-int readMessageItem(const std::string &typeCode, sdbusplus::message::message &m,
-                    nlohmann::json &data)
+int readMessageItem(char typeCode, sd_bus_message *m, nlohmann::json &data)
 {
     T value;
 
-    int r = sd_bus_message_read_basic(m.get(), typeCode.front(), &value);
+    int r = sd_bus_message_read_basic(m, typeCode, &value);
     if (r < 0)
     {
         BMCWEB_LOG_ERROR << "sd_bus_message_read_basic on type " << typeCode
@@ -812,31 +1233,26 @@ int readMessageItem(const std::string &typeCode, sdbusplus::message::message &m,
     return 0;
 }
 
-int convertDBusToJSON(const std::string &returnType,
-                      sdbusplus::message::message &m, nlohmann::json &response);
+int readDbusType(const DbusSignature &sig, uint32_t index, sd_bus_message *m,
+                 nlohmann::json &data);
 
-int readDictEntryFromMessage(const std::string &typeCode,
-                             sdbusplus::message::message &m,
-                             nlohmann::json &object)
-{
-    std::vector<std::string> types = dbusArgSplit(typeCode);
-    if (types.size() != 2)
-    {
-        BMCWEB_LOG_ERROR << "wrong number contained types in dictionary: "
-                         << types.size();
-        return -1;
-    }
+int readDbusTypes(const DbusSignature &sig, uint32_t begin, uint32_t end,
+                  sd_bus_message *m, nlohmann::json &data);
 
-    int r = sd_bus_message_enter_container(m.get(), SD_BUS_TYPE_DICT_ENTRY,
-                                           typeCode.c_str());
+int readDictEntryFromMessage(const DbusSignature &sig, uint32_t index,
+                             sd_bus_message *m, nlohmann::json &object)
+{
+    int r = sd_bus_message_enter_container(m, SD_BUS_TYPE_DICT_ENTRY,
+                                           sig[index].contents.c_str());
     if (r < 0)
     {
         BMCWEB_LOG_ERROR << "sd_bus_message_enter_container with rc " << r;
         return r;
     }
 
+    const uint32_t keyIndex = index + 1;
     nlohmann::json key;
-    r = convertDBusToJSON(types[0], m, key);
+    r = readDbusType(sig, keyIndex, m, key);
     if (r < 0)
     {
         return r;
@@ -857,13 +1273,13 @@ int readDictEntryFromMessage(const std::string &typeCode,
     }
     nlohmann::json &value = object[*keyPtr];
 
-    r = convertDBusToJSON(types[1], m, value);
+    r = readDbusType(sig, sig[keyIndex].end, m, value);
     if (r < 0)
     {
         return r;
     }
 
-    r = sd_bus_message_exit_container(m.get());
+    r = sd_bus_message_exit_container(m);
     if (r < 0)
     {
         BMCWEB_LOG_ERROR << "sd_bus_message_exit_container failed";
@@ -873,20 +1289,11 @@ int readDictEntryFromMessage(const std::string &typeCode,
     return 0;
 }
 
-int readArrayFromMessage(const std::string &typeCode,
-                         sdbusplus::message::message &m, nlohmann::json &data)
+int readArrayFromMessage(const DbusSignature &sig, uint32_t index,
+                         sd_bus_message *m, nlohmann::json &data)
 {
-    if (typeCode.size() < 2)
-    {
-        BMCWEB_LOG_ERROR << "Type code " << typeCode
-                         << " too small for an array";
-        return -1;
-    }
-
-    std::string containedType = typeCode.substr(1);
-
-    int r = sd_bus_message_enter_container(m.get(), SD_BUS_TYPE_ARRAY,
-                                           containedType.c_str());
+    int r = sd_bus_message_enter_container(m, SD_BUS_TYPE_ARRAY,
+                                           sig[index].contents.c_str());
     if (r < 0)
     {
         BMCWEB_LOG_ERROR << "sd_bus_message_enter_container failed with rc "
@@ -894,13 +1301,11 @@ int readArrayFromMessage(const std::string &typeCode,
         return r;
     }
 
-    bool dict = boost::starts_with(containedType, "{") &&
-                boost::ends_with(containedType, "}");
+    const uint32_t element = index + 1;
+    bool dict = sig[element].type == '{';
 
     if (dict)
     {
-        // Remove the { }
-        containedType = containedType.substr(1, containedType.size() - 2);
         data = nlohmann::json::object();
     }
     else
@@ -910,7 +1315,7 @@ int readArrayFromMessage(const std::string &typeCode,
 
     while (true)
     {
-        r = sd_bus_message_at_end(m.get(), false);
+        r = sd_bus_message_at_end(m, false);
         if (r < 0)
         {
             BMCWEB_LOG_ERROR << "sd_bus_message_at_end failed";
@@ -925,7 +1330,7 @@ int readArrayFromMessage(const std::string &typeCode,
         // Dictionaries are only ever seen in an array
         if (dict)
         {
-            r = readDictEntryFromMessage(containedType, m, data);
+            r = readDictEntryFromMessage(sig, element, m, data);
             if (r < 0)
             {
                 return r;
@@ -935,7 +1340,7 @@ int readArrayFromMessage(const std::string &typeCode,
         {
             data.push_back(nlohmann::json());
 
-            r = convertDBusToJSON(containedType, m, data.back());
+            r = readDbusType(sig, element, m, data.back());
             if (r < 0)
             {
                 return r;
@@ -943,7 +1348,7 @@ int readArrayFromMessage(const std::string &typeCode,
         }
     }
 
-    r = sd_bus_message_exit_container(m.get());
+    r = sd_bus_message_exit_container(m);
     if (r < 0)
     {
         BMCWEB_LOG_ERROR << "sd_bus_message_exit_container failed";
@@ -953,21 +1358,11 @@ int readArrayFromMessage(const std::string &typeCode,
     return 0;
 }
 
-int readStructFromMessage(const std::string &typeCode,
-                          sdbusplus::message::message &m, nlohmann::json &data)
+int readStructFromMessage(const DbusSignature &sig, uint32_t index,
+                          sd_bus_message *m, nlohmann::json &data)
 {
-    if (typeCode.size() < 3)
-    {
-        BMCWEB_LOG_ERROR << "Type code " << typeCode
-                         << " too small for a struct";
-        return -1;
-    }
-
-    std::string containedTypes = typeCode.substr(1, typeCode.size() - 2);
-    std::vector<std::string> types = dbusArgSplit(containedTypes);
-
-    int r = sd_bus_message_enter_container(m.get(), SD_BUS_TYPE_STRUCT,
-                                           containedTypes.c_str());
+    int r = sd_bus_message_enter_container(m, SD_BUS_TYPE_STRUCT,
+                                           sig[index].contents.c_str());
     if (r < 0)
     {
         BMCWEB_LOG_ERROR << "sd_bus_message_enter_container failed with rc "
@@ -975,17 +1370,19 @@ int readStructFromMessage(const std::string &typeCode,
         return r;
     }
 
-    for (const std::string &type : types)
+    data = nlohmann::json::array();
+    for (uint32_t child = index + 1; child < sig[index].end;
+         child = sig[child].end)
     {
         data.push_back(nlohmann::json());
-        r = convertDBusToJSON(type, m, data.back());
+        r = readDbusType(sig, child, m, data.back());
         if (r < 0)
         {
             return r;
         }
     }
 
-    r = sd_bus_message_exit_container(m.get());
+    r = sd_bus_message_exit_container(m);
     if (r < 0)
     {
         BMCWEB_LOG_ERROR << "sd_bus_message_exit_container failed";
@@ -993,198 +1390,139 @@ int readStructFromMessage(const std::string &typeCode,
     }
     return 0;
 }
-
-int readVariantFromMessage(sdbusplus::message::message &m, nlohmann::json &data)
-{
-    const char *containerType;
-    int r = sd_bus_message_peek_type(m.get(), NULL, &containerType);
-    if (r < 0)
-    {
-        BMCWEB_LOG_ERROR << "sd_bus_message_peek_type failed";
-        return r;
-    }
-
-    r = sd_bus_message_enter_container(m.get(), SD_BUS_TYPE_VARIANT,
-                                       containerType);
-    if (r < 0)
-    {
-        BMCWEB_LOG_ERROR << "sd_bus_message_enter_container failed with rc "
-                         << r;
-        return r;
-    }
-
-    r = convertDBusToJSON(containerType, m, data);
-    if (r < 0)
-    {
-        return r;
-    }
-
-    r = sd_bus_message_exit_container(m.get());
-    if (r < 0)
-    {
-        BMCWEB_LOG_ERROR << "sd_bus_message_enter_container failed";
-        return r;
-    }
-
-    return 0;
-}
-
-int convertDBusToJSON(const std::string &returnType,
-                      sdbusplus::message::message &m, nlohmann::json &response)
-{
-    int r = 0;
-    const std::vector<std::string> returnTypes = dbusArgSplit(returnType);
-
-    for (const std::string &typeCode : returnTypes)
-    {
-        nlohmann::json *thisElement = &response;
-        if (returnTypes.size() > 1)
-        {
-            response.push_back(nlohmann::json{});
-            thisElement = &response.back();
-        }
-
-        if (typeCode == "s")
-        {
-            r = readMessageItem<char *>(typeCode, m, *thisElement);
-            if (r < 0)
-            {
-                return r;
-            }
-        }
-        else if (typeCode == "g")
-        {
-            r = readMessageItem<char *>(typeCode, m, *thisElement);
-            if (r < 0)
-            {
-                return r;
-            }
-        }
-        else if (typeCode == "o")
-        {
-            r = readMessageItem<char *>(typeCode, m, *thisElement);
-            if (r < 0)
-            {
-                return r;
-            }
-        }
-        else if (typeCode == "b")
-        {
-            r = readMessageItem<int>(typeCode, m, *thisElement);
-            if (r < 0)
-            {
-                return r;
-            }
-
-            *thisElement = static_cast<bool>(thisElement->get<int>());
-        }
-        else if (typeCode == "u")
-        {
-            r = readMessageItem<uint32_t>(typeCode, m, *thisElement);
-            if (r < 0)
-            {
-                return r;
-            }
-        }
-        else if (typeCode == "i")
-        {
-            r = readMessageItem<int32_t>(typeCode, m, *thisElement);
-            if (r < 0)
-            {
-                return r;
-            }
-        }
-        else if (typeCode == "x")
-        {
-            r = readMessageItem<int64_t>(typeCode, m, *thisElement);
-            if (r < 0)
-            {
-                return r;
-            }
-        }
-        else if (typeCode == "t")
-        {
-            r = readMessageItem<uint64_t>(typeCode, m, *thisElement);
-            if (r < 0)
-            {
-                return r;
-            }
-        }
-        else if (typeCode == "n")
-        {
-            r = readMessageItem<int16_t>(typeCode, m, *thisElement);
-            if (r < 0)
-            {
-                return r;
-            }
-        }
-        else if (typeCode == "q")
-        {
-            r = readMessageItem<uint16_t>(typeCode, m, *thisElement);
-            if (r < 0)
-            {
-                return r;
-            }
-        }
-        else if (typeCode == "y")
-        {
-            r = readMessageItem<uint8_t>(typeCode, m, *thisElement);
-            if (r < 0)
-            {
-                return r;
-            }
-        }
-        else if (typeCode == "d")
-        {
-            r = readMessageItem<double>(typeCode, m, *thisElement);
-            if (r < 0)
-            {
-                return r;
-            }
-        }
-        else if (typeCode == "h")
-        {
-            r = readMessageItem<int>(typeCode, m, *thisElement);
-            if (r < 0)
-            {
-                return r;
-            }
-        }
-        else if (boost::starts_with(typeCode, "a"))
-        {
-            r = readArrayFromMessage(typeCode, m, *thisElement);
-            if (r < 0)
-            {
-                return r;
-            }
-        }
-        else if (boost::starts_with(typeCode, "(") &&
-                 boost::ends_with(typeCode, ")"))
-        {
-            r = readStructFromMessage(typeCode, m, *thisElement);
-            if (r < 0)
-            {
-                return r;
-            }
-        }
-        else if (boost::starts_with(typeCode, "v"))
+
+int readVariantFromMessage(sd_bus_message *m, nlohmann::json &data)
+{
+    const char *containerType;
+    int r = sd_bus_message_peek_type(m, NULL, &containerType);
+    if (r < 0)
+    {
+        BMCWEB_LOG_ERROR << "sd_bus_message_peek_type failed";
+        return r;
+    }
+
+    // Variants carry their own signature, so this is the only place a
+    // signature is looked up while decoding.  Nearly all of them are basic
+    // types that are already in the cache.
+    std::shared_ptr<const DbusSignature> sig =
+        getCompiledSignature(containerType);
+    if (sig == nullptr)
+    {
+        return -2;
+    }
+
+    r = sd_bus_message_enter_container(m, SD_BUS_TYPE_VARIANT, containerType);
+    if (r < 0)
+    {
+        BMCWEB_LOG_ERROR << "sd_bus_message_enter_container failed with rc "
+                         << r;
+        return r;
+    }
+
+    r = readDbusTypes(*sig, 0, static_cast<uint32_t>(sig->size()), m, data);
+    if (r < 0)
+    {
+        return r;
+    }
+
+    r = sd_bus_message_exit_container(m);
+    if (r < 0)
+    {
+        BMCWEB_LOG_ERROR << "sd_bus_message_exit_container failed";
+        return r;
+    }
+
+    return 0;
+}
+
+int readDbusType(const DbusSignature &sig, uint32_t index, sd_bus_message *m,
+                 nlohmann::json &data)
+{
+    const char typeCode = sig[index].type;
+    switch (typeCode)
+    {
+        case 's':
+        case 'g':
+        case 'o':
+            return readMessageItem<char *>(typeCode, m, data);
+        case 'b':
         {
-            r = readVariantFromMessage(m, *thisElement);
+            int r = readMessageItem<int>(typeCode, m, data);
             if (r < 0)
             {
                 return r;
             }
+            data = static_cast<bool>(data.get<int>());
+            return 0;
         }
-        else
-        {
+        case 'u':
+            return readMessageItem<uint32_t>(typeCode, m, data);
+        case 'i':
+            return readMessageItem<int32_t>(typeCode, m, data);
+        case 'x':
+            return readMessageItem<int64_t>(typeCode, m, data);
+        case 't':
+            return readMessageItem<uint64_t>(typeCode, m, data);
+        case 'n':
+            return readMessageItem<int16_t>(typeCode, m, data);
+        case 'q':
+            return readMessageItem<uint16_t>(typeCode, m, data);
+        case 'y':
+            return readMessageItem<uint8_t>(typeCode, m, data);
+        case 'd':
+            return readMessageItem<double>(typeCode, m, data);
+        case 'h':
+            return readMessageItem<int>(typeCode, m, data);
+        case 'a':
+            return readArrayFromMessage(sig, index, m, data);
+        case '(':
+            return readStructFromMessage(sig, index, m, data);
+        case 'v':
+            return readVariantFromMessage(m, data);
+        default:
             BMCWEB_LOG_ERROR << "Invalid D-Bus signature type " << typeCode;
             return -2;
-        }
     }
+}
 
+// Reads the sibling types in [begin, end).  A lone type is stored directly in
+// data, while several types are stored as consecutive array elements.
+int readDbusTypes(const DbusSignature &sig, uint32_t begin, uint32_t end,
+                  sd_bus_message *m, nlohmann::json &data)
+{
+    if (begin == end)
+    {
+        return 0;
+    }
+    if (sig[begin].end == end)
+    {
+        return readDbusType(sig, begin, m, data);
+    }
+    for (uint32_t index = begin; index < end; index = sig[index].end)
+    {
+        data.push_back(nlohmann::json{});
+        int r = readDbusType(sig, index, m, data.back());
+        if (r < 0)
+        {
+            return r;
+        }
+    }
     return 0;
 }
 
+int convertDBusToJSON(const std::string &returnType,
+                      sdbusplus::message::message &m, nlohmann::json &response)
+{
+    std::shared_ptr<const DbusSignature> sig =
+        getCompiledSignature(returnType);
+    if (sig == nullptr)
+    {
+        return -2;
+    }
+    return readDbusTypes(*sig, 0, static_cast<uint32_t>(sig->size()), m.get(),
+                         response);
+}
+
 void handleMethodResponse(std::shared_ptr<InProgressActionData> transaction,
                           sdbusplus::message::message &m,
                           const std::string &returnType)
@@ -1527,34 +1865,40 @@ void handleList(crow::Response &res, const std::string &objectPath,
         depth, std::array<std::string, 0>());
 }
 
-void handleEnumerate(crow::Response &res, const std::string &objectPath)
+// Returns every object below objectPath along with its properties.  With
+// streamOutput set the objects are sent to the client as they're read rather
+// than once the whole subtree has been collected, which keeps memory flat on
+// large trees.
+void handleEnumerate(crow::Response &res, const std::string &objectPath,
+                     bool streamOutput = false)
 {
     BMCWEB_LOG_DEBUG << "Doing enumerate on " << objectPath;
     auto asyncResp = std::make_shared<bmcweb::AsyncResp>(res);
 
-    asyncResp->res.jsonValue = {{"message", "200 OK"},
-                                {"status", "ok"},
-                                {"data", nlohmann::json::object()}};
+    if (!streamOutput)
+    {
+        asyncResp->res.jsonValue = {{"message", "200 OK"},
+                                    {"status", "ok"},
+                                    {"data", nlohmann::json::object()}};
+    }
 
     crow::connections::systemBus->async_method_call(
-        [objectPath, asyncResp](const boost::system::error_code ec,
-                                GetSubTreeType &object_names) {
-            auto transaction = std::make_shared<InProgressEnumerateData>(
-                objectPath, asyncResp);
-
-            transaction->subtree =
-                std::make_shared<GetSubTreeType>(std::move(object_names));
-
+        [objectPath, asyncResp, streamOutput](
+            const boost::system::error_code ec, GetSubTreeType &object_names) {
             if (ec)
             {
-                BMCWEB_LOG_ERROR << "GetSubTree failed on "
-                                 << transaction->objectPath;
-                setErrorResponse(transaction->asyncResp->res,
+                BMCWEB_LOG_ERROR << "GetSubTree failed on " << objectPath;
+                setErrorResponse(asyncResp->res,
                                  boost::beast::http::status::not_found,
                                  notFoundDesc, notFoundMsg);
                 return;
             }
 
+            auto transaction = std::make_shared<InProgressEnumerateData>(
+                objectPath, asyncResp, streamOutput);
+            transaction->subtree =
+                std::make_shared<GetSubTreeType>(std::move(object_names));
+
             // Add the data for the path passed in to the results
             // as if GetSubTree returned it, and continue on enumerating
             getObjectAndEnumerate(transaction);
@@ -1678,32 +2022,180 @@ void handleGet(crow::Response &res, std::string &objectPath,
         std::array<std::string, 0>());
 }
 
-struct AsyncPutRequest
+// PUT of a single property.  Finds every connection hosting the object,
+// introspects them all at once for the property's type, then sets it
+// everywhere it's found.
+struct AsyncPutRequest : bmcweb::AsyncTask<AsyncPutRequest>
 {
-    AsyncPutRequest(crow::Response &res) : res(res)
+    using GetObjectType =
+        std::vector<std::pair<std::string, std::vector<std::string>>>;
+
+    AsyncPutRequest(boost::asio::io_context &io, crow::Response &res) :
+        AsyncTask(io, res)
     {
     }
     ~AsyncPutRequest()
     {
-        if (res.jsonValue.empty())
+        if (asyncResp->res.jsonValue.empty())
         {
-            setErrorResponse(res, boost::beast::http::status::forbidden,
+            setErrorResponse(asyncResp->res,
+                             boost::beast::http::status::forbidden,
                              forbiddenMsg, forbiddenPropDesc);
         }
-
-        res.end();
     }
 
     void setErrorStatus(const std::string &desc)
     {
-        setErrorResponse(res, boost::beast::http::status::internal_server_error,
+        setErrorResponse(asyncResp->res,
+                         boost::beast::http::status::internal_server_error,
                          desc, badReqMsg);
     }
 
-    crow::Response &res;
+    void step()
+    {
+        BOOST_ASIO_CORO_REENTER(this)
+        {
+            BOOST_ASIO_CORO_YIELD
+            crow::connections::systemBus->async_method_call(
+                resume(ec, objectNames), "xyz.openbmc_project.ObjectMapper",
+                "/xyz/openbmc_project/object_mapper",
+                "xyz.openbmc_project.ObjectMapper", "GetObject", objectPath,
+                std::array<std::string, 0>());
+            if (!ec && objectNames.size() <= 0)
+            {
+                setErrorResponse(asyncResp->res,
+                                 boost::beast::http::status::not_found,
+                                 propNotFoundDesc, notFoundMsg);
+                return;
+            }
+
+            introspectErrors.resize(objectNames.size());
+            introspectXml.resize(objectNames.size());
+            BOOST_ASIO_CORO_YIELD
+            {
+                Join join = whenAll();
+                for (size_t i = 0; i < objectNames.size(); i++)
+                {
+                    crow::connections::systemBus->async_method_call(
+                        join.add(introspectErrors[i], introspectXml[i]),
+                        objectNames[i].first, objectPath,
+                        "org.freedesktop.DBus.Introspectable", "Introspect");
+                }
+            }
+
+            BOOST_ASIO_CORO_YIELD
+            {
+                Join join = whenAll();
+                for (size_t i = 0; i < objectNames.size(); i++)
+                {
+                    if (introspectErrors[i])
+                    {
+                        BMCWEB_LOG_ERROR
+                            << "Introspect call failed with error: "
+                            << introspectErrors[i].message()
+                            << " on process: " << objectNames[i].first;
+                        setErrorStatus("Unexpected Error");
+                        continue;
+                    }
+                    setOnConnection(objectNames[i].first, introspectXml[i],
+                                    join);
+                }
+            }
+
+            for (const boost::system::error_code &setError : setErrors)
+            {
+                if (setError)
+                {
+                    setErrorResponse(asyncResp->res,
+                                     boost::beast::http::status::forbidden,
+                                     forbiddenPropDesc, setError.message());
+                    return;
+                }
+            }
+            if (!setErrors.empty())
+            {
+                asyncResp->res.jsonValue = {
+                    {"status", "ok"}, {"message", "200 OK"}, {"data", nullptr}};
+            }
+        }
+    }
+
+    // Sends a Set for every interface on connectionName that has the
+    // property, typed by the introspection data
+    void setOnConnection(const std::string &connectionName,
+                         const std::string &xml, Join &join)
+    {
+        tinyxml2::XMLDocument doc;
+
+        doc.Parse(xml.c_str());
+        tinyxml2::XMLNode *pRoot = doc.FirstChildElement("node");
+        if (pRoot == nullptr)
+        {
+            BMCWEB_LOG_ERROR << "XML document failed to parse: " << xml;
+            setErrorStatus("Unexpected Error");
+            return;
+        }
+        tinyxml2::XMLElement *ifaceNode = pRoot->FirstChildElement("interface");
+        while (ifaceNode != nullptr)
+        {
+            const char *interfaceName = ifaceNode->Attribute("name");
+            BMCWEB_LOG_DEBUG << "found interface " << interfaceName;
+            tinyxml2::XMLElement *propNode =
+                ifaceNode->FirstChildElement("property");
+            while (propNode != nullptr)
+            {
+                const char *propName = propNode->Attribute("name");
+                const char *argType = propNode->Attribute("type");
+                if (propName != nullptr && argType != nullptr &&
+                    propName == propertyName)
+                {
+                    sdbusplus::message::message m =
+                        crow::connections::systemBus->new_method_call(
+                            connectionName.c_str(), objectPath.c_str(),
+                            "org.freedesktop.DBus.Properties", "Set");
+                    m.append(interfaceName, propertyName);
+                    int r = sd_bus_message_open_container(
+                        m.get(), SD_BUS_TYPE_VARIANT, argType);
+                    if (r < 0)
+                    {
+                        setErrorStatus("Unexpected Error");
+                        return;
+                    }
+                    r = convertJsonToDbus(m.get(), argType, propertyValue);
+                    if (r < 0)
+                    {
+                        setErrorStatus("Invalid arg type");
+                        return;
+                    }
+                    r = sd_bus_message_close_container(m.get());
+                    if (r < 0)
+                    {
+                        setErrorStatus("Unexpected Error");
+                        return;
+                    }
+
+                    // deque, so the slots handed to join stay put
+                    setErrors.emplace_back();
+                    setReplies.emplace_back();
+                    crow::connections::systemBus->async_send(
+                        m, join.add(setErrors.back(), setReplies.back()));
+                }
+                propNode = propNode->NextSiblingElement("property");
+            }
+            ifaceNode = ifaceNode->NextSiblingElement("interface");
+        }
+    }
+
     std::string objectPath;
     std::string propertyName;
     nlohmann::json propertyValue;
+
+    boost::system::error_code ec;
+    GetObjectType objectNames;
+    std::vector<boost::system::error_code> introspectErrors;
+    std::vector<std::string> introspectXml;
+    std::deque<boost::system::error_code> setErrors;
+    std::deque<sdbusplus::message::message> setReplies;
 };
 
 void handlePut(const crow::Request &req, crow::Response &res,
@@ -1736,162 +2228,12 @@ void handlePut(const crow::Request &req, crow::Response &res,
         res.end();
         return;
     }
-    const nlohmann::json &propertySetValue = *propertyIt;
-    auto transaction = std::make_shared<AsyncPutRequest>(res);
+    auto transaction =
+        std::make_shared<AsyncPutRequest>(*req.ioService, res);
     transaction->objectPath = objectPath;
     transaction->propertyName = destProperty;
-    transaction->propertyValue = propertySetValue;
-
-    using GetObjectType =
-        std::vector<std::pair<std::string, std::vector<std::string>>>;
-
-    crow::connections::systemBus->async_method_call(
-        [transaction](const boost::system::error_code ec,
-                      const GetObjectType &object_names) {
-            if (!ec && object_names.size() <= 0)
-            {
-                setErrorResponse(transaction->res,
-                                 boost::beast::http::status::not_found,
-                                 propNotFoundDesc, notFoundMsg);
-                return;
-            }
-
-            for (const std::pair<std::string, std::vector<std::string>>
-                     connection : object_names)
-            {
-                const std::string &connectionName = connection.first;
-
-                crow::connections::systemBus->async_method_call(
-                    [connectionName{std::string(connectionName)},
-                     transaction](const boost::system::error_code ec,
-                                  const std::string &introspectXml) {
-                        if (ec)
-                        {
-                            BMCWEB_LOG_ERROR
-                                << "Introspect call failed with error: "
-                                << ec.message()
-                                << " on process: " << connectionName;
-                            transaction->setErrorStatus("Unexpected Error");
-                            return;
-                        }
-                        tinyxml2::XMLDocument doc;
-
-                        doc.Parse(introspectXml.c_str());
-                        tinyxml2::XMLNode *pRoot =
-                            doc.FirstChildElement("node");
-                        if (pRoot == nullptr)
-                        {
-                            BMCWEB_LOG_ERROR << "XML document failed to parse: "
-                                             << introspectXml;
-                            transaction->setErrorStatus("Unexpected Error");
-                            return;
-                        }
-                        tinyxml2::XMLElement *ifaceNode =
-                            pRoot->FirstChildElement("interface");
-                        while (ifaceNode != nullptr)
-                        {
-                            const char *interfaceName =
-                                ifaceNode->Attribute("name");
-                            BMCWEB_LOG_DEBUG << "found interface "
-                                             << interfaceName;
-                            tinyxml2::XMLElement *propNode =
-                                ifaceNode->FirstChildElement("property");
-                            while (propNode != nullptr)
-                            {
-                                const char *propertyName =
-                                    propNode->Attribute("name");
-                                BMCWEB_LOG_DEBUG << "Found property "
-                                                 << propertyName;
-                                if (propertyName == transaction->propertyName)
-                                {
-                                    const char *argType =
-                                        propNode->Attribute("type");
-                                    if (argType != nullptr)
-                                    {
-                                        sdbusplus::message::message m =
-                                            crow::connections::systemBus
-                                                ->new_method_call(
-                                                    connectionName.c_str(),
-                                                    transaction->objectPath
-                                                        .c_str(),
-                                                    "org.freedesktop.DBus."
-                                                    "Properties",
-                                                    "Set");
-                                        m.append(interfaceName,
-                                                 transaction->propertyName);
-                                        int r = sd_bus_message_open_container(
-                                            m.get(), SD_BUS_TYPE_VARIANT,
-                                            argType);
-                                        if (r < 0)
-                                        {
-                                            transaction->setErrorStatus(
-                                                "Unexpected Error");
-                                            return;
-                                        }
-                                        r = convertJsonToDbus(
-                                            m.get(), argType,
-                                            transaction->propertyValue);
-                                        if (r < 0)
-                                        {
-                                            transaction->setErrorStatus(
-                                                "Invalid arg type");
-                                            return;
-                                        }
-                                        r = sd_bus_message_close_container(
-                                            m.get());
-                                        if (r < 0)
-                                        {
-                                            transaction->setErrorStatus(
-                                                "Unexpected Error");
-                                            return;
-                                        }
-
-                                        crow::connections::systemBus
-                                            ->async_send(
-                                                m,
-                                                [transaction](
-                                                    boost::system::error_code
-                                                        ec,
-                                                    sdbusplus::message::message
-                                                        &m) {
-                                                    BMCWEB_LOG_DEBUG << "sent";
-                                                    if (ec)
-                                                    {
-                                                        setErrorResponse(
-                                                            transaction->res,
-                                                            boost::beast::http::
-                                                                status::
-                                                                    forbidden,
-                                                            forbiddenPropDesc,
-                                                            ec.message());
-                                                    }
-                                                    else
-                                                    {
-                                                        transaction->res
-                                                            .jsonValue = {
-                                                            {"status", "ok"},
-                                                            {"message",
-                                                             "200 OK"},
-                                                            {"data", nullptr}};
-                                                    }
-                                                });
-                                    }
-                                }
-                                propNode =
-                                    propNode->NextSiblingElement("property");
-                            }
-                            ifaceNode =
-                                ifaceNode->NextSiblingElement("interface");
-                        }
-                    },
-                    connectionName, transaction->objectPath,
-                    "org.freedesktop.DBus.Introspectable", "Introspect");
-            }
-        },
-        "xyz.openbmc_project.ObjectMapper",
-        "/xyz/openbmc_project/object_mapper",
-        "xyz.openbmc_project.ObjectMapper", "GetObject",
-        transaction->objectPath, std::array<std::string, 0>());
+    transaction->propertyValue = *propertyIt;
+    transaction->run();
 }
 
 inline void handleDBusUrl(const crow::Request &req, crow::Response &res,
@@ -1930,7 +2272,11 @@ inline void handleDBusUrl(const crow::Request &req, crow::Response &res,
         {
             objectPath.erase(objectPath.end() - sizeof("enumerate"),
                              objectPath.end());
-            handleEnumerate(res, objectPath);
+            // Browsers get the pretty printed page, which needs the whole
+            // document up front
+            handleEnumerate(res, objectPath,
+                            res.canStream() &&
+                                !http_helpers::requestPrefersHtml(req));
         }
         else if (boost::ends_with(objectPath, "/list"))
         {
@@ -1969,6 +2315,165 @@ inline void handleDBusUrl(const crow::Request &req, crow::Response &res,
     res.end();
 }
 
+// Most operations a single /batch/ request may carry
+constexpr size_t maxBatchOperations = 64;
+
+// One entry of a batch request.  It's run through handleDBusUrl exactly as if
+// it had arrived as its own HTTP request, so it owns the request it was built
+// from and the response it's answered through.
+struct BatchOperation
+{
+    boost::beast::http::request<boost::beast::http::string_body> req;
+    crow::Response res;
+};
+
+struct InProgressBatchData
+{
+    InProgressBatchData(crow::Response &res) : res(res)
+    {
+    }
+
+    crow::Response &res;
+    std::vector<std::unique_ptr<BatchOperation>> operations;
+    nlohmann::json results;
+    size_t remaining = 0;
+    // Held until the last operation completes; the operations' responses
+    // only know the batch by pointer.
+    std::shared_ptr<InProgressBatchData> self;
+};
+
+void finishBatch(InProgressBatchData &batch, boost::asio::io_context &io)
+{
+    batch.res.jsonValue = {{"status", "ok"},
+                           {"message", "200 OK"},
+                           {"data", std::move(batch.results)}};
+    batch.res.end();
+    // This runs inside the last operation's completion handler, which the
+    // batch owns, so release it once the stack has unwound.
+    boost::asio::post(io, [self{std::move(batch.self)}] {});
+}
+
+void runBatchOperation(const crow::Request &req, BatchOperation &operation,
+                       const nlohmann::json &op)
+{
+    const std::string *method = nullptr;
+    const std::string *path = nullptr;
+    if (op.is_object())
+    {
+        auto it = op.find("method");
+        if (it != op.end())
+        {
+            method = it->get_ptr<const std::string *>();
+        }
+        it = op.find("path");
+        if (it != op.end())
+        {
+            path = it->get_ptr<const std::string *>();
+        }
+    }
+    if (method == nullptr || path == nullptr)
+    {
+        setErrorResponse(operation.res, boost::beast::http::status::bad_request,
+                         badBatchOperationDesc, badReqMsg);
+        operation.res.end();
+        return;
+    }
+
+    boost::beast::http::verb verb =
+        boost::beast::http::string_to_verb(boost::to_upper_copy(*method));
+    if (verb != boost::beast::http::verb::get &&
+        verb != boost::beast::http::verb::put &&
+        verb != boost::beast::http::verb::post &&
+        verb != boost::beast::http::verb::delete_)
+    {
+        setErrorResponse(operation.res,
+                         boost::beast::http::status::method_not_allowed,
+                         methodNotAllowedDesc, methodNotAllowedMsg);
+        operation.res.end();
+        return;
+    }
+    // Only the trees the REST routes expose are reachable from a batch
+    if (!boost::starts_with(*path, "/xyz/") &&
+        !boost::starts_with(*path, "/org/"))
+    {
+        setErrorResponse(operation.res, boost::beast::http::status::not_found,
+                         notFoundDesc, notFoundMsg);
+        operation.res.end();
+        return;
+    }
+
+    operation.req.method(verb);
+    operation.req.target(*path);
+    auto data = op.find("data");
+    if (data != op.end())
+    {
+        operation.req.body() = nlohmann::json{{"data", *data}}.dump();
+    }
+
+    crow::Request operationReq(operation.req);
+    operationReq.url = operationReq.target();
+    operationReq.ioService = req.ioService;
+    operationReq.middlewareContext = req.middlewareContext;
+    std::string objectPath = *path;
+    handleDBusUrl(operationReq, operation.res, objectPath);
+}
+
+// Runs an array of {"method", "path", "data"} operations concurrently, each
+// the same as the equivalent single request against path, and returns their
+// results in order as {"code": <HTTP status>, "response": <body>}.
+void handleBatch(const crow::Request &req, crow::Response &res)
+{
+    nlohmann::json requestJson =
+        nlohmann::json::parse(req.body, nullptr, false);
+    if (requestJson.is_discarded() || !requestJson.is_array())
+    {
+        setErrorResponse(res, boost::beast::http::status::bad_request,
+                         badBatchDesc, badReqMsg);
+        res.end();
+        return;
+    }
+    if (requestJson.size() > maxBatchOperations)
+    {
+        setErrorResponse(res, boost::beast::http::status::bad_request,
+                         batchTooLargeDesc, badReqMsg);
+        res.end();
+        return;
+    }
+    if (requestJson.empty() || req.ioService == nullptr)
+    {
+        res.jsonValue = {{"status", "ok"},
+                         {"message", "200 OK"},
+                         {"data", nlohmann::json::array()}};
+        res.end();
+        return;
+    }
+
+    auto batch = std::make_shared<InProgressBatchData>(res);
+    batch->self = batch;
+    batch->results = nlohmann::json::array_t(requestJson.size());
+    batch->remaining = requestJson.size();
+    batch->operations.reserve(requestJson.size());
+
+    boost::asio::io_context &io = *req.ioService;
+    for (size_t index = 0; index < requestJson.size(); index++)
+    {
+        batch->operations.emplace_back(std::make_unique<BatchOperation>());
+        BatchOperation &operation = *batch->operations.back();
+        operation.res.setIsAliveHelper([&res] { return res.isAlive(); });
+        operation.res.setCompleteRequestHandler(
+            [batchData{batch.get()}, &operation, index, &io] {
+                batchData->results[index] = {
+                    {"code", operation.res.resultInt()},
+                    {"response", std::move(operation.res.jsonValue)}};
+                if (--batchData->remaining == 0)
+                {
+                    finishBatch(*batchData, io);
+                }
+            });
+        runBatchOperation(req, operation, requestJson[index]);
+    }
+}
+
 template <typename... Middlewares> void requestRoutes(Crow<Middlewares...> &app)
 {
     BMCWEB_ROUTE(app, "/bus/")
@@ -2013,6 +2518,12 @@ template <typename... Middlewares> void requestRoutes(Crow<Middlewares...> &app)
                 handleList(res, "/");
             });
 
+    BMCWEB_ROUTE(app, "/batch/")
+        .methods("POST"_method)(
+            [](const crow::Request &req, crow::Response &res) {
+                handleBatch(req, res);
+            });
+
     BMCWEB_ROUTE(app, "/xyz/<path>")
         .methods("GET"_method, "PUT"_method, "POST"_method, "DELETE"_method)(
             [](const crow::Request &req, crow::Response &res,
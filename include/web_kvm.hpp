@@ -1,8 +1,14 @@
 #include <crow/app.h>
 
+#include <algorithm>
+#include <array>
 #include <ast_jpeg_decoder.hpp>
 #include <ast_video_puller.hpp>
+#include <boost/container/flat_map.hpp>
 #include <boost/endian/arithmetic.hpp>
+#include <chrono>
+#include <kvm_encodings.hpp>
+#include <memory>
 #include <string>
 
 namespace crow
@@ -199,55 +205,647 @@ class ConnectionMetadata
     VncState vncState{VncState::UNSTARTED};
 };
 
-using meta_list = std::vector<ConnectionMetadata>;
-meta_list connectionStates(10);
+// Protocol state of each viewer.  Every viewer is fed from the one capture.
+static boost::container::flat_map<crow::websocket::Connection*,
+                                  ConnectionMetadata>
+    sessions;
+
+// Each viewer costs an encoder and a send queue on the BMC
+constexpr size_t maxViewers = 4;
+
+// How long to wait before capturing again when nothing a viewer is waiting
+// for has changed
+constexpr std::chrono::milliseconds idlePollInterval(20);
+
+// Viewers whose last update took longer than slowUpdateTime to be delivered
+// and answered get lower quality updates, and those under fastUpdateTime get
+// higher quality again
+constexpr std::chrono::milliseconds slowUpdateTime(200);
+constexpr std::chrono::milliseconds fastUpdateTime(50);
+
+// Updates are held while this much is still queued for a viewer, and a
+// viewer that doesn't get below it within maxStallTime is disconnected
+constexpr size_t maxSendBacklog = 1024 * 1024;
+constexpr std::chrono::seconds maxStallTime(30);
+
+// Channel masks for each quality level, best first
+constexpr std::array<uint8_t, 4> qualityMasks{0xFF, 0xF8, 0xF0, 0xE0};
+
+#ifndef BMCWEB_KVM_SNAPSHOT_CACHE_SECONDS
+#define BMCWEB_KVM_SNAPSHOT_CACHE_SECONDS 5
+#endif
+
+// Snapshots are served from the last captured frame for this long, so any
+// number of clients polling for screenshots cost one capture between them
+constexpr std::chrono::seconds
+    snapshotCacheTime(BMCWEB_KVM_SNAPSHOT_CACHE_SECONDS);
+
+// The most a snapshot can be scaled down by
+constexpr size_t maxSnapshotScale = 16;
+
+// Capture and decode pipeline for the video device.  It's created with the
+// first KVM session and kept for the life of the process, so /dev/video stays
+// open and the decoder's tables and frame buffers stay warm across frames and
+// sessions.  Nothing in it blocks the io_context.
+//
+// Viewers are sent only the tiles that changed since their last update,
+// merged into rectangles, in the best encoding and pixel format they asked
+// for.  As RFB allows, an incremental update request is held until something
+// on screen changes, so an idle desktop produces no traffic.  Each viewer is
+// paced by its own requests; one that falls behind skips frames, getting the
+// tiles changed by all of them in its next update.  Whatever is encoded for a
+// frame is shared by every viewer that needs the same thing, so viewers that
+// keep up with the screen usually cost one encode between them.
+//
+// On a slow link the quality drops by sending fewer bits per channel, which
+// ZRLE compresses much better, and the tiles sent that way are sent again at
+// full quality once the link catches up.
+class KvmCapture
+{
+  public:
+    KvmCapture(boost::asio::io_context& io) : puller(io), idleTimer(io)
+    {
+        puller.registerCallback([this](const boost::system::error_code& ec,
+                                       ast_video::RawVideoBuffer& raw) {
+            frameReady(ec, raw);
+        });
+    }
+
+    bool isOpen() const
+    {
+        return puller.isOpen();
+    }
+
+    // Sends conn a framebuffer update once the screen has changed, or with
+    // the whole screen if the request isn't incremental
+    void requestUpdate(crow::websocket::Connection& conn, bool incremental)
+    {
+        Viewer& viewer = getViewer(conn);
+        if (viewer.updateInFlight)
+        {
+            // The client asks again once it has the previous update, so
+            // this is how long that update spent in the send queues
+            viewer.updateInFlight = false;
+            adjustQuality(viewer, std::chrono::steady_clock::now() -
+                                      viewer.sentTime);
+        }
+        viewer.waiting = true;
+        if (!incremental)
+        {
+            viewer.fullFrame = true;
+        }
+        puller.requestFrame();
+    }
 
-ConnectionMetadata meta;
+    // Uses the first encoding in the client's list of preferences that this
+    // server supports
+    void setEncodings(crow::websocket::Connection& conn,
+                      const std::vector<int32_t>& encodings)
+    {
+        Viewer& viewer = getViewer(conn);
+        viewer.encoding = encoding_type::raw;
+        for (int32_t encoding : encodings)
+        {
+            auto type = static_cast<encoding_type>(encoding);
+            if (type == encoding_type::raw || type == encoding_type::zrle)
+            {
+                viewer.encoding = type;
+                break;
+            }
+        }
+        if (viewer.encoding == encoding_type::zrle && viewer.zrle == nullptr)
+        {
+            viewer.zrle = std::make_unique<ZrleStream>();
+        }
+    }
+
+    void setPixelFormat(crow::websocket::Connection& conn,
+                        const PixelFormatStruct& format)
+    {
+        if (format.isTrueColor == 0)
+        {
+            BMCWEB_LOG_ERROR << "KVM client asked for a color map";
+            return;
+        }
+        Viewer& viewer = getViewer(conn);
+        if (!viewer.pixelFormat.set(
+                format.bitsPerPixel, format.depth, format.isBigEndian != 0,
+                format.redMax, format.greenMax, format.blueMax,
+                format.redShift, format.greenShift, format.blueShift))
+        {
+            BMCWEB_LOG_ERROR << "Unsupported KVM pixel format, "
+                             << static_cast<int>(format.bitsPerPixel)
+                             << " bits per pixel";
+        }
+    }
+
+    // Calls back with a PNG of the screen, shrunk by scale, or nullptr if
+    // capturing failed.  A PNG made within snapshotCacheTime is served again,
+    // and otherwise the screen is captured again only when the last capture
+    // is older than that.
+    void requestSnapshot(
+        size_t scale,
+        std::function<void(std::shared_ptr<const std::string>)>&& callback)
+    {
+        auto now = std::chrono::steady_clock::now();
+        for (const Snapshot& snapshot : snapshots)
+        {
+            if (snapshot.scale == scale &&
+                now - snapshot.time < snapshotCacheTime)
+            {
+                callback(snapshot.png);
+                return;
+            }
+        }
+        if (frameCount != 0 && now - frameTime < snapshotCacheTime)
+        {
+            callback(getSnapshot(scale));
+            return;
+        }
+        snapshotRequests.push_back({scale, std::move(callback)});
+        puller.requestFrame();
+    }
+
+    void removeSession(crow::websocket::Connection& conn)
+    {
+        viewers.erase(std::remove_if(viewers.begin(), viewers.end(),
+                                     [&conn](const auto& v) {
+                                         return v->conn == &conn;
+                                     }),
+                      viewers.end());
+    }
+
+  private:
+    struct Viewer
+    {
+        crow::websocket::Connection* conn = nullptr;
+        // Tiles that changed since the last update sent to this viewer
+        std::vector<uint8_t> pendingTiles;
+        // Tiles last sent at reduced quality
+        std::vector<uint8_t> lossyTiles;
+        bool waiting = false;
+        bool fullFrame = true;
+        encoding_type encoding = encoding_type::raw;
+        ClientPixelFormat pixelFormat;
+        std::unique_ptr<ZrleStream> zrle;
+        size_t quality = 0;
+        bool updateInFlight = false;
+        std::chrono::steady_clock::time_point sentTime;
+        bool stalled = false;
+        std::chrono::steady_clock::time_point stalledSince;
+    };
+
+    struct Snapshot
+    {
+        size_t scale;
+        // The frame it was made from, and when
+        size_t frame;
+        std::chrono::steady_clock::time_point time;
+        std::shared_ptr<const std::string> png;
+    };
+
+    struct SnapshotRequest
+    {
+        size_t scale;
+        std::function<void(std::shared_ptr<const std::string>)> callback;
+    };
+
+    // Something encoded from the current frame: a whole raw update, or the
+    // ZRLE tile data of one rectangle
+    struct SharedEncoding
+    {
+        std::vector<TileRect> rects;
+        encoding_type encoding;
+        const ClientPixelFormat* format;
+        uint8_t mask;
+        std::shared_ptr<const std::string> data;
+    };
+
+    Viewer& getViewer(crow::websocket::Connection& conn)
+    {
+        for (std::unique_ptr<Viewer>& viewer : viewers)
+        {
+            if (viewer->conn == &conn)
+            {
+                return *viewer;
+            }
+        }
+        viewers.emplace_back(std::make_unique<Viewer>());
+        viewers.back()->conn = &conn;
+        return *viewers.back();
+    }
+
+    // A snapshot of the last frame decoded, made from it unless one at the
+    // same scale already was.  One snapshot is kept per scale.
+    std::shared_ptr<const std::string> getSnapshot(size_t scale)
+    {
+        auto snapshot = std::find_if(
+            snapshots.begin(), snapshots.end(),
+            [scale](const Snapshot& s) { return s.scale == scale; });
+        if (snapshot == snapshots.end())
+        {
+            snapshot = snapshots.insert(snapshots.end(), Snapshot{scale});
+        }
+        else if (snapshot->frame == frameCount)
+        {
+            return snapshot->png;
+        }
+        const size_t stride = decoder.getTileColumns() * decoder.tileSize();
+        snapshot->frame = frameCount;
+        snapshot->time = std::chrono::steady_clock::now();
+        snapshot->png = std::make_shared<const std::string>(encodePng(
+            decoder.outBuffer.data(), stride, frameWidth, frameHeight, scale));
+        return snapshot->png;
+    }
+
+    static void adjustQuality(Viewer& viewer,
+                              std::chrono::steady_clock::duration elapsed)
+    {
+        if (elapsed > slowUpdateTime &&
+            viewer.quality + 1 < qualityMasks.size())
+        {
+            viewer.quality++;
+        }
+        else if (elapsed < fastUpdateTime && viewer.quality > 0)
+        {
+            viewer.quality--;
+        }
+    }
+
+    void frameReady(const boost::system::error_code& ec,
+                    ast_video::RawVideoBuffer& raw)
+    {
+        std::vector<SnapshotRequest> requests;
+        requests.swap(snapshotRequests);
+        if (ec)
+        {
+            for (std::unique_ptr<Viewer>& viewer : viewers)
+            {
+                if (viewer->waiting)
+                {
+                    viewer->waiting = false;
+                    viewer->conn->close("Video capture failed");
+                }
+            }
+            for (SnapshotRequest& request : requests)
+            {
+                request.callback(nullptr);
+            }
+            return;
+        }
+
+        decoder.decode(raw.buffer, raw.width, raw.height, raw.mode,
+                       raw.ySelector, raw.uvSelector);
+        frameCount++;
+        frameTime = std::chrono::steady_clock::now();
+        frameWidth = raw.width;
+        frameHeight = raw.height;
+        for (SnapshotRequest& request : requests)
+        {
+            request.callback(getSnapshot(request.scale));
+        }
+        const size_t columns = decoder.getTileColumns();
+        const size_t rows = decoder.getTileRows();
+
+        bool idle = false;
+        for (std::unique_ptr<Viewer>& viewerPtr : viewers)
+        {
+            Viewer& viewer = *viewerPtr;
+            if (viewer.pendingTiles.size() != columns * rows)
+            {
+                viewer.pendingTiles.assign(columns * rows, 0);
+                viewer.lossyTiles.assign(columns * rows, 0);
+                viewer.fullFrame = true;
+            }
+            for (size_t y = 0; y < rows; y++)
+            {
+                for (size_t x = 0; x < columns; x++)
+                {
+                    if (decoder.isTileDirty(x, y))
+                    {
+                        viewer.pendingTiles[y * columns + x] = 1;
+                    }
+                }
+            }
+            if (!viewer.waiting)
+            {
+                continue;
+            }
+            if (viewer.conn->sendQueueSize() > maxSendBacklog)
+            {
+                auto now = std::chrono::steady_clock::now();
+                if (!viewer.stalled)
+                {
+                    viewer.stalled = true;
+                    viewer.stalledSince = now;
+                }
+                else if (now - viewer.stalledSince > maxStallTime)
+                {
+                    viewer.waiting = false;
+                    viewer.conn->close("KVM viewer too slow");
+                    continue;
+                }
+                idle = true;
+                continue;
+            }
+            viewer.stalled = false;
+
+            if (viewer.quality == 0)
+            {
+                // Bring tiles sent at reduced quality up to full quality
+                for (size_t i = 0; i < viewer.lossyTiles.size(); i++)
+                {
+                    viewer.pendingTiles[i] |= viewer.lossyTiles[i];
+                }
+                std::fill(viewer.lossyTiles.begin(), viewer.lossyTiles.end(),
+                          0);
+            }
+            else
+            {
+                for (size_t i = 0; i < viewer.pendingTiles.size(); i++)
+                {
+                    viewer.lossyTiles[i] |= viewer.pendingTiles[i];
+                }
+                if (viewer.fullFrame)
+                {
+                    std::fill(viewer.lossyTiles.begin(),
+                              viewer.lossyTiles.end(), 1);
+                }
+            }
+
+            std::vector<TileRect> rects;
+            if (viewer.fullFrame)
+            {
+                rects.push_back({0, 0, columns, rows});
+            }
+            else
+            {
+                rects = mergeTiles(viewer.pendingTiles, columns, rows);
+            }
+            if (rects.empty())
+            {
+                idle = true;
+                continue;
+            }
+            viewer.conn->sendBinary(encodeUpdate(viewer, rects, raw));
+            viewer.waiting = false;
+            viewer.fullFrame = false;
+            viewer.updateInFlight = true;
+            viewer.sentTime = std::chrono::steady_clock::now();
+            std::fill(viewer.pendingTiles.begin(), viewer.pendingTiles.end(),
+                      0);
+        }
+        frameEncodings.clear();
+
+        if (idle)
+        {
+            idleTimer.expires_after(idlePollInterval);
+            idleTimer.async_wait([this](const boost::system::error_code& ec) {
+                if (!ec)
+                {
+                    puller.requestFrame();
+                }
+            });
+        }
+    }
+
+    std::shared_ptr<const std::string>
+        findEncoding(const std::vector<TileRect>& rects,
+                     encoding_type encoding, const ClientPixelFormat& format,
+                     uint8_t mask) const
+    {
+        for (const SharedEncoding& shared : frameEncodings)
+        {
+            if (shared.encoding == encoding && shared.mask == mask &&
+                shared.rects == rects &&
+                (shared.format == &format || *shared.format == format))
+            {
+                return shared.data;
+            }
+        }
+        return nullptr;
+    }
+
+    std::shared_ptr<const std::string>
+        encodeUpdate(Viewer& viewer, const std::vector<TileRect>& rects,
+                     const ast_video::RawVideoBuffer& raw)
+    {
+        // Each ZRLE viewer has its own zlib stream, so only the tile data
+        // inside its update can be shared
+        if (viewer.encoding == encoding_type::zrle)
+        {
+            return std::make_shared<const std::string>(
+                serializeUpdate(viewer, rects, raw));
+        }
+        const uint8_t mask = qualityMasks[viewer.quality];
+        std::shared_ptr<const std::string> update =
+            findEncoding(rects, viewer.encoding, viewer.pixelFormat, mask);
+        if (update == nullptr)
+        {
+            update = std::make_shared<const std::string>(
+                serializeUpdate(viewer, rects, raw));
+            frameEncodings.push_back(
+                {rects, viewer.encoding, &viewer.pixelFormat, mask, update});
+        }
+        return update;
+    }
+
+    // Builds a framebuffer update with a rectangle per tile rectangle,
+    // straight from the decoder's output and clipped to the frame
+    std::string serializeUpdate(Viewer& viewer,
+                                const std::vector<TileRect>& rects,
+                                const ast_video::RawVideoBuffer& raw)
+    {
+        const size_t tileSize = decoder.tileSize();
+        const size_t stride = decoder.getTileColumns() * tileSize;
+        const size_t rectHeaderSize =
+            sizeof(FramebufferRectangle) - sizeof(std::vector<uint8_t>);
+        const ClientPixelFormat& format = viewer.pixelFormat;
+        const uint8_t mask = qualityMasks[viewer.quality];
+
+        std::string serialized(4, 0);
+        serialized[0] = static_cast<char>(
+            server_to_client_message_type::framebuffer_update); // Type
+        serialized[1] = 0;                                      // Pad byte
+        boost::endian::big_uint16_t numberOfRectangles = rects.size();
+        std::memcpy(&serialized[2], &numberOfRectangles,
+                    sizeof(numberOfRectangles));
+
+        for (const TileRect& rect : rects)
+        {
+            FramebufferRectangle header;
+            size_t x = rect.x * tileSize;
+            size_t y = rect.y * tileSize;
+            size_t width =
+                std::min<size_t>(rect.width * tileSize, raw.width - x);
+            size_t height =
+                std::min<size_t>(rect.height * tileSize, raw.height - y);
+            header.x = x;
+            header.y = y;
+            header.width = width;
+            header.height = height;
+            header.encoding = static_cast<uint32_t>(viewer.encoding);
+            serialized.append(reinterpret_cast<const char*>(&header),
+                              rectHeaderSize);
+
+            const ast_video::RGB* origin = &decoder.outBuffer[y * stride + x];
+            if (viewer.encoding == encoding_type::zrle)
+            {
+                std::vector<TileRect> key{rect};
+                std::shared_ptr<const std::string> tiles =
+                    findEncoding(key, encoding_type::zrle, format, mask);
+                if (tiles == nullptr)
+                {
+                    std::string encoded;
+                    tileEncoder.encode(origin, stride, width, height, format,
+                                       mask, encoded);
+                    tiles = std::make_shared<const std::string>(
+                        std::move(encoded));
+                    frameEncodings.push_back({std::move(key),
+                                              encoding_type::zrle, &format,
+                                              mask, tiles});
+                }
+                viewer.zrle->compress(*tiles, serialized);
+                continue;
+            }
+
+            encodeRaw(origin, stride, width, height, format, mask,
+                      serialized);
+        }
+        return serialized;
+    }
+
+    ast_video::AsyncVideoPuller puller;
+    ast_video::AstJpegDecoder decoder;
+    boost::asio::steady_timer idleTimer;
+    std::vector<std::unique_ptr<Viewer>> viewers;
+    ZrleTileEncoder tileEncoder;
+    std::vector<SharedEncoding> frameEncodings;
+    // Frames decoded so far, and when and at what size the last one was
+    size_t frameCount = 0;
+    std::chrono::steady_clock::time_point frameTime;
+    size_t frameWidth = 0;
+    size_t frameHeight = 0;
+    std::vector<Snapshot> snapshots;
+    std::vector<SnapshotRequest> snapshotRequests;
+};
+
+static std::unique_ptr<KvmCapture> capture;
 
 template <typename... Middlewares> void requestRoutes(Crow<Middlewares...>& app)
 {
+    // The screen as a PNG, for thumbnails and dashboards that don't want a
+    // whole RFB session.  ?scale=n shrinks it n times in each direction.
+    BMCWEB_ROUTE(app, "/kvm/snapshot")
+        .methods("GET"_method)(
+            [](const crow::Request& req, crow::Response& res) {
+                size_t scale = 1;
+                const char* scaleParam = req.urlParams.get("scale");
+                if (scaleParam != nullptr)
+                {
+                    char* end = nullptr;
+                    unsigned long value = std::strtoul(scaleParam, &end, 10);
+                    if (*end != '\0' || value < 1 || value > maxSnapshotScale)
+                    {
+                        res.result(boost::beast::http::status::bad_request);
+                        res.end();
+                        return;
+                    }
+                    scale = value;
+                }
+                if (capture == nullptr || !capture->isOpen())
+                {
+                    capture = std::make_unique<KvmCapture>(*req.ioService);
+                    if (!capture->isOpen())
+                    {
+                        res.result(
+                            boost::beast::http::status::service_unavailable);
+                        res.end();
+                        return;
+                    }
+                }
+                capture->requestSnapshot(
+                    scale, [&res](std::shared_ptr<const std::string> png) {
+                        if (png == nullptr)
+                        {
+                            res.result(boost::beast::http::status::
+                                           internal_server_error);
+                            res.end();
+                            return;
+                        }
+                        if (png->empty())
+                        {
+                            // Nothing on screen, such as with no video signal
+                            res.result(boost::beast::http::status::
+                                           service_unavailable);
+                            res.end();
+                            return;
+                        }
+                        res.addHeader("Content-Type", "image/png");
+                        res.addHeader("Cache-Control", "no-store");
+                        res.body() = *png;
+                        res.end();
+                    });
+            });
+
+    // Not compressed by the websocket, as ZRLE viewers already get zlib
+    // compressed tiles and deflating them again would only cost CPU
     BMCWEB_ROUTE(app, "/kvmws")
         .websocket()
         .onopen([&](crow::websocket::Connection& conn) {
-            if (meta.vncState == VncState::UNSTARTED)
+            if (sessions.size() >= maxViewers)
             {
-                meta.vncState = VncState::AWAITING_CLIENT_VERSION;
-                conn.sendBinary(rfb38VersionString);
+                conn.close("Too many KVM viewers");
+                return;
             }
-            else
-            { // SHould never happen
-                conn.close();
+            if (capture == nullptr || !capture->isOpen())
+            {
+                capture = std::make_unique<KvmCapture>(conn.get_io_context());
             }
+            // RFB is a byte stream, so queued updates can be written together
+            conn.setCoalescing(true);
+            sessions[&conn].vncState = VncState::AWAITING_CLIENT_VERSION;
+            conn.sendBinary(rfb38VersionString);
         })
         .onclose(
             [&](crow::websocket::Connection& conn, const std::string& reason) {
-                meta.vncState = VncState::UNSTARTED;
+                sessions.erase(&conn);
+                if (capture != nullptr)
+                {
+                    capture->removeSession(conn);
+                }
             })
         .onmessage([&](crow::websocket::Connection& conn,
                        const std::string& data, bool is_binary) {
-            switch (meta.vncState)
+            auto session = sessions.find(&conn);
+            if (session == sessions.end())
+            {
+                return;
+            }
+            VncState& vncState = session->second.vncState;
+            switch (vncState)
             {
                 case VncState::AWAITING_CLIENT_VERSION:
                 {
-                    std::cout << "Client sent: " << data;
+                    BMCWEB_LOG_DEBUG << "KVM client sent version " << data;
                     if (data == rfb38VersionString ||
                         data == rfb37VersionString)
                     {
                         std::string authTypes{
                             1, (uint8_t)RfbAuthScheme::no_authentication};
                         conn.sendBinary(authTypes);
-                        meta.vncState = VncState::AWAITING_CLIENT_AUTH_METHOD;
+                        vncState = VncState::AWAITING_CLIENT_AUTH_METHOD;
                     }
                     else if (data == rfb33VersionString)
                     {
                         // TODO(ed)  Support older protocols
-                        meta.vncState = VncState::UNSTARTED;
+                        vncState = VncState::UNSTARTED;
                         conn.close();
                     }
                     else
                     {
                         // TODO(ed)  Support older protocols
-                        meta.vncState = VncState::UNSTARTED;
+                        vncState = VncState::UNSTARTED;
                         conn.close();
                     }
                 }
@@ -257,13 +855,13 @@ template <typename... Middlewares> void requestRoutes(Crow<Middlewares...>& app)
                     std::string securityResult{{0, 0, 0, 0}};
                     if (data[0] == (uint8_t)RfbAuthScheme::no_authentication)
                     {
-                        meta.vncState = VncState::AWAITING_CLIENT_INIT_msg;
+                        vncState = VncState::AWAITING_CLIENT_INIT_msg;
                     }
                     else
                     {
                         // Mark auth as failed
                         securityResult[3] = 1;
-                        meta.vncState = VncState::UNSTARTED;
+                        vncState = VncState::UNSTARTED;
                     }
                     conn.sendBinary(securityResult);
                 }
@@ -275,6 +873,7 @@ template <typename... Middlewares> void requestRoutes(Crow<Middlewares...>& app)
                     serverInitMsg.framebufferWidth = 800;
                     serverInitMsg.framebufferHeight = 600;
                     serverInitMsg.pixelFormat.bitsPerPixel = 32;
+                    serverInitMsg.pixelFormat.depth = 24;
                     serverInitMsg.pixelFormat.isBigEndian = 0;
                     serverInitMsg.pixelFormat.isTrueColor = 1;
                     serverInitMsg.pixelFormat.redMax = 255;
@@ -284,15 +883,13 @@ template <typename... Middlewares> void requestRoutes(Crow<Middlewares...>& app)
                     serverInitMsg.pixelFormat.greenShift = 8;
                     serverInitMsg.pixelFormat.blueShift = 0;
                     serverInitMsg.nameLength = 0;
-                    std::cout << "size: " << sizeof(serverInitMsg);
                     // TODO(ed) this is ugly.  Crow should really have a span
                     // type interface to avoid the copy, but alas, today it does
                     // not.
                     std::string s(reinterpret_cast<char*>(&serverInitMsg),
                                   sizeof(serverInitMsg));
-                    std::cout << "s.size() " << s.size();
                     conn.sendBinary(s);
-                    meta.vncState = VncState::MAIN_LOOP;
+                    vncState = VncState::MAIN_LOOP;
                 }
                 break;
                 case VncState::MAIN_LOOP:
@@ -301,12 +898,23 @@ template <typename... Middlewares> void requestRoutes(Crow<Middlewares...>& app)
                     {
                         auto type =
                             static_cast<client_to_server_msg_type>(data[0]);
-                        std::cout << "Received client message type "
-                                  << static_cast<std::size_t>(type) << "\n";
+                        BMCWEB_LOG_DEBUG << "Received KVM client message type "
+                                         << static_cast<std::size_t>(type);
                         switch (type)
                         {
                             case client_to_server_msg_type::set_pixel_format:
                             {
+                                if (data.size() >=
+                                    sizeof(SetPixelFormatMsg) +
+                                        sizeof(client_to_server_msg_type))
+                                {
+                                    auto msg = reinterpret_cast<
+                                        const SetPixelFormatMsg*>(
+                                        data.data() + // NOLINT
+                                        sizeof(client_to_server_msg_type));
+                                    capture->setPixelFormat(conn,
+                                                            msg->pixelFormat);
+                                }
                             }
                             break;
 
@@ -317,6 +925,28 @@ template <typename... Middlewares> void requestRoutes(Crow<Middlewares...>& app)
                             break;
                             case client_to_server_msg_type::set_encodings:
                             {
+                                // Type, padding and a count, then the
+                                // encodings in order of preference
+                                constexpr size_t headerSize = 4;
+                                if (data.size() < headerSize)
+                                {
+                                    break;
+                                }
+                                boost::endian::big_uint16_t count;
+                                std::memcpy(&count, &data[2], sizeof(count));
+                                std::vector<int32_t> encodings;
+                                for (size_t i = 0; i < count &&
+                                                   headerSize + i * 4 + 4 <=
+                                                       data.size();
+                                     i++)
+                                {
+                                    boost::endian::big_int32_t encoding;
+                                    std::memcpy(&encoding,
+                                                &data[headerSize + i * 4],
+                                                sizeof(encoding));
+                                    encodings.push_back(encoding);
+                                }
+                                capture->setEncodings(conn, encodings);
                             }
                             break;
                             case client_to_server_msg_type::
@@ -332,60 +962,11 @@ template <typename... Middlewares> void requestRoutes(Crow<Middlewares...>& app)
                                         const FrameBufferUpdateReq*>(
                                         data.data() + // NOLINT
                                         sizeof(client_to_server_msg_type));
-                                    // TODO(ed) find a better way to do this
-                                    // deserialization
-
-                                    // Todo(ed) lifecycle of the video puller
-                                    // and decoder should be with the websocket,
-                                    // not recreated every time
-                                    ast_video::SimpleVideoPuller p;
-                                    p.initialize();
-                                    auto out = p.readVideo();
-                                    ast_video::AstJpegDecoder d;
-                                    d.decode(out.buffer, out.width, out.height,
-                                             out.mode, out.ySelector,
-                                             out.uvSelector);
-
-                                    FramebufferUpdateMsg bufferUpdateMsg;
-
-                                    // If the viewer is requesting a full
-                                    // update, force write of all pixels
-
-                                    FramebufferRectangle thisRect;
-                                    thisRect.x = msg->xPosition;
-                                    thisRect.y = msg->yPosition;
-                                    thisRect.width = out.width;
-                                    thisRect.height = out.height;
-                                    thisRect.encoding = static_cast<uint8_t>(
-                                        encoding_type::raw);
-                                    std::cout << "Encoding is "
-                                              << thisRect.encoding;
-                                    thisRect.data.reserve(
-                                        static_cast<std::size_t>(
-                                            thisRect.width) *
-                                        static_cast<std::size_t>(
-                                            thisRect.height) *
-                                        4);
-                                    std::cout << "Width " << out.width
-                                              << " Height " << out.height;
-
-                                    for (int i = 0; i < out.width * out.height;
-                                         i++)
-                                    {
-                                        auto& pixel = d.outBuffer[i];
-                                        thisRect.data.push_back(pixel.b);
-                                        thisRect.data.push_back(pixel.g);
-                                        thisRect.data.push_back(pixel.r);
-                                        thisRect.data.push_back(0);
-                                    }
-
-                                    bufferUpdateMsg.rectangles.push_back(
-                                        std::move(thisRect));
-                                    auto serialized =
-                                        serialize(bufferUpdateMsg);
-
-                                    conn.sendBinary(serialized);
-
+                                    // Updates cover whatever changed on the
+                                    // whole screen, not just the region asked
+                                    // for
+                                    capture->requestUpdate(
+                                        conn, msg->incremental != 0);
                                 } // TODO(Ed) handle error
                             }
 
@@ -205,6 +205,18 @@ void propertyValueFormatError(crow::Response& res, const std::string& arg1,
 void propertyValueNotInList(crow::Response& res, const std::string& arg1,
                             const std::string& arg2);
 
+/**
+ * @brief Formats PropertyValueOutOfRange message into JSON
+ * Message body: "The value <arg1> for the property <arg2> is not in the
+ * supported range of acceptable values."
+ *
+ * @param[in] arg1 Parameter of message that will replace %1 in its body.
+ * @param[in] arg2 Parameter of message that will replace %2 in its body.
+ *
+ * @returns Message PropertyValueOutOfRange formatted to JSON */
+void propertyValueOutOfRange(crow::Response& res, const std::string& arg1,
+                             const std::string& arg2);
+
 /**
  * @brief Formats ResourceAtUriInUnknownFormat message into JSON
  * Message body: "The resource at <arg1> is in a format not recognized by the
@@ -0,0 +1,717 @@
+/*
+// Copyright (c) 2018 Intel Corporation
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+*/
+#pragma once
+
+#include <crow/logging.h>
+
+#include <algorithm>
+#include <boost/asio/ip/address.hpp>
+#include <boost/asio/io_context.hpp>
+#include <boost/asio/ip/tcp.hpp>
+#include <boost/asio/steady_timer.hpp>
+#include <boost/beast/core/flat_buffer.hpp>
+#include <boost/beast/http.hpp>
+#include <boost/container/flat_map.hpp>
+#include <boost/utility/string_view.hpp>
+#include <chrono>
+#include <deque>
+#include <error_messages.hpp>
+#include <functional>
+#include <memory>
+#include <nlohmann/json.hpp>
+#include <string>
+#include <vector>
+
+#ifndef BMCWEB_EVENT_MAX_SSE_SUBSCRIPTIONS
+#define BMCWEB_EVENT_MAX_SSE_SUBSCRIPTIONS 100
+#endif
+
+#ifndef BMCWEB_EVENT_MAX_PUSH_SUBSCRIPTIONS
+#define BMCWEB_EVENT_MAX_PUSH_SUBSCRIPTIONS 100
+#endif
+
+namespace redfish
+{
+
+/**
+ * @brief One event, as a source reports it, before it's formatted for each
+ *        subscriber
+ */
+struct Event
+{
+    // Registry qualified, such as "OpenBMC.0.1.DCPowerOff"
+    std::string messageId;
+    std::string message;
+    std::vector<std::string> messageArgs;
+    std::string severity = "OK";
+    // The resource the event is about, such as "/redfish/v1/Systems/system"
+    std::string originOfCondition;
+    std::string timestamp;
+};
+
+/**
+ * @brief Which events a subscriber wants.  An empty list doesn't restrict.
+ */
+struct EventFilter
+{
+    // "Event" or "MetricReport", which are filtered by nothing further
+    std::string eventFormatType = "Event";
+    // Registry prefixes, such as "OpenBMC"
+    std::vector<std::string> registryPrefixes;
+    // Resources whose own events, and those of the resources under them,
+    // are sent
+    std::vector<std::string> originResources;
+
+    bool matches(const Event& event) const
+    {
+        if (eventFormatType != "Event")
+        {
+            return false;
+        }
+        if (!registryPrefixes.empty())
+        {
+            std::string prefix =
+                event.messageId.substr(0, event.messageId.find('.'));
+            if (std::find(registryPrefixes.begin(), registryPrefixes.end(),
+                          prefix) == registryPrefixes.end())
+            {
+                return false;
+            }
+        }
+        if (!originResources.empty())
+        {
+            const std::string& origin = event.originOfCondition;
+            bool found = false;
+            for (const std::string& resource : originResources)
+            {
+                if (origin.compare(0, resource.size(), resource) == 0 &&
+                    (origin.size() == resource.size() ||
+                     origin[resource.size()] == '/' ||
+                     origin[resource.size()] == '#'))
+                {
+                    found = true;
+                    break;
+                }
+            }
+            if (!found)
+            {
+                return false;
+            }
+        }
+        return true;
+    }
+};
+
+/**
+ * @brief Parses the $filter of an SSE stream, such as
+ *        "RegistryPrefix eq 'OpenBMC' or OriginResource eq
+ *        '/redfish/v1/Systems/system'"
+ *
+ * Terms on the same property are ORed and terms on different ones ANDed,
+ * whichever of "and" and "or" joins them.  An EventFormatType term of
+ * 'MetricReport' streams metric reports instead of events.
+ *
+ * @return false if the filter isn't one that's supported
+ */
+inline bool parseSseFilter(boost::string_view text, EventFilter& filter)
+{
+    while (!text.empty())
+    {
+        size_t space = text.find(' ');
+        if (space == boost::string_view::npos)
+        {
+            return false;
+        }
+        boost::string_view property = text.substr(0, space);
+        text.remove_prefix(space + 1);
+        if (!text.starts_with("eq '"))
+        {
+            return false;
+        }
+        text.remove_prefix(4);
+        size_t quote = text.find('\'');
+        if (quote == boost::string_view::npos || quote == 0)
+        {
+            return false;
+        }
+        std::string value = text.substr(0, quote).to_string();
+        text.remove_prefix(quote + 1);
+
+        if (property == "RegistryPrefix")
+        {
+            filter.registryPrefixes.emplace_back(std::move(value));
+        }
+        else if (property == "OriginResource")
+        {
+            filter.originResources.emplace_back(std::move(value));
+        }
+        else if (property == "EventFormatType" &&
+                 (value == "Event" || value == "MetricReport"))
+        {
+            filter.eventFormatType = std::move(value);
+        }
+        else
+        {
+            return false;
+        }
+
+        if (text.starts_with(" and "))
+        {
+            text.remove_prefix(5);
+        }
+        else if (text.starts_with(" or "))
+        {
+            text.remove_prefix(4);
+        }
+        else if (!text.empty())
+        {
+            return false;
+        }
+        else
+        {
+            break;
+        }
+    }
+    return true;
+}
+
+/**
+ * @brief Splits an http:// push destination into where to connect and the
+ *        target to post to
+ *
+ * The host has to be an IP address.  bmcweb is built without threads, which
+ * asio needs to resolve names asynchronously, and a lookup on the event
+ * path would hold up every other client while it waits on DNS.
+ */
+inline bool parseDestination(const std::string& destination,
+                             std::string& host, std::string& port,
+                             std::string& target)
+{
+    constexpr boost::string_view scheme = "http://";
+    boost::string_view url(destination);
+    if (!url.starts_with(scheme))
+    {
+        return false;
+    }
+    url.remove_prefix(scheme.size());
+    size_t slash = url.find('/');
+    boost::string_view authority = url.substr(0, slash);
+    target = slash == boost::string_view::npos ? "/"
+                                               : url.substr(slash).to_string();
+    size_t colon = authority.rfind(':');
+    // A bracketed IPv6 address holds colons of its own
+    if (colon != boost::string_view::npos &&
+        authority.find(']', colon) == boost::string_view::npos)
+    {
+        port = authority.substr(colon + 1).to_string();
+        authority = authority.substr(0, colon);
+        if (port.empty() || port.size() > 5 ||
+            port.find_first_not_of("0123456789") != std::string::npos ||
+            std::stoul(port) > 65535)
+        {
+            return false;
+        }
+    }
+    else
+    {
+        port = "80";
+    }
+    if (authority.size() > 2 && authority.front() == '[' &&
+        authority.back() == ']')
+    {
+        authority.remove_prefix(1);
+        authority.remove_suffix(1);
+    }
+    host = authority.to_string();
+    boost::system::error_code ec;
+    boost::asio::ip::make_address(host, ec);
+    return !ec;
+}
+
+/**
+ * @brief Formats an event as the Redfish Event a subscriber is sent
+ */
+inline std::string formatEvent(const Event& event, uint64_t eventId,
+                               const std::string& context)
+{
+    nlohmann::json entry = {{"EventType", "Event"},
+                            {"EventId", std::to_string(eventId)},
+                            {"EventTimestamp", event.timestamp},
+                            {"Severity", event.severity},
+                            {"Message", event.message},
+                            {"MessageId", event.messageId},
+                            {"MessageArgs", event.messageArgs}};
+    if (!event.originOfCondition.empty())
+    {
+        entry["OriginOfCondition"] = {
+            {"@odata.id", event.originOfCondition}};
+    }
+    nlohmann::json payload = {{"@odata.type", "#Event.v1_4_0.Event"},
+                              {"Id", std::to_string(eventId)},
+                              {"Name", "Event Log"},
+                              {"Context", context},
+                              {"Events", nlohmann::json::array({entry})}};
+    return payload.dump(-1, ' ', true);
+}
+
+/**
+ * @brief How delivery to a push subscriber is retried
+ */
+struct RetryPolicy
+{
+    // Attempts at an event, the first included, before it's dropped
+    size_t attempts = 5;
+    // The wait after the first failure, which doubles with each one after
+    std::chrono::milliseconds initialDelay{1000};
+    std::chrono::milliseconds maxDelay{60000};
+};
+
+/**
+ * @brief The wait before retrying an event that has failed failures times
+ */
+inline std::chrono::milliseconds getRetryDelay(const RetryPolicy& policy,
+                                               size_t failures)
+{
+    std::chrono::milliseconds delay = policy.initialDelay;
+    for (size_t i = 1; i < failures && delay < policy.maxDelay; i++)
+    {
+        delay *= 2;
+    }
+    return std::min(delay, policy.maxDelay);
+}
+
+/**
+ * @brief Posts payloads to an HTTP listener one at a time, keeping the
+ *        connection open between them
+ */
+class HttpPushClient : public std::enable_shared_from_this<HttpPushClient>
+{
+  public:
+    // host is an IP address and port a number, as parseDestination() gives
+    HttpPushClient(boost::asio::io_context& io, const std::string& host,
+                   const std::string& port, const std::string& target) :
+        endpoint(boost::asio::ip::make_address(host),
+                 static_cast<unsigned short>(std::stoul(port))),
+        socket(io), timer(io), host(host), target(target)
+    {
+    }
+
+    // Calls handler with whether the listener answered with a 2xx status
+    void post(const std::string& body, std::function<void(bool)>&& handler)
+    {
+        request = {};
+        request.method(boost::beast::http::verb::post);
+        request.target(target);
+        request.version(11);
+        request.set(boost::beast::http::field::host, host);
+        request.set(boost::beast::http::field::content_type,
+                    "application/json");
+        request.keep_alive(true);
+        request.body() = body;
+        request.prepare_payload();
+        done = std::move(handler);
+
+        // A timeout that was already on its way when an earlier post
+        // finished mustn't cut this one short
+        uint64_t thisPost = ++posts;
+        timer.expires_after(timeout);
+        timer.async_wait([weak(weak_from_this()), thisPost](
+                             const boost::system::error_code& ec) {
+            std::shared_ptr<HttpPushClient> self = weak.lock();
+            if (ec || self == nullptr || self->posts != thisPost)
+            {
+                return;
+            }
+            BMCWEB_LOG_DEBUG << "Event push to " << self->host << " timed out";
+            // Fails whatever is in progress
+            boost::system::error_code closeEc;
+            self->socket.close(closeEc);
+        });
+
+        if (socket.is_open())
+        {
+            sendRequest();
+            return;
+        }
+        socket.async_connect(endpoint, [self(shared_from_this())](
+                                           const boost::system::error_code& ec) {
+            if (ec)
+            {
+                self->finish(false);
+                return;
+            }
+            self->sendRequest();
+        });
+    }
+
+  private:
+    void sendRequest()
+    {
+        boost::beast::http::async_write(
+            socket, request,
+            [self(shared_from_this())](const boost::system::error_code& ec,
+                                       size_t) {
+                if (ec)
+                {
+                    self->finish(false);
+                    return;
+                }
+                self->response = {};
+                boost::beast::http::async_read(
+                    self->socket, self->buffer, self->response,
+                    [self](const boost::system::error_code& ec, size_t) {
+                        if (ec)
+                        {
+                            self->finish(false);
+                            return;
+                        }
+                        unsigned status = self->response.result_int();
+                        if (!self->response.keep_alive())
+                        {
+                            boost::system::error_code closeEc;
+                            self->socket.close(closeEc);
+                        }
+                        self->finish(status >= 200 && status < 300);
+                    });
+            });
+    }
+
+    void finish(bool delivered)
+    {
+        timer.cancel();
+        if (!delivered)
+        {
+            // Start over with a new connection next time
+            boost::system::error_code ec;
+            socket.close(ec);
+            buffer.consume(buffer.size());
+        }
+        std::function<void(bool)> handler = std::move(done);
+        done = nullptr;
+        if (handler)
+        {
+            handler(delivered);
+        }
+    }
+
+    static constexpr std::chrono::seconds timeout{10};
+
+    boost::asio::ip::tcp::endpoint endpoint;
+    boost::asio::ip::tcp::socket socket;
+    boost::asio::steady_timer timer;
+    std::string host;
+    std::string target;
+    boost::beast::http::request<boost::beast::http::string_body> request;
+    boost::beast::http::response<boost::beast::http::string_body> response;
+    boost::beast::flat_buffer buffer;
+    std::function<void(bool)> done;
+    uint64_t posts = 0;
+};
+
+/**
+ * @brief A subscriber to the EventService
+ */
+class Subscription
+{
+  public:
+    Subscription(const std::string& id, EventFilter&& filter,
+                 const std::string& context) :
+        id(id),
+        filter(std::move(filter)), context(context)
+    {
+    }
+
+    virtual ~Subscription() = default;
+
+    Subscription(const Subscription&) = delete;
+    Subscription& operator=(const Subscription&) = delete;
+
+    // Queues a formatted event for the subscriber.  eventId numbers it among
+    // everything the service has sent, for streams that let a client say
+    // which it saw last.
+    virtual void sendEvent(std::string&& payload, uint64_t eventId) = 0;
+
+    // Whether the subscriber holds an SSE stream open, rather than having
+    // events pushed to it.  The two are limited separately.
+    virtual bool isSse() const
+    {
+        return false;
+    }
+
+    // False once the subscriber is gone and the subscription can be removed
+    virtual bool isAlive()
+    {
+        return true;
+    }
+
+    // Fills in the EventDestination properties particular to the kind of
+    // subscription
+    virtual void fillJson(nlohmann::json& json) const = 0;
+
+    const std::string id;
+    const EventFilter filter;
+    const std::string context;
+    // Events that were dropped, for a full queue or failed delivery
+    size_t droppedEvents = 0;
+};
+
+/**
+ * @brief A subscriber the events are posted to, in order, each retried with
+ *        backoff until it's delivered or runs out of attempts
+ */
+class PushSubscription : public Subscription,
+                         public std::enable_shared_from_this<PushSubscription>
+{
+  public:
+    PushSubscription(boost::asio::io_context& io, const std::string& id,
+                     EventFilter&& filter, const std::string& context,
+                     const std::string& destination, const std::string& host,
+                     const std::string& port, const std::string& target,
+                     const RetryPolicy& policy = RetryPolicy(),
+                     size_t maxQueue = 256) :
+        Subscription(id, std::move(filter), context),
+        destination(destination), policy(policy), maxQueue(maxQueue),
+        retryTimer(io),
+        client(std::make_shared<HttpPushClient>(io, host, port, target))
+    {
+    }
+
+    void sendEvent(std::string&& payload, uint64_t) override
+    {
+        // The oldest events are dropped first, but not one being delivered
+        if (queue.size() >= maxQueue && queue.size() > (busy ? 1 : 0))
+        {
+            queue.erase(queue.begin() + (busy ? 1 : 0));
+            droppedEvents++;
+        }
+        queue.emplace_back(std::move(payload));
+        sendNext();
+    }
+
+    void fillJson(nlohmann::json& json) const override
+    {
+        json["Destination"] = destination;
+        json["SubscriptionType"] = "RedfishEvent";
+    }
+
+    size_t queuedEvents() const
+    {
+        return queue.size();
+    }
+
+  private:
+    void sendNext()
+    {
+        if (busy || queue.empty())
+        {
+            return;
+        }
+        busy = true;
+        client->post(queue.front(), [weak(weak_from_this())](bool delivered) {
+            std::shared_ptr<PushSubscription> self = weak.lock();
+            if (self == nullptr)
+            {
+                return;
+            }
+            self->sendDone(delivered);
+        });
+    }
+
+    void sendDone(bool delivered)
+    {
+        if (delivered)
+        {
+            failures = 0;
+            queue.pop_front();
+            busy = false;
+            sendNext();
+            return;
+        }
+        failures++;
+        if (failures >= policy.attempts)
+        {
+            BMCWEB_LOG_ERROR << "Dropping event for " << destination
+                             << " after " << failures << " attempts";
+            failures = 0;
+            queue.pop_front();
+            droppedEvents++;
+            busy = false;
+            sendNext();
+            return;
+        }
+        retryTimer.expires_after(getRetryDelay(policy, failures));
+        retryTimer.async_wait([weak(weak_from_this())](
+                                  const boost::system::error_code& ec) {
+            std::shared_ptr<PushSubscription> self = weak.lock();
+            if (ec || self == nullptr)
+            {
+                return;
+            }
+            self->busy = false;
+            self->sendNext();
+        });
+    }
+
+    const std::string destination;
+    const RetryPolicy policy;
+    const size_t maxQueue;
+    std::deque<std::string> queue;
+    // Set while the event at the front of the queue is being delivered, or
+    // waiting to be retried
+    bool busy = false;
+    size_t failures = 0;
+    boost::asio::steady_timer retryTimer;
+    std::shared_ptr<HttpPushClient> client;
+};
+
+/**
+ * @brief The EventService's subscriptions, and what sends them events
+ */
+class EventServiceManager
+{
+  public:
+    // Subscriptions of each kind beyond these are refused
+    static constexpr size_t maxSseSubscriptions =
+        BMCWEB_EVENT_MAX_SSE_SUBSCRIPTIONS;
+    static constexpr size_t maxPushSubscriptions =
+        BMCWEB_EVENT_MAX_PUSH_SUBSCRIPTIONS;
+
+    static EventServiceManager& getInstance()
+    {
+        static EventServiceManager manager;
+        return manager;
+    }
+
+    // An id for a new subscription
+    std::string getNewId()
+    {
+        return std::to_string(++lastSubscriptionId);
+    }
+
+    bool addSubscription(const std::shared_ptr<Subscription>& subscription)
+    {
+        removeDeadSubscriptions();
+        size_t sameKind = 0;
+        for (const auto& [id, existing] : subscriptions)
+        {
+            if (existing->isSse() == subscription->isSse())
+            {
+                sameKind++;
+            }
+        }
+        if (sameKind >= (subscription->isSse() ? maxSseSubscriptions
+                                               : maxPushSubscriptions))
+        {
+            return false;
+        }
+        subscriptions.emplace(subscription->id, subscription);
+        return true;
+    }
+
+    // As above, answering res with a 503 when the subscription is refused
+    bool addSubscription(const std::shared_ptr<Subscription>& subscription,
+                         crow::Response& res)
+    {
+        if (addSubscription(subscription))
+        {
+            return true;
+        }
+        messages::resourceExhaustion(
+            res, subscription->isSse()
+                     ? "/redfish/v1/EventService/SSE"
+                     : "/redfish/v1/EventService/Subscriptions");
+        return false;
+    }
+
+    bool removeSubscription(const std::string& id)
+    {
+        return subscriptions.erase(id) != 0;
+    }
+
+    std::shared_ptr<Subscription> getSubscription(const std::string& id)
+    {
+        auto it = subscriptions.find(id);
+        if (it == subscriptions.end() || !it->second->isAlive())
+        {
+            return nullptr;
+        }
+        return it->second;
+    }
+
+    const boost::container::flat_map<std::string,
+                                     std::shared_ptr<Subscription>>&
+        getSubscriptions()
+    {
+        removeDeadSubscriptions();
+        return subscriptions;
+    }
+
+    // Sends the event to every subscriber whose filter it passes.  Each is
+    // formatted with the subscriber's context only once it's known to be
+    // wanted.
+    void sendEvent(const Event& event)
+    {
+        removeDeadSubscriptions();
+        uint64_t eventId = ++lastEventId;
+        for (auto& [id, subscription] : subscriptions)
+        {
+            if (subscription->filter.matches(event))
+            {
+                subscription->sendEvent(
+                    formatEvent(event, eventId, subscription->context),
+                    eventId);
+            }
+        }
+    }
+
+    // Sends a MetricReport to every subscriber that asked for them
+    void sendMetricReport(const nlohmann::json& report)
+    {
+        removeDeadSubscriptions();
+        uint64_t eventId = ++lastEventId;
+        for (auto& [id, subscription] : subscriptions)
+        {
+            if (subscription->filter.eventFormatType == "MetricReport")
+            {
+                nlohmann::json payload = report;
+                payload["Context"] = subscription->context;
+                subscription->sendEvent(payload.dump(-1, ' ', true), eventId);
+            }
+        }
+    }
+
+  private:
+    void removeDeadSubscriptions()
+    {
+        for (auto it = subscriptions.begin(); it != subscriptions.end();)
+        {
+            if (it->second->isAlive())
+            {
+                it++;
+                continue;
+            }
+            BMCWEB_LOG_DEBUG << "Removing subscription " << it->first;
+            it = subscriptions.erase(it);
+        }
+    }
+
+    boost::container::flat_map<std::string, std::shared_ptr<Subscription>>
+        subscriptions;
+    uint64_t lastSubscriptionId = 0;
+    uint64_t lastEventId = 0;
+};
+
+} // namespace redfish
@@ -19,6 +19,7 @@
 #include "../lib/chassis.hpp"
 #include "../lib/cpudimm.hpp"
 #include "../lib/ethernet.hpp"
+#include "../lib/event_service.hpp"
 #include "../lib/log_services.hpp"
 #include "../lib/managers.hpp"
 #include "../lib/network_protocol.hpp"
@@ -27,6 +28,7 @@
 #include "../lib/roles.hpp"
 #include "../lib/service_root.hpp"
 #include "../lib/systems.hpp"
+#include "../lib/telemetry_service.hpp"
 #include "../lib/thermal.hpp"
 #include "../lib/update_service.hpp"
 #include "webserver_common.hpp"
@@ -77,12 +79,22 @@ class RedfishService
         nodes.emplace_back(std::make_unique<EventLogService>(app));
         nodes.emplace_back(std::make_unique<EventLogEntryCollection>(app));
         nodes.emplace_back(std::make_unique<EventLogEntry>(app));
+        nodes.emplace_back(std::make_unique<EventLogExport>(app));
+#ifdef BMCWEB_ENABLE_HOST_CONSOLE_CAPTURE
+        nodes.emplace_back(std::make_unique<HostConsoleLogService>(app));
+        nodes.emplace_back(
+            std::make_unique<HostConsoleLogEntryCollection>(app));
+        nodes.emplace_back(std::make_unique<HostConsoleLogEntry>(app));
+        nodes.emplace_back(
+            std::make_unique<HostConsoleLogEntryAttachment>(app));
+#endif
 
         nodes.emplace_back(std::make_unique<BMCLogServiceCollection>(app));
 #ifdef BMCWEB_ENABLE_REDFISH_BMC_JOURNAL
         nodes.emplace_back(std::make_unique<BMCJournalLogService>(app));
         nodes.emplace_back(std::make_unique<BMCJournalLogEntryCollection>(app));
         nodes.emplace_back(std::make_unique<BMCJournalLogEntry>(app));
+        nodes.emplace_back(std::make_unique<BMCJournalLogExport>(app));
 #endif
 
 #ifdef BMCWEB_ENABLE_REDFISH_CPU_LOG
@@ -103,6 +115,20 @@ class RedfishService
         nodes.emplace_back(std::make_unique<SystemsCollection>(app));
         nodes.emplace_back(std::make_unique<Systems>(app));
         nodes.emplace_back(std::make_unique<SystemActionsReset>(app));
+
+        nodes.emplace_back(std::make_unique<EventService>(app));
+        nodes.emplace_back(std::make_unique<EventServiceSse>(app));
+        nodes.emplace_back(std::make_unique<EventDestinationCollection>(app));
+        nodes.emplace_back(std::make_unique<EventDestination>(app));
+
+        nodes.emplace_back(std::make_unique<TelemetryService>(app));
+        nodes.emplace_back(
+            std::make_unique<MetricReportDefinitionCollection>(app));
+        nodes.emplace_back(std::make_unique<MetricReportDefinitionEntry>(app));
+        nodes.emplace_back(std::make_unique<MetricReportCollection>(app));
+        nodes.emplace_back(std::make_unique<MetricReport>(app));
+        nodes.emplace_back(std::make_unique<SensorHistoryCollection>(app));
+        nodes.emplace_back(std::make_unique<SensorHistoryEntry>(app));
     }
 
   private:
@@ -0,0 +1,746 @@
+/*
+// Copyright (c) 2018 Intel Corporation
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+*/
+#pragma once
+
+#include <time.h>
+#include <utils/time_series.hpp>
+
+#include <algorithm>
+#include <boost/container/flat_map.hpp>
+#include <boost/utility/string_view.hpp>
+#include <chrono>
+#include <cstdint>
+#include <limits>
+#include <memory>
+#include <nlohmann/json.hpp>
+#include <optional>
+#include <string>
+#include <vector>
+
+namespace redfish
+{
+
+namespace telemetry
+{
+
+// The longest duration parseDuration() accepts, which keeps the times
+// computed from intervals and durations well within range
+constexpr std::chrono::hours maxDuration(7 * 24);
+
+/**
+ * @brief Parses an ISO 8601 duration, such as "PT1M30S" or "P1DT12H", of no
+ *        more than maxDuration
+ */
+inline bool parseDuration(boost::string_view text,
+                          std::chrono::milliseconds& duration)
+{
+    if (!text.starts_with("P"))
+    {
+        return false;
+    }
+    text.remove_prefix(1);
+    bool inTime = false;
+    bool empty = true;
+    double total = 0;
+    while (!text.empty())
+    {
+        if (text.front() == 'T' && !inTime)
+        {
+            inTime = true;
+            text.remove_prefix(1);
+            continue;
+        }
+        size_t end = 0;
+        while (end < text.size() &&
+               ((text[end] >= '0' && text[end] <= '9') || text[end] == '.'))
+        {
+            end++;
+        }
+        if (end == 0 || end == text.size())
+        {
+            return false;
+        }
+        std::string number = text.substr(0, end).to_string();
+        char unit = text[end];
+        text.remove_prefix(end + 1);
+        char* numberEnd = nullptr;
+        double value = std::strtod(number.c_str(), &numberEnd);
+        if (*numberEnd != '\0')
+        {
+            return false;
+        }
+        if (!inTime && unit == 'D')
+        {
+            total += value * 24 * 60 * 60;
+        }
+        else if (inTime && unit == 'H')
+        {
+            total += value * 60 * 60;
+        }
+        else if (inTime && unit == 'M')
+        {
+            total += value * 60;
+        }
+        else if (inTime && unit == 'S')
+        {
+            total += value;
+        }
+        else
+        {
+            return false;
+        }
+        empty = false;
+    }
+    // Written so that a total too large to be finite fails it too
+    if (empty || !(total <= std::chrono::duration_cast<std::chrono::seconds>(
+                                 maxDuration)
+                                 .count()))
+    {
+        return false;
+    }
+    duration = std::chrono::milliseconds(static_cast<int64_t>(total * 1000));
+    return true;
+}
+
+/**
+ * @brief Formats a duration as ISO 8601, in seconds
+ */
+inline std::string formatDuration(std::chrono::milliseconds duration)
+{
+    std::string text = "PT" + std::to_string(duration.count() / 1000);
+    int64_t millis = duration.count() % 1000;
+    if (millis != 0)
+    {
+        std::string fraction = std::to_string(1000 + millis).substr(1);
+        fraction.erase(fraction.find_last_not_of('0') + 1);
+        text += "." + fraction;
+    }
+    return text + "S";
+}
+
+/**
+ * @brief Formats milliseconds since the epoch as a Redfish DateTime
+ */
+inline std::string formatTimestamp(uint64_t millis)
+{
+    time_t t = static_cast<time_t>(millis / 1000);
+    struct tm tm = {};
+    char text[64] = {};
+    if (localtime_r(&t, &tm) == nullptr ||
+        strftime(text, sizeof(text), "%FT%T%z", &tm) == 0)
+    {
+        return std::string();
+    }
+    // Insert the ':' into the timezone
+    std::string timestamp(text);
+    if (timestamp.size() > 2)
+    {
+        timestamp.insert(timestamp.size() - 2, ":");
+    }
+    return timestamp;
+}
+
+// The sensor types that are shown in each of the Thermal and Power arrays
+struct SensorArray
+{
+    const char* resource;
+    const char* array;
+    std::vector<const char*> types;
+};
+
+inline const std::vector<SensorArray>& getSensorArrays()
+{
+    static const std::vector<SensorArray> arrays = {
+        {"Thermal", "Temperatures", {"temperature"}},
+        {"Thermal", "Fans", {"fan", "fan_tach", "fan_pwm"}},
+        {"Power", "Voltages", {"voltage"}},
+        {"Power", "PowerSupply", {"power", "current"}}};
+    return arrays;
+}
+
+} // namespace telemetry
+
+/**
+ * @brief Finds the D-Bus sensors a MetricProperty could refer to
+ *
+ * Properties name a sensor in a chassis' Thermal or Power resource by its
+ * MemberId, as in
+ * "/redfish/v1/Chassis/chassis/Thermal#/Temperatures/CPU_Temp/ReadingCelsius".
+ * The reading property at the end may be left out.
+ *
+ * @param[in]  property     The MetricProperty
+ * @param[out] sensorPaths  The object paths of the sensors of each type that
+ *                          are shown in that array
+ *
+ * @return false if the property doesn't name a sensor
+ */
+inline bool parseMetricProperty(const std::string& property,
+                                std::vector<std::string>& sensorPaths)
+{
+    constexpr boost::string_view prefix = "/redfish/v1/Chassis/";
+    boost::string_view uri(property);
+    if (!uri.starts_with(prefix))
+    {
+        return false;
+    }
+    uri.remove_prefix(prefix.size());
+    size_t hash = uri.find('#');
+    if (hash == boost::string_view::npos)
+    {
+        return false;
+    }
+    boost::string_view resource = uri.substr(0, hash);
+    boost::string_view fragment = uri.substr(hash + 1);
+    size_t slash = resource.find('/');
+    if (slash == 0 || slash == boost::string_view::npos)
+    {
+        return false;
+    }
+    resource.remove_prefix(slash + 1);
+
+    // Split "/<array>/<sensor>[/<property>]"
+    std::vector<std::string> parts;
+    while (fragment.starts_with("/"))
+    {
+        fragment.remove_prefix(1);
+        size_t end = std::min(fragment.find('/'), fragment.size());
+        parts.push_back(fragment.substr(0, end).to_string());
+        fragment.remove_prefix(end);
+    }
+    if (!fragment.empty() || parts.size() < 2 || parts.size() > 3 ||
+        parts[1].empty())
+    {
+        return false;
+    }
+
+    for (const telemetry::SensorArray& array : telemetry::getSensorArrays())
+    {
+        if (resource == array.resource && parts[0] == array.array)
+        {
+            sensorPaths.clear();
+            for (const char* type : array.types)
+            {
+                sensorPaths.push_back(std::string("/xyz/openbmc_project/"
+                                                  "sensors/") +
+                                      type + "/" + parts[1]);
+            }
+            return true;
+        }
+    }
+    return false;
+}
+
+/**
+ * @brief The latest reading of every sensor, kept up to date from D-Bus so
+ *        sampling them costs nothing there
+ */
+class SensorValueCache
+{
+  public:
+    // Sets the reading of the sensor at path, as Redfish shows it
+    void update(const std::string& path, double value)
+    {
+        values[path] = value;
+    }
+
+    void remove(const std::string& path)
+    {
+        values.erase(path);
+    }
+
+    // Gets the reading of the first of paths that's known
+    bool get(const std::vector<std::string>& paths, double& value) const
+    {
+        for (const std::string& path : paths)
+        {
+            auto it = values.find(path);
+            if (it != values.end())
+            {
+                value = it->second;
+                return true;
+            }
+        }
+        return false;
+    }
+
+  private:
+    boost::container::flat_map<std::string, double> values;
+};
+
+enum class CollectionFunction
+{
+    Average,
+    Maximum,
+    Minimum,
+    Summation
+};
+
+inline std::optional<CollectionFunction>
+    getCollectionFunction(const std::string& name)
+{
+    if (name == "Average")
+    {
+        return CollectionFunction::Average;
+    }
+    if (name == "Maximum")
+    {
+        return CollectionFunction::Maximum;
+    }
+    if (name == "Minimum")
+    {
+        return CollectionFunction::Minimum;
+    }
+    if (name == "Summation")
+    {
+        return CollectionFunction::Summation;
+    }
+    return std::nullopt;
+}
+
+inline const char* getCollectionFunctionName(CollectionFunction function)
+{
+    switch (function)
+    {
+        case CollectionFunction::Average:
+            return "Average";
+        case CollectionFunction::Maximum:
+            return "Maximum";
+        case CollectionFunction::Minimum:
+            return "Minimum";
+        case CollectionFunction::Summation:
+            return "Summation";
+    }
+    return "";
+}
+
+/**
+ * @brief A fixed number of the most recent samples of a metric
+ */
+class MetricRing
+{
+  public:
+    struct Sample
+    {
+        // Milliseconds since the epoch
+        uint64_t timestamp;
+        double value;
+    };
+
+    explicit MetricRing(size_t capacity) :
+        samples(std::max<size_t>(capacity, 1))
+    {
+    }
+
+    void push(uint64_t timestamp, double value)
+    {
+        samples[next] = {timestamp, value};
+        next = (next + 1) % samples.size();
+        count = std::min(count + 1, samples.size());
+    }
+
+    size_t size() const
+    {
+        return count;
+    }
+
+    size_t capacity() const
+    {
+        return samples.size();
+    }
+
+    const Sample* latest() const
+    {
+        if (count == 0)
+        {
+            return nullptr;
+        }
+        return &samples[(next + samples.size() - 1) % samples.size()];
+    }
+
+    // Aggregates the samples taken at or after since
+    bool aggregate(CollectionFunction function, uint64_t since,
+                   double& result) const
+    {
+        size_t used = 0;
+        double sum = 0;
+        double min = std::numeric_limits<double>::max();
+        double max = std::numeric_limits<double>::lowest();
+        for (size_t i = 0; i < count; i++)
+        {
+            const Sample& sample = samples[i];
+            if (sample.timestamp < since)
+            {
+                continue;
+            }
+            used++;
+            sum += sample.value;
+            min = std::min(min, sample.value);
+            max = std::max(max, sample.value);
+        }
+        if (used == 0)
+        {
+            return false;
+        }
+        switch (function)
+        {
+            case CollectionFunction::Average:
+                result = sum / used;
+                break;
+            case CollectionFunction::Maximum:
+                result = max;
+                break;
+            case CollectionFunction::Minimum:
+                result = min;
+                break;
+            case CollectionFunction::Summation:
+                result = sum;
+                break;
+        }
+        return true;
+    }
+
+  private:
+    std::vector<Sample> samples;
+    size_t next = 0;
+    size_t count = 0;
+};
+
+/**
+ * @brief One of the Metrics of a MetricReportDefinition: a sensor property
+ *        and, optionally, how its samples are aggregated
+ */
+struct Metric
+{
+    // Samples kept for any one metric are limited to this, and so the
+    // duration it can aggregate over to this many intervals
+    static constexpr size_t maxSamples = 3600;
+
+    Metric(const std::string& id, const std::string& property,
+           std::vector<std::string>&& sensorPaths,
+           std::optional<CollectionFunction> function,
+           std::chrono::milliseconds duration,
+           std::chrono::milliseconds interval) :
+        id(id),
+        property(property), sensorPaths(std::move(sensorPaths)),
+        function(function), duration(duration),
+        samples(getSampleCount(function, duration, interval))
+    {
+    }
+
+    // The samples kept to aggregate over duration when sampled at interval,
+    // which a definition has to keep within maxSamples
+    static size_t getSampleCount(std::optional<CollectionFunction> function,
+                                 std::chrono::milliseconds duration,
+                                 std::chrono::milliseconds interval)
+    {
+        if (!function)
+        {
+            return 1;
+        }
+        return static_cast<size_t>(duration / interval) + 1;
+    }
+
+    std::string id;
+    std::string property;
+    std::vector<std::string> sensorPaths;
+    // Without one the latest sample is reported
+    std::optional<CollectionFunction> function;
+    // The window the samples are aggregated over
+    std::chrono::milliseconds duration;
+    MetricRing samples;
+};
+
+/**
+ * @brief A periodic report of sensor readings sampled at an interval
+ */
+class MetricReportDefinition
+{
+  public:
+    // Samples are taken no more often than this
+    static constexpr std::chrono::milliseconds minInterval{1000};
+    // What one definition can ask for, which bounds the memory it takes
+    static constexpr size_t maxMetrics = 32;
+    static constexpr size_t maxSamples = 2 * Metric::maxSamples;
+
+    MetricReportDefinition(const std::string& id,
+                           std::chrono::milliseconds interval,
+                           std::vector<std::string>&& reportActions,
+                           std::vector<Metric>&& metrics) :
+        id(id),
+        interval(interval), reportActions(std::move(reportActions)),
+        metrics(std::move(metrics))
+    {
+    }
+
+    bool hasAction(const std::string& action) const
+    {
+        return std::find(reportActions.begin(), reportActions.end(),
+                         action) != reportActions.end();
+    }
+
+    // Samples each metric if the interval has passed since the last time.
+    // Returns whether it did, and so a new report is due.
+    bool sample(uint64_t now, const SensorValueCache& sensors)
+    {
+        if (now < nextSample)
+        {
+            return false;
+        }
+        for (Metric& metric : metrics)
+        {
+            double value = 0;
+            if (sensors.get(metric.sensorPaths, value))
+            {
+                metric.samples.push(now, value);
+            }
+        }
+        // Keep to the schedule, unless a whole interval was missed
+        uint64_t step = static_cast<uint64_t>(interval.count());
+        nextSample = nextSample + step > now ? nextSample + step : now + step;
+        lastSample = now;
+        return true;
+    }
+
+    void fillReport(nlohmann::json& report) const
+    {
+        report = {
+            {"@odata.type", "#MetricReport.v1_2_0.MetricReport"},
+            {"@odata.context",
+             "/redfish/v1/$metadata#MetricReport.MetricReport"},
+            {"@odata.id", "/redfish/v1/TelemetryService/MetricReports/" + id},
+            {"Id", id},
+            {"Name", "Metric Report " + id},
+            {"MetricReportDefinition",
+             {{"@odata.id",
+               "/redfish/v1/TelemetryService/MetricReportDefinitions/" +
+                   id}}},
+            {"Timestamp", telemetry::formatTimestamp(lastSample)}};
+        nlohmann::json& values = report["MetricValues"];
+        values = nlohmann::json::array();
+        for (const Metric& metric : metrics)
+        {
+            double value = 0;
+            uint64_t timestamp = lastSample;
+            if (metric.function)
+            {
+                uint64_t window =
+                    static_cast<uint64_t>(metric.duration.count());
+                uint64_t since = lastSample > window ? lastSample - window : 0;
+                if (!metric.samples.aggregate(*metric.function, since, value))
+                {
+                    continue;
+                }
+            }
+            else
+            {
+                const MetricRing::Sample* sample = metric.samples.latest();
+                if (sample == nullptr)
+                {
+                    continue;
+                }
+                value = sample->value;
+                timestamp = sample->timestamp;
+            }
+            values.push_back(
+                {{"MetricId", metric.id},
+                 {"MetricProperty", metric.property},
+                 {"MetricValue", nlohmann::json(value).dump()},
+                 {"Timestamp", telemetry::formatTimestamp(timestamp)}});
+        }
+    }
+
+    void fillDefinition(nlohmann::json& json) const
+    {
+        json = {
+            {"@odata.type",
+             "#MetricReportDefinition.v1_3_0.MetricReportDefinition"},
+            {"@odata.context", "/redfish/v1/$metadata#MetricReportDefinition."
+                               "MetricReportDefinition"},
+            {"@odata.id",
+             "/redfish/v1/TelemetryService/MetricReportDefinitions/" + id},
+            {"Id", id},
+            {"Name", "Metric Report Definition " + id},
+            {"MetricReportDefinitionType", "Periodic"},
+            {"Schedule",
+             {{"RecurrenceInterval", telemetry::formatDuration(interval)}}},
+            {"ReportActions", reportActions},
+            {"MetricReport",
+             {{"@odata.id",
+               "/redfish/v1/TelemetryService/MetricReports/" + id}}}};
+        nlohmann::json& metricsJson = json["Metrics"];
+        metricsJson = nlohmann::json::array();
+        for (const Metric& metric : metrics)
+        {
+            nlohmann::json metricJson = {
+                {"MetricId", metric.id},
+                {"MetricProperties", {metric.property}}};
+            if (metric.function)
+            {
+                metricJson["CollectionFunction"] =
+                    getCollectionFunctionName(*metric.function);
+                metricJson["CollectionDuration"] =
+                    telemetry::formatDuration(metric.duration);
+            }
+            metricsJson.push_back(std::move(metricJson));
+        }
+    }
+
+    const std::string id;
+    const std::chrono::milliseconds interval;
+    const std::vector<std::string> reportActions;
+
+  private:
+    std::vector<Metric> metrics;
+    uint64_t nextSample = 0;
+    uint64_t lastSample = 0;
+};
+
+/**
+ * @brief The history of every sensor's readings
+ */
+class SensorHistory
+{
+  public:
+    // Readings of sensors beyond this many aren't kept
+    static constexpr size_t maxSensors = 512;
+
+    void record(const std::string& path, uint32_t timestamp, double value)
+    {
+        auto it = series.find(path);
+        if (it == series.end())
+        {
+            if (series.size() >= maxSensors)
+            {
+                return;
+            }
+            it = series.emplace(path, std::make_unique<TimeSeries>()).first;
+        }
+        it->second->append(timestamp, value);
+    }
+
+    const TimeSeries* get(const std::string& path) const
+    {
+        auto it = series.find(path);
+        if (it == series.end())
+        {
+            return nullptr;
+        }
+        return it->second.get();
+    }
+
+    const boost::container::flat_map<std::string,
+                                     std::unique_ptr<TimeSeries>>&
+        getSeries() const
+    {
+        return series;
+    }
+
+    size_t memoryUsage() const
+    {
+        size_t bytes = 0;
+        for (const auto& [path, history] : series)
+        {
+            bytes += path.capacity() + history->memoryUsage();
+        }
+        return bytes;
+    }
+
+  private:
+    boost::container::flat_map<std::string, std::unique_ptr<TimeSeries>>
+        series;
+};
+
+/**
+ * @brief The TelemetryService's report definitions, and the sensor readings
+ *        they're sampled from
+ */
+class TelemetryServiceManager
+{
+  public:
+    // Definitions beyond this are refused
+    static constexpr size_t maxReports = 10;
+
+    static TelemetryServiceManager& getInstance()
+    {
+        static TelemetryServiceManager manager;
+        return manager;
+    }
+
+    SensorValueCache& getSensorValues()
+    {
+        return sensorValues;
+    }
+
+    SensorHistory& getSensorHistory()
+    {
+        return sensorHistory;
+    }
+
+    bool addDefinition(const std::shared_ptr<MetricReportDefinition>& def)
+    {
+        if (definitions.size() >= maxReports ||
+            definitions.find(def->id) != definitions.end())
+        {
+            return false;
+        }
+        definitions.emplace(def->id, def);
+        return true;
+    }
+
+    bool removeDefinition(const std::string& id)
+    {
+        return definitions.erase(id) != 0;
+    }
+
+    std::shared_ptr<MetricReportDefinition> getDefinition(const std::string& id)
+    {
+        auto it = definitions.find(id);
+        if (it == definitions.end())
+        {
+            return nullptr;
+        }
+        return it->second;
+    }
+
+    const boost::container::flat_map<
+        std::string, std::shared_ptr<MetricReportDefinition>>&
+        getDefinitions() const
+    {
+        return definitions;
+    }
+
+    // Samples every definition that's due, calling onReport for each
+    template <typename Callback>
+    void sample(uint64_t now, Callback&& onReport)
+    {
+        for (auto& [id, definition] : definitions)
+        {
+            if (definition->sample(now, sensorValues))
+            {
+                onReport(*definition);
+            }
+        }
+    }
+
+  private:
+    SensorValueCache sensorValues;
+    SensorHistory sensorHistory;
+    boost::container::flat_map<std::string,
+                               std::shared_ptr<MetricReportDefinition>>
+        definitions;
+};
+
+} // namespace redfish
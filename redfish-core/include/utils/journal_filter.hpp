@@ -0,0 +1,272 @@
+/*
+// Copyright (c) 2018 Intel Corporation
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+*/
+#pragma once
+
+#include <time.h>
+
+#include <algorithm>
+#include <boost/utility/string_view.hpp>
+#include <cstdint>
+#include <cstdio>
+#include <limits>
+#include <string>
+#include <vector>
+
+namespace redfish
+{
+
+/**
+ * @brief A log entry $filter in the terms the journal can search by itself
+ */
+struct JournalFilter
+{
+    // FIELD=value matches for sd_journal_add_match().  Matches on the same
+    // field are ORed together and those on different fields ANDed.
+    std::vector<std::string> matches;
+    // Bounds on the entries' realtime timestamps, in microseconds, inclusive
+    uint64_t since = 0;
+    uint64_t until = std::numeric_limits<uint64_t>::max();
+};
+
+namespace journal_filter
+{
+
+/**
+ * @brief Reads a Created timestamp, as getTimestampStr() writes them, into
+ *        microseconds since the epoch
+ */
+inline bool parseTimestamp(boost::string_view text, uint64_t& usec)
+{
+    if (text.size() >= 2 && text.front() == '\'' && text.back() == '\'')
+    {
+        text.remove_prefix(1);
+        text.remove_suffix(1);
+    }
+    std::string value = text.to_string();
+    struct tm tm = {};
+    int consumed = 0;
+    if (sscanf(value.c_str(), "%4d-%2d-%2dT%2d:%2d:%2d%n", &tm.tm_year,
+               &tm.tm_mon, &tm.tm_mday, &tm.tm_hour, &tm.tm_min, &tm.tm_sec,
+               &consumed) != 6 ||
+        consumed != 19)
+    {
+        return false;
+    }
+    boost::string_view zone(value);
+    zone.remove_prefix(consumed);
+    // Fractions of a second are ignored, as Created doesn't have them
+    if (zone.starts_with("."))
+    {
+        zone.remove_prefix(1);
+        while (!zone.empty() && zone.front() >= '0' && zone.front() <= '9')
+        {
+            zone.remove_prefix(1);
+        }
+    }
+    int64_t offset = 0;
+    if (zone == "Z")
+    {
+        offset = 0;
+    }
+    else
+    {
+        int hours = 0;
+        int minutes = 0;
+        std::string offsetText = zone.to_string();
+        if (offsetText.size() != 6 ||
+            (offsetText[0] != '+' && offsetText[0] != '-') ||
+            sscanf(offsetText.c_str() + 1, "%2d:%2d", &hours, &minutes) != 2)
+        {
+            return false;
+        }
+        offset = (hours * 60 + minutes) * 60;
+        if (offsetText[0] == '-')
+        {
+            offset = -offset;
+        }
+    }
+    tm.tm_year -= 1900;
+    tm.tm_mon -= 1;
+    time_t seconds = timegm(&tm);
+    if (seconds - offset < 0)
+    {
+        return false;
+    }
+    usec = static_cast<uint64_t>(seconds - offset) * 1000 * 1000;
+    return true;
+}
+
+/**
+ * @brief Reads one "Property op value" term of a $filter into filter
+ */
+inline bool parseTerm(boost::string_view term, bool withMessageId,
+                      JournalFilter& filter, std::vector<std::string>& seen)
+{
+    size_t space = term.find(' ');
+    if (space == boost::string_view::npos)
+    {
+        return false;
+    }
+    std::string property = term.substr(0, space).to_string();
+    term.remove_prefix(space + 1);
+    space = term.find(' ');
+    if (space == boost::string_view::npos)
+    {
+        return false;
+    }
+    boost::string_view op = term.substr(0, space);
+    boost::string_view value = term.substr(space + 1);
+
+    if (property == "Created")
+    {
+        uint64_t usec = 0;
+        if (!parseTimestamp(value, usec))
+        {
+            return false;
+        }
+        // Created only has whole seconds, so a bound takes in, or leaves out,
+        // the whole second it names
+        constexpr uint64_t second = 1000 * 1000;
+        if (op == "ge")
+        {
+            filter.since = std::max(filter.since, usec);
+        }
+        else if (op == "gt")
+        {
+            filter.since = std::max(filter.since, usec + second);
+        }
+        else if (op == "le")
+        {
+            filter.until = std::min(filter.until, usec + second - 1);
+        }
+        else if (op == "lt")
+        {
+            if (usec == 0)
+            {
+                return false;
+            }
+            filter.until = std::min(filter.until, usec - 1);
+        }
+        else
+        {
+            return false;
+        }
+        return true;
+    }
+
+    if (op != "eq" || value.size() < 2 || value.front() != '\'' ||
+        value.back() != '\'')
+    {
+        return false;
+    }
+    value.remove_prefix(1);
+    value.remove_suffix(1);
+    // The journal would OR a second match on the same field, not AND it
+    for (const std::string& previous : seen)
+    {
+        if (previous == property)
+        {
+            return false;
+        }
+    }
+    seen.push_back(property);
+
+    if (property == "Severity")
+    {
+        // The same mapping from PRIORITY the entries are shown with
+        const char* priorities = nullptr;
+        if (value == "Critical")
+        {
+            priorities = "012";
+        }
+        else if (value == "Warning")
+        {
+            priorities = "34";
+        }
+        else if (value == "OK")
+        {
+            priorities = "567";
+        }
+        else
+        {
+            return false;
+        }
+        for (const char* p = priorities; *p != '\0'; p++)
+        {
+            filter.matches.push_back(std::string("PRIORITY=") + *p);
+        }
+        return true;
+    }
+    if (property == "MessageId" && withMessageId && !value.empty())
+    {
+        filter.matches.push_back("REDFISH_MESSAGE_ID=" + value.to_string());
+        return true;
+    }
+    return false;
+}
+
+} // namespace journal_filter
+
+/**
+ * @brief Parses a log entry collection's $filter
+ *
+ * Supports terms on Severity (eq), Created (ge, gt, le, lt) and, when
+ * withMessageId is set, MessageId (eq), joined by "and", for example
+ * "Severity eq 'Critical' and Created ge 2019-05-01T00:00:00+00:00".
+ *
+ * @param[in]  text           Value of the $filter query parameter
+ * @param[in]  withMessageId  Whether the entries have a MessageId
+ * @param[out] filter         The journal matches and time range
+ *
+ * @return false if the filter isn't one that's supported
+ */
+inline bool parseJournalFilter(boost::string_view text, bool withMessageId,
+                               JournalFilter& filter)
+{
+    std::vector<std::string> seen;
+    constexpr boost::string_view conjunction = " and ";
+    while (true)
+    {
+        // Quoted values may themselves hold " and "
+        size_t end = boost::string_view::npos;
+        bool quoted = false;
+        for (size_t i = 0; i < text.size(); i++)
+        {
+            if (text[i] == '\'')
+            {
+                quoted = !quoted;
+            }
+            else if (!quoted && text.substr(i).starts_with(conjunction))
+            {
+                end = i;
+                break;
+            }
+        }
+        if (!journal_filter::parseTerm(text.substr(0, end), withMessageId,
+                                       filter, seen))
+        {
+            return false;
+        }
+        if (end == boost::string_view::npos)
+        {
+            break;
+        }
+        text.remove_prefix(end + conjunction.size());
+    }
+    return filter.since <= filter.until;
+}
+
+} // namespace redfish
@@ -0,0 +1,389 @@
+/*
+// Copyright (c) 2018 Intel Corporation
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+*/
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <cstring>
+#include <deque>
+#include <vector>
+
+namespace redfish
+{
+
+namespace time_series
+{
+
+/**
+ * @brief Samples compressed into a fixed number of bytes, as Facebook's
+ *        Gorilla does: each timestamp as the change in the time between
+ *        samples and each value XORed with the one before
+ */
+class CompressedBlock
+{
+  public:
+    // The most bits one sample can take
+    static constexpr size_t maxSampleBits = (4 + 64) + (2 + 5 + 6 + 64);
+
+    explicit CompressedBlock(size_t bytes) : data(bytes)
+    {
+    }
+
+    // Adds a sample later than the last.  False once the block is full.
+    bool append(uint32_t timestamp, double value)
+    {
+        if (bits + maxSampleBits > data.size() * 8)
+        {
+            return false;
+        }
+        uint64_t valueBits = 0;
+        std::memcpy(&valueBits, &value, sizeof(valueBits));
+        if (count == 0)
+        {
+            write(timestamp, 32);
+            write(valueBits, 64);
+            first = timestamp;
+        }
+        else
+        {
+            int64_t delta = static_cast<int64_t>(timestamp) - last;
+            writeTimestamp(delta - lastDelta);
+            lastDelta = delta;
+            writeValue(valueBits ^ lastValue);
+        }
+        last = timestamp;
+        lastValue = valueBits;
+        count++;
+        return true;
+    }
+
+    // Calls callback(timestamp, value) for each sample, oldest first
+    template <typename Callback> void forEach(Callback&& callback) const
+    {
+        Reader reader{data};
+        uint32_t timestamp = 0;
+        int64_t delta = 0;
+        uint64_t valueBits = 0;
+        uint8_t leading = 0;
+        uint8_t meaningful = 0;
+        for (size_t i = 0; i < count; i++)
+        {
+            if (i == 0)
+            {
+                timestamp = static_cast<uint32_t>(reader.read(32));
+                valueBits = reader.read(64);
+            }
+            else
+            {
+                delta += reader.readTimestamp();
+                timestamp = static_cast<uint32_t>(timestamp + delta);
+                valueBits ^= reader.readValue(leading, meaningful);
+            }
+            double value = 0;
+            std::memcpy(&value, &valueBits, sizeof(value));
+            callback(timestamp, value);
+        }
+    }
+
+    size_t size() const
+    {
+        return count;
+    }
+
+    uint32_t firstTimestamp() const
+    {
+        return first;
+    }
+
+    uint32_t lastTimestamp() const
+    {
+        return last;
+    }
+
+    size_t capacity() const
+    {
+        return data.size();
+    }
+
+  private:
+    struct Reader
+    {
+        const std::vector<uint8_t>& data;
+        size_t bit = 0;
+
+        uint64_t read(size_t n)
+        {
+            uint64_t value = 0;
+            while (n > 0)
+            {
+                size_t free = 8 - bit % 8;
+                size_t take = std::min(free, n);
+                uint64_t chunk = (data[bit / 8] >> (free - take)) &
+                                 ((1u << take) - 1);
+                value = (value << take) | chunk;
+                bit += take;
+                n -= take;
+            }
+            return value;
+        }
+
+        int64_t readTimestamp()
+        {
+            if (read(1) == 0)
+            {
+                return 0;
+            }
+            if (read(1) == 0)
+            {
+                return static_cast<int64_t>(read(7)) - 63;
+            }
+            if (read(1) == 0)
+            {
+                return static_cast<int64_t>(read(9)) - 255;
+            }
+            if (read(1) == 0)
+            {
+                return static_cast<int64_t>(read(12)) - 2047;
+            }
+            return static_cast<int64_t>(read(64));
+        }
+
+        uint64_t readValue(uint8_t& leading, uint8_t& meaningful)
+        {
+            if (read(1) == 0)
+            {
+                return 0;
+            }
+            if (read(1) == 1)
+            {
+                leading = static_cast<uint8_t>(read(5));
+                meaningful = static_cast<uint8_t>(read(6) + 1);
+            }
+            return read(meaningful) << (64 - leading - meaningful);
+        }
+    };
+
+    // Writes the low n bits of value, a byte at a time where it can
+    void write(uint64_t value, size_t n)
+    {
+        while (n > 0)
+        {
+            size_t free = 8 - bits % 8;
+            size_t take = std::min(free, n);
+            uint64_t chunk = (value >> (n - take)) & ((1u << take) - 1);
+            data[bits / 8] |= static_cast<uint8_t>(chunk << (free - take));
+            bits += take;
+            n -= take;
+        }
+    }
+
+    // Regular samples take a single bit, and jitter of up to a minute or so
+    // one or two bytes
+    void writeTimestamp(int64_t deltaOfDelta)
+    {
+        if (deltaOfDelta == 0)
+        {
+            write(0, 1);
+        }
+        else if (deltaOfDelta >= -63 && deltaOfDelta <= 64)
+        {
+            write(0b10, 2);
+            write(static_cast<uint64_t>(deltaOfDelta + 63), 7);
+        }
+        else if (deltaOfDelta >= -255 && deltaOfDelta <= 256)
+        {
+            write(0b110, 3);
+            write(static_cast<uint64_t>(deltaOfDelta + 255), 9);
+        }
+        else if (deltaOfDelta >= -2047 && deltaOfDelta <= 2048)
+        {
+            write(0b1110, 4);
+            write(static_cast<uint64_t>(deltaOfDelta + 2047), 12);
+        }
+        else
+        {
+            write(0b1111, 4);
+            write(static_cast<uint64_t>(deltaOfDelta), 64);
+        }
+    }
+
+    // An unchanged value takes a single bit, and one whose changed bits fit
+    // within those of the last change only those bits and two more
+    void writeValue(uint64_t xorValue)
+    {
+        if (xorValue == 0)
+        {
+            write(0, 1);
+            return;
+        }
+        uint8_t leading =
+            static_cast<uint8_t>(std::min(__builtin_clzll(xorValue), 31));
+        uint8_t trailing = static_cast<uint8_t>(__builtin_ctzll(xorValue));
+        if (meaningful != 0 && leading >= lastLeading &&
+            64 - trailing <= lastLeading + meaningful)
+        {
+            write(0b10, 2);
+            write(xorValue >> (64 - lastLeading - meaningful), meaningful);
+            return;
+        }
+        lastLeading = leading;
+        meaningful = static_cast<uint8_t>(64 - leading - trailing);
+        write(0b11, 2);
+        write(leading, 5);
+        write(meaningful - 1u, 6);
+        write(xorValue >> trailing, meaningful);
+    }
+
+    std::vector<uint8_t> data;
+    size_t bits = 0;
+    size_t count = 0;
+    uint32_t first = 0;
+    uint32_t last = 0;
+    int64_t lastDelta = 0;
+    uint64_t lastValue = 0;
+    // The window of bits that changed in the last value written in full
+    uint8_t lastLeading = 0;
+    uint8_t meaningful = 0;
+};
+
+} // namespace time_series
+
+/**
+ * @brief A history of readings in a fixed amount of memory
+ *
+ * Readings are kept at full resolution in the first tier.  As that fills,
+ * its oldest block is averaged into one minute points in the next tier,
+ * and so on into fifteen minute points, whose oldest are dropped.
+ */
+class TimeSeries
+{
+  public:
+    static constexpr size_t blockBytes = 512;
+    static constexpr size_t blocksPerTier = 4;
+    // Seconds between the points of each tier
+    static constexpr std::array<uint32_t, 3> resolutions = {1, 60, 900};
+
+    // Adds a reading, unless it's no later than the last one
+    void append(uint32_t timestamp, double value)
+    {
+        if (!empty && timestamp <= lastTimestamp)
+        {
+            return;
+        }
+        empty = false;
+        lastTimestamp = timestamp;
+        appendToTier(0, timestamp, value);
+    }
+
+    // Calls callback(timestamp, value) for each point from from to to,
+    // oldest first, at the finest resolution still kept for each time
+    template <typename Callback>
+    void query(uint32_t from, uint32_t to, Callback&& callback) const
+    {
+        auto emit = [from, to, &callback](uint32_t timestamp, double value) {
+            if (timestamp >= from && timestamp <= to)
+            {
+                callback(timestamp, value);
+            }
+        };
+        for (size_t i = tiers.size(); i > 0; i--)
+        {
+            const Tier& tier = tiers[i - 1];
+            for (const time_series::CompressedBlock& block : tier.blocks)
+            {
+                if (block.size() != 0 && block.lastTimestamp() >= from &&
+                    block.firstTimestamp() <= to)
+                {
+                    block.forEach(emit);
+                }
+            }
+            // Readings on their way into this tier are newer than its points
+            if (tier.pendingCount != 0)
+            {
+                emit(tier.pendingStart, tier.pendingSum / tier.pendingCount);
+            }
+        }
+    }
+
+    // Bytes taken, which never grows past that of every block in use
+    size_t memoryUsage() const
+    {
+        size_t bytes = sizeof(*this);
+        for (const Tier& tier : tiers)
+        {
+            bytes += tier.blocks.size() *
+                     (sizeof(time_series::CompressedBlock) + blockBytes);
+        }
+        return bytes;
+    }
+
+  private:
+    struct Tier
+    {
+        std::deque<time_series::CompressedBlock> blocks;
+        // Readings from the tier before, being averaged into the next point
+        uint32_t pendingStart = 0;
+        double pendingSum = 0;
+        size_t pendingCount = 0;
+    };
+
+    void appendToTier(size_t index, uint32_t timestamp, double value)
+    {
+        Tier& tier = tiers[index];
+        if (!tier.blocks.empty() && tier.blocks.back().append(timestamp, value))
+        {
+            return;
+        }
+        if (tier.blocks.size() == blocksPerTier)
+        {
+            if (index + 1 < tiers.size())
+            {
+                downsample(index + 1, tier.blocks.front());
+            }
+            tier.blocks.pop_front();
+        }
+        tier.blocks.emplace_back(blockBytes);
+        tier.blocks.back().append(timestamp, value);
+    }
+
+    // Averages the readings of a block leaving the tier before into points
+    void downsample(size_t index, const time_series::CompressedBlock& block)
+    {
+        uint32_t resolution = resolutions[index];
+        block.forEach([this, index, resolution](uint32_t timestamp,
+                                                double value) {
+            Tier& tier = tiers[index];
+            uint32_t start = timestamp - timestamp % resolution;
+            if (tier.pendingCount != 0 && start != tier.pendingStart)
+            {
+                double average = tier.pendingSum / tier.pendingCount;
+                tier.pendingCount = 0;
+                tier.pendingSum = 0;
+                appendToTier(index, tier.pendingStart, average);
+            }
+            tiers[index].pendingStart = start;
+            tiers[index].pendingSum += value;
+            tiers[index].pendingCount++;
+        });
+    }
+
+    std::array<Tier, resolutions.size()> tiers;
+    uint32_t lastTimestamp = 0;
+    bool empty = true;
+};
+
+} // namespace redfish
@@ -0,0 +1,831 @@
+/*
+// Copyright (c) 2018 Intel Corporation
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+*/
+#pragma once
+
+#include "event_service_manager.hpp"
+#include "log_services.hpp"
+#include "node.hpp"
+#include "telemetry_service_manager.hpp"
+
+#include <boost/asio/posix/stream_descriptor.hpp>
+#include <sdbusplus/bus/match.hpp>
+#include <utils/json_utils.hpp>
+#include <variant>
+
+namespace redfish
+{
+
+// Bytes of events waiting for an SSE client beyond which new ones are
+// dropped for it
+constexpr size_t maxSseBacklog = 64 * 1024;
+
+// How often an idle SSE stream gets a comment, so a client that's gone is
+// noticed and its subscription removed
+constexpr std::chrono::seconds sseHeartbeatInterval(30);
+
+/**
+ * @brief A client holding an EventService SSE stream open
+ */
+class SseSubscription : public Subscription,
+                        public std::enable_shared_from_this<SseSubscription>
+{
+  public:
+    SseSubscription(boost::asio::io_context &io, const std::string &id,
+                    EventFilter &&filter,
+                    const std::shared_ptr<AsyncResp> &asyncResp) :
+        Subscription(id, std::move(filter), std::string()),
+        asyncResp(asyncResp), heartbeatTimer(io)
+    {
+    }
+
+    void start()
+    {
+        asyncResp->res.addHeader("Content-Type", "text/event-stream");
+        asyncResp->res.addHeader("Cache-Control", "no-cache");
+        asyncResp->res.startStreaming();
+        heartbeat();
+    }
+
+    void sendEvent(std::string &&payload, uint64_t eventId) override
+    {
+        crow::Response &res = asyncResp->res;
+        if (!res.isAlive())
+        {
+            return;
+        }
+        if (res.streamBacklog() > maxSseBacklog)
+        {
+            droppedEvents++;
+            return;
+        }
+        // The id is what a client reconnecting passes back as Last-Event-ID
+        res.writeChunk("id: " + std::to_string(eventId) + "\ndata: " +
+                       payload + "\n\n");
+    }
+
+    bool isAlive() override
+    {
+        return asyncResp->res.isAlive();
+    }
+
+    bool isSse() const override
+    {
+        return true;
+    }
+
+    void fillJson(nlohmann::json &json) const override
+    {
+        json["SubscriptionType"] = "SSE";
+    }
+
+  private:
+    void heartbeat()
+    {
+        heartbeatTimer.expires_after(sseHeartbeatInterval);
+        heartbeatTimer.async_wait([weak(weak_from_this())](
+                                      const boost::system::error_code &ec) {
+            std::shared_ptr<SseSubscription> self = weak.lock();
+            if (ec || self == nullptr || !self->isAlive())
+            {
+                return;
+            }
+            self->asyncResp->res.writeChunk(":\n\n");
+            self->heartbeat();
+        });
+    }
+
+    // Held until the subscription goes, which ends the response
+    std::shared_ptr<AsyncResp> asyncResp;
+    boost::asio::steady_timer heartbeatTimer;
+};
+
+/**
+ * @brief Turns what happens on the BMC into events: entries added to the
+ *        event log, host power changes and sensor threshold crossings
+ */
+class EventSources
+{
+  public:
+    explicit EventSources(boost::asio::io_context &io) :
+        io(io), journalWatch(io)
+    {
+        watchJournal();
+        watchHostState();
+        watchThresholds();
+        watchInventory();
+    }
+
+    ~EventSources()
+    {
+        // The descriptor belongs to the journal
+        journalWatch.release();
+        if (journal != nullptr)
+        {
+            sd_journal_close(journal);
+        }
+    }
+
+    EventSources(const EventSources &) = delete;
+    EventSources &operator=(const EventSources &) = delete;
+
+  private:
+    static std::string getCurrentTimestamp()
+    {
+        return getTimestampStr(std::time(nullptr));
+    }
+
+    void watchJournal()
+    {
+        int ret = sd_journal_open(&journal, SD_JOURNAL_LOCAL_ONLY);
+        if (ret < 0)
+        {
+            BMCWEB_LOG_ERROR << "failed to open journal: " << strerror(-ret);
+            journal = nullptr;
+            return;
+        }
+        // Only entries added from now on are events
+        sd_journal_seek_tail(journal);
+        sd_journal_previous(journal);
+        int fd = sd_journal_get_fd(journal);
+        if (fd < 0)
+        {
+            BMCWEB_LOG_ERROR << "failed to watch journal: " << strerror(-fd);
+            return;
+        }
+        journalWatch.assign(fd);
+        waitForJournal();
+    }
+
+    void waitForJournal()
+    {
+        journalWatch.async_wait(
+            boost::asio::posix::stream_descriptor::wait_read,
+            [this](const boost::system::error_code &ec) {
+                if (ec)
+                {
+                    BMCWEB_LOG_ERROR << "Journal watch failed: " << ec;
+                    return;
+                }
+                if (sd_journal_process(journal) != SD_JOURNAL_NOP)
+                {
+                    readJournal();
+                }
+                waitForJournal();
+            });
+    }
+
+    // Sends an event for each event log entry added since the last read
+    void readJournal()
+    {
+        // Entry IDs are numbered through the event log's index
+        JournalIndex &index = getEventLogIndex();
+        if (!index.refresh(io))
+        {
+            return;
+        }
+        while (sd_journal_next(journal) > 0)
+        {
+            boost::string_view messageID;
+            if (getJournalMetadata(journal, "REDFISH_MESSAGE_ID", messageID) <
+                0)
+            {
+                continue;
+            }
+            uint64_t realtime = 0;
+            uint16_t entryIndex = 0;
+            if (sd_journal_get_realtime_usec(journal, &realtime) < 0 ||
+                !index.findEntryIndex(journal, realtime, entryIndex))
+            {
+                continue;
+            }
+            nlohmann::json entry;
+            if (fillEventLogEntryJson(
+                    JournalIndex::formatEntryID(realtime, entryIndex),
+                    messageID, journal, entry) != 0)
+            {
+                continue;
+            }
+
+            Event event;
+            event.messageId = messageID.to_string();
+            event.message = entry["Message"].get<std::string>();
+            event.messageArgs =
+                entry["MessageArgs"].get<std::vector<std::string>>();
+            event.severity = entry["Severity"].get<std::string>();
+            event.timestamp = entry["Created"].get<std::string>();
+            boost::string_view origin;
+            if (getJournalMetadata(journal, "REDFISH_ORIGIN_OF_CONDITION",
+                                   origin) >= 0)
+            {
+                event.originOfCondition = origin.to_string();
+            }
+            else
+            {
+                event.originOfCondition = entry["@odata.id"];
+            }
+            EventServiceManager::getInstance().sendEvent(event);
+        }
+    }
+
+    void watchHostState()
+    {
+        hostStateMatch = std::make_unique<sdbusplus::bus::match::match>(
+            *crow::connections::systemBus,
+            "type='signal',interface='org.freedesktop.DBus.Properties',"
+            "member='PropertiesChanged',"
+            "path='/xyz/openbmc_project/state/host0',"
+            "arg0='xyz.openbmc_project.State.Host'",
+            [](sdbusplus::message::message &m) {
+                std::string interface;
+                boost::container::flat_map<
+                    std::string, dbus::utility::DbusVariantType>
+                    values;
+                m.read(interface, values);
+                auto it = values.find("CurrentHostState");
+                if (it == values.end())
+                {
+                    return;
+                }
+                const std::string *state =
+                    std::get_if<std::string>(&it->second);
+                if (state == nullptr)
+                {
+                    return;
+                }
+                Event event;
+                event.originOfCondition = "/redfish/v1/Systems/system";
+                event.timestamp = getCurrentTimestamp();
+                if (*state ==
+                    "xyz.openbmc_project.State.Host.HostState.Running")
+                {
+                    event.messageId = "OpenBMC.0.1.DCPowerOn";
+                    event.message = "Host system DC power is on.";
+                }
+                else if (*state ==
+                         "xyz.openbmc_project.State.Host.HostState.Off")
+                {
+                    event.messageId = "OpenBMC.0.1.DCPowerOff";
+                    event.message = "Host system DC power is off.";
+                }
+                else
+                {
+                    return;
+                }
+                EventServiceManager::getInstance().sendEvent(event);
+            });
+    }
+
+    void watchThresholds()
+    {
+        thresholdMatch = std::make_unique<sdbusplus::bus::match::match>(
+            *crow::connections::systemBus,
+            "type='signal',interface='org.freedesktop.DBus.Properties',"
+            "member='PropertiesChanged',"
+            "path_namespace='/xyz/openbmc_project/sensors',"
+            "arg0namespace='xyz.openbmc_project.Sensor.Threshold'",
+            [this](sdbusplus::message::message &m) {
+                std::string interface;
+                boost::container::flat_map<
+                    std::string, dbus::utility::DbusVariantType>
+                    values;
+                m.read(interface, values);
+                // Sensors are at /xyz/openbmc_project/sensors/<type>/<name>
+                std::string path = m.get_path();
+                size_t nameStart = path.rfind('/');
+                size_t typeStart = path.rfind('/', nameStart - 1);
+                if (nameStart == std::string::npos || nameStart == 0 ||
+                    typeStart == std::string::npos)
+                {
+                    return;
+                }
+                std::string sensor = path.substr(nameStart + 1);
+                std::string type =
+                    path.substr(typeStart + 1, nameStart - typeStart - 1);
+
+                for (const auto &[property, value] : values)
+                {
+                    const bool *alarm = std::get_if<bool>(&value);
+                    if (alarm == nullptr)
+                    {
+                        continue;
+                    }
+                    // The alarm properties are named <Level>Alarm<Direction>
+                    size_t split = property.find("Alarm");
+                    if (split == std::string::npos)
+                    {
+                        continue;
+                    }
+                    std::string level = property.substr(0, split);
+                    std::string direction = property.substr(split + 5);
+                    if ((level != "Warning" && level != "Critical") ||
+                        (direction != "High" && direction != "Low"))
+                    {
+                        continue;
+                    }
+                    // Crossing a high threshold is going high, and clearing
+                    // it going low, and the other way around for low ones
+                    bool goingHigh = *alarm == (direction == "High");
+
+                    Event event;
+                    event.messageId = "OpenBMC.0.1.SensorThreshold" + level +
+                                      direction + "Going" +
+                                      (goingHigh ? "High" : "Low");
+                    event.message = sensor + " sensor crossed a " +
+                                    (level == "Warning" ? "warning"
+                                                        : "critical") +
+                                    (direction == "High" ? " high" : " low") +
+                                    " threshold going " +
+                                    (goingHigh ? "high." : "low.");
+                    event.messageArgs = {sensor};
+                    if (*alarm)
+                    {
+                        event.severity = level;
+                    }
+                    event.timestamp = getCurrentTimestamp();
+                    sendSensorEvent(std::move(event), type, sensor);
+                }
+            });
+    }
+
+    // The Thermal or Power member a sensor is shown as, as in
+    // /redfish/v1/Chassis/chassis/Thermal#/Temperatures/CPU_Temp, or the
+    // chassis if its type is shown in neither
+    static std::string getSensorOrigin(const std::string &chassis,
+                                       const std::string &type,
+                                       const std::string &sensor)
+    {
+        std::string origin = "/redfish/v1/Chassis/" + chassis;
+        for (const telemetry::SensorArray &array :
+             telemetry::getSensorArrays())
+        {
+            for (const char *arrayType : array.types)
+            {
+                if (type == arrayType)
+                {
+                    return origin + "/" + array.resource + "#/" +
+                           array.array + "/" + sensor;
+                }
+            }
+        }
+        return origin;
+    }
+
+    struct SensorEvent
+    {
+        Event event;
+        std::string type;
+        std::string sensor;
+    };
+
+    // Forgets the chassis of the sensors whenever EntityManager's inventory
+    // changes, so they're read again for the next sensor event
+    void watchInventory()
+    {
+        auto forget = [this](sdbusplus::message::message &) {
+            sensorChassis.clear();
+            sensorChassisKnown = false;
+            inventoryChanges++;
+        };
+        interfacesAddedMatch = std::make_unique<sdbusplus::bus::match::match>(
+            *crow::connections::systemBus,
+            "type='signal',sender='xyz.openbmc_project.EntityManager',"
+            "interface='org.freedesktop.DBus.ObjectManager',"
+            "member='InterfacesAdded'",
+            forget);
+        interfacesRemovedMatch =
+            std::make_unique<sdbusplus::bus::match::match>(
+                *crow::connections::systemBus,
+                "type='signal',sender='xyz.openbmc_project.EntityManager',"
+                "interface='org.freedesktop.DBus.ObjectManager',"
+                "member='InterfacesRemoved'",
+                forget);
+    }
+
+    // Sends a sensor's event with the sensor as its origin, which needs the
+    // chassis it's in.  Those are read from EntityManager, as the Chassis
+    // sensor collections do, and kept until its inventory changes.  A sensor
+    // it doesn't know, as hwmon and virtual ones aren't, has the Chassis
+    // collection as its origin.
+    void sendSensorEvent(Event &&event, const std::string &type,
+                         const std::string &sensor)
+    {
+        auto chassis = sensorChassis.find(sensor);
+        if (chassis != sensorChassis.end())
+        {
+            event.originOfCondition =
+                getSensorOrigin(chassis->second, type, sensor);
+            EventServiceManager::getInstance().sendEvent(event);
+            return;
+        }
+        if (sensorChassisKnown)
+        {
+            event.originOfCondition = "/redfish/v1/Chassis";
+            EventServiceManager::getInstance().sendEvent(event);
+            return;
+        }
+        waitingEvents.push_back({std::move(event), type, sensor});
+        if (waitingEvents.size() > 1)
+        {
+            // Already being looked up
+            return;
+        }
+        crow::connections::systemBus->async_method_call(
+            [this, changes(inventoryChanges)](
+                const boost::system::error_code ec,
+                const dbus::utility::ManagedObjectType &objects) {
+                if (ec)
+                {
+                    BMCWEB_LOG_ERROR << "Couldn't find sensors' chassis: "
+                                     << ec;
+                }
+                else
+                {
+                    sensorChassis.clear();
+                    // What was read is out of date if the inventory changed
+                    // meanwhile, so is only kept for the events waiting on it
+                    sensorChassisKnown = changes == inventoryChanges;
+                    // Sensors are at .../<chassis>/<sensor> in the inventory
+                    for (const auto &object : objects)
+                    {
+                        const std::string &path =
+                            static_cast<const std::string &>(object.first);
+                        size_t sensorStart = path.rfind('/');
+                        if (sensorStart == std::string::npos ||
+                            sensorStart == 0)
+                        {
+                            continue;
+                        }
+                        size_t chassisStart = path.rfind('/', sensorStart - 1);
+                        if (chassisStart == std::string::npos)
+                        {
+                            continue;
+                        }
+                        sensorChassis[path.substr(sensorStart + 1)] =
+                            path.substr(chassisStart + 1,
+                                        sensorStart - chassisStart - 1);
+                    }
+                }
+
+                std::vector<SensorEvent> events;
+                events.swap(waitingEvents);
+                for (SensorEvent &waiting : events)
+                {
+                    auto chassis = sensorChassis.find(waiting.sensor);
+                    // Still worth sending without a chassis to name
+                    waiting.event.originOfCondition =
+                        chassis == sensorChassis.end()
+                            ? "/redfish/v1/Chassis"
+                            : getSensorOrigin(chassis->second, waiting.type,
+                                              waiting.sensor);
+                    EventServiceManager::getInstance().sendEvent(
+                        waiting.event);
+                }
+                if (!sensorChassisKnown)
+                {
+                    sensorChassis.clear();
+                }
+            },
+            "xyz.openbmc_project.EntityManager", "/",
+            "org.freedesktop.DBus.ObjectManager", "GetManagedObjects");
+    }
+
+    boost::asio::io_context &io;
+    sd_journal *journal = nullptr;
+    boost::asio::posix::stream_descriptor journalWatch;
+    std::unique_ptr<sdbusplus::bus::match::match> hostStateMatch;
+    std::unique_ptr<sdbusplus::bus::match::match> thresholdMatch;
+    std::unique_ptr<sdbusplus::bus::match::match> interfacesAddedMatch;
+    std::unique_ptr<sdbusplus::bus::match::match> interfacesRemovedMatch;
+    // The chassis each sensor is in, by sensor name
+    boost::container::flat_map<std::string, std::string> sensorChassis;
+    // Set once sensorChassis holds every sensor EntityManager has, so one
+    // that isn't in it needn't be looked up
+    bool sensorChassisKnown = false;
+    uint64_t inventoryChanges = 0;
+    std::vector<SensorEvent> waitingEvents;
+};
+
+class EventService : public Node
+{
+  public:
+    EventService(CrowApp &app) : Node(app, "/redfish/v1/EventService/")
+    {
+        entityPrivileges = {
+            {boost::beast::http::verb::get, {{"Login"}}},
+            {boost::beast::http::verb::head, {{"Login"}}},
+            {boost::beast::http::verb::patch, {{"ConfigureManager"}}},
+            {boost::beast::http::verb::put, {{"ConfigureManager"}}},
+            {boost::beast::http::verb::delete_, {{"ConfigureManager"}}},
+            {boost::beast::http::verb::post, {{"ConfigureManager"}}}};
+
+        static std::unique_ptr<EventSources> sources;
+        if (sources == nullptr)
+        {
+            sources = std::make_unique<EventSources>(*app.getIoContext());
+        }
+    }
+
+  private:
+    void doGet(crow::Response &res, const crow::Request &req,
+               const std::vector<std::string> &params) override
+    {
+        RetryPolicy policy;
+        res.jsonValue = {
+            {"@odata.type", "#EventService.v1_3_0.EventService"},
+            {"@odata.context",
+             "/redfish/v1/$metadata#EventService.EventService"},
+            {"@odata.id", "/redfish/v1/EventService"},
+            {"Id", "EventService"},
+            {"Name", "Event Service"},
+            {"ServiceEnabled", true},
+            {"DeliveryRetryAttempts", policy.attempts},
+            {"DeliveryRetryIntervalSeconds",
+             std::chrono::duration_cast<std::chrono::seconds>(
+                 policy.initialDelay)
+                 .count()},
+            {"EventFormatTypes", {"Event", "MetricReport"}},
+            {"RegistryPrefixes", {"OpenBMC"}},
+            {"ServerSentEventUri", "/redfish/v1/EventService/SSE"},
+            {"SSEFilterPropertiesSupported",
+             {{"EventFormatType", true},
+              {"RegistryPrefix", true},
+              {"OriginResource", true}}},
+            {"Subscriptions",
+             {{"@odata.id", "/redfish/v1/EventService/Subscriptions"}}}};
+        res.end();
+    }
+};
+
+class EventServiceSse : public Node
+{
+  public:
+    EventServiceSse(CrowApp &app) :
+        Node(app, "/redfish/v1/EventService/SSE/"), io(*app.getIoContext())
+    {
+        entityPrivileges = {
+            {boost::beast::http::verb::get, {{"Login"}}},
+            {boost::beast::http::verb::head, {{"Login"}}},
+            {boost::beast::http::verb::patch, {{"ConfigureManager"}}},
+            {boost::beast::http::verb::put, {{"ConfigureManager"}}},
+            {boost::beast::http::verb::delete_, {{"ConfigureManager"}}},
+            {boost::beast::http::verb::post, {{"ConfigureManager"}}}};
+    }
+
+  private:
+    void doGet(crow::Response &res, const crow::Request &req,
+               const std::vector<std::string> &params) override
+    {
+        std::shared_ptr<AsyncResp> asyncResp = std::make_shared<AsyncResp>(res);
+        EventFilter filter;
+        char *filterParam = req.urlParams.get("$filter");
+        if (filterParam != nullptr && !parseSseFilter(filterParam, filter))
+        {
+            messages::queryParameterValueFormatError(asyncResp->res,
+                                                     filterParam, "$filter");
+            return;
+        }
+
+        EventServiceManager &manager = EventServiceManager::getInstance();
+        auto subscription = std::make_shared<SseSubscription>(
+            io, manager.getNewId(), std::move(filter), asyncResp);
+        if (!manager.addSubscription(subscription, asyncResp->res))
+        {
+            return;
+        }
+        subscription->start();
+    }
+
+    boost::asio::io_context &io;
+};
+
+static void fillEventDestinationJson(const Subscription &subscription,
+                                     nlohmann::json &json)
+{
+    json = {
+        {"@odata.type", "#EventDestination.v1_5_0.EventDestination"},
+        {"@odata.context",
+         "/redfish/v1/$metadata#EventDestination.EventDestination"},
+        {"@odata.id",
+         "/redfish/v1/EventService/Subscriptions/" + subscription.id},
+        {"Id", subscription.id},
+        {"Name", "Event Destination " + subscription.id},
+        {"Context", subscription.context},
+        {"Protocol", "Redfish"},
+        {"EventFormatType", subscription.filter.eventFormatType},
+        {"RegistryPrefixes", subscription.filter.registryPrefixes},
+        {"Oem",
+         {{"OpenBmc", {{"DroppedEvents", subscription.droppedEvents}}}}}};
+    nlohmann::json &origins = json["OriginResources"];
+    origins = nlohmann::json::array();
+    for (const std::string &origin : subscription.filter.originResources)
+    {
+        origins.push_back({{"@odata.id", origin}});
+    }
+    subscription.fillJson(json);
+}
+
+class EventDestinationCollection : public Node
+{
+  public:
+    EventDestinationCollection(CrowApp &app) :
+        Node(app, "/redfish/v1/EventService/Subscriptions/"),
+        io(*app.getIoContext())
+    {
+        entityPrivileges = {
+            {boost::beast::http::verb::get, {{"Login"}}},
+            {boost::beast::http::verb::head, {{"Login"}}},
+            {boost::beast::http::verb::patch, {{"ConfigureManager"}}},
+            {boost::beast::http::verb::put, {{"ConfigureManager"}}},
+            {boost::beast::http::verb::delete_, {{"ConfigureManager"}}},
+            {boost::beast::http::verb::post, {{"ConfigureManager"}}}};
+    }
+
+  private:
+    void doGet(crow::Response &res, const crow::Request &req,
+               const std::vector<std::string> &params) override
+    {
+        res.jsonValue = {
+            {"@odata.type",
+             "#EventDestinationCollection.EventDestinationCollection"},
+            {"@odata.context", "/redfish/v1/"
+                               "$metadata#EventDestinationCollection."
+                               "EventDestinationCollection"},
+            {"@odata.id", "/redfish/v1/EventService/Subscriptions"},
+            {"Name", "Event Destination Collection"}};
+        nlohmann::json &members = res.jsonValue["Members"];
+        members = nlohmann::json::array();
+        for (const auto &[id, subscription] :
+             EventServiceManager::getInstance().getSubscriptions())
+        {
+            members.push_back({{"@odata.id",
+                                "/redfish/v1/EventService/Subscriptions/" +
+                                    id}});
+        }
+        res.jsonValue["Members@odata.count"] = members.size();
+        res.end();
+    }
+
+    void doPost(crow::Response &res, const crow::Request &req,
+                const std::vector<std::string> &params) override
+    {
+        std::string destination;
+        std::string protocol;
+        std::optional<std::string> context;
+        std::optional<std::string> eventFormatType;
+        std::optional<std::vector<std::string>> registryPrefixes;
+        std::optional<std::vector<nlohmann::json>> originResources;
+        if (!json_util::readJson(req, res, "Destination", destination,
+                                 "Protocol", protocol, "Context", context,
+                                 "EventFormatType", eventFormatType,
+                                 "RegistryPrefixes", registryPrefixes,
+                                 "OriginResources", originResources))
+        {
+            res.end();
+            return;
+        }
+        if (protocol != "Redfish")
+        {
+            messages::propertyValueNotInList(res, protocol, "Protocol");
+            res.end();
+            return;
+        }
+        std::string host;
+        std::string port;
+        std::string target;
+        if (!parseDestination(destination, host, port, target))
+        {
+            messages::propertyValueFormatError(res, destination,
+                                               "Destination");
+            res.end();
+            return;
+        }
+
+        EventFilter filter;
+        if (eventFormatType)
+        {
+            if (*eventFormatType != "Event" &&
+                *eventFormatType != "MetricReport")
+            {
+                messages::propertyValueNotInList(res, *eventFormatType,
+                                                 "EventFormatType");
+                res.end();
+                return;
+            }
+            filter.eventFormatType = std::move(*eventFormatType);
+        }
+        if (registryPrefixes)
+        {
+            filter.registryPrefixes = std::move(*registryPrefixes);
+        }
+        if (originResources)
+        {
+            for (nlohmann::json &origin : *originResources)
+            {
+                const std::string *uri = nullptr;
+                auto it = origin.find("@odata.id");
+                if (it != origin.end())
+                {
+                    uri = it->get_ptr<const std::string *>();
+                }
+                if (uri == nullptr)
+                {
+                    messages::propertyValueFormatError(res, origin.dump(),
+                                                       "OriginResources");
+                    res.end();
+                    return;
+                }
+                filter.originResources.push_back(*uri);
+            }
+        }
+
+        EventServiceManager &manager = EventServiceManager::getInstance();
+        std::string id = manager.getNewId();
+        auto subscription = std::make_shared<PushSubscription>(
+            io, id, std::move(filter), context.value_or(""), destination, host,
+            port, target);
+        if (!manager.addSubscription(subscription, res))
+        {
+            res.end();
+            return;
+        }
+        messages::created(res);
+        res.addHeader("Location",
+                      "/redfish/v1/EventService/Subscriptions/" + id);
+        res.end();
+    }
+
+    boost::asio::io_context &io;
+};
+
+class EventDestination : public Node
+{
+  public:
+    EventDestination(CrowApp &app) :
+        Node(app, "/redfish/v1/EventService/Subscriptions/<str>/",
+             std::string())
+    {
+        entityPrivileges = {
+            {boost::beast::http::verb::get, {{"Login"}}},
+            {boost::beast::http::verb::head, {{"Login"}}},
+            {boost::beast::http::verb::patch, {{"ConfigureManager"}}},
+            {boost::beast::http::verb::put, {{"ConfigureManager"}}},
+            {boost::beast::http::verb::delete_, {{"ConfigureManager"}}},
+            {boost::beast::http::verb::post, {{"ConfigureManager"}}}};
+    }
+
+  private:
+    void doGet(crow::Response &res, const crow::Request &req,
+               const std::vector<std::string> &params) override
+    {
+        if (params.size() != 1)
+        {
+            messages::internalError(res);
+            res.end();
+            return;
+        }
+        std::shared_ptr<Subscription> subscription =
+            EventServiceManager::getInstance().getSubscription(params[0]);
+        if (subscription == nullptr)
+        {
+            messages::resourceNotFound(res, "EventDestination", params[0]);
+            res.end();
+            return;
+        }
+        fillEventDestinationJson(*subscription, res.jsonValue);
+        res.end();
+    }
+
+    void doDelete(crow::Response &res, const crow::Request &req,
+                  const std::vector<std::string> &params) override
+    {
+        if (params.size() != 1)
+        {
+            messages::internalError(res);
+            res.end();
+            return;
+        }
+        if (!EventServiceManager::getInstance().removeSubscription(params[0]))
+        {
+            messages::resourceNotFound(res, "EventDestination", params[0]);
+            res.end();
+            return;
+        }
+        messages::success(res);
+        res.end();
+    }
+};
+
+} // namespace redfish
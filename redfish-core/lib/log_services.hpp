@@ -15,13 +15,20 @@
 */
 #pragma once
 
+#include "byte_range.hpp"
+#include "console_capture.hpp"
 #include "filesystem.hpp"
+#include "http_utility.hpp"
 #include "node.hpp"
+#include "utils/journal_filter.hpp"
 
 #include <systemd/sd-journal.h>
 
+#include <boost/asio/posix/stream_descriptor.hpp>
+#include <boost/asio/post.hpp>
 #include <boost/container/flat_map.hpp>
 #include <boost/utility/string_view.hpp>
+#include <optional>
 #include <variant>
 
 namespace redfish
@@ -74,19 +81,8 @@ static int getJournalMetadata(sd_journal *journal,
     return ret;
 }
 
-static bool getEntryTimestamp(sd_journal *journal, std::string &entryTimestamp)
+static std::string getTimestampStr(time_t t)
 {
-    int ret = 0;
-    uint64_t timestamp = 0;
-    ret = sd_journal_get_realtime_usec(journal, &timestamp);
-    if (ret < 0)
-    {
-        BMCWEB_LOG_ERROR << "Failed to read entry timestamp: "
-                         << strerror(-ret);
-        return false;
-    }
-    time_t t =
-        static_cast<time_t>(timestamp / 1000 / 1000); // Convert from us to s
     struct tm *loctime = localtime(&t);
     char entryTime[64] = {};
     if (NULL != loctime)
@@ -101,7 +97,23 @@ static bool getEntryTimestamp(sd_journal *journal, std::string &entryTimestamp)
         t1.remove_suffix(2);
         t2.remove_prefix(t2.size() - 2);
     }
-    entryTimestamp = t1.to_string() + ":" + t2.to_string();
+    return t1.to_string() + ":" + t2.to_string();
+}
+
+static bool getEntryTimestamp(sd_journal *journal, std::string &entryTimestamp)
+{
+    int ret = 0;
+    uint64_t timestamp = 0;
+    ret = sd_journal_get_realtime_usec(journal, &timestamp);
+    if (ret < 0)
+    {
+        BMCWEB_LOG_ERROR << "Failed to read entry timestamp: "
+                         << strerror(-ret);
+        return false;
+    }
+    // Convert from us to s
+    entryTimestamp =
+        getTimestampStr(static_cast<time_t>(timestamp / 1000 / 1000));
     return true;
 }
 
@@ -158,41 +170,6 @@ static bool getTopParam(crow::Response &res, const crow::Request &req,
     return true;
 }
 
-static bool getUniqueEntryID(sd_journal *journal, std::string &entryID)
-{
-    int ret = 0;
-    static uint64_t prevTs = 0;
-    static int index = 0;
-    // Get the entry timestamp
-    uint64_t curTs = 0;
-    ret = sd_journal_get_realtime_usec(journal, &curTs);
-    if (ret < 0)
-    {
-        BMCWEB_LOG_ERROR << "Failed to read entry timestamp: "
-                         << strerror(-ret);
-        return false;
-    }
-    // If the timestamp isn't unique, increment the index
-    if (curTs == prevTs)
-    {
-        index++;
-    }
-    else
-    {
-        // Otherwise, reset it
-        index = 0;
-    }
-    // Save the timestamp
-    prevTs = curTs;
-
-    entryID = std::to_string(curTs);
-    if (index > 0)
-    {
-        entryID += "_" + std::to_string(index);
-    }
-    return true;
-}
-
 static bool getTimestampFromID(crow::Response &res, const std::string &entryID,
                                uint64_t &timestamp, uint16_t &index)
 {
@@ -255,60 +232,994 @@ static bool getTimestampFromID(crow::Response &res, const std::string &entryID,
     return true;
 }
 
-class SystemLogServiceCollection : public Node
+// The journal entries a log entry collection pages through, so that a page
+// seeks straight to its entries rather than walking the whole journal.  It's
+// built on first use and after that only extended with what journald has
+// appended, which sd_journal_process() learns of through inotify.  The
+// inotify fd is watched from the io_context, so that journal files journald
+// deletes are let go of straight away rather than kept mapped until the next
+// refresh.
+class JournalIndex
 {
   public:
-    template <typename CrowApp>
-    SystemLogServiceCollection(CrowApp &app) :
-        Node(app, "/redfish/v1/Systems/system/LogServices/")
+    // Indexes the entries that have field, or every entry if it's empty
+    explicit JournalIndex(std::string field) : field(std::move(field))
     {
-        entityPrivileges = {
-            {boost::beast::http::verb::get, {{"Login"}}},
-            {boost::beast::http::verb::head, {{"Login"}}},
-            {boost::beast::http::verb::patch, {{"ConfigureManager"}}},
-            {boost::beast::http::verb::put, {{"ConfigureManager"}}},
-            {boost::beast::http::verb::delete_, {{"ConfigureManager"}}},
-            {boost::beast::http::verb::post, {{"ConfigureManager"}}}};
+    }
+
+    ~JournalIndex()
+    {
+        close();
+    }
+
+    JournalIndex(const JournalIndex &) = delete;
+    JournalIndex &operator=(const JournalIndex &) = delete;
+
+    // Brings the index up to date with the journal
+    bool refresh(boost::asio::io_context &ioContext)
+    {
+        io = &ioContext;
+        if (tail == nullptr || !watched)
+        {
+            close();
+            if (!open())
+            {
+                return false;
+            }
+        }
+        else
+        {
+            int ret = sd_journal_process(tail);
+            if (ret < 0 || ret == SD_JOURNAL_INVALIDATE)
+            {
+                // Journal files were rotated or vacuumed, so indexed entries
+                // may be gone
+                close();
+                if (!open())
+                {
+                    return false;
+                }
+            }
+            else if (ret == SD_JOURNAL_NOP && !unread)
+            {
+                return true;
+            }
+        }
+
+        unread = false;
+        while (sd_journal_next(tail) > 0)
+        {
+            uint64_t realtime = 0;
+            if (sd_journal_get_realtime_usec(tail, &realtime) < 0)
+            {
+                continue;
+            }
+            // Entries sharing a timestamp are numbered in journal order,
+            // whether or not they're indexed, as seekEntry() counts them
+            if (realtime == lastRealtime)
+            {
+                sameRealtime++;
+            }
+            else
+            {
+                lastRealtime = realtime;
+                sameRealtime = 0;
+            }
+            if (!field.empty())
+            {
+                const void *data = nullptr;
+                size_t length = 0;
+                if (sd_journal_get_data(tail, field.c_str(), &data, &length) <
+                    0)
+                {
+                    continue;
+                }
+            }
+            entries.push_back({realtime, sameRealtime});
+        }
+        return true;
+    }
+
+    size_t size() const
+    {
+        return entries.size();
+    }
+
+    // An entry's unique ID, in the form getTimestampFromID() reads, from its
+    // timestamp and its place among the entries sharing it
+    static std::string formatEntryID(uint64_t realtime, uint16_t index)
+    {
+        std::string id = std::to_string(realtime);
+        if (index > 0)
+        {
+            id += "_" + std::to_string(index);
+        }
+        return id;
+    }
+
+    std::string entryID(size_t i) const
+    {
+        return formatEntryID(entries[i].realtime, entries[i].index);
+    }
+
+    // Moves to entry i, returning the journal to read it from, or nullptr if
+    // it's no longer there
+    sd_journal *seekEntry(size_t i)
+    {
+        const Entry &entry = entries[i];
+        if (sd_journal_seek_realtime_usec(reader, entry.realtime) < 0)
+        {
+            return nullptr;
+        }
+        for (int n = 0; n <= entry.index; n++)
+        {
+            if (sd_journal_next(reader) <= 0)
+            {
+                return nullptr;
+            }
+        }
+        return reader;
+    }
+
+    // Calls addEntry(journal, entryID) for the entries matching filter from
+    // skip to skip + top, and counts all that match.  Unlike paging through
+    // the index, this walks the matches on every request, but the matches
+    // are found through the journal's own field indexes, and the time range
+    // by seeking, so entries that don't match aren't read.
+    template <typename AddEntry>
+    bool getFilteredEntries(const JournalFilter &filter, uint64_t skip,
+                            uint64_t top, uint64_t &entryCount,
+                            AddEntry &&addEntry)
+    {
+        sd_journal *journalTmp = nullptr;
+        int ret = sd_journal_open(&journalTmp, SD_JOURNAL_LOCAL_ONLY);
+        if (ret < 0)
+        {
+            BMCWEB_LOG_ERROR << "failed to open journal: " << strerror(-ret);
+            return false;
+        }
+        std::unique_ptr<sd_journal, decltype(&sd_journal_close)> journal(
+            journalTmp, sd_journal_close);
+        journalTmp = nullptr;
+        for (const std::string &match : filter.matches)
+        {
+            ret = sd_journal_add_match(journal.get(), match.data(),
+                                       match.size());
+            if (ret < 0)
+            {
+                BMCWEB_LOG_ERROR << "failed to add journal match " << match
+                                 << ": " << strerror(-ret);
+                return false;
+            }
+        }
+        sd_journal_seek_realtime_usec(journal.get(), filter.since);
+
+        entryCount = 0;
+        while (sd_journal_next(journal.get()) > 0)
+        {
+            uint64_t realtime = 0;
+            // Not a break past until, as entries from a boot before the
+            // clock was set can follow later ones
+            if (sd_journal_get_realtime_usec(journal.get(), &realtime) < 0 ||
+                realtime < filter.since || realtime > filter.until)
+            {
+                continue;
+            }
+            if (!isIndexed(journal.get()))
+            {
+                continue;
+            }
+            entryCount++;
+            if (entryCount <= skip || entryCount > skip + top)
+            {
+                continue;
+            }
+            uint16_t index = 0;
+            if (!findEntryIndex(journal.get(), realtime, index))
+            {
+                continue;
+            }
+            if (!addEntry(journal.get(), formatEntryID(realtime, index)))
+            {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    // Whether the entry journal is at belongs in the index
+    bool isIndexed(sd_journal *journal) const
+    {
+        if (field.empty())
+        {
+            return true;
+        }
+        const void *data = nullptr;
+        size_t length = 0;
+        return sd_journal_get_data(journal, field.c_str(), &data, &length) >=
+               0;
+    }
+
+    // Finds the place of the entry journal is at among every entry sharing
+    // its timestamp, matching or not, which its ID needs
+    bool findEntryIndex(sd_journal *journal, uint64_t realtime,
+                        uint16_t &index)
+    {
+        char *cursor = nullptr;
+        if (sd_journal_get_cursor(journal, &cursor) < 0)
+        {
+            return false;
+        }
+        std::unique_ptr<char, decltype(&free)> cursorOwner(cursor, free);
+        if (sd_journal_seek_realtime_usec(reader, realtime) < 0)
+        {
+            return false;
+        }
+        for (index = 0; sd_journal_next(reader) > 0; index++)
+        {
+            uint64_t readerRealtime = 0;
+            if (sd_journal_get_realtime_usec(reader, &readerRealtime) < 0 ||
+                readerRealtime != realtime)
+            {
+                return false;
+            }
+            if (sd_journal_test_cursor(reader, cursor) > 0)
+            {
+                return true;
+            }
+        }
+        return false;
     }
 
   private:
-    /**
-     * Functions triggers appropriate requests on DBus
-     */
-    void doGet(crow::Response &res, const crow::Request &req,
-               const std::vector<std::string> &params) override
+    // Rather than the entry's cursor, which runs to over a hundred bytes, the
+    // index holds what its ID is made of, which locates it just as well
+    struct Entry
     {
-        std::shared_ptr<AsyncResp> asyncResp = std::make_shared<AsyncResp>(res);
-        // Collections don't include the static data added by SubRoute because
-        // it has a duplicate entry for members
-        asyncResp->res.jsonValue["@odata.type"] =
-            "#LogServiceCollection.LogServiceCollection";
-        asyncResp->res.jsonValue["@odata.context"] =
-            "/redfish/v1/$metadata#LogServiceCollection.LogServiceCollection";
-        asyncResp->res.jsonValue["@odata.id"] =
-            "/redfish/v1/Systems/system/LogServices";
-        asyncResp->res.jsonValue["Name"] = "System Log Services Collection";
-        asyncResp->res.jsonValue["Description"] =
-            "Collection of LogServices for this Computer System";
-        nlohmann::json &logServiceArray = asyncResp->res.jsonValue["Members"];
-        logServiceArray = nlohmann::json::array();
-        logServiceArray.push_back(
-            {{"@odata.id", "/redfish/v1/Systems/system/LogServices/EventLog"}});
-#ifdef BMCWEB_ENABLE_REDFISH_CPU_LOG
-        logServiceArray.push_back(
-            {{"@odata.id", "/redfish/v1/Systems/system/LogServices/CpuLog"}});
-#endif
-        asyncResp->res.jsonValue["Members@odata.count"] =
-            logServiceArray.size();
+        uint64_t realtime;
+        uint16_t index;
+    };
+
+    bool open()
+    {
+        int ret = sd_journal_open(&tail, SD_JOURNAL_LOCAL_ONLY);
+        if (ret < 0)
+        {
+            BMCWEB_LOG_ERROR << "failed to open journal: " << strerror(-ret);
+            tail = nullptr;
+            return false;
+        }
+        ret = sd_journal_open(&reader, SD_JOURNAL_LOCAL_ONLY);
+        if (ret < 0)
+        {
+            BMCWEB_LOG_ERROR << "failed to open journal: " << strerror(-ret);
+            reader = nullptr;
+            close();
+            return false;
+        }
+        // Asking for the fd is what sets up the inotify watches that
+        // sd_journal_process() reports on.  Without them every refresh
+        // rebuilds the index.
+        ret = sd_journal_get_fd(tail);
+        watched = ret >= 0;
+        if (!watched)
+        {
+            BMCWEB_LOG_ERROR << "failed to watch journal: " << strerror(-ret);
+        }
+        else if (io != nullptr)
+        {
+            watch.emplace(*io, ret);
+            waitForChanges();
+        }
+        entries.clear();
+        lastRealtime = 0;
+        sameRealtime = 0;
+        unread = true;
+        return true;
+    }
+
+    void waitForChanges()
+    {
+        watch->async_wait(
+            boost::asio::posix::stream_descriptor::wait_read,
+            [this](const boost::system::error_code &ec) {
+                if (ec)
+                {
+                    if (ec != boost::asio::error::operation_aborted)
+                    {
+                        BMCWEB_LOG_ERROR << "Journal watch failed: " << ec;
+                    }
+                    return;
+                }
+                int ret = sd_journal_process(tail);
+                if (ret < 0 || ret == SD_JOURNAL_INVALIDATE)
+                {
+                    // Both journals keep deleted files mapped until they're
+                    // closed, which on a BMC is RAM as /run/log is a tmpfs.
+                    // The index is rebuilt on the next refresh.
+                    close();
+                    open();
+                    return;
+                }
+                if (ret == SD_JOURNAL_APPEND)
+                {
+                    unread = true;
+                }
+                waitForChanges();
+            });
+    }
+
+    void close()
+    {
+        if (watch)
+        {
+            // The descriptor belongs to the journal
+            watch->release();
+            watch.reset();
+        }
+        if (tail != nullptr)
+        {
+            sd_journal_close(tail);
+            tail = nullptr;
+        }
+        if (reader != nullptr)
+        {
+            sd_journal_close(reader);
+            reader = nullptr;
+        }
+    }
+
+    std::string field;
+    // Kept at the end of the journal, where new entries are indexed from
+    sd_journal *tail = nullptr;
+    // Seeks to the entries of a page
+    sd_journal *reader = nullptr;
+    bool watched = false;
+    boost::asio::io_context *io = nullptr;
+    std::optional<boost::asio::posix::stream_descriptor> watch;
+    // Whether the tail may have entries the index hasn't read
+    bool unread = false;
+    std::vector<Entry> entries;
+    uint64_t lastRealtime = 0;
+    uint16_t sameRealtime = 0;
+};
+
+static JournalIndex &getEventLogIndex()
+{
+    static JournalIndex index("REDFISH_MESSAGE_ID");
+    return index;
+}
+
+static JournalIndex &getBMCJournalIndex()
+{
+    static JournalIndex index("");
+    return index;
+}
+
+// Serialized entries gathered before they're handed to the response
+constexpr size_t journalExportChunkSize = 16 * 1024;
+
+// Journal entries looked at before other work on the io_context gets a
+// turn, so a log with few entries in a large journal doesn't hold it up
+constexpr size_t journalExportEntriesPerTurn = 256;
+
+// Streams a log's entries as newline delimited JSON, one LogEntry a line,
+// each carrying the journal cursor to resume after.  Entries are read and
+// serialized a few at a time as the client takes them, so neither bmcweb's
+// memory nor the time it spends per turn grows with the size of the log.
+class JournalExport : public std::enable_shared_from_this<JournalExport>
+{
+  public:
+    // Fills in the LogEntry at the journal's position, returning false for
+    // an entry that doesn't belong in the log
+    using FillEntry = std::function<bool(sd_journal *, const std::string &,
+                                         nlohmann::json &)>;
+
+    JournalExport(boost::asio::io_context &io,
+                  const std::shared_ptr<AsyncResp> &asyncResp,
+                  JournalIndex &index, FillEntry &&fill) :
+        io(io),
+        asyncResp(asyncResp), index(index), fill(std::move(fill)),
+        journal(nullptr, sd_journal_close)
+    {
+    }
+
+    // Opens the journal at the first entry after the cursor, or at the
+    // start, returning a negative errno on failure
+    int open(const char *after, const JournalFilter &journalFilter)
+    {
+        sd_journal *journalTmp = nullptr;
+        int ret = sd_journal_open(&journalTmp, SD_JOURNAL_LOCAL_ONLY);
+        if (ret < 0)
+        {
+            return ret;
+        }
+        journal.reset(journalTmp);
+        filter = journalFilter;
+        for (const std::string &match : filter.matches)
+        {
+            ret = sd_journal_add_match(journal.get(), match.data(),
+                                       match.size());
+            if (ret < 0)
+            {
+                return ret;
+            }
+        }
+        if (after == nullptr)
+        {
+            return sd_journal_seek_realtime_usec(journal.get(), filter.since);
+        }
+        ret = sd_journal_seek_cursor(journal.get(), after);
+        if (ret < 0)
+        {
+            return ret;
+        }
+        // The cursor's entry may have been vacuumed, in which case the seek
+        // lands on the one after it, which is sent
+        if (sd_journal_next(journal.get()) > 0 &&
+            sd_journal_test_cursor(journal.get(), after) <= 0)
+        {
+            atUnsentEntry = true;
+        }
+        return 0;
+    }
+
+    // Sends a turn's worth of entries, then picks up again from the
+    // io_context, or once the client has taken them if it's fallen behind
+    void run()
+    {
+        crow::Response &res = asyncResp->res;
+        if (!res.isAlive())
+        {
+            return;
+        }
+        bool more = readEntries();
+        if (!output.empty())
+        {
+            res.writeChunk(std::move(output));
+            output.clear();
+        }
+        if (!more)
+        {
+            // The response ends when the last reference to asyncResp goes
+            return;
+        }
+        if (res.streamBacklog() != 0)
+        {
+            res.onStreamDrained([self(shared_from_this())] { self->run(); });
+            return;
+        }
+        boost::asio::post(io, [self(shared_from_this())] { self->run(); });
+    }
+
+  private:
+    // Serializes entries into output until it's a chunk's worth or a turn's
+    // worth of entries have been looked at, returning false once there are
+    // none left
+    bool readEntries()
+    {
+        for (size_t examined = 0; examined < journalExportEntriesPerTurn &&
+                                  output.size() < journalExportChunkSize;
+             examined++)
+        {
+            if (atUnsentEntry)
+            {
+                atUnsentEntry = false;
+            }
+            else if (sd_journal_next(journal.get()) <= 0)
+            {
+                return false;
+            }
+            // Not the end past until, as entries from a boot before the
+            // clock was set can follow later ones
+            uint64_t realtime = 0;
+            if (sd_journal_get_realtime_usec(journal.get(), &realtime) < 0 ||
+                realtime < filter.since || realtime > filter.until ||
+                !index.isIndexed(journal.get()))
+            {
+                continue;
+            }
+            uint16_t entryIndex = 0;
+            if (!index.findEntryIndex(journal.get(), realtime, entryIndex))
+            {
+                continue;
+            }
+            char *cursor = nullptr;
+            if (sd_journal_get_cursor(journal.get(), &cursor) < 0)
+            {
+                continue;
+            }
+            std::unique_ptr<char, decltype(&free)> cursorOwner(cursor, free);
+
+            nlohmann::json entry;
+            if (!fill(journal.get(),
+                      JournalIndex::formatEntryID(realtime, entryIndex),
+                      entry))
+            {
+                continue;
+            }
+            entry["Oem"]["OpenBmc"]["Cursor"] = cursor;
+            output += entry.dump(-1, ' ', true);
+            output += '\n';
+        }
+        return true;
+    }
+
+    boost::asio::io_context &io;
+    std::shared_ptr<AsyncResp> asyncResp;
+    JournalIndex &index;
+    FillEntry fill;
+    std::unique_ptr<sd_journal, decltype(&sd_journal_close)> journal;
+    JournalFilter filter;
+    // Set when the journal is at an entry that hasn't been read yet
+    bool atUnsentEntry = false;
+    std::string output;
+};
+
+// Answers a GET of a log's Export.  The after parameter takes the cursor of
+// the last entry the client has, and $filter works as on Entries.
+static void exportJournal(const std::shared_ptr<AsyncResp> &asyncResp,
+                          const crow::Request &req, JournalIndex &index,
+                          bool withMessageId, JournalExport::FillEntry &&fill)
+{
+    JournalFilter filter;
+    char *filterParam = req.urlParams.get("$filter");
+    if (filterParam != nullptr &&
+        !parseJournalFilter(filterParam, withMessageId, filter))
+    {
+        messages::queryParameterValueFormatError(asyncResp->res, filterParam,
+                                                 "$filter");
+        return;
+    }
+    // Entry IDs are numbered through the index's journal
+    if (!index.refresh(*req.ioService))
+    {
+        messages::internalError(asyncResp->res);
+        return;
+    }
+
+    auto journalExport =
+        std::make_shared<JournalExport>(*req.ioService, asyncResp, index,
+                                        std::move(fill));
+    char *after = req.urlParams.get("after");
+    int ret = journalExport->open(after, filter);
+    if (ret == -EINVAL && after != nullptr)
+    {
+        messages::queryParameterValueFormatError(asyncResp->res, after,
+                                                 "after");
+        return;
+    }
+    if (ret < 0)
+    {
+        BMCWEB_LOG_ERROR << "failed to open journal: " << strerror(-ret);
+        messages::internalError(asyncResp->res);
+        return;
+    }
+
+    asyncResp->res.addHeader("Content-Type", "application/x-ndjson");
+    asyncResp->res.startStreaming();
+    journalExport->run();
+}
+
+class SystemLogServiceCollection : public Node
+{
+  public:
+    template <typename CrowApp>
+    SystemLogServiceCollection(CrowApp &app) :
+        Node(app, "/redfish/v1/Systems/system/LogServices/")
+    {
+        entityPrivileges = {
+            {boost::beast::http::verb::get, {{"Login"}}},
+            {boost::beast::http::verb::head, {{"Login"}}},
+            {boost::beast::http::verb::patch, {{"ConfigureManager"}}},
+            {boost::beast::http::verb::put, {{"ConfigureManager"}}},
+            {boost::beast::http::verb::delete_, {{"ConfigureManager"}}},
+            {boost::beast::http::verb::post, {{"ConfigureManager"}}}};
+    }
+
+  private:
+    /**
+     * Functions triggers appropriate requests on DBus
+     */
+    void doGet(crow::Response &res, const crow::Request &req,
+               const std::vector<std::string> &params) override
+    {
+        std::shared_ptr<AsyncResp> asyncResp = std::make_shared<AsyncResp>(res);
+        // Collections don't include the static data added by SubRoute because
+        // it has a duplicate entry for members
+        asyncResp->res.jsonValue["@odata.type"] =
+            "#LogServiceCollection.LogServiceCollection";
+        asyncResp->res.jsonValue["@odata.context"] =
+            "/redfish/v1/$metadata#LogServiceCollection.LogServiceCollection";
+        asyncResp->res.jsonValue["@odata.id"] =
+            "/redfish/v1/Systems/system/LogServices";
+        asyncResp->res.jsonValue["Name"] = "System Log Services Collection";
+        asyncResp->res.jsonValue["Description"] =
+            "Collection of LogServices for this Computer System";
+        nlohmann::json &logServiceArray = asyncResp->res.jsonValue["Members"];
+        logServiceArray = nlohmann::json::array();
+        logServiceArray.push_back(
+            {{"@odata.id", "/redfish/v1/Systems/system/LogServices/EventLog"}});
+#ifdef BMCWEB_ENABLE_HOST_CONSOLE_CAPTURE
+        logServiceArray.push_back(
+            {{"@odata.id",
+              "/redfish/v1/Systems/system/LogServices/HostConsole"}});
+#endif
+#ifdef BMCWEB_ENABLE_REDFISH_CPU_LOG
+        logServiceArray.push_back(
+            {{"@odata.id", "/redfish/v1/Systems/system/LogServices/CpuLog"}});
+#endif
+        asyncResp->res.jsonValue["Members@odata.count"] =
+            logServiceArray.size();
+    }
+};
+
+class EventLogService : public Node
+{
+  public:
+    template <typename CrowApp>
+    EventLogService(CrowApp &app) :
+        Node(app, "/redfish/v1/Systems/system/LogServices/EventLog/")
+    {
+        entityPrivileges = {
+            {boost::beast::http::verb::get, {{"Login"}}},
+            {boost::beast::http::verb::head, {{"Login"}}},
+            {boost::beast::http::verb::patch, {{"ConfigureManager"}}},
+            {boost::beast::http::verb::put, {{"ConfigureManager"}}},
+            {boost::beast::http::verb::delete_, {{"ConfigureManager"}}},
+            {boost::beast::http::verb::post, {{"ConfigureManager"}}}};
+    }
+
+  private:
+    void doGet(crow::Response &res, const crow::Request &req,
+               const std::vector<std::string> &params) override
+    {
+        std::shared_ptr<AsyncResp> asyncResp = std::make_shared<AsyncResp>(res);
+
+        asyncResp->res.jsonValue["@odata.id"] =
+            "/redfish/v1/Systems/system/LogServices/EventLog";
+        asyncResp->res.jsonValue["@odata.type"] =
+            "#LogService.v1_1_0.LogService";
+        asyncResp->res.jsonValue["@odata.context"] =
+            "/redfish/v1/$metadata#LogService.LogService";
+        asyncResp->res.jsonValue["Name"] = "Event Log Service";
+        asyncResp->res.jsonValue["Description"] = "System Event Log Service";
+        asyncResp->res.jsonValue["Id"] = "Event Log";
+        asyncResp->res.jsonValue["OverWritePolicy"] = "WrapsWhenFull";
+        asyncResp->res.jsonValue["Entries"] = {
+            {"@odata.id",
+             "/redfish/v1/Systems/system/LogServices/EventLog/Entries"}};
+        asyncResp->res.jsonValue["Oem"]["OpenBmc"]["Export"] = {
+            {"@odata.id",
+             "/redfish/v1/Systems/system/LogServices/EventLog/Export"}};
+    }
+};
+
+static int fillEventLogEntryJson(const std::string &bmcLogEntryID,
+                                 const boost::string_view &messageID,
+                                 sd_journal *journal,
+                                 nlohmann::json &bmcLogEntryJson)
+{
+    // Get the Log Entry contents
+    int ret = 0;
+
+    boost::string_view msg;
+    ret = getJournalMetadata(journal, "MESSAGE", msg);
+    if (ret < 0)
+    {
+        BMCWEB_LOG_ERROR << "Failed to read MESSAGE field: " << strerror(-ret);
+        return 1;
+    }
+
+    // Get the severity from the PRIORITY field
+    int severity = 8; // Default to an invalid priority
+    ret = getJournalMetadata(journal, "PRIORITY", 10, severity);
+    if (ret < 0)
+    {
+        BMCWEB_LOG_ERROR << "Failed to read PRIORITY field: " << strerror(-ret);
+        return 1;
+    }
+
+    // Get the MessageArgs from the journal entry by finding all of the
+    // REDFISH_MESSAGE_ARG_x fields
+    const void *data;
+    size_t length;
+    std::vector<std::string> messageArgs;
+    SD_JOURNAL_FOREACH_DATA(journal, data, length)
+    {
+        boost::string_view field(static_cast<const char *>(data), length);
+        if (field.starts_with("REDFISH_MESSAGE_ARG_"))
+        {
+            // Get the Arg number from the field name
+            field.remove_prefix(sizeof("REDFISH_MESSAGE_ARG_") - 1);
+            if (field.empty())
+            {
+                continue;
+            }
+            int argNum = std::strtoul(field.data(), nullptr, 10);
+            if (argNum == 0)
+            {
+                continue;
+            }
+            // Get the Arg value after the "=" character.
+            field.remove_prefix(std::min(field.find("=") + 1, field.size()));
+            // Make sure we have enough space in messageArgs
+            if (argNum > messageArgs.size())
+            {
+                messageArgs.resize(argNum);
+            }
+            messageArgs[argNum - 1] = field.to_string();
+        }
+    }
+
+    // Get the Created time from the timestamp
+    std::string entryTimeStr;
+    if (!getEntryTimestamp(journal, entryTimeStr))
+    {
+        return 1;
+    }
+
+    // Fill in the log entry with the gathered data
+    bmcLogEntryJson = {
+        {"@odata.type", "#LogEntry.v1_3_0.LogEntry"},
+        {"@odata.context", "/redfish/v1/$metadata#LogEntry.LogEntry"},
+        {"@odata.id",
+         "/redfish/v1/Systems/system/LogServices/EventLog/Entries/" +
+             bmcLogEntryID},
+        {"Name", "System Event Log Entry"},
+        {"Id", bmcLogEntryID},
+        {"Message", msg},
+        {"MessageId", messageID},
+        {"MessageArgs", std::move(messageArgs)},
+        {"EntryType", "Event"},
+        {"Severity",
+         severity <= 2 ? "Critical"
+                       : severity <= 4 ? "Warning" : severity <= 7 ? "OK" : ""},
+        {"Created", std::move(entryTimeStr)}};
+    return 0;
+}
+
+class EventLogEntryCollection : public Node
+{
+  public:
+    template <typename CrowApp>
+    EventLogEntryCollection(CrowApp &app) :
+        Node(app, "/redfish/v1/Systems/system/LogServices/EventLog/Entries/")
+    {
+        entityPrivileges = {
+            {boost::beast::http::verb::get, {{"Login"}}},
+            {boost::beast::http::verb::head, {{"Login"}}},
+            {boost::beast::http::verb::patch, {{"ConfigureManager"}}},
+            {boost::beast::http::verb::put, {{"ConfigureManager"}}},
+            {boost::beast::http::verb::delete_, {{"ConfigureManager"}}},
+            {boost::beast::http::verb::post, {{"ConfigureManager"}}}};
+    }
+
+  private:
+    void doGet(crow::Response &res, const crow::Request &req,
+               const std::vector<std::string> &params) override
+    {
+        std::shared_ptr<AsyncResp> asyncResp = std::make_shared<AsyncResp>(res);
+        long skip = 0;
+        long top = maxEntriesPerPage; // Show max entries by default
+        if (!getSkipParam(asyncResp->res, req, skip))
+        {
+            return;
+        }
+        if (!getTopParam(asyncResp->res, req, top))
+        {
+            return;
+        }
+        // Collections don't include the static data added by SubRoute because
+        // it has a duplicate entry for members
+        asyncResp->res.jsonValue["@odata.type"] =
+            "#LogEntryCollection.LogEntryCollection";
+        asyncResp->res.jsonValue["@odata.context"] =
+            "/redfish/v1/$metadata#LogEntryCollection.LogEntryCollection";
+        asyncResp->res.jsonValue["@odata.id"] =
+            "/redfish/v1/Systems/system/LogServices/EventLog/Entries";
+        asyncResp->res.jsonValue["Name"] = "System Event Log Entries";
+        asyncResp->res.jsonValue["Description"] =
+            "Collection of System Event Log Entries";
+        nlohmann::json &logEntryArray = asyncResp->res.jsonValue["Members"];
+        logEntryArray = nlohmann::json::array();
+
+        JournalIndex &index = getEventLogIndex();
+        if (!index.refresh(*req.ioService))
+        {
+            messages::internalError(asyncResp->res);
+            return;
+        }
+        auto addEntry = [&logEntryArray](sd_journal *journal,
+                                         const std::string &entryID) {
+            boost::string_view messageID;
+            if (getJournalMetadata(journal, "REDFISH_MESSAGE_ID", messageID) <
+                0)
+            {
+                return true;
+            }
+            logEntryArray.push_back({});
+            return fillEventLogEntryJson(entryID, messageID, journal,
+                                         logEntryArray.back()) == 0;
+        };
+
+        uint64_t entryCount = 0;
+        char *filterParam = req.urlParams.get("$filter");
+        if (filterParam != nullptr)
+        {
+            JournalFilter filter;
+            if (!parseJournalFilter(filterParam, true, filter))
+            {
+                messages::queryParameterValueFormatError(
+                    asyncResp->res, filterParam, "$filter");
+                return;
+            }
+            if (!index.getFilteredEntries(filter, skip, top, entryCount,
+                                          addEntry))
+            {
+                messages::internalError(asyncResp->res);
+                return;
+            }
+        }
+        else
+        {
+            entryCount = index.size();
+            // Handle paging using skip (number of entries to skip from the
+            // start) and top (number of entries to display)
+            for (uint64_t i = skip; i < entryCount && i < skip + top; i++)
+            {
+                sd_journal *journal = index.seekEntry(i);
+                if (journal == nullptr)
+                {
+                    continue;
+                }
+                if (!addEntry(journal, index.entryID(i)))
+                {
+                    messages::internalError(asyncResp->res);
+                    return;
+                }
+            }
+        }
+        asyncResp->res.jsonValue["Members@odata.count"] = entryCount;
+        if (skip + top < entryCount)
+        {
+            std::string nextLink =
+                "/redfish/v1/Systems/system/LogServices/EventLog/"
+                "Entries?$skip=" +
+                std::to_string(skip + top);
+            if (filterParam != nullptr)
+            {
+                nextLink += "&$filter=" + http_helpers::urlEncode(filterParam);
+            }
+            asyncResp->res.jsonValue["Members@odata.nextLink"] = nextLink;
+        }
+    }
+};
+
+class EventLogEntry : public Node
+{
+  public:
+    EventLogEntry(CrowApp &app) :
+        Node(app,
+             "/redfish/v1/Systems/system/LogServices/EventLog/Entries/<str>/",
+             std::string())
+    {
+        entityPrivileges = {
+            {boost::beast::http::verb::get, {{"Login"}}},
+            {boost::beast::http::verb::head, {{"Login"}}},
+            {boost::beast::http::verb::patch, {{"ConfigureManager"}}},
+            {boost::beast::http::verb::put, {{"ConfigureManager"}}},
+            {boost::beast::http::verb::delete_, {{"ConfigureManager"}}},
+            {boost::beast::http::verb::post, {{"ConfigureManager"}}}};
+    }
+
+  private:
+    void doGet(crow::Response &res, const crow::Request &req,
+               const std::vector<std::string> &params) override
+    {
+        std::shared_ptr<AsyncResp> asyncResp = std::make_shared<AsyncResp>(res);
+        if (params.size() != 1)
+        {
+            messages::internalError(asyncResp->res);
+            return;
+        }
+        const std::string &entryID = params[0];
+        // Convert the unique ID back to a timestamp to find the entry
+        uint64_t ts = 0;
+        uint16_t index = 0;
+        if (!getTimestampFromID(asyncResp->res, entryID, ts, index))
+        {
+            return;
+        }
+
+        sd_journal *journalTmp = nullptr;
+        int ret = sd_journal_open(&journalTmp, SD_JOURNAL_LOCAL_ONLY);
+        if (ret < 0)
+        {
+            BMCWEB_LOG_ERROR << "failed to open journal: " << strerror(-ret);
+            messages::internalError(asyncResp->res);
+            return;
+        }
+        std::unique_ptr<sd_journal, decltype(&sd_journal_close)> journal(
+            journalTmp, sd_journal_close);
+        journalTmp = nullptr;
+        // Go to the timestamp in the log and move to the entry at the index
+        ret = sd_journal_seek_realtime_usec(journal.get(), ts);
+        for (int i = 0; i <= index; i++)
+        {
+            sd_journal_next(journal.get());
+        }
+        // Confirm that the entry is the one that was requested, which it's
+        // not if there are fewer entries at the timestamp than its index
+        uint64_t realtime = 0;
+        if (sd_journal_get_realtime_usec(journal.get(), &realtime) < 0 ||
+            realtime != ts)
+        {
+            messages::resourceMissingAtURI(asyncResp->res, entryID);
+            return;
+        }
+
+        // only use journal entries that contain a REDFISH_MESSAGE_ID field
+        boost::string_view messageID;
+        ret =
+            getJournalMetadata(journal.get(), "REDFISH_MESSAGE_ID", messageID);
+        if (ret < 0)
+        {
+            messages::resourceNotFound(asyncResp->res, "LogEntry", "system");
+            return;
+        }
+
+        if (fillEventLogEntryJson(entryID, messageID, journal.get(),
+                                  asyncResp->res.jsonValue) != 0)
+        {
+            messages::internalError(asyncResp->res);
+            return;
+        }
+    }
+};
+
+class EventLogExport : public Node
+{
+  public:
+    template <typename CrowApp>
+    EventLogExport(CrowApp &app) :
+        Node(app, "/redfish/v1/Systems/system/LogServices/EventLog/Export/")
+    {
+        entityPrivileges = {
+            {boost::beast::http::verb::get, {{"Login"}}},
+            {boost::beast::http::verb::head, {{"Login"}}},
+            {boost::beast::http::verb::patch, {{"ConfigureManager"}}},
+            {boost::beast::http::verb::put, {{"ConfigureManager"}}},
+            {boost::beast::http::verb::delete_, {{"ConfigureManager"}}},
+            {boost::beast::http::verb::post, {{"ConfigureManager"}}}};
+    }
+
+  private:
+    void doGet(crow::Response &res, const crow::Request &req,
+               const std::vector<std::string> &params) override
+    {
+        std::shared_ptr<AsyncResp> asyncResp = std::make_shared<AsyncResp>(res);
+        exportJournal(asyncResp, req, getEventLogIndex(), true,
+                      [](sd_journal *journal, const std::string &entryID,
+                         nlohmann::json &entry) {
+                          boost::string_view messageID;
+                          if (getJournalMetadata(journal, "REDFISH_MESSAGE_ID",
+                                                 messageID) < 0)
+                          {
+                              return false;
+                          }
+                          return fillEventLogEntryJson(entryID, messageID,
+                                                       journal, entry) == 0;
+                      });
     }
 };
 
-class EventLogService : public Node
+class HostConsoleLogService : public Node
 {
   public:
     template <typename CrowApp>
-    EventLogService(CrowApp &app) :
-        Node(app, "/redfish/v1/Systems/system/LogServices/EventLog/")
+    HostConsoleLogService(CrowApp &app) :
+        Node(app, "/redfish/v1/Systems/system/LogServices/HostConsole/")
     {
         entityPrivileges = {
             {boost::beast::http::verb::get, {{"Login"}}},
@@ -324,113 +1235,62 @@ class EventLogService : public Node
                const std::vector<std::string> &params) override
     {
         std::shared_ptr<AsyncResp> asyncResp = std::make_shared<AsyncResp>(res);
-
         asyncResp->res.jsonValue["@odata.id"] =
-            "/redfish/v1/Systems/system/LogServices/EventLog";
+            "/redfish/v1/Systems/system/LogServices/HostConsole";
         asyncResp->res.jsonValue["@odata.type"] =
             "#LogService.v1_1_0.LogService";
         asyncResp->res.jsonValue["@odata.context"] =
             "/redfish/v1/$metadata#LogService.LogService";
-        asyncResp->res.jsonValue["Name"] = "Event Log Service";
-        asyncResp->res.jsonValue["Description"] = "System Event Log Service";
-        asyncResp->res.jsonValue["Id"] = "Event Log";
+        asyncResp->res.jsonValue["Name"] = "Host Console Log Service";
+        asyncResp->res.jsonValue["Description"] =
+            "Captured Host Console Output";
+        asyncResp->res.jsonValue["Id"] = "HostConsole";
         asyncResp->res.jsonValue["OverWritePolicy"] = "WrapsWhenFull";
         asyncResp->res.jsonValue["Entries"] = {
             {"@odata.id",
-             "/redfish/v1/Systems/system/LogServices/EventLog/Entries"}};
+             "/redfish/v1/Systems/system/LogServices/HostConsole/Entries"}};
     }
 };
 
-static int fillEventLogEntryJson(const std::string &bmcLogEntryID,
-                                 const boost::string_view &messageID,
-                                 sd_journal *journal,
-                                 nlohmann::json &bmcLogEntryJson)
+static int fillConsoleCaptureEntryJson(
+    const crow::obmc_console::CaptureSegment &segment,
+    nlohmann::json &entryJson)
 {
-    // Get the Log Entry contents
-    int ret = 0;
-
-    boost::string_view msg;
-    ret = getJournalMetadata(journal, "MESSAGE", msg);
-    if (ret < 0)
-    {
-        BMCWEB_LOG_ERROR << "Failed to read MESSAGE field: " << strerror(-ret);
-        return 1;
-    }
-
-    // Get the severity from the PRIORITY field
-    int severity = 8; // Default to an invalid priority
-    ret = getJournalMetadata(journal, "PRIORITY", 10, severity);
-    if (ret < 0)
-    {
-        BMCWEB_LOG_ERROR << "Failed to read PRIORITY field: " << strerror(-ret);
-        return 1;
-    }
-
-    // Get the MessageArgs from the journal entry by finding all of the
-    // REDFISH_MESSAGE_ARG_x fields
-    const void *data;
-    size_t length;
-    std::vector<std::string> messageArgs;
-    SD_JOURNAL_FOREACH_DATA(journal, data, length)
-    {
-        boost::string_view field(static_cast<const char *>(data), length);
-        if (field.starts_with("REDFISH_MESSAGE_ARG_"))
-        {
-            // Get the Arg number from the field name
-            field.remove_prefix(sizeof("REDFISH_MESSAGE_ARG_") - 1);
-            if (field.empty())
-            {
-                continue;
-            }
-            int argNum = std::strtoul(field.data(), nullptr, 10);
-            if (argNum == 0)
-            {
-                continue;
-            }
-            // Get the Arg value after the "=" character.
-            field.remove_prefix(std::min(field.find("=") + 1, field.size()));
-            // Make sure we have enough space in messageArgs
-            if (argNum > messageArgs.size())
-            {
-                messageArgs.resize(argNum);
-            }
-            messageArgs[argNum - 1] = field.to_string();
-        }
-    }
-
-    // Get the Created time from the timestamp
-    std::string entryTimeStr;
-    if (!getEntryTimestamp(journal, entryTimeStr))
+    struct stat st;
+    if (stat(segment.path.c_str(), &st) != 0)
     {
+        BMCWEB_LOG_ERROR << "Failed to stat " << segment.path << ": "
+                         << strerror(errno);
         return 1;
     }
-
-    // Fill in the log entry with the gathered data
-    bmcLogEntryJson = {
-        {"@odata.type", "#LogEntry.v1_3_0.LogEntry"},
+    const std::string entryURI =
+        "/redfish/v1/Systems/system/LogServices/HostConsole/Entries/" +
+        segment.id();
+    // Each entry is one segment of the capture, the output itself being the
+    // entry's additional data
+    entryJson = {
+        {"@odata.type", "#LogEntry.v1_8_0.LogEntry"},
         {"@odata.context", "/redfish/v1/$metadata#LogEntry.LogEntry"},
-        {"@odata.id",
-         "/redfish/v1/Systems/system/LogServices/EventLog/Entries/" +
-             bmcLogEntryID},
-        {"Name", "System Event Log Entry"},
-        {"Id", bmcLogEntryID},
-        {"Message", msg},
-        {"MessageId", messageID},
-        {"MessageArgs", std::move(messageArgs)},
-        {"EntryType", "Event"},
-        {"Severity",
-         severity <= 2 ? "Critical"
-                       : severity <= 4 ? "Warning" : severity <= 7 ? "OK" : ""},
-        {"Created", std::move(entryTimeStr)}};
+        {"@odata.id", entryURI},
+        {"Name", "Host Console Capture"},
+        {"Id", segment.id()},
+        {"Message", "Output of " + segment.console},
+        {"EntryType", "Oem"},
+        {"Severity", "OK"},
+        {"OemRecordFormat", segment.compressed ? "Host Console Capture (gzip)"
+                                               : "Host Console Capture"},
+        {"AdditionalDataURI", entryURI + "/attachment"},
+        {"AdditionalDataSizeBytes", st.st_size},
+        {"Created", getTimestampStr(st.st_mtime)}};
     return 0;
 }
 
-class EventLogEntryCollection : public Node
+class HostConsoleLogEntryCollection : public Node
 {
   public:
     template <typename CrowApp>
-    EventLogEntryCollection(CrowApp &app) :
-        Node(app, "/redfish/v1/Systems/system/LogServices/EventLog/Entries/")
+    HostConsoleLogEntryCollection(CrowApp &app) :
+        Node(app, "/redfish/v1/Systems/system/LogServices/HostConsole/Entries/")
     {
         entityPrivileges = {
             {boost::beast::http::verb::get, {{"Login"}}},
@@ -446,16 +1306,6 @@ class EventLogEntryCollection : public Node
                const std::vector<std::string> &params) override
     {
         std::shared_ptr<AsyncResp> asyncResp = std::make_shared<AsyncResp>(res);
-        long skip = 0;
-        long top = maxEntriesPerPage; // Show max entries by default
-        if (!getSkipParam(asyncResp->res, req, skip))
-        {
-            return;
-        }
-        if (!getTopParam(asyncResp->res, req, top))
-        {
-            return;
-        }
         // Collections don't include the static data added by SubRoute because
         // it has a duplicate entry for members
         asyncResp->res.jsonValue["@odata.type"] =
@@ -463,77 +1313,34 @@ class EventLogEntryCollection : public Node
         asyncResp->res.jsonValue["@odata.context"] =
             "/redfish/v1/$metadata#LogEntryCollection.LogEntryCollection";
         asyncResp->res.jsonValue["@odata.id"] =
-            "/redfish/v1/Systems/system/LogServices/EventLog/Entries";
-        asyncResp->res.jsonValue["Name"] = "System Event Log Entries";
+            "/redfish/v1/Systems/system/LogServices/HostConsole/Entries";
+        asyncResp->res.jsonValue["Name"] = "Host Console Log Entries";
         asyncResp->res.jsonValue["Description"] =
-            "Collection of System Event Log Entries";
+            "Collection of Host Console Captures";
         nlohmann::json &logEntryArray = asyncResp->res.jsonValue["Members"];
         logEntryArray = nlohmann::json::array();
-
-        // Go through the journal and create a unique ID for each entry
-        sd_journal *journalTmp = nullptr;
-        int ret = sd_journal_open(&journalTmp, SD_JOURNAL_LOCAL_ONLY);
-        if (ret < 0)
-        {
-            BMCWEB_LOG_ERROR << "failed to open journal: " << strerror(-ret);
-            messages::internalError(asyncResp->res);
-            return;
-        }
-        std::unique_ptr<sd_journal, decltype(&sd_journal_close)> journal(
-            journalTmp, sd_journal_close);
-        journalTmp = nullptr;
-        uint64_t entryCount = 0;
-        SD_JOURNAL_FOREACH(journal.get())
+        for (const crow::obmc_console::CaptureSegment &segment :
+             crow::obmc_console::listSegments(crow::obmc_console::captureDir))
         {
-            // Look for only journal entries that contain a REDFISH_MESSAGE_ID
-            // field
-            boost::string_view messageID;
-            ret = getJournalMetadata(journal.get(), "REDFISH_MESSAGE_ID",
-                                     messageID);
-            if (ret < 0)
-            {
-                continue;
-            }
-
-            entryCount++;
-            // Handle paging using skip (number of entries to skip from the
-            // start) and top (number of entries to display)
-            if (entryCount <= skip || entryCount > skip + top)
-            {
-                continue;
-            }
-
-            std::string idStr;
-            if (!getUniqueEntryID(journal.get(), idStr))
-            {
-                continue;
-            }
-
             logEntryArray.push_back({});
-            nlohmann::json &bmcLogEntry = logEntryArray.back();
-            if (fillEventLogEntryJson(idStr, messageID, journal.get(),
-                                      bmcLogEntry) != 0)
+            if (fillConsoleCaptureEntryJson(segment, logEntryArray.back()) !=
+                0)
             {
-                messages::internalError(asyncResp->res);
-                return;
+                // Pruned since it was listed
+                logEntryArray.erase(logEntryArray.size() - 1);
             }
         }
-        asyncResp->res.jsonValue["Members@odata.count"] = entryCount;
-        if (skip + top < entryCount)
-        {
-            asyncResp->res.jsonValue["Members@odata.nextLink"] =
-                "/redfish/v1/Managers/bmc/LogServices/BmcLog/Entries?$skip=" +
-                std::to_string(skip + top);
-        }
+        asyncResp->res.jsonValue["Members@odata.count"] = logEntryArray.size();
     }
 };
 
-class EventLogEntry : public Node
+class HostConsoleLogEntry : public Node
 {
   public:
-    EventLogEntry(CrowApp &app) :
+    HostConsoleLogEntry(CrowApp &app) :
         Node(app,
-             "/redfish/v1/Systems/system/LogServices/EventLog/Entries/<str>/",
+             "/redfish/v1/Systems/system/LogServices/HostConsole/Entries/"
+             "<str>/",
              std::string())
     {
         entityPrivileges = {
@@ -555,53 +1362,99 @@ class EventLogEntry : public Node
             messages::internalError(asyncResp->res);
             return;
         }
-        const std::string &entryID = params[0];
-        // Convert the unique ID back to a timestamp to find the entry
-        uint64_t ts = 0;
-        uint16_t index = 0;
-        if (!getTimestampFromID(asyncResp->res, entryID, ts, index))
+        crow::obmc_console::CaptureSegment segment;
+        if (!crow::obmc_console::findSegment(crow::obmc_console::captureDir,
+                                             params[0], segment) ||
+            fillConsoleCaptureEntryJson(segment, asyncResp->res.jsonValue) !=
+                0)
         {
+            messages::resourceMissingAtURI(asyncResp->res, params[0]);
             return;
         }
+    }
+};
 
-        sd_journal *journalTmp = nullptr;
-        int ret = sd_journal_open(&journalTmp, SD_JOURNAL_LOCAL_ONLY);
-        if (ret < 0)
+// Serves the captured output of an entry, or the part of it asked for by a
+// Range header, so large or growing captures can be fetched piecewise
+class HostConsoleLogEntryAttachment : public Node
+{
+  public:
+    HostConsoleLogEntryAttachment(CrowApp &app) :
+        Node(app,
+             "/redfish/v1/Systems/system/LogServices/HostConsole/Entries/"
+             "<str>/attachment/",
+             std::string())
+    {
+        entityPrivileges = {
+            {boost::beast::http::verb::get, {{"Login"}}},
+            {boost::beast::http::verb::head, {{"Login"}}},
+            {boost::beast::http::verb::patch, {{"ConfigureManager"}}},
+            {boost::beast::http::verb::put, {{"ConfigureManager"}}},
+            {boost::beast::http::verb::delete_, {{"ConfigureManager"}}},
+            {boost::beast::http::verb::post, {{"ConfigureManager"}}}};
+    }
+
+  private:
+    void doGet(crow::Response &res, const crow::Request &req,
+               const std::vector<std::string> &params) override
+    {
+        std::shared_ptr<AsyncResp> asyncResp = std::make_shared<AsyncResp>(res);
+        if (params.size() != 1)
         {
-            BMCWEB_LOG_ERROR << "failed to open journal: " << strerror(-ret);
             messages::internalError(asyncResp->res);
             return;
         }
-        std::unique_ptr<sd_journal, decltype(&sd_journal_close)> journal(
-            journalTmp, sd_journal_close);
-        journalTmp = nullptr;
-        // Go to the timestamp in the log and move to the entry at the index
-        ret = sd_journal_seek_realtime_usec(journal.get(), ts);
-        for (int i = 0; i <= index; i++)
+        crow::obmc_console::CaptureSegment segment;
+        std::ifstream file;
+        if (crow::obmc_console::findSegment(crow::obmc_console::captureDir,
+                                             params[0], segment))
         {
-            sd_journal_next(journal.get());
+            file.open(segment.path, std::ios::binary | std::ios::ate);
         }
-        // Confirm that the entry ID matches what was requested
-        std::string idStr;
-        if (!getUniqueEntryID(journal.get(), idStr) || idStr != entryID)
+        if (!file.is_open())
         {
-            messages::resourceMissingAtURI(asyncResp->res, entryID);
+            messages::resourceMissingAtURI(asyncResp->res, params[0]);
             return;
         }
+        size_t size = static_cast<size_t>(file.tellg());
 
-        // only use journal entries that contain a REDFISH_MESSAGE_ID field
-        boost::string_view messageID;
-        ret =
-            getJournalMetadata(journal.get(), "REDFISH_MESSAGE_ID", messageID);
-        if (ret < 0)
+        asyncResp->res.addHeader("Accept-Ranges", "bytes");
+        crow::ByteRange range{0, size - 1};
+        switch (crow::parseByteRange(req.getHeaderValue("Range"), size, range))
         {
-            messages::resourceNotFound(asyncResp->res, "LogEntry", "system");
-            return;
+            case crow::RangeResult::none:
+                break;
+            case crow::RangeResult::satisfiable:
+                asyncResp->res.result(
+                    boost::beast::http::status::partial_content);
+                asyncResp->res.addHeader("Content-Range",
+                                         crow::contentRange(range, size));
+                break;
+            case crow::RangeResult::unsatisfiable:
+                asyncResp->res.result(
+                    boost::beast::http::status::range_not_satisfiable);
+                asyncResp->res.addHeader("Content-Range",
+                                         "bytes */" + std::to_string(size));
+                return;
         }
 
-        if (fillEventLogEntryJson(entryID, messageID, journal.get(),
-                                  asyncResp->res.jsonValue) != 0)
+        asyncResp->res.addHeader("Content-Type",
+                                 segment.compressed ? "application/gzip"
+                                                    : "text/plain");
+        asyncResp->res.addHeader(
+            "Content-Disposition",
+            "attachment; filename=\"" + segment.path.filename().string() +
+                "\"");
+        if (size == 0)
+        {
+            return;
+        }
+        std::string &body = asyncResp->res.body();
+        body.resize(range.last - range.first + 1);
+        file.seekg(static_cast<std::streamoff>(range.first));
+        if (!file.read(&body[0], static_cast<std::streamsize>(body.size())))
         {
+            body.clear();
             messages::internalError(asyncResp->res);
             return;
         }
@@ -688,6 +1541,9 @@ class BMCJournalLogService : public Node
         asyncResp->res.jsonValue["Entries"] = {
             {"@odata.id",
              "/redfish/v1/Managers/bmc/LogServices/Journal/Entries/"}};
+        asyncResp->res.jsonValue["Oem"]["OpenBmc"]["Export"] = {
+            {"@odata.id",
+             "/redfish/v1/Managers/bmc/LogServices/Journal/Export/"}};
     }
 };
 
@@ -790,51 +1646,67 @@ class BMCJournalLogEntryCollection : public Node
         nlohmann::json &logEntryArray = asyncResp->res.jsonValue["Members"];
         logEntryArray = nlohmann::json::array();
 
-        // Go through the journal and use the timestamp to create a unique ID
-        // for each entry
-        sd_journal *journalTmp = nullptr;
-        int ret = sd_journal_open(&journalTmp, SD_JOURNAL_LOCAL_ONLY);
-        if (ret < 0)
+        JournalIndex &index = getBMCJournalIndex();
+        if (!index.refresh(*req.ioService))
         {
-            BMCWEB_LOG_ERROR << "failed to open journal: " << strerror(-ret);
             messages::internalError(asyncResp->res);
             return;
         }
-        std::unique_ptr<sd_journal, decltype(&sd_journal_close)> journal(
-            journalTmp, sd_journal_close);
-        journalTmp = nullptr;
+        auto addEntry = [&logEntryArray](sd_journal *journal,
+                                         const std::string &entryID) {
+            logEntryArray.push_back({});
+            return fillBMCJournalLogEntryJson(entryID, journal,
+                                              logEntryArray.back()) == 0;
+        };
+
         uint64_t entryCount = 0;
-        SD_JOURNAL_FOREACH(journal.get())
+        char *filterParam = req.urlParams.get("$filter");
+        if (filterParam != nullptr)
         {
-            entryCount++;
-            // Handle paging using skip (number of entries to skip from the
-            // start) and top (number of entries to display)
-            if (entryCount <= skip || entryCount > skip + top)
-            {
-                continue;
-            }
-
-            std::string idStr;
-            if (!getUniqueEntryID(journal.get(), idStr))
+            JournalFilter filter;
+            if (!parseJournalFilter(filterParam, false, filter))
             {
-                continue;
+                messages::queryParameterValueFormatError(
+                    asyncResp->res, filterParam, "$filter");
+                return;
             }
-
-            logEntryArray.push_back({});
-            nlohmann::json &bmcJournalLogEntry = logEntryArray.back();
-            if (fillBMCJournalLogEntryJson(idStr, journal.get(),
-                                           bmcJournalLogEntry) != 0)
+            if (!index.getFilteredEntries(filter, skip, top, entryCount,
+                                          addEntry))
             {
                 messages::internalError(asyncResp->res);
                 return;
             }
         }
+        else
+        {
+            entryCount = index.size();
+            // Handle paging using skip (number of entries to skip from the
+            // start) and top (number of entries to display)
+            for (uint64_t i = skip; i < entryCount && i < skip + top; i++)
+            {
+                sd_journal *journal = index.seekEntry(i);
+                if (journal == nullptr)
+                {
+                    continue;
+                }
+                if (!addEntry(journal, index.entryID(i)))
+                {
+                    messages::internalError(asyncResp->res);
+                    return;
+                }
+            }
+        }
         asyncResp->res.jsonValue["Members@odata.count"] = entryCount;
         if (skip + top < entryCount)
         {
-            asyncResp->res.jsonValue["Members@odata.nextLink"] =
+            std::string nextLink =
                 "/redfish/v1/Managers/bmc/LogServices/Journal/Entries?$skip=" +
                 std::to_string(skip + top);
+            if (filterParam != nullptr)
+            {
+                nextLink += "&$filter=" + http_helpers::urlEncode(filterParam);
+            }
+            asyncResp->res.jsonValue["Members@odata.nextLink"] = nextLink;
         }
     }
 };
@@ -891,9 +1763,11 @@ class BMCJournalLogEntry : public Node
         {
             sd_journal_next(journal.get());
         }
-        // Confirm that the entry ID matches what was requested
-        std::string idStr;
-        if (!getUniqueEntryID(journal.get(), idStr) || idStr != entryID)
+        // Confirm that the entry is the one that was requested, which it's
+        // not if there are fewer entries at the timestamp than its index
+        uint64_t realtime = 0;
+        if (sd_journal_get_realtime_usec(journal.get(), &realtime) < 0 ||
+            realtime != ts)
         {
             messages::resourceMissingAtURI(asyncResp->res, entryID);
             return;
@@ -908,6 +1782,36 @@ class BMCJournalLogEntry : public Node
     }
 };
 
+class BMCJournalLogExport : public Node
+{
+  public:
+    template <typename CrowApp>
+    BMCJournalLogExport(CrowApp &app) :
+        Node(app, "/redfish/v1/Managers/bmc/LogServices/Journal/Export/")
+    {
+        entityPrivileges = {
+            {boost::beast::http::verb::get, {{"Login"}}},
+            {boost::beast::http::verb::head, {{"Login"}}},
+            {boost::beast::http::verb::patch, {{"ConfigureManager"}}},
+            {boost::beast::http::verb::put, {{"ConfigureManager"}}},
+            {boost::beast::http::verb::delete_, {{"ConfigureManager"}}},
+            {boost::beast::http::verb::post, {{"ConfigureManager"}}}};
+    }
+
+  private:
+    void doGet(crow::Response &res, const crow::Request &req,
+               const std::vector<std::string> &params) override
+    {
+        std::shared_ptr<AsyncResp> asyncResp = std::make_shared<AsyncResp>(res);
+        exportJournal(asyncResp, req, getBMCJournalIndex(), false,
+                      [](sd_journal *journal, const std::string &entryID,
+                         nlohmann::json &entry) {
+                          return fillBMCJournalLogEntryJson(entryID, journal,
+                                                            entry) == 0;
+                      });
+    }
+};
+
 class CPULogService : public Node
 {
   public:
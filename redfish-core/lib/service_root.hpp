@@ -63,6 +63,13 @@ class ServiceRoot : public Node
 
         res.jsonValue["UpdateService"] = {
             {"@odata.id", "/redfish/v1/UpdateService"}};
+#ifndef BMCWEB_ENABLE_REDFISH_RMC
+        // Not registered by RmcRedfishService
+        res.jsonValue["EventService"] = {
+            {"@odata.id", "/redfish/v1/EventService"}};
+        res.jsonValue["TelemetryService"] = {
+            {"@odata.id", "/redfish/v1/TelemetryService"}};
+#endif
 
         res.jsonValue["UUID"] = getUuid();
         res.end();
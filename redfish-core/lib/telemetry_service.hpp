@@ -0,0 +1,833 @@
+/*
+// Copyright (c) 2018 Intel Corporation
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+*/
+#pragma once
+
+#include "event_service_manager.hpp"
+#include "node.hpp"
+#include "sensors.hpp"
+#include "telemetry_service_manager.hpp"
+#include "utils/journal_filter.hpp"
+
+#include <boost/asio/steady_timer.hpp>
+#include <sdbusplus/bus/match.hpp>
+#include <utils/json_utils.hpp>
+
+namespace redfish
+{
+
+/**
+ * @brief Keeps the TelemetryService's sensor readings, and their history, up
+ *        to date: read once from every sensor service, then from their
+ *        PropertiesChanged signals
+ */
+class SensorValueFeed
+{
+  public:
+    SensorValueFeed()
+    {
+        valueMatch = std::make_unique<sdbusplus::bus::match::match>(
+            *crow::connections::systemBus,
+            "type='signal',interface='org.freedesktop.DBus.Properties',"
+            "member='PropertiesChanged',"
+            "path_namespace='/xyz/openbmc_project/sensors',"
+            "arg0='xyz.openbmc_project.Sensor.Value'",
+            [this](sdbusplus::message::message &m) {
+                std::string interface;
+                boost::container::flat_map<std::string, SensorVariant> values;
+                m.read(interface, values);
+                update(m.get_sender(), m.get_path(), values);
+            });
+        readSensors();
+    }
+
+    SensorValueFeed(const SensorValueFeed &) = delete;
+    SensorValueFeed &operator=(const SensorValueFeed &) = delete;
+
+  private:
+    static bool getDouble(const SensorVariant &variant, double &value)
+    {
+        if (const int64_t *int64Value = std::get_if<int64_t>(&variant))
+        {
+            value = static_cast<double>(*int64Value);
+            return true;
+        }
+        if (const double *doubleValue = std::get_if<double>(&variant))
+        {
+            value = *doubleValue;
+            return true;
+        }
+        return false;
+    }
+
+    // Applies the Value interface properties of the sensor at path, which
+    // service has
+    void update(const std::string &service, const std::string &path,
+                const boost::container::flat_map<std::string, SensorVariant>
+                    &properties)
+    {
+        auto scaleIt = properties.find("Scale");
+        if (scaleIt != properties.end())
+        {
+            const int64_t *scale = std::get_if<int64_t>(&scaleIt->second);
+            if (scale != nullptr)
+            {
+                scales[path] = *scale;
+            }
+        }
+        auto valueIt = properties.find("Value");
+        double value = 0;
+        if (valueIt == properties.end() || !getDouble(valueIt->second, value))
+        {
+            return;
+        }
+        auto scale = scales.find(path);
+        if (scale == scales.end())
+        {
+            // A sensor that wasn't there when they were all read, whose
+            // readings only say what they are once its Scale is known
+            readScale(service, path, value);
+            return;
+        }
+        record(path, value * std::pow(10, scale->second));
+    }
+
+    // Looks up the Scale of the sensor at path, holding on to its latest
+    // reading until it's known
+    void readScale(const std::string &service, const std::string &path,
+                   double value)
+    {
+        bool reading = unscaledValues.find(path) != unscaledValues.end();
+        unscaledValues[path] = value;
+        if (reading)
+        {
+            return;
+        }
+        crow::connections::systemBus->async_method_call(
+            [this, path](const boost::system::error_code ec,
+                         const SensorVariant &scaleVariant) {
+                int64_t scale = 0;
+                const int64_t *scaleValue = std::get_if<int64_t>(&scaleVariant);
+                if (ec || scaleValue == nullptr)
+                {
+                    // Taken as unscaled rather than asked for again
+                    BMCWEB_LOG_ERROR << "Failed to read Scale of " << path;
+                }
+                else
+                {
+                    scale = *scaleValue;
+                }
+                scales[path] = scale;
+                auto value = unscaledValues.find(path);
+                if (value == unscaledValues.end())
+                {
+                    return;
+                }
+                double scaled = value->second * std::pow(10, scale);
+                unscaledValues.erase(value);
+                record(path, scaled);
+            },
+            service, path, "org.freedesktop.DBus.Properties", "Get",
+            "xyz.openbmc_project.Sensor.Value", "Scale");
+    }
+
+    static void record(const std::string &path, double value)
+    {
+        TelemetryServiceManager &manager =
+            TelemetryServiceManager::getInstance();
+        manager.getSensorValues().update(path, value);
+        manager.getSensorHistory().record(
+            path, static_cast<uint32_t>(std::time(nullptr)), value);
+    }
+
+    void readSensors()
+    {
+        const std::array<std::string, 1> interfaces = {
+            "xyz.openbmc_project.Sensor.Value"};
+        crow::connections::systemBus->async_method_call(
+            [this](const boost::system::error_code ec,
+                   const GetSubTreeType &subtree) {
+                if (ec)
+                {
+                    BMCWEB_LOG_ERROR << "Failed to find sensors: " << ec;
+                    return;
+                }
+                boost::container::flat_set<std::string> connections;
+                for (const auto &[path, objects] : subtree)
+                {
+                    for (const auto &[connection, interfaces] : objects)
+                    {
+                        connections.insert(connection);
+                    }
+                }
+                for (const std::string &connection : connections)
+                {
+                    readConnection(connection);
+                }
+            },
+            "xyz.openbmc_project.ObjectMapper",
+            "/xyz/openbmc_project/object_mapper",
+            "xyz.openbmc_project.ObjectMapper", "GetSubTree",
+            "/xyz/openbmc_project/sensors", 2, interfaces);
+    }
+
+    void readConnection(const std::string &connection)
+    {
+        crow::connections::systemBus->async_method_call(
+            [this, connection](const boost::system::error_code ec,
+                   const ManagedObjectsVectorType &objects) {
+                if (ec)
+                {
+                    BMCWEB_LOG_ERROR << "Failed to read sensors: " << ec;
+                    return;
+                }
+                for (const auto &[path, interfaces] : objects)
+                {
+                    auto value =
+                        interfaces.find("xyz.openbmc_project.Sensor.Value");
+                    if (value != interfaces.end())
+                    {
+                        update(connection, path, value->second);
+                    }
+                }
+            },
+            connection, "/", "org.freedesktop.DBus.ObjectManager",
+            "GetManagedObjects");
+    }
+
+    // Scales of the sensors, which aren't sent with every new value
+    boost::container::flat_map<std::string, int64_t> scales;
+    // The latest readings of sensors whose Scale is being read
+    boost::container::flat_map<std::string, double> unscaledValues;
+    std::unique_ptr<sdbusplus::bus::match::match> valueMatch;
+};
+
+/**
+ * @brief Samples the metric report definitions as they fall due, and pushes
+ *        the reports of those that ask for it
+ */
+class MetricReportSampler
+{
+  public:
+    explicit MetricReportSampler(boost::asio::io_context &io) : timer(io)
+    {
+        tick();
+    }
+
+  private:
+    void tick()
+    {
+        timer.expires_after(MetricReportDefinition::minInterval);
+        timer.async_wait([this](const boost::system::error_code &ec) {
+            if (ec)
+            {
+                return;
+            }
+            uint64_t now =
+                std::chrono::duration_cast<std::chrono::milliseconds>(
+                    std::chrono::system_clock::now().time_since_epoch())
+                    .count();
+            TelemetryServiceManager::getInstance().sample(
+                now, [](const MetricReportDefinition &definition) {
+                    if (!definition.hasAction("RedfishEvent"))
+                    {
+                        return;
+                    }
+                    nlohmann::json report;
+                    definition.fillReport(report);
+                    EventServiceManager::getInstance().sendMetricReport(
+                        report);
+                });
+            tick();
+        });
+    }
+
+    boost::asio::steady_timer timer;
+};
+
+class TelemetryService : public Node
+{
+  public:
+    TelemetryService(CrowApp &app) :
+        Node(app, "/redfish/v1/TelemetryService/")
+    {
+        entityPrivileges = {
+            {boost::beast::http::verb::get, {{"Login"}}},
+            {boost::beast::http::verb::head, {{"Login"}}},
+            {boost::beast::http::verb::patch, {{"ConfigureManager"}}},
+            {boost::beast::http::verb::put, {{"ConfigureManager"}}},
+            {boost::beast::http::verb::delete_, {{"ConfigureManager"}}},
+            {boost::beast::http::verb::post, {{"ConfigureManager"}}}};
+
+        static std::unique_ptr<SensorValueFeed> feed;
+        static std::unique_ptr<MetricReportSampler> sampler;
+        if (feed == nullptr)
+        {
+            feed = std::make_unique<SensorValueFeed>();
+            sampler =
+                std::make_unique<MetricReportSampler>(*app.getIoContext());
+        }
+    }
+
+  private:
+    void doGet(crow::Response &res, const crow::Request &req,
+               const std::vector<std::string> &params) override
+    {
+        res.jsonValue = {
+            {"@odata.type", "#TelemetryService.v1_1_0.TelemetryService"},
+            {"@odata.context",
+             "/redfish/v1/$metadata#TelemetryService.TelemetryService"},
+            {"@odata.id", "/redfish/v1/TelemetryService"},
+            {"Id", "TelemetryService"},
+            {"Name", "Telemetry Service"},
+            {"Status", {{"State", "Enabled"}, {"Health", "OK"}}},
+            {"MaxReports", TelemetryServiceManager::maxReports},
+            {"MinCollectionInterval",
+             telemetry::formatDuration(MetricReportDefinition::minInterval)},
+            {"SupportedCollectionFunctions",
+             {"Average", "Maximum", "Minimum", "Summation"}},
+            {"MetricReportDefinitions",
+             {{"@odata.id",
+               "/redfish/v1/TelemetryService/MetricReportDefinitions"}}},
+            {"MetricReports",
+             {{"@odata.id", "/redfish/v1/TelemetryService/MetricReports"}}},
+            {"Oem",
+             {{"OpenBmc",
+               {{"SensorHistory",
+                 {{"@odata.id", "/redfish/v1/TelemetryService/Oem/OpenBmc/"
+                                "SensorHistory"}}}}}}}};
+        res.end();
+    }
+};
+
+/**
+ * @brief Reads the Metrics of a new MetricReportDefinition, one Metric for
+ *        each of their MetricProperties, up to the definition's limits
+ */
+static bool readMetrics(crow::Response &res,
+                        std::vector<nlohmann::json> &metricsJson,
+                        std::chrono::milliseconds interval,
+                        std::vector<Metric> &metrics)
+{
+    size_t samples = 0;
+    for (nlohmann::json &metricJson : metricsJson)
+    {
+        std::optional<std::string> metricId;
+        std::vector<std::string> properties;
+        std::optional<std::string> functionName;
+        std::optional<std::string> durationText;
+        if (!json_util::readJson(metricJson, res, "MetricId", metricId,
+                                 "MetricProperties", properties,
+                                 "CollectionFunction", functionName,
+                                 "CollectionDuration", durationText))
+        {
+            return false;
+        }
+        std::optional<CollectionFunction> function;
+        if (functionName)
+        {
+            function = getCollectionFunction(*functionName);
+            if (!function)
+            {
+                messages::propertyValueNotInList(res, *functionName,
+                                                 "CollectionFunction");
+                return false;
+            }
+        }
+        // By default the samples of one interval are aggregated
+        std::chrono::milliseconds duration = interval;
+        if (durationText &&
+            (!telemetry::parseDuration(*durationText, duration) ||
+             duration < interval))
+        {
+            messages::propertyValueFormatError(res, *durationText,
+                                               "CollectionDuration");
+            return false;
+        }
+        if (properties.empty())
+        {
+            messages::propertyMissing(res, "MetricProperties");
+            return false;
+        }
+        size_t metricSamples =
+            Metric::getSampleCount(function, duration, interval);
+        if (metricSamples > Metric::maxSamples)
+        {
+            // Longer than the samples kept for it would cover
+            messages::propertyValueOutOfRange(
+                res, durationText.value_or(""), "CollectionDuration");
+            return false;
+        }
+        samples += properties.size() * metricSamples;
+        if (metrics.size() + properties.size() >
+                MetricReportDefinition::maxMetrics ||
+            samples > MetricReportDefinition::maxSamples)
+        {
+            // The first metric that doesn't fit
+            messages::propertyValueFormatError(
+                res, metricId.value_or(properties.front()), "Metrics");
+            return false;
+        }
+        for (const std::string &property : properties)
+        {
+            std::vector<std::string> sensorPaths;
+            if (!parseMetricProperty(property, sensorPaths))
+            {
+                messages::propertyValueFormatError(res, property,
+                                                   "MetricProperties");
+                return false;
+            }
+            metrics.emplace_back(metricId.value_or(property), property,
+                                 std::move(sensorPaths), function, duration,
+                                 interval);
+        }
+    }
+    return true;
+}
+
+class MetricReportDefinitionCollection : public Node
+{
+  public:
+    MetricReportDefinitionCollection(CrowApp &app) :
+        Node(app, "/redfish/v1/TelemetryService/MetricReportDefinitions/")
+    {
+        entityPrivileges = {
+            {boost::beast::http::verb::get, {{"Login"}}},
+            {boost::beast::http::verb::head, {{"Login"}}},
+            {boost::beast::http::verb::patch, {{"ConfigureManager"}}},
+            {boost::beast::http::verb::put, {{"ConfigureManager"}}},
+            {boost::beast::http::verb::delete_, {{"ConfigureManager"}}},
+            {boost::beast::http::verb::post, {{"ConfigureManager"}}}};
+    }
+
+  private:
+    void doGet(crow::Response &res, const crow::Request &req,
+               const std::vector<std::string> &params) override
+    {
+        res.jsonValue = {
+            {"@odata.type", "#MetricReportDefinitionCollection."
+                            "MetricReportDefinitionCollection"},
+            {"@odata.context", "/redfish/v1/"
+                               "$metadata#MetricReportDefinitionCollection."
+                               "MetricReportDefinitionCollection"},
+            {"@odata.id",
+             "/redfish/v1/TelemetryService/MetricReportDefinitions"},
+            {"Name", "Metric Report Definition Collection"}};
+        nlohmann::json &members = res.jsonValue["Members"];
+        members = nlohmann::json::array();
+        for (const auto &[id, definition] :
+             TelemetryServiceManager::getInstance().getDefinitions())
+        {
+            members.push_back(
+                {{"@odata.id",
+                  "/redfish/v1/TelemetryService/MetricReportDefinitions/" +
+                      id}});
+        }
+        res.jsonValue["Members@odata.count"] = members.size();
+        res.end();
+    }
+
+    void doPost(crow::Response &res, const crow::Request &req,
+                const std::vector<std::string> &params) override
+    {
+        std::string id;
+        std::optional<std::string> type;
+        nlohmann::json schedule;
+        std::optional<std::vector<std::string>> reportActions;
+        std::vector<nlohmann::json> metricsJson;
+        if (!json_util::readJson(req, res, "Id", id,
+                                 "MetricReportDefinitionType", type,
+                                 "Schedule", schedule, "ReportActions",
+                                 reportActions, "Metrics", metricsJson))
+        {
+            res.end();
+            return;
+        }
+        if (id.empty() ||
+            id.find_first_not_of("ABCDEFGHIJKLMNOPQRSTUVWXYZ"
+                                 "abcdefghijklmnopqrstuvwxyz0123456789_-") !=
+                std::string::npos)
+        {
+            messages::propertyValueFormatError(res, id, "Id");
+            res.end();
+            return;
+        }
+        if (type && *type != "Periodic")
+        {
+            messages::propertyValueNotInList(res, *type,
+                                             "MetricReportDefinitionType");
+            res.end();
+            return;
+        }
+        std::string intervalText;
+        if (!json_util::readJson(schedule, res, "RecurrenceInterval",
+                                 intervalText))
+        {
+            res.end();
+            return;
+        }
+        std::chrono::milliseconds interval;
+        if (!telemetry::parseDuration(intervalText, interval) ||
+            interval < MetricReportDefinition::minInterval)
+        {
+            messages::propertyValueFormatError(res, intervalText,
+                                               "RecurrenceInterval");
+            res.end();
+            return;
+        }
+        std::vector<std::string> actions = {"LogToMetricReportsCollection"};
+        if (reportActions)
+        {
+            for (const std::string &action : *reportActions)
+            {
+                if (action != "LogToMetricReportsCollection" &&
+                    action != "RedfishEvent")
+                {
+                    messages::propertyValueNotInList(res, action,
+                                                     "ReportActions");
+                    res.end();
+                    return;
+                }
+            }
+            actions = std::move(*reportActions);
+        }
+        std::vector<Metric> metrics;
+        if (!readMetrics(res, metricsJson, interval, metrics))
+        {
+            res.end();
+            return;
+        }
+
+        TelemetryServiceManager &manager =
+            TelemetryServiceManager::getInstance();
+        if (manager.getDefinition(id) != nullptr)
+        {
+            messages::resourceAlreadyExists(res, "MetricReportDefinition",
+                                            "Id", id);
+            res.end();
+            return;
+        }
+        if (!manager.addDefinition(std::make_shared<MetricReportDefinition>(
+                id, interval, std::move(actions), std::move(metrics))))
+        {
+            messages::createLimitReachedForResource(res);
+            res.end();
+            return;
+        }
+        messages::created(res);
+        res.addHeader("Location",
+                      "/redfish/v1/TelemetryService/MetricReportDefinitions/" +
+                          id);
+        res.end();
+    }
+};
+
+class MetricReportDefinitionEntry : public Node
+{
+  public:
+    MetricReportDefinitionEntry(CrowApp &app) :
+        Node(app, "/redfish/v1/TelemetryService/MetricReportDefinitions/<str>/",
+             std::string())
+    {
+        entityPrivileges = {
+            {boost::beast::http::verb::get, {{"Login"}}},
+            {boost::beast::http::verb::head, {{"Login"}}},
+            {boost::beast::http::verb::patch, {{"ConfigureManager"}}},
+            {boost::beast::http::verb::put, {{"ConfigureManager"}}},
+            {boost::beast::http::verb::delete_, {{"ConfigureManager"}}},
+            {boost::beast::http::verb::post, {{"ConfigureManager"}}}};
+    }
+
+  private:
+    void doGet(crow::Response &res, const crow::Request &req,
+               const std::vector<std::string> &params) override
+    {
+        if (params.size() != 1)
+        {
+            messages::internalError(res);
+            res.end();
+            return;
+        }
+        std::shared_ptr<MetricReportDefinition> definition =
+            TelemetryServiceManager::getInstance().getDefinition(params[0]);
+        if (definition == nullptr)
+        {
+            messages::resourceNotFound(res, "MetricReportDefinition",
+                                       params[0]);
+            res.end();
+            return;
+        }
+        definition->fillDefinition(res.jsonValue);
+        res.end();
+    }
+
+    void doDelete(crow::Response &res, const crow::Request &req,
+                  const std::vector<std::string> &params) override
+    {
+        if (params.size() != 1)
+        {
+            messages::internalError(res);
+            res.end();
+            return;
+        }
+        if (!TelemetryServiceManager::getInstance().removeDefinition(
+                params[0]))
+        {
+            messages::resourceNotFound(res, "MetricReportDefinition",
+                                       params[0]);
+            res.end();
+            return;
+        }
+        messages::success(res);
+        res.end();
+    }
+};
+
+class MetricReportCollection : public Node
+{
+  public:
+    MetricReportCollection(CrowApp &app) :
+        Node(app, "/redfish/v1/TelemetryService/MetricReports/")
+    {
+        entityPrivileges = {
+            {boost::beast::http::verb::get, {{"Login"}}},
+            {boost::beast::http::verb::head, {{"Login"}}},
+            {boost::beast::http::verb::patch, {{"ConfigureManager"}}},
+            {boost::beast::http::verb::put, {{"ConfigureManager"}}},
+            {boost::beast::http::verb::delete_, {{"ConfigureManager"}}},
+            {boost::beast::http::verb::post, {{"ConfigureManager"}}}};
+    }
+
+  private:
+    void doGet(crow::Response &res, const crow::Request &req,
+               const std::vector<std::string> &params) override
+    {
+        res.jsonValue = {
+            {"@odata.type", "#MetricReportCollection.MetricReportCollection"},
+            {"@odata.context", "/redfish/v1/"
+                               "$metadata#MetricReportCollection."
+                               "MetricReportCollection"},
+            {"@odata.id", "/redfish/v1/TelemetryService/MetricReports"},
+            {"Name", "Metric Report Collection"}};
+        nlohmann::json &members = res.jsonValue["Members"];
+        members = nlohmann::json::array();
+        for (const auto &[id, definition] :
+             TelemetryServiceManager::getInstance().getDefinitions())
+        {
+            if (definition->hasAction("LogToMetricReportsCollection"))
+            {
+                members.push_back(
+                    {{"@odata.id",
+                      "/redfish/v1/TelemetryService/MetricReports/" + id}});
+            }
+        }
+        res.jsonValue["Members@odata.count"] = members.size();
+        res.end();
+    }
+};
+
+class MetricReport : public Node
+{
+  public:
+    MetricReport(CrowApp &app) :
+        Node(app, "/redfish/v1/TelemetryService/MetricReports/<str>/",
+             std::string())
+    {
+        entityPrivileges = {
+            {boost::beast::http::verb::get, {{"Login"}}},
+            {boost::beast::http::verb::head, {{"Login"}}},
+            {boost::beast::http::verb::patch, {{"ConfigureManager"}}},
+            {boost::beast::http::verb::put, {{"ConfigureManager"}}},
+            {boost::beast::http::verb::delete_, {{"ConfigureManager"}}},
+            {boost::beast::http::verb::post, {{"ConfigureManager"}}}};
+    }
+
+  private:
+    void doGet(crow::Response &res, const crow::Request &req,
+               const std::vector<std::string> &params) override
+    {
+        if (params.size() != 1)
+        {
+            messages::internalError(res);
+            res.end();
+            return;
+        }
+        std::shared_ptr<MetricReportDefinition> definition =
+            TelemetryServiceManager::getInstance().getDefinition(params[0]);
+        if (definition == nullptr ||
+            !definition->hasAction("LogToMetricReportsCollection"))
+        {
+            messages::resourceNotFound(res, "MetricReport", params[0]);
+            res.end();
+            return;
+        }
+        definition->fillReport(res.jsonValue);
+        res.end();
+    }
+};
+
+class SensorHistoryCollection : public Node
+{
+  public:
+    SensorHistoryCollection(CrowApp &app) :
+        Node(app, "/redfish/v1/TelemetryService/Oem/OpenBmc/SensorHistory/")
+    {
+        entityPrivileges = {
+            {boost::beast::http::verb::get, {{"Login"}}},
+            {boost::beast::http::verb::head, {{"Login"}}},
+            {boost::beast::http::verb::patch, {{"ConfigureManager"}}},
+            {boost::beast::http::verb::put, {{"ConfigureManager"}}},
+            {boost::beast::http::verb::delete_, {{"ConfigureManager"}}},
+            {boost::beast::http::verb::post, {{"ConfigureManager"}}}};
+    }
+
+  private:
+    void doGet(crow::Response &res, const crow::Request &req,
+               const std::vector<std::string> &params) override
+    {
+        const SensorHistory &history =
+            TelemetryServiceManager::getInstance().getSensorHistory();
+        res.jsonValue = {
+            {"@odata.id",
+             "/redfish/v1/TelemetryService/Oem/OpenBmc/SensorHistory"},
+            {"Name", "Sensor History Collection"},
+            {"MaxSensors", SensorHistory::maxSensors},
+            {"MemoryBytes", history.memoryUsage()}};
+        nlohmann::json &members = res.jsonValue["Members"];
+        members = nlohmann::json::array();
+        constexpr boost::string_view prefix = "/xyz/openbmc_project/sensors/";
+        for (const auto &[path, series] : history.getSeries())
+        {
+            boost::string_view sensor(path);
+            if (sensor.starts_with(prefix))
+            {
+                sensor.remove_prefix(prefix.size());
+                members.push_back(
+                    {{"@odata.id",
+                      "/redfish/v1/TelemetryService/Oem/OpenBmc/"
+                      "SensorHistory/" +
+                          sensor.to_string()}});
+            }
+        }
+        res.jsonValue["Members@odata.count"] = members.size();
+        res.end();
+    }
+};
+
+class SensorHistoryEntry : public Node
+{
+  public:
+    SensorHistoryEntry(CrowApp &app) :
+        Node(app,
+             "/redfish/v1/TelemetryService/Oem/OpenBmc/SensorHistory/<str>/"
+             "<str>/",
+             std::string(), std::string())
+    {
+        entityPrivileges = {
+            {boost::beast::http::verb::get, {{"Login"}}},
+            {boost::beast::http::verb::head, {{"Login"}}},
+            {boost::beast::http::verb::patch, {{"ConfigureManager"}}},
+            {boost::beast::http::verb::put, {{"ConfigureManager"}}},
+            {boost::beast::http::verb::delete_, {{"ConfigureManager"}}},
+            {boost::beast::http::verb::post, {{"ConfigureManager"}}}};
+    }
+
+  private:
+    // Reads a DateTime query parameter as seconds since the epoch
+    static bool readTime(crow::Response &res, const crow::Request &req,
+                         const char *name, uint32_t &seconds)
+    {
+        char *param = req.urlParams.get(name);
+        if (param == nullptr)
+        {
+            return true;
+        }
+        uint64_t usec = 0;
+        if (!journal_filter::parseTimestamp(param, usec) ||
+            usec / 1000000 > std::numeric_limits<uint32_t>::max())
+        {
+            messages::queryParameterValueFormatError(res, param, name);
+            return false;
+        }
+        seconds = static_cast<uint32_t>(usec / 1000000);
+        return true;
+    }
+
+    /**
+     * Returns the readings of a sensor between the start and end query
+     * parameters, by default those of the last hour, as [seconds since the
+     * epoch, value] pairs.  Older readings come at a coarser resolution.
+     */
+    void doGet(crow::Response &res, const crow::Request &req,
+               const std::vector<std::string> &params) override
+    {
+        if (params.size() != 2)
+        {
+            messages::internalError(res);
+            res.end();
+            return;
+        }
+        const std::string &type = params[0];
+        const std::string &name = params[1];
+        const TimeSeries *series =
+            TelemetryServiceManager::getInstance().getSensorHistory().get(
+                "/xyz/openbmc_project/sensors/" + type + "/" + name);
+        if (series == nullptr)
+        {
+            messages::resourceNotFound(res, "SensorHistory", name);
+            res.end();
+            return;
+        }
+
+        uint32_t end = static_cast<uint32_t>(std::time(nullptr));
+        if (!readTime(res, req, "end", end))
+        {
+            res.end();
+            return;
+        }
+        uint32_t start = end > 3600 ? end - 3600 : 0;
+        if (!readTime(res, req, "start", start))
+        {
+            res.end();
+            return;
+        }
+        if (start > end)
+        {
+            messages::queryParameterOutOfRange(
+                res, std::to_string(start), "start", "no later than end");
+            res.end();
+            return;
+        }
+
+        nlohmann::json readings = nlohmann::json::array();
+        series->query(start, end, [&readings](uint32_t timestamp,
+                                              double value) {
+            readings.push_back({timestamp, value});
+        });
+        res.jsonValue = {
+            {"@odata.id", "/redfish/v1/TelemetryService/Oem/OpenBmc/"
+                          "SensorHistory/" +
+                              type + "/" + name},
+            {"Id", name},
+            {"Name", "Sensor History " + name},
+            {"SensorType", type},
+            {"Start", telemetry::formatTimestamp(start * 1000ULL)},
+            {"End", telemetry::formatTimestamp(end * 1000ULL)},
+            {"Readings", std::move(readings)}};
+        res.end();
+    }
+};
+
+} // namespace redfish
@@ -496,6 +496,34 @@ void propertyValueNotInList(crow::Response& res, const std::string& arg1,
         arg2);
 }
 
+/**
+ * @internal
+ * @brief Formats PropertyValueOutOfRange message into JSON for the specified
+ * property
+ *
+ * See header file for more information
+ * @endinternal
+ */
+void propertyValueOutOfRange(crow::Response& res, const std::string& arg1,
+                             const std::string& arg2)
+{
+    res.result(boost::beast::http::status::bad_request);
+    addMessageToJson(
+        res.jsonValue,
+        nlohmann::json{
+            {"@odata.type", "/redfish/v1/$metadata#Message.v1_0_0.Message"},
+            {"MessageId", "Base.1.8.1.PropertyValueOutOfRange"},
+            {"Message", "The value " + arg1 + " for the property " + arg2 +
+                            " is not in the supported range of acceptable "
+                            "values."},
+            {"MessageArgs", {arg1, arg2}},
+            {"Severity", "Warning"},
+            {"Resolution",
+             "Correct the value for the property in the request body and "
+             "resubmit the request if the operation failed."}},
+        arg2);
+}
+
 /**
  * @internal
  * @brief Formats ResourceAtUriInUnknownFormat message into JSON
@@ -0,0 +1,388 @@
+#include "event_service_manager.hpp"
+
+#include <boost/asio/ip/tcp.hpp>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "gmock/gmock.h"
+
+using namespace redfish;
+
+TEST(EventServiceTest, FilterMatchesPrefixAndOrigin)
+{
+    Event event;
+    event.messageId = "OpenBMC.0.1.DCPowerOff";
+    event.originOfCondition = "/redfish/v1/Systems/system";
+
+    EventFilter filter;
+    EXPECT_TRUE(filter.matches(event));
+
+    ASSERT_TRUE(parseSseFilter("RegistryPrefix eq 'OpenBMC' or "
+                               "OriginResource eq '/redfish/v1/Systems'",
+                               filter));
+    EXPECT_TRUE(filter.matches(event));
+
+    event.originOfCondition = "/redfish/v1/SystemsElsewhere";
+    EXPECT_FALSE(filter.matches(event));
+
+    event.originOfCondition = "/redfish/v1/Systems/system";
+    event.messageId = "Base.1.4.Success";
+    EXPECT_FALSE(filter.matches(event));
+
+    EventFilter bad;
+    EXPECT_FALSE(parseSseFilter("MessageId eq 'x'", bad));
+    EXPECT_FALSE(parseSseFilter("RegistryPrefix ne 'x'", bad));
+    EXPECT_FALSE(parseSseFilter("RegistryPrefix eq 'x' xor", bad));
+}
+
+TEST(EventServiceTest, ParseDestination)
+{
+    std::string host;
+    std::string port;
+    std::string target;
+    ASSERT_TRUE(parseDestination("http://10.0.0.1:8080/events", host, port,
+                                 target));
+    EXPECT_EQ(host, "10.0.0.1");
+    EXPECT_EQ(port, "8080");
+    EXPECT_EQ(target, "/events");
+
+    ASSERT_TRUE(parseDestination("http://[fe80::1]", host, port, target));
+    EXPECT_EQ(host, "fe80::1");
+    EXPECT_EQ(port, "80");
+    EXPECT_EQ(target, "/");
+
+    EXPECT_FALSE(parseDestination("ftp://host/", host, port, target));
+    EXPECT_FALSE(parseDestination("http://host:port/", host, port, target));
+    // Names would have to be looked up on the event path
+    EXPECT_FALSE(
+        parseDestination("http://listener/events", host, port, target));
+    EXPECT_FALSE(
+        parseDestination("http://10.0.0.1:99999/", host, port, target));
+    EXPECT_FALSE(parseDestination("http:///path", host, port, target));
+}
+
+TEST(EventServiceTest, RetryDelayBacksOff)
+{
+    RetryPolicy policy;
+    policy.initialDelay = std::chrono::milliseconds(100);
+    policy.maxDelay = std::chrono::milliseconds(1000);
+    EXPECT_EQ(getRetryDelay(policy, 1).count(), 100);
+    EXPECT_EQ(getRetryDelay(policy, 2).count(), 200);
+    EXPECT_EQ(getRetryDelay(policy, 4).count(), 800);
+    EXPECT_EQ(getRetryDelay(policy, 5).count(), 1000);
+    EXPECT_EQ(getRetryDelay(policy, 50).count(), 1000);
+}
+
+namespace
+{
+// An HTTP listener that answers the first failures requests with 503 and
+// the rest with 204, recording the bodies it accepted
+class EventSink : public std::enable_shared_from_this<EventSink>
+{
+  public:
+    EventSink(boost::asio::io_context& io, size_t failures) :
+        io(io), acceptor(io, {boost::asio::ip::make_address("127.0.0.1"), 0}),
+        failures(failures)
+    {
+    }
+
+    std::string destination()
+    {
+        return "http://127.0.0.1:" +
+               std::to_string(acceptor.local_endpoint().port()) + "/events";
+    }
+
+    void accept()
+    {
+        auto socket = std::make_shared<boost::asio::ip::tcp::socket>(io);
+        acceptor.async_accept(
+            *socket, [self(shared_from_this()),
+                      socket](const boost::system::error_code& ec) {
+                if (ec)
+                {
+                    return;
+                }
+                self->connections++;
+                self->read(socket, std::make_shared<Session>());
+                self->accept();
+            });
+    }
+
+    std::vector<std::string> received;
+    size_t requests = 0;
+    size_t connections = 0;
+
+  private:
+    struct Session
+    {
+        boost::beast::flat_buffer buffer;
+        boost::beast::http::request<boost::beast::http::string_body> request;
+        boost::beast::http::response<boost::beast::http::empty_body>
+            response;
+    };
+
+    void read(const std::shared_ptr<boost::asio::ip::tcp::socket>& socket,
+              const std::shared_ptr<Session>& session)
+    {
+        session->request = {};
+        boost::beast::http::async_read(
+            *socket, session->buffer, session->request,
+            [self(shared_from_this()), socket,
+             session](const boost::system::error_code& ec, size_t) {
+                if (ec)
+                {
+                    return;
+                }
+                self->requests++;
+                bool fail = self->requests <= self->failures;
+                if (!fail)
+                {
+                    self->received.push_back(session->request.body());
+                }
+                session->response = {};
+                session->response.version(11);
+                session->response.result(
+                    fail ? boost::beast::http::status::service_unavailable
+                         : boost::beast::http::status::no_content);
+                session->response.keep_alive(true);
+                session->response.prepare_payload();
+                boost::beast::http::async_write(
+                    *socket, session->response,
+                    [self, socket, session](const boost::system::error_code& ec,
+                                            size_t) {
+                        if (!ec)
+                        {
+                            self->read(socket, session);
+                        }
+                    });
+            });
+    }
+
+    boost::asio::io_context& io;
+    boost::asio::ip::tcp::acceptor acceptor;
+    size_t failures;
+};
+
+// Runs io until done() holds, or a few seconds have passed
+template <typename Predicate>
+void runUntil(boost::asio::io_context& io, Predicate done)
+{
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(5);
+    while (!done() && std::chrono::steady_clock::now() < deadline)
+    {
+        io.run_one_for(std::chrono::milliseconds(100));
+    }
+}
+
+std::shared_ptr<PushSubscription>
+    makeSubscription(boost::asio::io_context& io, const std::string& url,
+                     size_t attempts, size_t maxQueue)
+{
+    std::string host;
+    std::string port;
+    std::string target;
+    parseDestination(url, host, port, target);
+    RetryPolicy policy;
+    policy.attempts = attempts;
+    policy.initialDelay = std::chrono::milliseconds(1);
+    policy.maxDelay = std::chrono::milliseconds(4);
+    return std::make_shared<PushSubscription>(io, "1", EventFilter(), "ctx",
+                                              url, host, port, target, policy,
+                                              maxQueue);
+}
+} // namespace
+
+TEST(EventServiceTest, PushRetriesThenDeliversInOrder)
+{
+    boost::asio::io_context io;
+    auto sink = std::make_shared<EventSink>(io, 3);
+    sink->accept();
+    auto subscription = makeSubscription(io, sink->destination(), 5, 16);
+
+    subscription->sendEvent("first", 0);
+    subscription->sendEvent("second", 0);
+    subscription->sendEvent("third", 0);
+    runUntil(io, [&subscription] { return subscription->queuedEvents() == 0; });
+
+    EXPECT_THAT(sink->received,
+                ::testing::ElementsAre("first", "second", "third"));
+    EXPECT_EQ(sink->requests, 6);
+    EXPECT_EQ(subscription->droppedEvents, 0);
+    EXPECT_EQ(subscription->queuedEvents(), 0);
+}
+
+TEST(EventServiceTest, PushDropsWhenQueueOrAttemptsRunOut)
+{
+    boost::asio::io_context io;
+    auto sink = std::make_shared<EventSink>(io, 2);
+    sink->accept();
+    auto subscription = makeSubscription(io, sink->destination(), 2, 2);
+
+    // "a" is being delivered, so "b" makes way for "c"
+    subscription->sendEvent("a", 0);
+    subscription->sendEvent("b", 0);
+    subscription->sendEvent("c", 0);
+    runUntil(io, [&subscription] { return subscription->queuedEvents() == 0; });
+
+    // "a" fails both of its attempts, after which "c" goes through
+    EXPECT_THAT(sink->received, ::testing::ElementsAre("c"));
+    EXPECT_EQ(subscription->droppedEvents, 2);
+}
+
+TEST(EventServiceTest, ManagerSendsToMatchingSubscribers)
+{
+    boost::asio::io_context io;
+    auto sink = std::make_shared<EventSink>(io, 0);
+    sink->accept();
+
+    std::string host;
+    std::string port;
+    std::string target;
+    parseDestination(sink->destination(), host, port, target);
+    EventFilter filter;
+    filter.registryPrefixes = {"OpenBMC"};
+    EventServiceManager& manager = EventServiceManager::getInstance();
+    std::string id = manager.getNewId();
+    ASSERT_TRUE(manager.addSubscription(std::make_shared<PushSubscription>(
+        io, id, std::move(filter), "mine", sink->destination(), host, port,
+        target)));
+
+    Event event;
+    event.messageId = "Base.1.4.Success";
+    manager.sendEvent(event);
+    event.messageId = "OpenBMC.0.1.DCPowerOn";
+    event.message = "Host system DC power is on.";
+    manager.sendEvent(event);
+    runUntil(io, [&sink] { return sink->received.size() == 1; });
+    // Long enough for anything that shouldn't have been sent to arrive
+    io.run_for(std::chrono::milliseconds(50));
+
+    ASSERT_EQ(sink->received.size(), 1);
+    nlohmann::json payload = nlohmann::json::parse(sink->received[0]);
+    EXPECT_EQ(payload["Context"], "mine");
+    EXPECT_EQ(payload["Events"][0]["MessageId"], "OpenBMC.0.1.DCPowerOn");
+
+    EXPECT_TRUE(manager.removeSubscription(id));
+    EXPECT_EQ(manager.getSubscription(id), nullptr);
+}
+
+namespace
+{
+class RecordingSubscription : public Subscription
+{
+  public:
+    RecordingSubscription(const std::string& id, EventFilter&& filter,
+                          bool sse = false) :
+        Subscription(id, std::move(filter), "ctx-" + id),
+        sse(sse)
+    {
+    }
+
+    void sendEvent(std::string&& payload, uint64_t eventId) override
+    {
+        payloads.emplace_back(std::move(payload));
+        eventIds.push_back(eventId);
+    }
+
+    bool isSse() const override
+    {
+        return sse;
+    }
+
+    void fillJson(nlohmann::json&) const override
+    {
+    }
+
+    const bool sse;
+    std::vector<std::string> payloads;
+    std::vector<uint64_t> eventIds;
+};
+} // namespace
+
+TEST(EventServiceTest, MetricReportsGoToTheirSubscribers)
+{
+    EventFilter reportFilter;
+    ASSERT_TRUE(parseSseFilter("EventFormatType eq 'MetricReport'",
+                               reportFilter));
+    EventServiceManager& manager = EventServiceManager::getInstance();
+    auto events = std::make_shared<RecordingSubscription>(manager.getNewId(),
+                                                          EventFilter());
+    auto reports = std::make_shared<RecordingSubscription>(
+        manager.getNewId(), std::move(reportFilter));
+    ASSERT_TRUE(manager.addSubscription(events));
+    ASSERT_TRUE(manager.addSubscription(reports));
+
+    Event event;
+    event.messageId = "OpenBMC.0.1.DCPowerOn";
+    manager.sendEvent(event);
+    manager.sendMetricReport({{"Id", "Fans"}});
+
+    ASSERT_EQ(events->payloads.size(), 1);
+    ASSERT_EQ(reports->payloads.size(), 1);
+    nlohmann::json report = nlohmann::json::parse(reports->payloads[0]);
+    EXPECT_EQ(report["Id"], "Fans");
+    EXPECT_EQ(report["Context"], "ctx-" + reports->id);
+    // The event's id is the one an SSE stream gives it, and the report is
+    // numbered after it
+    nlohmann::json sent = nlohmann::json::parse(events->payloads[0]);
+    EXPECT_EQ(sent["Id"], std::to_string(events->eventIds[0]));
+    EXPECT_EQ(reports->eventIds[0], events->eventIds[0] + 1);
+
+    EXPECT_TRUE(manager.removeSubscription(events->id));
+    EXPECT_TRUE(manager.removeSubscription(reports->id));
+}
+
+TEST(EventServiceTest, EachKindOfSubscriptionHasItsOwnLimit)
+{
+    EventServiceManager& manager = EventServiceManager::getInstance();
+    std::vector<std::string> ids;
+    for (size_t i = 0; i < EventServiceManager::maxSseSubscriptions; i++)
+    {
+        ids.push_back(manager.getNewId());
+        ASSERT_TRUE(manager.addSubscription(
+            std::make_shared<RecordingSubscription>(ids.back(), EventFilter(),
+                                                    true)));
+    }
+    crow::Response sseRes;
+    EXPECT_FALSE(manager.addSubscription(
+        std::make_shared<RecordingSubscription>(manager.getNewId(),
+                                                EventFilter(), true),
+        sseRes));
+    EXPECT_EQ(sseRes.result(),
+              boost::beast::http::status::service_unavailable);
+    EXPECT_EQ(sseRes.jsonValue["error"]["@Message.ExtendedInfo"][0]
+                                ["MessageArgs"][0],
+              "/redfish/v1/EventService/SSE");
+
+    // The streams leave room for as many destinations
+    for (size_t i = 0; i < EventServiceManager::maxPushSubscriptions; i++)
+    {
+        ids.push_back(manager.getNewId());
+        ASSERT_TRUE(manager.addSubscription(
+            std::make_shared<RecordingSubscription>(ids.back(),
+                                                    EventFilter())));
+    }
+    crow::Response pushRes;
+    EXPECT_FALSE(manager.addSubscription(
+        std::make_shared<RecordingSubscription>(manager.getNewId(),
+                                                EventFilter()),
+        pushRes));
+    EXPECT_EQ(pushRes.result(),
+              boost::beast::http::status::service_unavailable);
+    EXPECT_EQ(pushRes.jsonValue["error"]["@Message.ExtendedInfo"][0]
+                                ["MessageArgs"][0],
+              "/redfish/v1/EventService/Subscriptions");
+
+    // Removing one makes room again
+    EXPECT_TRUE(manager.removeSubscription(ids.back()));
+    ids.pop_back();
+    ids.push_back(manager.getNewId());
+    EXPECT_TRUE(manager.addSubscription(
+        std::make_shared<RecordingSubscription>(ids.back(), EventFilter())));
+
+    for (const std::string& id : ids)
+    {
+        EXPECT_TRUE(manager.removeSubscription(id));
+    }
+}
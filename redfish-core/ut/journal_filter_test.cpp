@@ -0,0 +1,64 @@
+#include "utils/journal_filter.hpp"
+
+#include <string>
+
+#include "gmock/gmock.h"
+
+using namespace redfish;
+
+TEST(JournalFilterTest, SeverityAndMessageId)
+{
+    JournalFilter filter;
+    EXPECT_TRUE(parseJournalFilter(
+        "Severity eq 'Warning' and MessageId eq 'OpenBMC.0.1.DCPowerOff'",
+        true, filter));
+    EXPECT_THAT(filter.matches,
+                ::testing::ElementsAre(
+                    "PRIORITY=3", "PRIORITY=4",
+                    "REDFISH_MESSAGE_ID=OpenBMC.0.1.DCPowerOff"));
+    EXPECT_EQ(filter.since, 0);
+
+    // Journal entries have no MessageId
+    filter = JournalFilter();
+    EXPECT_FALSE(
+        parseJournalFilter("MessageId eq 'OpenBMC.0.1.DCPowerOff'", false,
+                           filter));
+}
+
+TEST(JournalFilterTest, CreatedRange)
+{
+    JournalFilter filter;
+    EXPECT_TRUE(parseJournalFilter("Created ge 2019-05-01T00:00:00+00:00 and "
+                                   "Created lt '2019-05-01T02:00:00+01:00'",
+                                   false, filter));
+    EXPECT_TRUE(filter.matches.empty());
+    EXPECT_EQ(filter.since, 1556668800ULL * 1000 * 1000);
+    EXPECT_EQ(filter.until, 1556672400ULL * 1000 * 1000 - 1);
+
+    // A bound covers the whole second it names
+    filter = JournalFilter();
+    EXPECT_TRUE(
+        parseJournalFilter("Created le 2019-05-01T00:00:00Z", false, filter));
+    EXPECT_EQ(filter.until, 1556668801ULL * 1000 * 1000 - 1);
+}
+
+TEST(JournalFilterTest, RejectsUnsupported)
+{
+    const char* filters[] = {
+        "",
+        "Severity eq 'Fatal'",
+        "Severity ne 'OK'",
+        "Severity eq OK",
+        "Severity eq 'OK' and Severity eq 'Warning'",
+        "Severity eq 'OK' or Severity eq 'Warning'",
+        "Message eq 'hello'",
+        "Created ge yesterday",
+        "Created ge 2019-05-01T00:00:00+00:00 and "
+        "Created lt 2019-04-01T00:00:00+00:00",
+    };
+    for (const char* text : filters)
+    {
+        JournalFilter filter;
+        EXPECT_FALSE(parseJournalFilter(text, true, filter)) << text;
+    }
+}
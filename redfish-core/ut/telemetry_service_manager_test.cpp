@@ -0,0 +1,185 @@
+#include "telemetry_service_manager.hpp"
+
+#include <string>
+#include <vector>
+
+#include "gmock/gmock.h"
+
+using namespace redfish;
+
+TEST(TelemetryServiceTest, Durations)
+{
+    std::chrono::milliseconds duration;
+    ASSERT_TRUE(telemetry::parseDuration("PT1M30S", duration));
+    EXPECT_EQ(duration.count(), 90000);
+    ASSERT_TRUE(telemetry::parseDuration("P1DT1H", duration));
+    EXPECT_EQ(duration.count(), 25 * 60 * 60 * 1000);
+    ASSERT_TRUE(telemetry::parseDuration("PT0.5S", duration));
+    EXPECT_EQ(duration.count(), 500);
+
+    ASSERT_TRUE(telemetry::parseDuration("P7D", duration));
+    EXPECT_EQ(duration, telemetry::maxDuration);
+
+    const char* bad[] = {"",    "P",   "PT",  "10S",    "PT5X",
+                         "P5H", "PTS", "P8D", "PT1.S1", "P7DT1S"};
+    for (const char* text : bad)
+    {
+        EXPECT_FALSE(telemetry::parseDuration(text, duration)) << text;
+    }
+    // Too large to convert, or even to be finite
+    EXPECT_FALSE(telemetry::parseDuration("P99999999999999999999D", duration));
+    EXPECT_FALSE(telemetry::parseDuration(
+        "PT" + std::string(400, '9') + "S", duration));
+
+    EXPECT_EQ(telemetry::formatDuration(std::chrono::milliseconds(90000)),
+              "PT90S");
+    EXPECT_EQ(telemetry::formatDuration(std::chrono::milliseconds(1500)),
+              "PT1.5S");
+    EXPECT_EQ(telemetry::formatDuration(std::chrono::milliseconds(1050)),
+              "PT1.05S");
+}
+
+TEST(TelemetryServiceTest, MetricProperties)
+{
+    std::vector<std::string> paths;
+    ASSERT_TRUE(parseMetricProperty("/redfish/v1/Chassis/chassis/Thermal#/"
+                                    "Temperatures/CPU_Temp/ReadingCelsius",
+                                    paths));
+    EXPECT_THAT(paths,
+                ::testing::ElementsAre(
+                    "/xyz/openbmc_project/sensors/temperature/CPU_Temp"));
+
+    ASSERT_TRUE(
+        parseMetricProperty("/redfish/v1/Chassis/c/Thermal#/Fans/Fan0", paths));
+    EXPECT_EQ(paths.size(), 3);
+    EXPECT_EQ(paths[1], "/xyz/openbmc_project/sensors/fan_tach/Fan0");
+
+    const char* bad[] = {
+        "/redfish/v1/Chassis/c/Thermal#/Temperatures",
+        "/redfish/v1/Chassis/c/Power#/Temperatures/CPU_Temp",
+        "/redfish/v1/Chassis/c/Thermal#/Temperatures//ReadingCelsius",
+        "/redfish/v1/Chassis/c/Thermal/Temperatures/CPU_Temp",
+        "/redfish/v1/Systems/system#/Temperatures/CPU_Temp",
+    };
+    for (const char* property : bad)
+    {
+        EXPECT_FALSE(parseMetricProperty(property, paths)) << property;
+    }
+}
+
+TEST(TelemetryServiceTest, RingKeepsTheLatestSamples)
+{
+    MetricRing ring(3);
+    double result = 0;
+    EXPECT_FALSE(ring.aggregate(CollectionFunction::Average, 0, result));
+
+    ring.push(1000, 10);
+    ring.push(2000, 40);
+    ring.push(3000, 20);
+    ring.push(4000, 30);
+    EXPECT_EQ(ring.size(), 3);
+    EXPECT_EQ(ring.latest()->value, 30);
+
+    ASSERT_TRUE(ring.aggregate(CollectionFunction::Average, 0, result));
+    EXPECT_EQ(result, 30);
+    ASSERT_TRUE(ring.aggregate(CollectionFunction::Minimum, 0, result));
+    EXPECT_EQ(result, 20);
+    ASSERT_TRUE(ring.aggregate(CollectionFunction::Maximum, 3000, result));
+    EXPECT_EQ(result, 30);
+    ASSERT_TRUE(ring.aggregate(CollectionFunction::Summation, 3000, result));
+    EXPECT_EQ(result, 50);
+    EXPECT_FALSE(ring.aggregate(CollectionFunction::Average, 5000, result));
+}
+
+TEST(TelemetryServiceTest, MetricSampleCounts)
+{
+    std::chrono::milliseconds second(1000);
+    EXPECT_EQ(Metric::getSampleCount(std::nullopt, second * 60, second), 1);
+    EXPECT_EQ(Metric::getSampleCount(CollectionFunction::Average, second * 60,
+                                     second),
+              61);
+    // The longest duration a definition can ask for, beyond which it's
+    // refused rather than aggregated over fewer samples
+    EXPECT_EQ(Metric::getSampleCount(CollectionFunction::Average,
+                                     second * (Metric::maxSamples - 1),
+                                     second),
+              Metric::maxSamples);
+    EXPECT_GT(Metric::getSampleCount(CollectionFunction::Average,
+                                     telemetry::maxDuration, second),
+              Metric::maxSamples);
+}
+
+TEST(TelemetryServiceTest, DefinitionSamplesOnSchedule)
+{
+    const std::string fan = "/xyz/openbmc_project/sensors/fan_tach/Fan0";
+    const std::string temp = "/xyz/openbmc_project/sensors/temperature/T0";
+    SensorValueCache sensors;
+
+    std::chrono::milliseconds interval(1000);
+    std::vector<Metric> metrics;
+    metrics.emplace_back("FanMax", "/redfish/v1/Chassis/c/Thermal#/Fans/Fan0",
+                         std::vector<std::string>{fan},
+                         CollectionFunction::Maximum,
+                         std::chrono::milliseconds(2000), interval);
+    metrics.emplace_back(
+        "Temp", "/redfish/v1/Chassis/c/Thermal#/Temperatures/T0",
+        std::vector<std::string>{temp}, std::nullopt, interval, interval);
+    MetricReportDefinition definition("Fans", interval, {"RedfishEvent"},
+                                      std::move(metrics));
+
+    sensors.update(fan, 5000);
+    EXPECT_TRUE(definition.sample(10000, sensors));
+    // Not due again until a whole interval has passed
+    EXPECT_FALSE(definition.sample(10500, sensors));
+    sensors.update(fan, 3000);
+    sensors.update(temp, 40.5);
+    EXPECT_TRUE(definition.sample(11000, sensors));
+    sensors.update(fan, 4000);
+    EXPECT_TRUE(definition.sample(12000, sensors));
+    sensors.update(fan, 2000);
+    EXPECT_TRUE(definition.sample(13000, sensors));
+
+    nlohmann::json report;
+    definition.fillReport(report);
+    EXPECT_EQ(report["Id"], "Fans");
+    ASSERT_EQ(report["MetricValues"].size(), 2);
+    // The 5000 RPM sample is out of the window
+    EXPECT_EQ(report["MetricValues"][0]["MetricId"], "FanMax");
+    EXPECT_EQ(report["MetricValues"][0]["MetricValue"], "4000.0");
+    EXPECT_EQ(report["MetricValues"][1]["MetricId"], "Temp");
+    EXPECT_EQ(report["MetricValues"][1]["MetricValue"], "40.5");
+
+    nlohmann::json json;
+    definition.fillDefinition(json);
+    EXPECT_EQ(json["Schedule"]["RecurrenceInterval"], "PT1S");
+    EXPECT_EQ(json["Metrics"][0]["CollectionFunction"], "Maximum");
+    EXPECT_EQ(json["Metrics"][0]["CollectionDuration"], "PT2S");
+    EXPECT_EQ(json["Metrics"][1].count("CollectionFunction"), 0);
+}
+
+TEST(TelemetryServiceTest, ManagerLimitsDefinitions)
+{
+    TelemetryServiceManager& manager = TelemetryServiceManager::getInstance();
+    for (size_t i = 0; i < TelemetryServiceManager::maxReports; i++)
+    {
+        EXPECT_TRUE(
+            manager.addDefinition(std::make_shared<MetricReportDefinition>(
+                std::to_string(i), std::chrono::milliseconds(1000),
+                std::vector<std::string>(), std::vector<Metric>())));
+    }
+    EXPECT_FALSE(manager.addDefinition(std::make_shared<MetricReportDefinition>(
+        "more", std::chrono::milliseconds(1000), std::vector<std::string>(),
+        std::vector<Metric>())));
+
+    size_t reports = 0;
+    manager.sample(1000, [&reports](const MetricReportDefinition&) {
+        reports++;
+    });
+    EXPECT_EQ(reports, TelemetryServiceManager::maxReports);
+
+    for (size_t i = 0; i < TelemetryServiceManager::maxReports; i++)
+    {
+        EXPECT_TRUE(manager.removeDefinition(std::to_string(i)));
+    }
+    EXPECT_EQ(manager.getDefinition("0"), nullptr);
+}
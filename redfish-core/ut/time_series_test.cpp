@@ -0,0 +1,155 @@
+#include "utils/time_series.hpp"
+
+#include <chrono>
+#include <cmath>
+#include <utility>
+#include <vector>
+
+#include "gmock/gmock.h"
+
+using namespace redfish;
+
+namespace
+{
+std::vector<std::pair<uint32_t, double>>
+    readBlock(const time_series::CompressedBlock& block)
+{
+    std::vector<std::pair<uint32_t, double>> samples;
+    block.forEach([&samples](uint32_t timestamp, double value) {
+        samples.emplace_back(timestamp, value);
+    });
+    return samples;
+}
+
+std::vector<std::pair<uint32_t, double>>
+    query(const TimeSeries& series, uint32_t from, uint32_t to)
+{
+    std::vector<std::pair<uint32_t, double>> points;
+    series.query(from, to, [&points](uint32_t timestamp, double value) {
+        points.emplace_back(timestamp, value);
+    });
+    return points;
+}
+} // namespace
+
+TEST(TimeSeriesTest, BlockRoundTrips)
+{
+    std::vector<std::pair<uint32_t, double>> samples = {
+        {1000, 41.5},      {1001, 41.5},       {1002, 41.75},
+        {1005, -3.25},     {1100, 1e300},      {1101, 0.0},
+        {5000, 12345.678}, {100000, 12345.67}, {100001, -0.0},
+        {4000000000, 7.0}};
+    time_series::CompressedBlock block(512);
+    for (const auto& [timestamp, value] : samples)
+    {
+        ASSERT_TRUE(block.append(timestamp, value));
+    }
+    EXPECT_EQ(block.size(), samples.size());
+    EXPECT_EQ(block.firstTimestamp(), 1000);
+    EXPECT_EQ(block.lastTimestamp(), 4000000000);
+    EXPECT_EQ(readBlock(block), samples);
+}
+
+TEST(TimeSeriesTest, RegularReadingsCompress)
+{
+    time_series::CompressedBlock block(512);
+    uint32_t timestamp = 1556668800;
+    size_t samples = 0;
+    // A fan reported every second, wandering within a few RPM
+    while (block.append(timestamp, 4800 + (samples * 7 % 5) * 10))
+    {
+        timestamp++;
+        samples++;
+    }
+    // Uncompressed the samples would take 12 bytes each
+    EXPECT_GT(samples, 512 / 2);
+
+    std::vector<std::pair<uint32_t, double>> read = readBlock(block);
+    ASSERT_EQ(read.size(), samples);
+    for (size_t i = 0; i < samples; i++)
+    {
+        EXPECT_EQ(read[i].first, 1556668800 + i);
+        EXPECT_EQ(read[i].second, 4800 + (i * 7 % 5) * 10);
+    }
+}
+
+TEST(TimeSeriesTest, DownsamplesInFixedMemory)
+{
+    TimeSeries series;
+    const uint32_t start = 1556668800;
+    const uint32_t days = 5;
+    size_t maxMemory = 0;
+    for (uint32_t t = start; t < start + days * 24 * 3600; t += 5)
+    {
+        series.append(t, 40 + std::sin(t / 600.0) * 10);
+        maxMemory = std::max(maxMemory, series.memoryUsage());
+    }
+    EXPECT_LE(maxMemory, sizeof(TimeSeries) +
+                             TimeSeries::resolutions.size() *
+                                 TimeSeries::blocksPerTier *
+                                 (sizeof(time_series::CompressedBlock) +
+                                  TimeSeries::blockBytes));
+
+    const uint32_t end = start + days * 24 * 3600 - 5;
+    std::vector<std::pair<uint32_t, double>> points = query(series, 0, end);
+    ASSERT_FALSE(points.empty());
+    // In order, with the most recent at full resolution and the oldest
+    // averaged into fifteen minute points
+    for (size_t i = 1; i < points.size(); i++)
+    {
+        ASSERT_LT(points[i - 1].first, points[i].first);
+    }
+    EXPECT_EQ(points.back().first, end);
+    EXPECT_EQ(points[1].first - points[0].first, 900);
+    EXPECT_LT(points.front().first, end - 24 * 3600);
+
+    // The last hour is covered at no worse than a minute
+    std::vector<std::pair<uint32_t, double>> hour =
+        query(series, end - 3600, end);
+    ASSERT_GE(hour.size(), 60);
+    EXPECT_LE(hour.front().first, end - 3600 + 60);
+    for (size_t i = 1; i < hour.size(); i++)
+    {
+        EXPECT_LE(hour[i].first - hour[i - 1].first, 60);
+        EXPECT_NEAR(hour[i].second, 40 + std::sin(hour[i].first / 600.0) * 10,
+                    1.0);
+    }
+}
+
+TEST(TimeSeriesTest, QueriesAreFast)
+{
+    std::vector<TimeSeries> sensors(300);
+    for (uint32_t t = 1556668800; t < 1556668800 + 2 * 3600; t++)
+    {
+        for (size_t i = 0; i < sensors.size(); i++)
+        {
+            sensors[i].append(t, static_cast<double>((t + i) % 17));
+        }
+    }
+    size_t memory = 0;
+    for (const TimeSeries& series : sensors)
+    {
+        memory += series.memoryUsage();
+    }
+    EXPECT_LT(memory, 4 * 1024 * 1024);
+
+    auto before = std::chrono::steady_clock::now();
+    std::vector<std::pair<uint32_t, double>> points =
+        query(sensors[0], 1556668800 + 3600, 1556668800 + 2 * 3600);
+    auto elapsed = std::chrono::steady_clock::now() - before;
+    EXPECT_FALSE(points.empty());
+    EXPECT_LT(elapsed, std::chrono::milliseconds(10));
+}
+
+TEST(TimeSeriesTest, IgnoresOutOfOrderReadings)
+{
+    TimeSeries series;
+    series.append(100, 1);
+    series.append(100, 2);
+    series.append(99, 3);
+    series.append(101, 4);
+    EXPECT_THAT(query(series, 0, 1000),
+                ::testing::ElementsAre(std::make_pair(100u, 1.0),
+                                       std::make_pair(101u, 4.0)));
+    EXPECT_TRUE(query(series, 102, 1000).empty());
+}
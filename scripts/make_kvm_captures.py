@@ -0,0 +1,350 @@
+#!/usr/bin/python3
+"""
+Writes synthetic video captures for kvmbench, in the format the ASPEED video
+engine leaves in /dev/video: JPEG blocks with the standard Huffman tables and
+quantization selector 0, and VQ blocks for tiles of up to four colors.
+
+They are drawn, not recorded, so they only stand in for real captures in the
+modes and resolutions we have no recording of.  Each is one full frame, every
+tile in raster order, as the engine sends after a mode change.
+
+usage: make_kvm_captures.py [output directory]
+"""
+
+import math
+import os
+import re
+import struct
+import sys
+
+SCRIPT_DIR = os.path.dirname(os.path.realpath(__file__))
+REPO_DIR = os.path.realpath(os.path.join(SCRIPT_DIR, ".."))
+
+JPEG_NO_SKIP_CODE = 0x0
+VQ_NO_SKIP_CODES = {1: 0x5, 2: 0x6, 4: 0x7}
+FRAME_END_CODE = 0x9
+
+# Quantization selector 0, in natural order, as AstJpegDecoder loads it
+QUANT = [
+    20, 13, 12, 20, 30, 50, 63, 76, 15, 15, 17, 23, 32, 72, 75, 68,
+    17, 16, 20, 30, 50, 71, 86, 70, 17, 21, 27, 36, 63, 108, 100, 77,
+    22, 27, 46, 70, 85, 136, 128, 96, 30, 43, 68, 80, 101, 130, 141, 115,
+    61, 80, 97, 108, 128, 151, 150, 126, 90, 115, 118, 122, 140, 125, 128,
+    123]
+
+ZIGZAG = [
+    0, 1, 8, 16, 9, 2, 3, 10, 17, 24, 32, 25, 18, 11, 4, 5,
+    12, 19, 26, 33, 40, 48, 41, 34, 27, 20, 13, 6, 7, 14, 21, 28,
+    35, 42, 49, 56, 57, 50, 43, 36, 29, 22, 15, 23, 30, 37, 44, 51,
+    58, 59, 52, 45, 38, 31, 39, 46, 53, 60, 61, 54, 47, 55, 62, 63]
+
+COS = [[(math.sqrt(0.5) if u == 0 else 1.0) * 0.5 *
+        math.cos((2 * x + 1) * u * math.pi / 16) for x in range(8)]
+       for u in range(8)]
+
+
+def load_huffman_tables():
+    """Builds symbol -> (code, length) for the tables in JTABLES.H"""
+    with open(os.path.join(REPO_DIR, "include", "aspeed", "JTABLES.H")) as f:
+        source = f.read()
+
+    def array(name):
+        body = re.search(name + r"\[[0-9]*\]\s*=\s*\{(.*?)\}", source, re.S)
+        return [int(v, 0) for v in body.group(1).replace("\n", "").split(",")
+                if v.strip()]
+
+    tables = {}
+    for name in ["DcLuminance", "AcLuminance", "DcChrominance",
+                 "AcChrominance"]:
+        counts = array("std" + name + "Nrcodes")
+        symbols = array("std" + name + "Values")
+        codes = {}
+        code = 0
+        index = 0
+        for length in range(1, 17):
+            for _ in range(counts[length]):
+                codes[symbols[index]] = (code, length)
+                code += 1
+                index += 1
+            code <<= 1
+        tables[name] = codes
+    return tables
+
+
+class BitWriter:
+    """Packs bits MSB first into 32 bit words, as the decoder reads them"""
+
+    def __init__(self):
+        self.words = []
+        self.bits = 0
+        self.count = 0
+
+    def put(self, value, length):
+        self.bits = (self.bits << length) | (value & ((1 << length) - 1))
+        self.count += length
+        while self.count >= 32:
+            self.count -= 32
+            self.words.append((self.bits >> self.count) & 0xFFFFFFFF)
+        self.bits &= (1 << self.count) - 1
+
+    def finish(self):
+        if self.count:
+            self.put(0, 32 - self.count)
+        # The decoder reads ahead of the frame end
+        self.words.extend([0] * 4)
+        return struct.pack("<%dI" % len(self.words), *self.words)
+
+
+def magnitude(value):
+    size = abs(value).bit_length()
+    bits = value if value >= 0 else value + (1 << size) - 1
+    return size, bits
+
+
+def forward_dct(block):
+    """Quantized coefficients of 64 samples, in zigzag order"""
+    rows = [[sum(COS[u][x] * block[y * 8 + x] for x in range(8))
+             for u in range(8)] for y in range(8)]
+    coefs = [0] * 64
+    for v in range(8):
+        for u in range(8):
+            total = sum(COS[v][y] * rows[y][u] for y in range(8))
+            coefs[v * 8 + u] = int(round(total / QUANT[v * 8 + u]))
+    return [coefs[i] for i in ZIGZAG]
+
+
+class Encoder:
+    def __init__(self, tables):
+        self.tables = tables
+        self.out = BitWriter()
+        self.previous_dc = [0, 0, 0]
+        self.colors = [None] * 4
+        self.next_slot = 0
+
+    def block(self, samples, component):
+        if all(s == samples[0] for s in samples):
+            # Flat, so only the DC is left
+            coefs = [int(round((samples[0] - 128) * 8 / QUANT[0]))] + \
+                [0] * 63
+        else:
+            coefs = forward_dct([s - 128 for s in samples])
+        dc_table, ac_table = (("DcLuminance", "AcLuminance")
+                              if component == 0 else
+                              ("DcChrominance", "AcChrominance"))
+        size, bits = magnitude(coefs[0] - self.previous_dc[component])
+        self.previous_dc[component] = coefs[0]
+        self.out.put(*self.tables[dc_table][size])
+        self.out.put(bits, size)
+
+        last = max([i for i in range(1, 64) if coefs[i]], default=0)
+        run = 0
+        for value in coefs[1:last + 1]:
+            if value == 0:
+                run += 1
+                continue
+            while run > 15:
+                self.out.put(*self.tables[ac_table][0xF0])
+                run -= 16
+            size, bits = magnitude(value)
+            self.out.put(*self.tables[ac_table][(run << 4) | size])
+            self.out.put(bits, size)
+            run = 0
+        if last < 63:
+            self.out.put(*self.tables[ac_table][0x00])
+
+    def jpeg(self, planes):
+        self.out.put(JPEG_NO_SKIP_CODE, 4)
+        for samples, component in planes:
+            self.block(samples, component)
+
+    def vq(self, pixels):
+        palette = sorted(set(pixels))
+        count = 1 if len(palette) == 1 else 2 if len(palette) == 2 else 4
+        self.out.put(VQ_NO_SKIP_CODES[count], 4)
+        # A new color can't replace one this block has already picked
+        used = [self.colors.index(c) for c in palette if c in self.colors]
+        for color in palette + palette[-1:] * (count - len(palette)):
+            if color in self.colors:
+                self.out.put(self.colors.index(color), 3)
+                continue
+            while self.next_slot in used:
+                self.next_slot = (self.next_slot + 1) % 4
+            slot = self.next_slot
+            used.append(slot)
+            self.colors[slot] = color
+            packed = (color[0] << 16) | (color[1] << 8) | color[2]
+            self.out.put((1 << 26) | (slot << 24) | packed, 27)
+        bits = {1: 0, 2: 1, 4: 2}[count]
+        if bits:
+            for pixel in pixels:
+                self.out.put(palette.index(pixel), bits)
+
+
+def to_ycbcr(rgb):
+    r, g, b = rgb
+    y = 0.299 * r + 0.587 * g + 0.114 * b
+    cb = 128 - 0.168736 * r - 0.331264 * g + 0.5 * b
+    cr = 128 + 0.5 * r - 0.418688 * g - 0.081312 * b
+    return tuple(min(255, max(0, int(round(c)))) for c in (y, cb, cr))
+
+
+def hash2(x, y, seed):
+    h = (x * 374761393 + y * 668265263 + seed * 2246822519) & 0xFFFFFFFF
+    h = ((h ^ (h >> 13)) * 1274126177) & 0xFFFFFFFF
+    return h ^ (h >> 16)
+
+
+class Canvas:
+    def __init__(self, width, height, color):
+        self.width = width
+        self.height = height
+        self.pixels = [[color] * width for _ in range(height)]
+
+    def fill(self, x0, y0, x1, y1, color):
+        for y in range(max(0, y0), min(self.height, y1)):
+            row = self.pixels[y]
+            for x in range(max(0, x0), min(self.width, x1)):
+                row[x] = color
+
+    def text(self, x0, y0, x1, lines, color, seed, shade=None):
+        """Draws lines of made up 8x16 glyphs.  shade, when given, is drawn
+        beside each stroke, as anti-aliased fonts do."""
+        for line in range(lines):
+            x = x0
+            y = y0 + line * 16
+            words = hash2(line, 0, seed) % 9 + 2
+            for word in range(words):
+                letters = hash2(line, word, seed) % 7 + 2
+                for letter in range(letters):
+                    if x + 8 > x1:
+                        break
+                    glyph = hash2(line * 97 + word, letter, seed)
+                    for gy in range(3, 13):
+                        pattern = hash2(glyph, gy, seed) & 0x3F
+                        for gx in range(6):
+                            if not pattern & (1 << gx):
+                                continue
+                            px, py = x + 1 + gx, y + gy
+                            if px < self.width and py < self.height:
+                                self.pixels[py][px] = color
+                                if shade and px + 1 < self.width and \
+                                        self.pixels[py][px + 1] != color:
+                                    self.pixels[py][px + 1] = shade
+                    x += 8
+                x += 8
+
+
+def desktop(width, height):
+    """A wallpaper with a window of anti-aliased text and a terminal"""
+    canvas = Canvas(width, height, (0, 0, 0))
+    for y in range(height):
+        row = canvas.pixels[y]
+        for x in range(width):
+            wave = math.sin(x * 3.1 / width + y * 1.7 / height)
+            noise = hash2(x, y, 1) % 13 - 6
+            row[x] = (min(255, max(0, int(60 + 50 * wave) + noise)),
+                      min(255, max(0, int(90 + 40 * wave) + noise)),
+                      min(255, max(0, int(150 - 30 * wave) + noise)))
+
+    def sx(v):
+        return v * width // 1920
+
+    def sy(v):
+        return v * height // 1080
+
+    canvas.fill(0, height - sy(40), width, height, (32, 32, 40))
+    for i in range(12):
+        x = sx(12) + i * sx(48)
+        canvas.fill(x, height - sy(34), x + sx(28), height - sy(6),
+                    ((i * 70) % 256, (i * 130) % 256, (i * 40 + 90) % 256))
+
+    canvas.fill(sx(120), sy(80), sx(1020), sy(108), (0, 90, 170))
+    canvas.text(sx(130), sy(86), sx(600), 1, (255, 255, 255), 2)
+    canvas.fill(sx(120), sy(108), sx(1020), sy(680), (250, 250, 250))
+    canvas.text(sx(136), sy(120), sx(1000), (sy(680) - sy(120)) // 16 - 1,
+                (20, 20, 20), 3, shade=(150, 150, 150))
+
+    canvas.fill(sx(900), sy(300), sx(1700), sy(900), (10, 10, 10))
+    canvas.text(sx(910), sy(310), sx(1690), (sy(900) - sy(310)) // 16 - 1,
+                (200, 200, 200), 4)
+    return canvas
+
+
+def console(width, height):
+    """A text mode setup screen, which is nearly all VQ"""
+    blue = (0, 0, 170)
+    grey = (170, 170, 170)
+    canvas = Canvas(width, height, blue)
+    canvas.fill(0, 0, width, 32, grey)
+    canvas.text(16, 8, width - 16, 1, blue, 5)
+    canvas.fill(8, 40, width - 8, 42, grey)
+    canvas.fill(8, height - 42, width - 8, height - 40, grey)
+    canvas.text(24, 56, width * 2 // 3, (height - 120) // 16, grey, 6)
+    canvas.fill(24, 200, width * 2 // 3, 216, (0, 170, 170))
+    canvas.text(24, 200, width * 2 // 3, 1, (255, 255, 255), 7)
+    canvas.fill(width * 2 // 3 + 8, 56, width * 2 // 3 + 10, height - 48,
+                grey)
+    canvas.text(width * 2 // 3 + 24, 56, width - 24, 12, (255, 255, 85), 8)
+    return canvas
+
+
+def encode(canvas, mode, tables):
+    encoder = Encoder(tables)
+    yuv = [[to_ycbcr(p) for p in row] for row in canvas.pixels]
+    tile = 8 if mode == "444" else 16
+    columns = (canvas.width + tile - 1) // tile
+    rows = (canvas.height + tile - 1) // tile
+
+    def pixel(x, y):
+        return yuv[min(y, canvas.height - 1)][min(x, canvas.width - 1)]
+
+    for ty in range(rows):
+        for tx in range(columns):
+            if mode == "444":
+                pixels = [pixel(tx * 8 + i % 8, ty * 8 + i // 8)
+                          for i in range(64)]
+                if len(set(pixels)) <= 4:
+                    encoder.vq(pixels)
+                    continue
+                encoder.jpeg([([p[c] for p in pixels], c) for c in range(3)])
+                continue
+            planes = []
+            for by in range(2):
+                for bx in range(2):
+                    planes.append(([pixel(tx * 16 + bx * 8 + i % 8,
+                                          ty * 16 + by * 8 + i // 8)[0]
+                                    for i in range(64)], 0))
+            for c in (1, 2):
+                chroma = []
+                for i in range(64):
+                    x = tx * 16 + (i % 8) * 2
+                    y = ty * 16 + (i // 8) * 2
+                    total = sum(pixel(x + dx, y + dy)[c]
+                                for dx in range(2) for dy in range(2))
+                    chroma.append((total + 2) // 4)
+                planes.append((chroma, c))
+            encoder.jpeg(planes)
+    encoder.out.put(FRAME_END_CODE, 4)
+    return encoder.out.finish()
+
+
+CAPTURES = [
+    ("synthetic_desktop_444_1920x1080.bin", desktop, "444", 1920, 1080),
+    ("synthetic_desktop_420_1920x1080.bin", desktop, "420", 1920, 1080),
+    ("synthetic_console_444_1024x768.bin", console, "444", 1024, 768),
+]
+
+
+def main():
+    directory = sys.argv[1] if len(sys.argv) > 1 else os.path.join(
+        REPO_DIR, "src", "test_resources")
+    tables = load_huffman_tables()
+    for name, scene, mode, width, height in CAPTURES:
+        data = encode(scene(width, height), mode, tables)
+        with open(os.path.join(directory, name), "wb") as f:
+            f.write(data)
+        print("%s: %d bytes" % (name, len(data)))
+
+
+if __name__ == "__main__":
+    main()
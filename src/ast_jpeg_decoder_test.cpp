@@ -167,4 +167,157 @@ TEST(AstJpegDecoder, BufferLimits)
         EXPECT_EQ(d.outBuffer[i].b, 0x00) << "index:" << i;
         EXPECT_EQ(d.outBuffer[i].g, 0x00) << "index:" << i;
     }
-}
\ No newline at end of file
+}
+#ifdef AST_JPEG_VECTOR_KERNELS
+// The vector kernels have to produce exactly the bytes of the scalar ones
+TEST(AstJpegDecoder, VectorKernelsMatchScalar)
+{
+    const char *files[] = {
+        "test_resources/aspeedbluescreen.bin",
+        "test_resources/aspeedblackscreen.bin",
+        "test_resources/ubuntu_444_800x600_0chrom_0lum.bin"};
+    for (const char *file : files)
+    {
+        ast_video::RawVideoBuffer out;
+        FILE *fp = fopen(file, "rb");
+        ASSERT_NE(fp, nullptr) << file;
+        size_t bufferlen = fread(out.buffer.data(), sizeof(char),
+                                 out.buffer.size() * sizeof(long), fp);
+        fclose(fp);
+
+        ASSERT_GT(bufferlen, 0);
+
+        out.ySelector = 0;
+        out.uvSelector = 0;
+        out.mode = ast_video::YuvMode::YUV444;
+        out.width = 800;
+        out.height = 600;
+
+        ast_video::AstJpegDecoder scalar(false);
+        ast_video::AstJpegDecoder vector(true);
+        scalar.decode(out.buffer, out.width, out.height, out.mode,
+                      out.ySelector, out.uvSelector);
+        vector.decode(out.buffer, out.width, out.height, out.mode,
+                      out.ySelector, out.uvSelector);
+
+        for (size_t i = 0; i < scalar.outBuffer.size(); i++)
+        {
+            const ast_video::RGB &expected = scalar.outBuffer[i];
+            const ast_video::RGB &pixel = vector.outBuffer[i];
+            ASSERT_EQ(pixel.r, expected.r) << file << " index:" << i;
+            ASSERT_EQ(pixel.g, expected.g) << file << " index:" << i;
+            ASSERT_EQ(pixel.b, expected.b) << file << " index:" << i;
+            ASSERT_EQ(pixel.reserved, expected.reserved)
+                << file << " index:" << i;
+        }
+    }
+}
+#endif
+
+TEST(AstJpegDecoder, ThreadedDecodeMatchesSerial)
+{
+    const char *files[] = {
+        "test_resources/aspeedbluescreen.bin",
+        "test_resources/aspeedblackscreen.bin",
+        "test_resources/ubuntu_444_800x600_0chrom_0lum.bin"};
+    ast_video::AstJpegDecoder serial;
+    ast_video::AstJpegDecoder threaded;
+    threaded.setDecodeThreads(4);
+    for (const char *file : files)
+    {
+        ast_video::RawVideoBuffer out;
+        FILE *fp = fopen(file, "rb");
+        ASSERT_NE(fp, nullptr) << file;
+        size_t bufferlen = fread(out.buffer.data(), sizeof(char),
+                                 out.buffer.size() * sizeof(long), fp);
+        fclose(fp);
+
+        ASSERT_GT(bufferlen, 0);
+
+        out.ySelector = 0;
+        out.uvSelector = 0;
+        out.mode = ast_video::YuvMode::YUV444;
+        out.width = 800;
+        out.height = 600;
+
+        serial.decode(out.buffer, out.width, out.height, out.mode,
+                      out.ySelector, out.uvSelector);
+        threaded.decode(out.buffer, out.width, out.height, out.mode,
+                        out.ySelector, out.uvSelector);
+
+        for (size_t i = 0; i < serial.outBuffer.size(); i++)
+        {
+            const ast_video::RGB &expected = serial.outBuffer[i];
+            const ast_video::RGB &pixel = threaded.outBuffer[i];
+            ASSERT_EQ(pixel.r, expected.r) << file << " index:" << i;
+            ASSERT_EQ(pixel.g, expected.g) << file << " index:" << i;
+            ASSERT_EQ(pixel.b, expected.b) << file << " index:" << i;
+        }
+        for (size_t y = 0; y < serial.getTileRows(); y++)
+        {
+            for (size_t x = 0; x < serial.getTileColumns(); x++)
+            {
+                ASSERT_EQ(threaded.isTileDirty(x, y), serial.isTileDirty(x, y))
+                    << file << " tile:" << x << "," << y;
+            }
+        }
+    }
+}
+
+// Decodes every code of the standard tables, with a range of magnitudes, and
+// checks the symbol, the coefficient and the number of bits consumed
+TEST(AstJpegDecoder, HuffmanTablesDecodeEveryCode)
+{
+    struct StandardTable
+    {
+        const ast_video::huffman::Table &table;
+        const unsigned char *counts;
+        const unsigned char *symbols;
+    };
+    const StandardTable tables[] = {
+        {ast_video::huffman::dcLuminance, stdDcLuminanceNrcodes,
+         stdDcLuminanceValues},
+        {ast_video::huffman::acLuminance, stdAcLuminanceNrcodes,
+         stdAcLuminanceValues},
+        {ast_video::huffman::dcChrominance, stdDcChrominanceNrcodes,
+         stdDcChrominanceValues},
+        {ast_video::huffman::acChrominance, stdAcChrominanceNrcodes,
+         stdAcChrominanceValues}};
+    for (const StandardTable &standard : tables)
+    {
+        uint32_t code = 0;
+        size_t index = 0;
+        for (int length = 1; length <= 16; length++)
+        {
+            for (int i = 0; i < standard.counts[length]; i++, code++)
+            {
+                int symbol = standard.symbols[index++];
+                int size = symbol & 0xF;
+                for (uint32_t magnitude = 0; magnitude < (1U << size);
+                     magnitude += size <= 6 ? 1 : 37)
+                {
+                    uint32_t words[3] = {
+                        (code << (32 - length)) |
+                            (size == 0 ? 0 : magnitude << (32 - length - size)),
+                        0xFFFFFFFF, 0};
+                    ast_video::huffman::BitReader reader;
+                    reader.reset(words);
+                    int value = -1;
+                    EXPECT_EQ(ast_video::huffman::decode(
+                                  reader, standard.table, value),
+                              symbol);
+                    // Magnitudes below half the range code negative values
+                    int expected = static_cast<int>(magnitude);
+                    if (size != 0 && magnitude < (1U << (size - 1)))
+                    {
+                        expected -= (1 << size) - 1;
+                    }
+                    EXPECT_EQ(value, expected)
+                        << "code:" << code << " length:" << length;
+                    EXPECT_EQ(reader.valid, 64 - length - size);
+                }
+            }
+            code <<= 1;
+        }
+    }
+}
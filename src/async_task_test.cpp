@@ -0,0 +1,157 @@
+#include "crow.h"
+
+#include "async_task.hpp"
+
+#include <functional>
+#include <memory>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+namespace
+{
+
+using Handler = std::function<void(const boost::system::error_code, int)>;
+
+// Issues one group of calls, whose handlers are left in calls for the test
+// to complete in whatever order it likes, then counts how often it resumes
+struct GroupTask : bmcweb::AsyncTask<GroupTask>
+{
+    GroupTask(boost::asio::io_context& io, crow::Response& res,
+              std::vector<Handler>& calls, size_t count) :
+        AsyncTask(io, res),
+        calls(calls), errors(count), values(count)
+    {
+    }
+
+    void step()
+    {
+        BOOST_ASIO_CORO_REENTER(this)
+        {
+            BOOST_ASIO_CORO_YIELD
+            {
+                Join join = whenAll();
+                for (size_t i = 0; i < values.size(); i++)
+                {
+                    calls.emplace_back(join.add(errors[i], values[i]));
+                }
+            }
+            resumed++;
+        }
+    }
+
+    std::vector<Handler>& calls;
+    std::vector<boost::system::error_code> errors;
+    std::vector<int> values;
+    int resumed = 0;
+};
+
+// Calls and then drops a handler, as a D-Bus connection does with a reply
+void complete(std::vector<Handler>& calls, size_t index,
+              const boost::system::error_code& ec, int value)
+{
+    Handler handler = std::move(calls[index]);
+    calls[index] = nullptr;
+    handler(ec, value);
+}
+
+class AsyncTaskTest : public ::testing::Test
+{
+  protected:
+    void SetUp() override
+    {
+        res.setCompleteRequestHandler([this] { completed = true; });
+        res.setIsAliveHelper([this] { return alive; });
+    }
+
+    // Runs whatever handlers are ready, as many times as the test likes
+    void poll()
+    {
+        io.restart();
+        io.poll();
+    }
+
+    boost::asio::io_context io;
+    crow::Response res;
+    std::vector<Handler> calls;
+    bool alive = true;
+    bool completed = false;
+};
+
+} // namespace
+
+TEST_F(AsyncTaskTest, ResumesOnceTheWholeGroupHasCompleted)
+{
+    auto task = std::make_shared<GroupTask>(io, res, calls, 3);
+    task->run();
+    ASSERT_EQ(calls.size(), 3);
+
+    complete(calls, 2, {}, 20);
+    complete(calls, 0, {}, 0);
+    poll();
+    EXPECT_EQ(task->resumed, 0);
+
+    complete(calls, 1, {}, 10);
+    EXPECT_EQ(task->resumed, 0);
+    poll();
+    EXPECT_EQ(task->resumed, 1);
+    EXPECT_EQ(task->values, std::vector<int>({0, 10, 20}));
+    for (const boost::system::error_code& ec : task->errors)
+    {
+        EXPECT_FALSE(ec);
+    }
+
+    EXPECT_FALSE(completed);
+    task.reset();
+    EXPECT_TRUE(completed);
+}
+
+TEST_F(AsyncTaskTest, EmptyGroupResumesFromTheEventLoop)
+{
+    auto task = std::make_shared<GroupTask>(io, res, calls, 0);
+    task->run();
+    // Never from inside the step() that made the group
+    EXPECT_EQ(task->resumed, 0);
+    poll();
+    EXPECT_EQ(task->resumed, 1);
+}
+
+TEST_F(AsyncTaskTest, GroupKeepsEachCallsError)
+{
+    auto task = std::make_shared<GroupTask>(io, res, calls, 3);
+    task->run();
+
+    complete(calls, 0, boost::system::errc::make_error_code(
+                           boost::system::errc::permission_denied),
+             0);
+    complete(calls, 2, {}, 20);
+    // A handler dropped without being called counts as aborted
+    calls[1] = nullptr;
+    poll();
+
+    EXPECT_EQ(task->resumed, 1);
+    EXPECT_EQ(task->errors[0], boost::system::errc::permission_denied);
+    EXPECT_EQ(task->errors[1], boost::asio::error::operation_aborted);
+    EXPECT_FALSE(task->errors[2]);
+    EXPECT_EQ(task->values[2], 20);
+}
+
+TEST_F(AsyncTaskTest, StopsOnceTheClientHasGoneAway)
+{
+    std::weak_ptr<GroupTask> weak;
+    {
+        auto task = std::make_shared<GroupTask>(io, res, calls, 2);
+        weak = task;
+        task->run();
+    }
+    // The calls in flight are all that keep the task alive
+    EXPECT_FALSE(weak.expired());
+
+    alive = false;
+    complete(calls, 0, {}, 0);
+    complete(calls, 1, {}, 10);
+    poll();
+
+    EXPECT_TRUE(weak.expired());
+    EXPECT_TRUE(completed);
+}
@@ -0,0 +1,258 @@
+#include "byte_range.hpp"
+#include "console_capture.hpp"
+
+#include <fstream>
+#include <iterator>
+#include <string>
+
+#include <gtest/gtest.h>
+
+using crow::ByteRange;
+using crow::RangeResult;
+using crow::obmc_console::CaptureOptions;
+using crow::obmc_console::CaptureSegment;
+using crow::obmc_console::ConsoleCapture;
+using crow::obmc_console::findSegment;
+using crow::obmc_console::listSegments;
+
+TEST(ByteRange, ParsesSingleRanges)
+{
+    ByteRange range;
+    EXPECT_EQ(crow::parseByteRange("bytes=10-19", 100, range),
+              RangeResult::satisfiable);
+    EXPECT_EQ(range.first, 10);
+    EXPECT_EQ(range.last, 19);
+    EXPECT_EQ(crow::contentRange(range, 100), "bytes 10-19/100");
+
+    EXPECT_EQ(crow::parseByteRange("bytes=90-", 100, range),
+              RangeResult::satisfiable);
+    EXPECT_EQ(range.first, 90);
+    EXPECT_EQ(range.last, 99);
+
+    // Ends past the resource are clamped
+    EXPECT_EQ(crow::parseByteRange("bytes=95-200", 100, range),
+              RangeResult::satisfiable);
+    EXPECT_EQ(range.last, 99);
+
+    EXPECT_EQ(crow::parseByteRange("bytes=-30", 100, range),
+              RangeResult::satisfiable);
+    EXPECT_EQ(range.first, 70);
+    EXPECT_EQ(range.last, 99);
+
+    EXPECT_EQ(crow::parseByteRange("bytes=-300", 100, range),
+              RangeResult::satisfiable);
+    EXPECT_EQ(range.first, 0);
+}
+
+TEST(ByteRange, IgnoresOrRejectsOthers)
+{
+    ByteRange range;
+    EXPECT_EQ(crow::parseByteRange("", 100, range), RangeResult::none);
+    EXPECT_EQ(crow::parseByteRange("items=0-1", 100, range),
+              RangeResult::none);
+    EXPECT_EQ(crow::parseByteRange("bytes=0-1,5-6", 100, range),
+              RangeResult::none);
+    EXPECT_EQ(crow::parseByteRange("bytes=5-1", 100, range),
+              RangeResult::none);
+    EXPECT_EQ(crow::parseByteRange("bytes=a-", 100, range),
+              RangeResult::none);
+    EXPECT_EQ(crow::parseByteRange("bytes=100-", 100, range),
+              RangeResult::unsatisfiable);
+    EXPECT_EQ(crow::parseByteRange("bytes=-0", 100, range),
+              RangeResult::unsatisfiable);
+    EXPECT_EQ(crow::parseByteRange("bytes=0-", 0, range),
+              RangeResult::unsatisfiable);
+}
+
+static std::string readFile(const std::filesystem::path& path)
+{
+    std::ifstream in(path, std::ios::binary);
+    return std::string((std::istreambuf_iterator<char>(in)),
+                       std::istreambuf_iterator<char>());
+}
+
+static std::string gunzip(std::string compressed)
+{
+    z_stream stream{};
+    // 16 added to the window bits expects a gzip wrapper
+    inflateInit2(&stream, 15 + 16);
+    std::string out(64 * 1024, '\0');
+    stream.next_in = reinterpret_cast<Bytef*>(&compressed[0]);
+    stream.avail_in = static_cast<uInt>(compressed.size());
+    stream.next_out = reinterpret_cast<Bytef*>(&out[0]);
+    stream.avail_out = static_cast<uInt>(out.size());
+    int ret = inflate(&stream, Z_FINISH);
+    out.resize(stream.total_out);
+    inflateEnd(&stream);
+    return ret == Z_STREAM_END ? out : std::string();
+}
+
+TEST(ConsoleCapture, RotatesAndCompressesSegments)
+{
+    std::filesystem::path dir =
+        std::filesystem::temp_directory_path() / "console_capture_test";
+    std::filesystem::remove_all(dir);
+
+    boost::asio::io_context io;
+    CaptureOptions options;
+    options.segmentSize = 1000;
+    options.maxSegments = 2;
+    options.batchSize = 100;
+
+    std::string all;
+    {
+        ConsoleCapture capture(io, dir, "host", options);
+        for (int i = 0; i < 500; i++)
+        {
+            std::string line = "line " + std::to_string(i) + "\n";
+            capture.append(line.data(), line.size());
+            all += line;
+        }
+        // The rest is written when the capture goes away
+    }
+
+    auto segments = listSegments(dir);
+    ASSERT_EQ(segments.size(), 3);
+    // The two newest closed segments are kept compressed, after which is
+    // the one that was still being written
+    EXPECT_EQ(segments[0].id(), "host.2.gz");
+    EXPECT_TRUE(segments[0].compressed);
+    EXPECT_EQ(segments[1].id(), "host.3.gz");
+    EXPECT_TRUE(segments[1].compressed);
+    EXPECT_EQ(segments[2].id(), "host.4");
+    EXPECT_FALSE(segments[2].compressed);
+
+    std::string kept;
+    for (int i = 0; i < 2; i++)
+    {
+        std::string segment = gunzip(readFile(segments[i].path));
+        EXPECT_EQ(segment.size(), 1000);
+        kept += segment;
+    }
+    kept += readFile(segments[2].path);
+    EXPECT_EQ(kept, all.substr(2000));
+
+    // A new capture closes the last run's segment, compressing it from the
+    // io_context, and starts another
+    options.flushInterval = std::chrono::milliseconds(1);
+    {
+        ConsoleCapture capture(io, dir, "host", options);
+        capture.append("more\n", 5);
+        io.run();
+    }
+    segments = listSegments(dir);
+    ASSERT_EQ(segments.size(), 3);
+    EXPECT_EQ(segments[0].id(), "host.3.gz");
+    EXPECT_EQ(segments[1].id(), "host.4.gz");
+    EXPECT_TRUE(segments[1].compressed);
+    EXPECT_EQ(gunzip(readFile(segments[1].path)), all.substr(4000));
+    EXPECT_EQ(segments[2].id(), "host.5");
+    EXPECT_EQ(readFile(segments[2].path), "more\n");
+
+    std::filesystem::remove_all(dir);
+}
+
+// Reads the bytes of the entry with id in range, as the attachment of a
+// HostConsole entry would serve them, or nothing when there's no such entry
+static std::string readRange(const std::filesystem::path& dir,
+                             const std::string& id, const std::string& range)
+{
+    CaptureSegment segment;
+    if (!findSegment(dir, id, segment))
+    {
+        return std::string();
+    }
+    std::string file = readFile(segment.path);
+    ByteRange bytes;
+    if (crow::parseByteRange(range, file.size(), bytes) !=
+        RangeResult::satisfiable)
+    {
+        return std::string();
+    }
+    return file.substr(bytes.first, bytes.last - bytes.first + 1);
+}
+
+TEST(ConsoleCapture, RangedReadsSeeTheSameBytesAcrossRotation)
+{
+    std::filesystem::path dir =
+        std::filesystem::temp_directory_path() / "console_capture_range_test";
+    for (bool compress : {true, false})
+    {
+        std::filesystem::remove_all(dir);
+        boost::asio::io_context io;
+        CaptureOptions options;
+        options.segmentSize = 1000;
+        options.batchSize = 1;
+        options.compress = compress;
+        ConsoleCapture capture(io, dir, "host", options);
+
+        std::string all;
+        for (int i = 0; i < 200; i++)
+        {
+            all += "line " + std::to_string(i) + "\n";
+        }
+        capture.append(all.data(), 500);
+        std::string first = readRange(dir, "host.0", "bytes=0-99");
+        EXPECT_EQ(first, all.substr(0, 100));
+
+        // The segment is closed between the two halves of the download
+        capture.append(all.data() + 500, all.size() - 500);
+        io.run();
+        std::string second = readRange(dir, "host.0", "bytes=100-199");
+        if (compress)
+        {
+            // It only exists compressed now, under an id of its own, so
+            // the download can't carry on with bytes of the other form
+            EXPECT_EQ(second, "");
+            CaptureSegment segment;
+            ASSERT_TRUE(findSegment(dir, "host.0.gz", segment));
+            EXPECT_TRUE(segment.compressed);
+            EXPECT_EQ(gunzip(readFile(segment.path)), all.substr(0, 1000));
+        }
+        else
+        {
+            EXPECT_EQ(second, all.substr(100, 100));
+        }
+    }
+    std::filesystem::remove_all(dir);
+}
+
+TEST(ConsoleCapture, SegmentLeftInBothFormsIsCompressed)
+{
+    std::filesystem::path dir =
+        std::filesystem::temp_directory_path() / "console_capture_pair_test";
+    std::filesystem::remove_all(dir);
+    std::filesystem::create_directories(dir);
+
+    // As a run that stopped between putting host.0.log.gz in place and
+    // removing host.0.log leaves it
+    boost::asio::io_context io;
+    {
+        CaptureOptions options;
+        options.segmentSize = 10;
+        ConsoleCapture capture(io, dir, "host", options);
+        capture.append("0123456789", 10);
+    }
+    {
+        std::ofstream log(dir / "host.0.log", std::ios::binary);
+        log << "0123456789";
+    }
+
+    auto segments = listSegments(dir);
+    ASSERT_EQ(segments.size(), 1);
+    EXPECT_EQ(segments[0].id(), "host.0.gz");
+    EXPECT_TRUE(segments[0].compressed);
+    CaptureSegment segment;
+    EXPECT_FALSE(findSegment(dir, "host.0", segment));
+
+    // The next capture removes the stale plain form rather than compressing
+    // it again
+    {
+        ConsoleCapture capture(io, dir, "host", CaptureOptions());
+        io.run();
+    }
+    EXPECT_FALSE(std::filesystem::exists(dir / "host.0.log"));
+    EXPECT_EQ(gunzip(readFile(dir / "host.0.log.gz")), "0123456789");
+
+    std::filesystem::remove_all(dir);
+}
@@ -0,0 +1,45 @@
+#include "console_scrollback.hpp"
+
+#include <string>
+
+#include <gtest/gtest.h>
+
+using crow::obmc_console::Scrollback;
+
+TEST(ConsoleScrollback, KeepsEverythingUntilFull)
+{
+    Scrollback scrollback(16);
+    EXPECT_EQ(scrollback.contents(), "");
+    scrollback.append("abc\n", 4);
+    scrollback.append("defghijklmno", 12);
+    EXPECT_EQ(scrollback.size(), 16);
+    EXPECT_EQ(scrollback.contents(), "abc\ndefghijklmno");
+}
+
+TEST(ConsoleScrollback, WrapsToTheMostRecentOutput)
+{
+    Scrollback scrollback(15);
+    for (int i = 0; i < 20; i++)
+    {
+        std::string line = "line " + std::to_string(i) + "\n";
+        scrollback.append(line.data(), line.size());
+    }
+    EXPECT_EQ(scrollback.size(), 15);
+    // The ring holds "ine 18\nline 19\n", and the partial line is skipped
+    EXPECT_EQ(scrollback.contents(), "line 19\n");
+}
+
+TEST(ConsoleScrollback, KeepsTheTailOfLargeWrites)
+{
+    Scrollback scrollback(8);
+    std::string big = "0123456789\nabcdefg";
+    scrollback.append("xy", 2);
+    scrollback.append(big.data(), big.size());
+    EXPECT_EQ(scrollback.size(), 8);
+    EXPECT_EQ(scrollback.contents(), "abcdefg");
+
+    // Output without a newline is kept whole
+    Scrollback unbroken(4);
+    unbroken.append("abcdefgh", 8);
+    EXPECT_EQ(unbroken.contents(), "efgh");
+}
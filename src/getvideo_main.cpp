@@ -55,6 +55,7 @@ int main()
     fclose(fp);
 
     ast_video::AstJpegDecoder d;
+    d.setDecodeThreads(std::thread::hardware_concurrency());
     d.decode(out.buffer, out.width, out.height, out.mode, out.ySelector,
              out.uvSelector);
 #ifdef BUILD_CIMG
@@ -111,4 +111,64 @@ TEST(Kvm, BasicRfb)
     EXPECT_EQ(open_string, "RFB 003.008");
 
     app.stop();
-}
\ No newline at end of file
+}
+
+TEST(Kvm, SnapshotPng)
+{
+    // A 4x2 image: a red row over a row of two blue and two white pixels
+    std::vector<ast_video::RGB> pixels(4 * 2);
+    for (size_t x = 0; x < 4; x++)
+    {
+        pixels[x] = {0, 0, 255, 0};
+        pixels[4 + x] = x < 2 ? ast_video::RGB{255, 0, 0, 0}
+                              : ast_video::RGB{255, 255, 255, 0};
+    }
+
+    // Returns the image data of a PNG, unfiltered
+    auto decode = [](const std::string& png, size_t width, size_t height) {
+        EXPECT_EQ(png.compare(0, 8, "\x89PNG\r\n\x1a\n", 8), 0);
+        EXPECT_EQ(png.compare(12, 4, "IHDR"), 0);
+        boost::endian::big_uint32_t size[2];
+        std::memcpy(size, &png[16], sizeof(size));
+        EXPECT_EQ(size[0], width);
+        EXPECT_EQ(size[1], height);
+
+        // IDAT follows the 25 byte IHDR chunk
+        boost::endian::big_uint32_t length;
+        std::memcpy(&length, &png[33], 4);
+        EXPECT_EQ(png.compare(37, 4, "IDAT"), 0);
+        std::string filtered(height * (1 + width * 3), 0);
+        uLongf filteredSize = filtered.size();
+        EXPECT_EQ(uncompress(reinterpret_cast<Bytef*>(&filtered[0]),
+                             &filteredSize,
+                             reinterpret_cast<const Bytef*>(&png[41]), length),
+                  Z_OK);
+        std::vector<uint8_t> rgb;
+        for (size_t y = 0; y < height; y++)
+        {
+            const char* row = &filtered[y * (1 + width * 3)];
+            EXPECT_EQ(row[0], 1); // Sub filter
+            for (size_t i = 0; i < width * 3; i++)
+            {
+                uint8_t left = i < 3 ? 0 : rgb[rgb.size() - 3];
+                rgb.push_back(static_cast<uint8_t>(left + row[1 + i]));
+            }
+        }
+        EXPECT_EQ(png.compare(png.size() - 8, 4, "IEND"), 0);
+        return rgb;
+    };
+
+    std::vector<uint8_t> full =
+        decode(crow::kvm::encodePng(pixels.data(), 4, 4, 2), 4, 2);
+    EXPECT_THAT(full, ElementsAre(255, 0, 0, 255, 0, 0, 255, 0, 0, 255, 0, 0,
+                                  0, 0, 255, 0, 0, 255, 255, 255, 255, 255,
+                                  255, 255));
+
+    // Each pixel of the half size image averages a 2x2 square
+    std::vector<uint8_t> half =
+        decode(crow::kvm::encodePng(pixels.data(), 4, 4, 2, 2), 2, 1);
+    EXPECT_THAT(half, ElementsAre(128, 0, 128, 255, 128, 128));
+
+    // No video signal captures a frame with no pixels
+    EXPECT_TRUE(crow::kvm::encodePng(pixels.data(), 4, 0, 2, 2).empty());
+}
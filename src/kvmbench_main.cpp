@@ -0,0 +1,442 @@
+// Replays recorded video captures through the KVM pipeline: decode (which
+// includes the dirty tile comparison), merging the dirty tiles into
+// rectangles, and RFB encoding with the Raw and ZRLE encodings.  It reports
+// throughput and the time each stage takes per pixel, and can save a run as
+// a baseline and fail when a later run is slower or decodes differently.
+//
+// Captures are the raw buffers read from /dev/video.  They don't record the
+// mode and resolution, so those come from the file name, as in
+// ubuntu_444_800x600_0chrom_0lum.bin or desktop_420_1920x1080.bin; names
+// without them are taken as 800x600 YUV444.
+//
+// With no captures given it replays the test_resources directory of the
+// source tree, which the build passes in as KVMBENCH_CORPUS, so it can be run
+// from any directory.
+#include <algorithm>
+#include <ast_jpeg_decoder.hpp>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem.hpp>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <kvm_encodings.hpp>
+#include <map>
+#include <regex>
+#include <string>
+#include <vector>
+
+namespace fs = std::filesystem;
+
+#ifndef KVMBENCH_CORPUS
+#define KVMBENCH_CORPUS "test_resources"
+#endif
+
+namespace
+{
+
+enum Stage
+{
+    decodeStage,
+    rectsStage,
+    rawStage,
+    zrleStage,
+    deflateStage,
+    stageCount
+};
+
+const char* stageNames[stageCount] = {"decode", "rects", "raw", "zrle",
+                                      "deflate"};
+
+// Differences smaller than this are timer noise, even if they're large
+// relative to a fast stage
+constexpr double noiseNsPerPixel = 0.1;
+
+struct Capture
+{
+    std::string name;
+    ast_video::RawVideoBuffer raw;
+    size_t bytes = 0;
+};
+
+struct Result
+{
+    size_t frames = 0;
+    size_t pixels = 0;
+    size_t bytes = 0;
+    std::chrono::nanoseconds stageTime[stageCount]{};
+    // FNV-1a of the decoded pixels and the ZRLE tile data of the first pass,
+    // which is the same however many passes are run
+    uint64_t digest = 14695981039346656037ULL;
+};
+
+void hash(uint64_t& digest, const void* data, size_t size)
+{
+    const uint8_t* bytes = static_cast<const uint8_t*>(data);
+    for (size_t i = 0; i < size; i++)
+    {
+        digest = (digest ^ bytes[i]) * 1099511628211ULL;
+    }
+}
+
+bool loadCapture(const fs::path& path, Capture& capture)
+{
+    std::ifstream file(path.string(), std::ios::binary);
+    if (!file)
+    {
+        std::cerr << "Can't open " << path << "\n";
+        return false;
+    }
+    file.read(reinterpret_cast<char*>(capture.raw.buffer.data()),
+              capture.raw.buffer.size() * sizeof(uint32_t));
+    capture.bytes = static_cast<size_t>(file.gcount());
+    if (capture.bytes == 0)
+    {
+        std::cerr << "Empty capture " << path << "\n";
+        return false;
+    }
+
+    capture.name = path.filename().string();
+    capture.raw.mode = ast_video::YuvMode::YUV444;
+    capture.raw.width = 800;
+    capture.raw.height = 600;
+    capture.raw.ySelector = 0;
+    capture.raw.uvSelector = 0;
+    std::smatch match;
+    static const std::regex format("_(444|420)_([0-9]+)x([0-9]+)");
+    if (std::regex_search(capture.name, match, format))
+    {
+        capture.raw.mode = match[1] == "420" ? ast_video::YuvMode::YUV420
+                                             : ast_video::YuvMode::YUV444;
+        capture.raw.width = std::stoi(match[2]);
+        capture.raw.height = std::stoi(match[3]);
+    }
+    return true;
+}
+
+// Runs one capture through every stage, adding the time each took to result
+void replay(ast_video::AstJpegDecoder& decoder,
+            crow::kvm::ZrleTileEncoder& tileEncoder,
+            crow::kvm::ZrleStream& zrle, Capture& capture, Result& result)
+{
+    using clock = std::chrono::steady_clock;
+    ast_video::RawVideoBuffer& raw = capture.raw;
+    const crow::kvm::ClientPixelFormat format;
+
+    auto start = clock::now();
+    decoder.decode(raw.buffer, raw.width, raw.height, raw.mode,
+                   raw.ySelector, raw.uvSelector);
+    auto decoded = clock::now();
+
+    const size_t columns = decoder.getTileColumns();
+    const size_t rows = decoder.getTileRows();
+    std::vector<uint8_t> tiles(columns * rows);
+    for (size_t y = 0; y < rows; y++)
+    {
+        for (size_t x = 0; x < columns; x++)
+        {
+            tiles[y * columns + x] = decoder.isTileDirty(x, y) ? 1 : 0;
+        }
+    }
+    std::vector<crow::kvm::TileRect> rects =
+        crow::kvm::mergeTiles(tiles, columns, rows);
+    auto merged = clock::now();
+
+    const size_t tileSize = decoder.tileSize();
+    const size_t stride = columns * tileSize;
+    std::string out;
+    std::string tileData;
+    std::chrono::nanoseconds stageTime[stageCount]{};
+    const bool firstPass = result.frames == 0;
+    for (const crow::kvm::TileRect& rect : rects)
+    {
+        size_t x = rect.x * tileSize;
+        size_t y = rect.y * tileSize;
+        size_t width = std::min<size_t>(rect.width * tileSize, raw.width - x);
+        size_t height =
+            std::min<size_t>(rect.height * tileSize, raw.height - y);
+        const ast_video::RGB* origin = &decoder.outBuffer[y * stride + x];
+
+        auto rectStart = clock::now();
+        out.clear();
+        crow::kvm::encodeRaw(origin, stride, width, height, format, 0xFF,
+                             out);
+        auto rawDone = clock::now();
+        tileData.clear();
+        tileEncoder.encode(origin, stride, width, height, format, 0xFF,
+                           tileData);
+        auto tilesDone = clock::now();
+        out.clear();
+        zrle.compress(tileData, out);
+        auto compressed = clock::now();
+
+        stageTime[rawStage] += rawDone - rectStart;
+        stageTime[zrleStage] += tilesDone - rawDone;
+        stageTime[deflateStage] += compressed - tilesDone;
+        if (firstPass)
+        {
+            hash(result.digest, tileData.data(), tileData.size());
+        }
+    }
+
+    stageTime[decodeStage] = decoded - start;
+    stageTime[rectsStage] = merged - decoded;
+    for (size_t stage = 0; stage < stageCount; stage++)
+    {
+        result.stageTime[stage] += stageTime[stage];
+    }
+    for (size_t y = 0; firstPass && y < raw.height; y++)
+    {
+        hash(result.digest, &decoder.outBuffer[y * stride],
+             raw.width * sizeof(ast_video::RGB));
+    }
+    result.frames++;
+    result.pixels += raw.width * raw.height;
+    result.bytes += capture.bytes;
+}
+
+double nsPerPixel(const Result& result, size_t stage)
+{
+    return static_cast<double>(result.stageTime[stage].count()) /
+           static_cast<double>(result.pixels);
+}
+
+void report(const std::string& name, const Result& result)
+{
+    std::chrono::nanoseconds total{};
+    for (const std::chrono::nanoseconds& time : result.stageTime)
+    {
+        total += time;
+    }
+    double seconds = std::chrono::duration<double>(total).count();
+    std::cout << std::left << std::setw(40) << name << std::right
+              << std::fixed << std::setprecision(1) << std::setw(9)
+              << result.frames / seconds << std::setw(9)
+              << result.bytes / seconds / 1e6 << std::setprecision(2);
+    for (size_t stage = 0; stage < stageCount; stage++)
+    {
+        std::cout << std::setw(9) << nsPerPixel(result, stage);
+    }
+    std::cout << "  " << std::hex << std::setw(16) << std::setfill('0')
+              << result.digest << std::dec << std::setfill(' ') << "\n";
+}
+
+void usage()
+{
+    std::cerr
+        << "Usage: kvmbench [options] [capture or directory...]\n"
+           "  --frames N       replay the corpus N times (default 20)\n"
+           "  --threads N      decode with N threads (default 1)\n"
+           "  --save FILE      save the results as a baseline\n"
+           "  --baseline FILE  fail if slower than, or different from, a\n"
+           "                   saved baseline\n"
+           "  --tolerance P    percent a stage may be slower than the\n"
+           "                   baseline (default 10)\n"
+           "Captures default to " KVMBENCH_CORPUS "\n";
+}
+
+} // namespace
+
+int main(int argc, char** argv)
+{
+    size_t passes = 20;
+    size_t threads = 1;
+    double tolerance = 10;
+    std::string savePath;
+    std::string baselinePath;
+    std::vector<fs::path> paths;
+    for (int i = 1; i < argc; i++)
+    {
+        std::string arg = argv[i];
+        if (arg == "--help")
+        {
+            usage();
+            return 0;
+        }
+        if (arg.compare(0, 2, "--") == 0)
+        {
+            if (i + 1 == argc)
+            {
+                usage();
+                return 2;
+            }
+            std::string value = argv[++i];
+            if (arg == "--frames")
+            {
+                passes = std::max(1, std::atoi(value.c_str()));
+            }
+            else if (arg == "--threads")
+            {
+                threads = std::max(1, std::atoi(value.c_str()));
+            }
+            else if (arg == "--save")
+            {
+                savePath = value;
+            }
+            else if (arg == "--baseline")
+            {
+                baselinePath = value;
+            }
+            else if (arg == "--tolerance")
+            {
+                tolerance = std::atof(value.c_str());
+            }
+            else
+            {
+                usage();
+                return 2;
+            }
+            continue;
+        }
+        paths.emplace_back(arg);
+    }
+    if (paths.empty())
+    {
+        paths.emplace_back(KVMBENCH_CORPUS);
+    }
+
+    std::vector<fs::path> files;
+    for (const fs::path& path : paths)
+    {
+        if (!fs::is_directory(path))
+        {
+            files.push_back(path);
+            continue;
+        }
+        for (const fs::directory_entry& entry : fs::directory_iterator(path))
+        {
+            if (entry.path().extension() == ".bin")
+            {
+                files.push_back(entry.path());
+            }
+        }
+    }
+    // Directory order isn't stable, and the replay order changes the results
+    std::sort(files.begin(), files.end());
+
+    std::vector<std::unique_ptr<Capture>> corpus;
+    for (const fs::path& file : files)
+    {
+        auto capture = std::make_unique<Capture>();
+        if (!loadCapture(file, *capture))
+        {
+            return 2;
+        }
+        corpus.push_back(std::move(capture));
+    }
+    if (corpus.empty())
+    {
+        std::cerr << "No captures found\n";
+        return 2;
+    }
+
+    // The corpus is replayed in order like a recording, so each frame is
+    // compared against the one before it, as the KVM server would
+    ast_video::AstJpegDecoder decoder;
+    decoder.setDecodeThreads(threads);
+    crow::kvm::ZrleTileEncoder tileEncoder;
+    crow::kvm::ZrleStream zrle;
+    std::vector<Result> results(corpus.size());
+    for (size_t pass = 0; pass < passes; pass++)
+    {
+        for (size_t i = 0; i < corpus.size(); i++)
+        {
+            replay(decoder, tileEncoder, zrle, *corpus[i], results[i]);
+        }
+    }
+
+    Result total;
+    total.digest = 0;
+    std::cout << std::left << std::setw(40) << "capture" << std::right
+              << std::setw(9) << "frames/s" << std::setw(9) << "MB/s";
+    for (const char* stage : stageNames)
+    {
+        std::cout << std::setw(9) << stage;
+    }
+    std::cout << "  (ns/pixel)\n";
+    for (size_t i = 0; i < corpus.size(); i++)
+    {
+        const Result& result = results[i];
+        report(corpus[i]->name, result);
+        total.frames += result.frames;
+        total.pixels += result.pixels;
+        total.bytes += result.bytes;
+        for (size_t stage = 0; stage < stageCount; stage++)
+        {
+            total.stageTime[stage] += result.stageTime[stage];
+        }
+        total.digest ^= result.digest;
+    }
+    report("total", total);
+
+    if (!savePath.empty())
+    {
+        std::ofstream save(savePath);
+        for (size_t i = 0; i < corpus.size(); i++)
+        {
+            save << corpus[i]->name << " digest " << std::hex
+                 << results[i].digest << std::dec << "\n";
+            for (size_t stage = 0; stage < stageCount; stage++)
+            {
+                save << corpus[i]->name << " " << stageNames[stage] << " "
+                     << nsPerPixel(results[i], stage) << "\n";
+            }
+        }
+    }
+
+    if (baselinePath.empty())
+    {
+        return 0;
+    }
+    std::ifstream baseline(baselinePath);
+    if (!baseline)
+    {
+        std::cerr << "Can't open baseline " << baselinePath << "\n";
+        return 2;
+    }
+    std::map<std::string, size_t> byName;
+    for (size_t i = 0; i < corpus.size(); i++)
+    {
+        byName[corpus[i]->name] = i;
+    }
+    bool regressed = false;
+    std::string name;
+    std::string key;
+    std::string value;
+    while (baseline >> name >> key >> value)
+    {
+        auto found = byName.find(name);
+        if (found == byName.end())
+        {
+            continue;
+        }
+        const Result& result = results[found->second];
+        if (key == "digest")
+        {
+            if (std::stoull(value, nullptr, 16) != result.digest)
+            {
+                std::cout << name << ": output differs from the baseline\n";
+                regressed = true;
+            }
+            continue;
+        }
+        auto stage = std::find(std::begin(stageNames), std::end(stageNames),
+                               key) -
+                     std::begin(stageNames);
+        if (stage == stageCount)
+        {
+            continue;
+        }
+        double expected = std::stod(value);
+        double actual = nsPerPixel(result, stage);
+        if (actual > expected * (1 + tolerance / 100) + noiseNsPerPixel)
+        {
+            std::cout << name << ": " << key << " took " << actual
+                      << " ns/pixel, baseline " << expected << "\n";
+            regressed = true;
+        }
+    }
+    return regressed ? 1 : 0;
+}